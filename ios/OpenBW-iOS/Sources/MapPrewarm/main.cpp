@@ -0,0 +1,256 @@
+// main.cpp
+// openbw_map_prewarm: map images for the shipped maps, built ahead of time
+//
+// Host command-line tool (no Foundation/UIKit). Loads the game data once, then
+// for each map and each pair of races the app starts games with, sets the
+// game up twice through the engine's melee setup (see MeleeSetup.h) into
+// states of their own and writes its map image (see MapImageSchema.h),
+// audited against the second setup, to the output directory. Images are named
+// by the game's key and the game data key, the same names the app looks up in
+// its bundle's MapImages folder, so a game start on a shipped map reads the
+// image instead of loading the map.
+//
+// Usage:
+//   openbw_map_prewarm --data <dir with MPQs> --output <dir> <map or dir>...
+
+#define OPENBW_HEADLESS 1
+
+#include "bwgame.h"
+#include "data_loading.h"
+
+#include "ArchiveService.h"
+#include "MapImageSchema.h"
+#include "MapStateCache.h"
+#include "MeleeSetup.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace openbw_ios;
+
+// Must match the app's kMapStateVersion, which both keys are built with
+constexpr uint64_t kMapStateVersion = 1;
+
+struct options {
+    std::string data_dir;
+    std::string output_dir;
+    std::vector<std::string> inputs;
+};
+
+struct loaded_map {
+    std::unique_ptr<bwgame::game_state> game = std::make_unique<bwgame::game_state>();
+    std::unique_ptr<bwgame::state> st = std::make_unique<bwgame::state>();
+};
+
+// The races of the games the app starts: any for the player, and protoss or
+// zerg for the computer depending on difficulty
+const bwgame::race_t human_races[] = {bwgame::race_t::terran, bwgame::race_t::protoss, bwgame::race_t::zerg};
+const bwgame::race_t computer_races[] = {bwgame::race_t::protoss, bwgame::race_t::zerg};
+
+// A game set up into a state of its own on the shared game data
+std::unique_ptr<loaded_map> load_game(const replay_header& header, const std::vector<uint8_t>& chk,
+                                      bwgame::global_state& global_st) {
+    auto loaded = std::make_unique<loaded_map>();
+    loaded->st->global = &global_st;
+    loaded->st->game = loaded->game.get();
+    bwgame::action_state action_st;
+    load_melee_game(*loaded->st, action_st, header, chk);
+    return loaded;
+}
+
+std::vector<uint8_t> read_map_chk(const std::string& path) {
+    bwgame::data_loading::mpq_file<> mpq(bwgame::a_string(path.begin(), path.end()));
+    bwgame::a_vector<uint8_t> data;
+    mpq(data, "staredit\\scenario.chk");
+    return std::vector<uint8_t>(data.begin(), data.end());
+}
+
+// The file name without directory or extension, as the app names the map
+std::string map_name(const std::string& path) {
+    std::string file = path.substr(path.find_last_of('/') + 1);
+    return file.substr(0, file.find_last_of('.'));
+}
+
+bool has_extension(const std::string& name, const char* extension) {
+    size_t n = std::strlen(extension);
+    if (name.size() < n) return false;
+    std::string tail = name.substr(name.size() - n);
+    for (char& c : tail) c = (char)tolower((unsigned char)c);
+    return tail == extension;
+}
+
+// Maps in a directory tree, or the path itself if it is a file
+void collect_maps(const std::string& path, std::vector<std::string>& out) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        std::fprintf(stderr, "warning: %s not found\n", path.c_str());
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        out.push_back(path);
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    std::vector<std::string> children;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.empty() || name[0] == '.') continue;
+        std::string child = path + "/" + name;
+        if (has_extension(name, ".scm") || has_extension(name, ".scx") ||
+            (stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))) {
+            children.push_back(child);
+        }
+    }
+    closedir(dir);
+    std::sort(children.begin(), children.end());
+    for (const std::string& child : children) collect_maps(child, out);
+}
+
+// The game's archives in priority order, matched case-insensitively
+std::vector<std::string> find_archives(const std::string& data_dir) {
+    std::vector<std::string> paths;
+    for (const char* wanted : {"patch_rt.mpq", "broodat.mpq", "stardat.mpq"}) {
+        DIR* dir = opendir(data_dir.c_str());
+        if (!dir) break;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            for (char& c : name) c = (char)tolower((unsigned char)c);
+            if (name == wanted) {
+                paths.push_back(data_dir + "/" + entry->d_name);
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return paths;
+}
+
+void usage() {
+    std::fprintf(stderr, "usage: openbw_map_prewarm --data <dir> --output <dir> <map or dir>...\n");
+}
+
+bool parse_options(int argc, char** argv, options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--data" && (v = value())) o.data_dir = v;
+        else if (arg == "--output" && (v = value())) o.output_dir = v;
+        else if (!arg.empty() && arg[0] != '-') o.inputs.push_back(arg);
+        else return false;
+    }
+    return !o.data_dir.empty() && !o.output_dir.empty() && !o.inputs.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<std::string> maps;
+    for (const std::string& input : opts.inputs) collect_maps(input, maps);
+    if (maps.empty()) {
+        std::fprintf(stderr, "no maps found\n");
+        return 1;
+    }
+
+    archive_service archives;
+    auto global_st = std::make_unique<bwgame::global_state>();
+    uint64_t data_key = 0;
+    try {
+        std::vector<std::string> mpqs = find_archives(opts.data_dir);
+        if (mpqs.empty()) throw std::runtime_error("no game archives in " + opts.data_dir);
+        archives.open(mpqs);
+        bwgame::global_init(*global_st, archives.data_loader());
+        data_key = map_data_key(mpqs, kMapStateVersion);
+        if (data_key == 0) throw std::runtime_error("could not read the game archives");
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "could not load game data: %s\n", e.what());
+        return 1;
+    }
+
+    size_t failed = 0;
+    size_t images = 0;
+    for (size_t i = 0; i < maps.size(); ++i) {
+        const std::string& path = maps[i];
+        std::vector<uint8_t> chk;
+        uint64_t map_key = 0;
+        try {
+            map_key = map_state_cache<int>::content_key(path, kMapStateVersion);
+            if (map_key == 0) throw std::runtime_error("cannot read the map");
+            chk = read_map_chk(path);
+        }
+        catch (const std::exception& e) {
+            ++failed;
+            std::fprintf(stderr, "[%zu/%zu] %s: %s\n", i + 1, maps.size(), path.c_str(), e.what());
+            continue;
+        }
+
+        for (bwgame::race_t human : human_races) {
+            for (bwgame::race_t computer : computer_races) {
+                std::string error;
+                double load_ms = 0;
+                double read_ms = 0;
+                size_t bytes = 0;
+                try {
+                    replay_header header;
+                    if (!melee_game_header(chk, map_name(path), human, computer, header)) {
+                        throw std::runtime_error("the map has no dimensions");
+                    }
+                    uint64_t key = melee_game_key(map_key, header);
+                    auto start = std::chrono::steady_clock::now();
+                    std::unique_ptr<loaded_map> first = load_game(header, chk, *global_st);
+                    load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    std::unique_ptr<loaded_map> second = load_game(header, chk, *global_st);
+
+                    state_image_writer writer;
+                    std::string image_path = opts.output_dir + "/" + map_image_file_name(key, data_key);
+                    if (!write_map_image(writer, *first->st, *second->st, key, error)) throw std::runtime_error(error);
+                    if (!writer.write(image_path)) throw std::runtime_error("cannot write " + image_path);
+                    bytes = writer.finish().size();
+
+                    // Read it back, as the app would instead of setting the game up
+                    loaded_map restored;
+                    restored.st->global = global_st.get();
+                    restored.st->game = restored.game.get();
+                    state_image_reader reader;
+                    start = std::chrono::steady_clock::now();
+                    if (!reader.open(image_path, map_image_schema::get().key, error) ||
+                        !read_map_image(reader, *restored.st, key, error)) {
+                        throw std::runtime_error("image does not read back: " + error);
+                    }
+                    read_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                }
+                catch (const std::exception& e) {
+                    ++failed;
+                    std::fprintf(stderr, "[%zu/%zu] %s (races %d/%d): %s\n", i + 1, maps.size(), path.c_str(),
+                                 (int)human, (int)computer, e.what());
+                    continue;
+                }
+                ++images;
+                std::fprintf(stderr, "[%zu/%zu] %s (races %d/%d): setup %.1f ms, image read %.1f ms, %.1f KB\n",
+                             i + 1, maps.size(), path.c_str(), (int)human, (int)computer, load_ms, read_ms,
+                             bytes / 1024.0);
+            }
+        }
+    }
+    std::fprintf(stderr, "%zu maps, %zu images, %zu failed\n", maps.size(), images, failed);
+    return images == 0 ? 1 : 0;
+}
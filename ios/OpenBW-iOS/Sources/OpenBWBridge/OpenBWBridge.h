@@ -11,6 +11,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 /// Represents a unit in the game
 @interface OpenBWUnit : NSObject
+/// Stable unit handle (slot + generation); never reused for another unit
 @property (nonatomic, readonly) int unitId;
 @property (nonatomic, readonly) int typeId;
 @property (nonatomic, readonly) int playerId;
@@ -42,6 +43,27 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, assign) BOOL enableMusic;
 @end
 
+/// How the background game loop reacts when a frame misses its deadline
+typedef NS_ENUM(NSInteger, OpenBWFramePacingPolicy) {
+    /// Drop missed frames and resynchronize (game slows down under load)
+    OpenBWFramePacingPolicySkip = 0,
+    /// Run missed frames back to back, up to maxCatchUpFrames
+    OpenBWFramePacingPolicyCatchUp = 1,
+};
+
+/// Timing statistics published by the background game loop
+@interface OpenBWFrameTimingStats : NSObject
+@property (nonatomic, readonly) uint64_t frames;
+@property (nonatomic, readonly) uint64_t overruns;
+@property (nonatomic, readonly) uint64_t skippedFrames;
+@property (nonatomic, readonly) double lastJitterMicroseconds;
+@property (nonatomic, readonly) double meanJitterMicroseconds;
+@property (nonatomic, readonly) double maxJitterMicroseconds;
+@property (nonatomic, readonly) double lastFrameMicroseconds;
+@property (nonatomic, readonly) double maxFrameMicroseconds;
+@property (nonatomic, readonly) double maxOverrunMicroseconds;
+@end
+
 /// Delegate for receiving game events
 @protocol OpenBWGameDelegate <NSObject>
 @optional
@@ -83,6 +105,15 @@ NS_ASSUME_NONNULL_BEGIN
 /// Stop the current game
 - (void)stop;
 
+/// Game loop pacing (applies to the next and the currently running loop)
+@property (nonatomic, assign) OpenBWFramePacingPolicy framePacingPolicy;
+
+/// Maximum number of missed frames run back to back with OpenBWFramePacingPolicyCatchUp
+@property (nonatomic, assign) int maxCatchUpFrames;
+
+/// Jitter and overrun statistics for the current game loop (nil if no loop has run)
+@property (nonatomic, readonly, nullable) OpenBWFrameTimingStats* frameTimingStats;
+
 // Input Flow:
 // 1. TouchInputManager (gesture recognition in Swift)
 // 2. GameController (command routing in Swift)
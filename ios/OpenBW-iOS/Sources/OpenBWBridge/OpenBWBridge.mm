@@ -14,6 +14,7 @@
 
 // Include game runner
 #import "OpenBWGameRunner.h"
+#include "FrameScheduler.h"
 
 // Namespace aliases for convenience
 namespace bw = bwgame;
@@ -106,6 +107,28 @@ namespace bw = bwgame;
 
 @end
 
+#pragma mark - OpenBWFrameTimingStats Implementation
+
+@implementation OpenBWFrameTimingStats
+
+- (instancetype)initWithStats:(const openbw_ios::frame_scheduler_stats&)stats {
+    self = [super init];
+    if (self) {
+        _frames = stats.frames;
+        _overruns = stats.overruns;
+        _skippedFrames = stats.skipped_frames;
+        _lastJitterMicroseconds = stats.last_jitter_us;
+        _meanJitterMicroseconds = stats.mean_jitter_us;
+        _maxJitterMicroseconds = stats.max_jitter_us;
+        _lastFrameMicroseconds = stats.last_frame_us;
+        _maxFrameMicroseconds = stats.max_frame_us;
+        _maxOverrunMicroseconds = stats.max_overrun_us;
+    }
+    return self;
+}
+
+@end
+
 #pragma mark - OpenBWConfig Implementation
 
 @implementation OpenBWConfig
@@ -148,9 +171,8 @@ namespace bw = bwgame;
     float _cameraY;
     float _zoomLevel;
 
-    // Selection state
-    std::vector<int> _selectedUnits;
-    std::vector<std::vector<int>> _controlGroups;
+    // Deadline scheduler driving the background game loop
+    std::shared_ptr<openbw_ios::frame_scheduler> _scheduler;
 }
 
 static OpenBWEngine* _sharedInstance = nil;
@@ -173,7 +195,8 @@ static OpenBWEngine* _sharedInstance = nil;
         _cameraX = 0;
         _cameraY = 0;
         _zoomLevel = 1.0f;
-        _controlGroups.resize(10);  // 10 control groups (0-9)
+        _framePacingPolicy = OpenBWFramePacingPolicySkip;
+        _maxCatchUpFrames = 4;
     }
     return self;
 }
@@ -271,12 +294,15 @@ static OpenBWEngine* _sharedInstance = nil;
         return NO;
     }
 
-    // Start game via game runner
+    // Start game (or replay playback, when a replay is given) via game runner
     NSError* gameError = nil;
-    if (![_gameRunner startGameWithMap:config.mapPath
-                            playerRace:config.playerRace
-                          aiDifficulty:config.aiDifficulty
-                                 error:&gameError]) {
+    BOOL started = config.replayPath.length > 0
+        ? [_gameRunner loadReplay:config.replayPath error:&gameError]
+        : [_gameRunner startGameWithMap:config.mapPath
+                             playerRace:config.playerRace
+                           aiDifficulty:config.aiDifficulty
+                                  error:&gameError];
+    if (!started) {
         if (error) *error = gameError;
         return NO;
     }
@@ -314,18 +340,51 @@ static OpenBWEngine* _sharedInstance = nil;
 }
 
 - (void)startGameLoop {
-    dispatch_async(_gameQueue, ^{
-        // Game loop runs at ~24 FPS (StarCraft's native frame rate)
-        while (!self->_isPaused && self->_initialized) {
-            // Process one game frame
-            [self processFrame];
+    // Stop any previous loop; the serial queue runs the new one after it exits
+    if (_scheduler) {
+        _scheduler->stop();
+    }
 
-            // Sleep to maintain frame rate
-            usleep(41667);  // ~24 FPS
-        }
+    auto scheduler = std::make_shared<openbw_ios::frame_scheduler>(
+        openbw_ios::default_frame_period, [self schedulerPolicy], _maxCatchUpFrames);
+    _scheduler = scheduler;
+
+    __weak OpenBWEngine* weakSelf = self;
+    dispatch_async(_gameQueue, ^{
+        // Frames run against absolute deadlines, so frame time does not add drift
+        scheduler->run([weakSelf] {
+            OpenBWEngine* strongSelf = weakSelf;
+            if (!strongSelf || !strongSelf->_initialized) return;
+            [strongSelf processFrame];
+        });
     });
 }
 
+- (openbw_ios::frame_pacing_policy)schedulerPolicy {
+    return _framePacingPolicy == OpenBWFramePacingPolicyCatchUp ?
+        openbw_ios::frame_pacing_policy::catch_up :
+        openbw_ios::frame_pacing_policy::skip;
+}
+
+- (void)setFramePacingPolicy:(OpenBWFramePacingPolicy)framePacingPolicy {
+    _framePacingPolicy = framePacingPolicy;
+    if (_scheduler) {
+        _scheduler->set_policy([self schedulerPolicy], _maxCatchUpFrames);
+    }
+}
+
+- (void)setMaxCatchUpFrames:(int)maxCatchUpFrames {
+    _maxCatchUpFrames = MAX(0, maxCatchUpFrames);
+    if (_scheduler) {
+        _scheduler->set_policy([self schedulerPolicy], _maxCatchUpFrames);
+    }
+}
+
+- (OpenBWFrameTimingStats*)frameTimingStats {
+    if (!_scheduler) return nil;
+    return [[OpenBWFrameTimingStats alloc] initWithStats:_scheduler->stats()];
+}
+
 - (void)processFrame {
     // Advance game via game runner
     [_gameRunner tick];
@@ -348,19 +407,29 @@ static OpenBWEngine* _sharedInstance = nil;
 
 - (void)pause {
     _isPaused = YES;
+    if (_scheduler) {
+        _scheduler->pause();
+    }
 }
 
 - (void)resume {
     if (_isPaused) {
         _isPaused = NO;
-        [self startGameLoop];
+        if (_scheduler) {
+            _scheduler->resume();
+        } else {
+            [self startGameLoop];
+        }
     }
 }
 
 - (void)stop {
     _isPaused = YES;
+    if (_scheduler) {
+        _scheduler->stop();
+        _scheduler.reset();
+    }
     _currentFrame = 0;
-    _selectedUnits.clear();
 
     if ([self.delegate respondsToSelector:@selector(gameDidEnd:)]) {
         dispatch_async(dispatch_get_main_queue(), ^{
@@ -379,16 +448,12 @@ static OpenBWEngine* _sharedInstance = nil;
 - (void)selectUnitAtX:(CGFloat)x y:(CGFloat)y {
     // Forward to game runner
     [_gameRunner selectUnitAtX:x y:y];
-    _selectedUnits.clear();
-    // TODO: Get selected unit IDs from game runner
 }
 
 - (void)boxSelectFromX:(CGFloat)x1 y:(CGFloat)y1 toX:(CGFloat)x2 y:(CGFloat)y2 {
     // Forward to game runner
     CGRect rect = CGRectMake(fmin(x1, x2), fmin(y1, y2), fabs(x2 - x1), fabs(y2 - y1));
     [_gameRunner selectUnitsInRect:rect];
-    _selectedUnits.clear();
-    // TODO: Get selected unit IDs from game runner
 }
 
 - (void)moveSelectedToX:(CGFloat)x y:(CGFloat)y {
@@ -412,15 +477,13 @@ static OpenBWEngine* _sharedInstance = nil;
 }
 
 - (void)assignToControlGroup:(int)groupNumber {
-    if (groupNumber >= 0 && groupNumber < 10) {
-        _controlGroups[groupNumber] = _selectedUnits;
-    }
+    // Forward to game runner (groups hold unit handles, so dead units drop out)
+    [_gameRunner assignControlGroup:groupNumber];
 }
 
 - (void)selectControlGroup:(int)groupNumber {
-    if (groupNumber >= 0 && groupNumber < 10) {
-        _selectedUnits = _controlGroups[groupNumber];
-    }
+    // Forward to game runner
+    [_gameRunner selectControlGroup:groupNumber];
 }
 
 #pragma mark - Camera Control
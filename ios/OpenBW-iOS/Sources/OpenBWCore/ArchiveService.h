@@ -0,0 +1,402 @@
+// ArchiveService.h
+// One shared, thread-safe reader for the game's MPQ archives
+//
+// The simulation, the renderer and map tools all read from the same archives.
+// Each MPQ is opened (and its hash and block tables parsed) by the service,
+// and every reader goes through it. Archives are memory-mapped: stored
+// (uncompressed) files are returned as views into the mapping. OpenBW's MPQ
+// reader keeps a file position, so each archive keeps a pool of them and a
+// read takes one no other thread is using, opening another when all are busy;
+// decompression runs without any service lock held, and reads of different
+// files proceed concurrently. The service's locks only guard the archive
+// lists, the pools and the cache.
+// Decompressed files, whether read by copy or as views, are kept in an LRU
+// cache with a byte budget, so a file several components read is decompressed
+// once. Files over a quarter of the budget are not cached. Standalone
+// archives (map files) are opened on demand, and the most recent ones stay
+// open. Their files are cached under the archive's size and mtime, so an
+// edited map is read again.
+
+#ifndef ARCHIVESERVICE_H
+#define ARCHIVESERVICE_H
+
+#include "bwgame.h"
+#include "data_loading.h"
+#include "MappedFile.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+class archive_service {
+public:
+    /// Read-only file contents; valid while the view (or a copy of it) is alive
+    struct file_view {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        std::shared_ptr<const void> owner;      // Cached buffer or mapped archive
+    };
+
+    struct stats_t {
+        size_t archives_opened = 0;     // Includes standalone (map) archives
+        size_t reads = 0;
+        size_t cache_hits = 0;
+        size_t mapped_reads = 0;        // Stored files returned without copying
+        size_t cached_bytes = 0;
+        size_t cached_files = 0;
+        size_t decompressed_reads = 0;  // Misses decompressed from an archive
+        size_t extra_readers = 0;       // Readers opened because an archive's were all busy:
+                                        // reads that overlapped another of the same archive
+        uint64_t open_ns = 0;           // Time spent opening archives and readers
+        uint64_t read_ns = 0;           // Time spent decompressing on misses, summed over threads
+    };
+
+    /// OpenBW load_data_file functor bound to a service
+    struct loader {
+        archive_service* service = nullptr;
+
+        void operator()(bwgame::a_vector<uint8_t>& dst, bwgame::a_string filename) const {
+            service->read(std::string(filename.begin(), filename.end()), dst);
+        }
+
+        bool file_exists(const bwgame::a_string& filename) const {
+            return service->file_exists(std::string(filename.begin(), filename.end()));
+        }
+    };
+
+    static archive_service& shared() {
+        static archive_service instance;
+        return instance;
+    }
+
+    archive_service() = default;
+    archive_service(const archive_service&) = delete;
+    archive_service& operator=(const archive_service&) = delete;
+
+    /// Open the data archives in priority order (patches first). Archives that
+    /// are already open under the same path are kept; the cache is cleared if
+    /// the set changes.
+    void open(const std::vector<std::string>& paths) {
+        std::lock_guard<std::mutex> lock(archive_mutex_);
+        std::vector<archive_ptr> archives;
+        for (const std::string& path : paths) {
+            auto it = std::find_if(archives_.begin(), archives_.end(),
+                                   [&](const archive_ptr& a) { return a->path == path; });
+            if (it != archives_.end()) {
+                archives.push_back(*it);
+            } else {
+                archives.push_back(open_archive(path));
+            }
+        }
+        bool changed = archives.size() != archives_.size() ||
+                       !std::equal(archives.begin(), archives.end(), archives_.begin());
+        archives_ = std::move(archives);
+        if (changed) {
+            std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+            clear_cache();
+        }
+    }
+
+    bool is_open() const {
+        std::lock_guard<std::mutex> lock(archive_mutex_);
+        return !archives_.empty();
+    }
+
+    loader data_loader() { return loader{this}; }
+
+    bool file_exists(const std::string& name) {
+        std::string key = normalize(name);
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex_);
+            if (cache_index_.count(key)) return true;
+        }
+        return archive_with(name) != nullptr;
+    }
+
+    /// Read a file from the data archives into dst; throws (like OpenBW's
+    /// loaders) if missing. Goes through the cache like read_view, so the
+    /// game and the renderer loading the same file decompress it once.
+    void read(const std::string& name, bwgame::a_vector<uint8_t>& dst) {
+        file_view view = read_view(name);
+        dst.assign(view.data, view.data + view.size);
+    }
+
+    /// Read a file without copying: stored files are views into the archive
+    /// mapping, compressed ones are decompressed once into the cache
+    file_view read_view(const std::string& name) {
+        std::string key = normalize(name);
+        if (file_data cached = lookup(key)) return view_of(cached);
+
+        archive_ptr a = archive_with(name);
+        if (!a) bwgame::error("archive_service: %s: file not found", bwgame::a_string(name.begin(), name.end()));
+        mpq_directory::span stored;
+        if (a->directory.find_stored(name, stored)) {
+            a->file.will_need(stored.data - a->file.data(), stored.size);
+            count_mapped_read();
+            return {stored.data, stored.size, a};
+        }
+        return view_of(insert(key, decompress(*a, name)));
+    }
+
+    /// Read a file from a standalone archive such as a map (.scm/.scx) into
+    /// dst, through the cache like read_view_from. The last few archives read
+    /// from stay open.
+    void read_from(const std::string& archive_path, const std::string& name, bwgame::a_vector<uint8_t>& dst) {
+        file_view view = read_view_from(archive_path, name);
+        dst.assign(view.data, view.data + view.size);
+    }
+
+    /// Read a file from a standalone archive without copying; decompressed
+    /// files are cached until the archive's size or mtime changes
+    file_view read_view_from(const std::string& archive_path, const std::string& name) {
+        std::string identity = file_identity(archive_path);
+        std::string key = archive_path + "|" + identity + "|" + normalize(name);
+        if (file_data cached = lookup(key)) return view_of(cached);
+
+        archive_ptr archive;
+        {
+            std::lock_guard<std::mutex> lock(archive_mutex_);
+            archive = standalone_archive(archive_path, identity);
+        }
+        return view_of(insert(key, decompress(*archive, name)));
+    }
+
+    /// Maximum bytes of decompressed files kept (files over a quarter of it are not cached)
+    void set_cache_budget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        cache_budget_ = bytes;
+        evict();
+    }
+
+    /// Drop every cached file, close standalone archives and the readers
+    /// opened for concurrent reads (e.g. under memory pressure)
+    void trim() {
+        {
+            std::lock_guard<std::mutex> lock(archive_mutex_);
+            standalone_.clear();
+            for (auto& a : archives_) {
+                std::lock_guard<std::mutex> readers_lock(a->readers_mutex);
+                if (a->idle.size() > 1) a->idle.resize(1);
+            }
+        }
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        clear_cache();
+    }
+
+    stats_t stats() const {
+        std::lock_guard<std::mutex> archive_lock(archive_mutex_);
+        std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+        stats_t s = stats_;
+        s.cached_bytes = cached_bytes_;
+        s.cached_files = cache_.size();
+        return s;
+    }
+
+private:
+    using file_data = std::shared_ptr<const bwgame::a_vector<uint8_t>>;
+    using mpq_reader = bwgame::data_loading::mpq_file<mapped_file_reader>;
+
+    // The MPQ readers and the directory each map the file; the pages are shared
+    struct archive {
+        std::string path;
+        std::string identity;                   // Size and mtime when opened (standalone archives)
+        mapped_file file;
+        mpq_directory directory;
+        std::mutex readers_mutex;
+        std::vector<std::unique_ptr<mpq_reader>> idle;  // Readers no thread is using
+        explicit archive(const std::string& path) : path(path) {
+            idle.push_back(std::make_unique<mpq_reader>(bwgame::a_string(path.begin(), path.end())));
+            if (file.open(path, mapped_file::access::random)) directory.parse(file.data(), file.size());
+        }
+    };
+    using archive_ptr = std::shared_ptr<archive>;
+
+    static constexpr size_t max_standalone_archives = 4;
+
+    static uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    // MPQ names are case-insensitive and use backslashes
+    static std::string normalize(const std::string& name) {
+        std::string key = name;
+        for (char& c : key) {
+            if (c == '/') c = '\\';
+            else if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        }
+        return key;
+    }
+
+    // archive_mutex_ held
+    archive_ptr open_archive(const std::string& path) {
+        auto start = std::chrono::steady_clock::now();
+        auto a = std::make_shared<archive>(path);
+        stats_.open_ns += elapsed_ns(start);
+        ++stats_.archives_opened;
+        return a;
+    }
+
+    // archive_mutex_ held. The open standalone archive at path, moved to the
+    // front of the recently used list; reopened if the file changed since.
+    archive_ptr standalone_archive(const std::string& path, const std::string& identity) {
+        auto it = std::find_if(standalone_.begin(), standalone_.end(),
+                               [&](const archive_ptr& a) { return a->path == path; });
+        archive_ptr a;
+        if (it != standalone_.end()) {
+            if ((*it)->identity == identity) a = *it;
+            standalone_.erase(it);
+        }
+        if (!a) {
+            a = open_archive(path);
+            a->identity = identity;
+            if (standalone_.size() >= max_standalone_archives) standalone_.pop_back();
+        }
+        standalone_.push_front(a);
+        return a;
+    }
+
+    // Size and mtime of a file, so cached contents of an edited file are not used
+    static std::string file_identity(const std::string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return std::string();
+        return std::to_string((long long)st.st_size) + ":" + std::to_string((long long)st.st_mtime);
+    }
+
+    // The first (highest priority) data archive with the file, or null.
+    // Searched outside archive_mutex_, since a search may need a reader.
+    archive_ptr archive_with(const std::string& name) {
+        std::vector<archive_ptr> archives;
+        {
+            std::lock_guard<std::mutex> lock(archive_mutex_);
+            archives = archives_;
+        }
+        for (auto& a : archives) {
+            if (contains(*a, name)) return a;
+        }
+        return nullptr;
+    }
+
+    // From the mapped directory, or an MPQ reader if the mapping failed
+    bool contains(archive& a, const std::string& name) {
+        if (!a.directory.empty()) return a.directory.contains(name);
+        bool found = false;
+        with_reader(a, [&](mpq_reader& r) { found = r.mpq.file_exists(bwgame::a_string(name.begin(), name.end())); });
+        return found;
+    }
+
+    // Call f with a reader of the archive that no other thread is using,
+    // opening another if all are busy, and return it to the pool afterwards
+    template<typename F>
+    void with_reader(archive& a, F f) {
+        std::unique_ptr<mpq_reader> reader;
+        {
+            std::lock_guard<std::mutex> lock(a.readers_mutex);
+            if (!a.idle.empty()) {
+                reader = std::move(a.idle.back());
+                a.idle.pop_back();
+            }
+        }
+        if (!reader) {
+            auto start = std::chrono::steady_clock::now();
+            reader = std::make_unique<mpq_reader>(bwgame::a_string(a.path.begin(), a.path.end()));
+            uint64_t ns = elapsed_ns(start);
+            std::lock_guard<std::mutex> lock(archive_mutex_);
+            ++stats_.extra_readers;
+            stats_.open_ns += ns;
+        }
+        struct give_back {
+            archive& a;
+            std::unique_ptr<mpq_reader>& reader;
+            ~give_back() {
+                std::lock_guard<std::mutex> lock(a.readers_mutex);
+                a.idle.push_back(std::move(reader));
+            }
+        } back{a, reader};
+        f(*reader);
+    }
+
+    // No service lock held; throws what the MPQ reader throws
+    file_data decompress(archive& a, const std::string& name) {
+        auto start = std::chrono::steady_clock::now();
+        auto buffer = std::make_shared<bwgame::a_vector<uint8_t>>();
+        with_reader(a, [&](mpq_reader& r) { r(*buffer, bwgame::a_string(name.begin(), name.end())); });
+        uint64_t ns = elapsed_ns(start);
+        std::lock_guard<std::mutex> lock(archive_mutex_);
+        ++stats_.decompressed_reads;
+        stats_.read_ns += ns;
+        return buffer;
+    }
+
+    static file_view view_of(const file_data& data) {
+        return {data->data(), data->size(), data};
+    }
+
+    void count_mapped_read() {
+        std::lock_guard<std::mutex> lock(archive_mutex_);
+        ++stats_.mapped_reads;
+    }
+
+    file_data lookup(const std::string& key) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        ++stats_.reads;
+        auto it = cache_index_.find(key);
+        if (it == cache_index_.end()) return nullptr;
+        cache_.splice(cache_.begin(), cache_, it->second);
+        ++stats_.cache_hits;
+        return it->second->second;
+    }
+
+    file_data insert(const std::string& key, file_data result) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (result->size() > cache_budget_ / 4 || cache_index_.count(key)) return result;
+        cache_.emplace_front(key, result);
+        cache_index_[key] = cache_.begin();
+        cached_bytes_ += result->size();
+        evict();
+        return result;
+    }
+
+    // cache_mutex_ held
+    void evict() {
+        while (cached_bytes_ > cache_budget_ && !cache_.empty()) {
+            cached_bytes_ -= cache_.back().second->size();
+            cache_index_.erase(cache_.back().first);
+            cache_.pop_back();
+        }
+    }
+
+    // cache_mutex_ held (or exclusive access)
+    void clear_cache() {
+        cache_.clear();
+        cache_index_.clear();
+        cached_bytes_ = 0;
+    }
+
+    mutable std::mutex archive_mutex_;
+    std::vector<archive_ptr> archives_;
+    std::list<archive_ptr> standalone_;         // Most recently used first
+
+    mutable std::mutex cache_mutex_;
+    std::list<std::pair<std::string, file_data>> cache_;   // Most recently used first
+    std::unordered_map<std::string, std::list<std::pair<std::string, file_data>>::iterator> cache_index_;
+    size_t cached_bytes_ = 0;
+    size_t cache_budget_ = 32 * 1024 * 1024;
+
+    stats_t stats_;
+};
+
+} // namespace openbw_ios
+
+#endif // ARCHIVESERVICE_H
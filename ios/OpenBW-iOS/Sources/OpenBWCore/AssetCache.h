@@ -0,0 +1,212 @@
+// AssetCache.h
+// Flat, versioned, memory-mappable cache of preprocessed game assets
+//
+// Portable C++14 on POSIX (no Foundation/UIKit or OpenBW types). On first run
+// the decoded assets (tileset bitmaps, palettes, color tables) are written as
+// one file of 64-byte aligned arrays. Later launches map the file and point
+// straight into it instead of decoding the archives again. The file carries a
+// key built from the source archives (size, mtime and a hash of their headers
+// and tables) plus the caller's format version; any mismatch makes it stale.
+//
+// Layout: header, section table, then section payloads.
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include "MappedFile.h"
+#include "MegatileColors.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+/// Key for a set of source files. Each file contributes its size, mtime and
+/// a hash of its first and last 64 KB (an MPQ's header and its hash and block
+/// tables), so the key is cheap to compute on every launch.
+inline uint64_t asset_source_key(const std::vector<std::string>& paths, uint64_t format_version) {
+    static constexpr size_t sample = 64 * 1024;
+    uint64_t key = fnv1a64(reinterpret_cast<const uint8_t*>(&format_version), sizeof(format_version));
+    for (const std::string& path : paths) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return 0;
+        uint64_t size = (uint64_t)st.st_size;
+        uint64_t mtime = (uint64_t)st.st_mtime;
+        key = fnv1a64(reinterpret_cast<const uint8_t*>(&size), sizeof(size), key);
+        key = fnv1a64(reinterpret_cast<const uint8_t*>(&mtime), sizeof(mtime), key);
+
+        mapped_file file;
+        if (!file.open(path, mapped_file::access::random)) return 0;
+        size_t head = std::min(sample, file.size());
+        key = fnv1a64(file.data(), head, key);
+        if (file.size() > head) {
+            size_t tail = std::min(sample, file.size() - head);
+            key = fnv1a64(file.data() + file.size() - tail, tail, key);
+        }
+    }
+    return key;
+}
+
+/// Builds a cache file in memory, then writes it atomically
+class asset_cache_writer {
+public:
+    void add(uint32_t id, const void* data, size_t size) {
+        sections_.push_back({id, std::vector<uint8_t>(static_cast<const uint8_t*>(data),
+                                                      static_cast<const uint8_t*>(data) + size)});
+    }
+
+    template<typename T>
+    void add_array(uint32_t id, const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "cached arrays must be trivially copyable");
+        add(id, values.data(), values.size() * sizeof(T));
+    }
+
+    /// Written to a temporary file and renamed, so readers never see a partial cache
+    bool write(const std::string& path, uint64_t key) const {
+        std::vector<uint8_t> out;
+        header h;
+        std::memcpy(h.magic, "OBWA", 4);
+        h.key = key;
+        h.section_count = (uint32_t)sections_.size();
+        out.resize(align(sizeof(header) + sections_.size() * sizeof(entry)));
+
+        std::vector<entry> entries;
+        for (const auto& s : sections_) {
+            entries.push_back({s.first, 0, (uint64_t)out.size(), (uint64_t)s.second.size()});
+            out.insert(out.end(), s.second.begin(), s.second.end());
+            out.resize(align(out.size()));
+        }
+        std::memcpy(out.data(), &h, sizeof(h));
+        if (!entries.empty()) std::memcpy(out.data() + sizeof(h), entries.data(), entries.size() * sizeof(entry));
+
+        std::string temp = path + ".tmp";
+        FILE* f = std::fopen(temp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    struct header {
+        char magic[4];
+        uint32_t section_count = 0;
+        uint64_t key = 0;
+    };
+    struct entry {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static constexpr size_t alignment = 64;
+    static size_t align(size_t n) { return (n + alignment - 1) / alignment * alignment; }
+
+private:
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> sections_;
+};
+
+/// A mapped cache file. Arrays returned by it stay valid while it is alive.
+class asset_cache {
+public:
+    /// Returns false if the file is missing, malformed or built from other sources
+    bool open(const std::string& path, uint64_t expected_key) {
+        using header = asset_cache_writer::header;
+        using entry = asset_cache_writer::entry;
+        sections_.clear();
+        if (!file_.open(path, mapped_file::access::random) || file_.size() < sizeof(header)) return false;
+
+        header h;
+        std::memcpy(&h, file_.data(), sizeof(h));
+        if (std::memcmp(h.magic, "OBWA", 4) || h.key != expected_key || expected_key == 0) return fail();
+        if ((file_.size() - sizeof(h)) / sizeof(entry) < h.section_count) return fail();
+
+        sections_.resize(h.section_count);
+        std::memcpy(sections_.data(), file_.data() + sizeof(h), h.section_count * sizeof(entry));
+        for (const entry& e : sections_) {
+            if (e.offset % asset_cache_writer::alignment || e.offset > file_.size() || e.size > file_.size() - e.offset) {
+                return fail();
+            }
+        }
+        return true;
+    }
+
+    bool is_open() const { return file_.is_open(); }
+
+    bool section(uint32_t id, const uint8_t*& data, size_t& size) const {
+        for (const auto& e : sections_) {
+            if (e.id != id) continue;
+            data = file_.data() + e.offset;
+            size = (size_t)e.size;
+            return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    bool array(uint32_t id, const T*& values, size_t& count) const {
+        static_assert(std::is_trivially_copyable<T>::value, "cached arrays must be trivially copyable");
+        const uint8_t* data;
+        size_t size;
+        if (!section(id, data, size) || size % sizeof(T)) return false;
+        values = reinterpret_cast<const T*>(data);
+        count = size / sizeof(T);
+        return true;
+    }
+
+private:
+    bool fail() {
+        sections_.clear();
+        file_.close();
+        return false;
+    }
+
+    mapped_file file_;
+    std::vector<asset_cache_writer::entry> sections_;
+};
+
+/// Array that either owns its elements or points into a mapped asset cache
+template<typename T>
+class cached_array {
+public:
+    void assign(std::vector<T> values) {
+        owned_ = std::move(values);
+        data_ = owned_.data();
+        size_ = owned_.size();
+    }
+
+    void point_to(const T* data, size_t size) {
+        std::vector<T>().swap(owned_);
+        data_ = data;
+        size_ = size;
+    }
+
+    void clear() { point_to(nullptr, 0); }
+
+    const T& operator[](size_t i) const { return data_[i]; }
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t owned_bytes() const { return owned_.size() * sizeof(T); }
+
+private:
+    std::vector<T> owned_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // ASSETCACHE_H
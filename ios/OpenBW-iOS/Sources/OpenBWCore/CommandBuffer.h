@@ -0,0 +1,203 @@
+// CommandBuffer.h
+// Frame-boundary command buffer encoded as StarCraft game actions
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). UI threads push compact
+// command records without taking a lock; the simulation thread drains all of
+// them in one pass at the start of a frame, groups records with the same
+// action, order and target, and encodes each group as the byte stream OpenBW's
+// actions.h executes (a select action followed by the order action). Because
+// the game only ever changes through these actions, the same bytes can be
+// written to a replay and played back deterministically.
+
+#ifndef COMMANDBUFFER_H
+#define COMMANDBUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace openbw_ios {
+
+/// Action opcodes from the game's network/replay protocol (see OpenBW actions.h)
+namespace game_action {
+    static constexpr uint8_t build = 0x0c;
+    static constexpr uint8_t select = 0x09;
+    static constexpr uint8_t right_click = 0x14;
+    static constexpr uint8_t targeted_order = 0x15;
+    static constexpr uint8_t stop = 0x1a;
+    static constexpr uint8_t train = 0x1f;
+    static constexpr uint8_t cloak = 0x21;
+    static constexpr uint8_t decloak = 0x22;
+    static constexpr uint8_t unsiege = 0x25;
+    static constexpr uint8_t siege = 0x26;
+    static constexpr uint8_t hold_position = 0x2b;
+    static constexpr uint8_t burrow = 0x2c;
+    static constexpr uint8_t unburrow = 0x2d;
+    static constexpr uint8_t stim = 0x36;
+    static constexpr uint8_t unit_morph = 0x23;
+    static constexpr uint8_t research = 0x30;
+    static constexpr uint8_t upgrade = 0x32;
+    static constexpr uint8_t building_morph = 0x35;
+
+    /// Units per select action (the game's selection limit)
+    static constexpr size_t max_selection = 12;
+    /// Unit type id meaning "no unit type"
+    static constexpr uint16_t no_unit_type = 228;
+}
+
+/// One UI command. Unit ids are OpenBW unit_id raw values.
+struct command_record {
+    uint8_t action = 0;         // game_action opcode
+    uint8_t order = 0;          // Order id for targeted_order / build
+    uint8_t queued = 0;         // Shift-queue flag where the action has one
+    uint8_t unit_count = 0;
+    uint16_t x = 0;             // Target position (pixels; tiles for build)
+    uint16_t y = 0;
+    uint16_t target = 0;        // Target unit id (0 = none)
+    uint16_t unit_type = game_action::no_unit_type;
+    std::array<uint16_t, game_action::max_selection> units{};
+
+    /// Train, build and stim are counted actions (two presses train two units),
+    /// so they are never merged; every other action is idempotent per unit
+    bool groupable() const {
+        return action != game_action::train && action != game_action::build && action != game_action::stim;
+    }
+
+    /// Records with the same key are executed as one group
+    bool same_group(const command_record& o) const {
+        return groupable() && action == o.action && order == o.order && queued == o.queued && x == o.x && y == o.y &&
+               target == o.target && unit_type == o.unit_type;
+    }
+};
+
+/// Multi-producer, single-consumer queue of command records.
+/// Producers never block; the consumer takes everything pushed so far at once.
+class command_buffer {
+public:
+    command_buffer() = default;
+    command_buffer(const command_buffer&) = delete;
+    command_buffer& operator=(const command_buffer&) = delete;
+
+    ~command_buffer() {
+        free_list(head_.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    /// Any thread: append a command for the next frame
+    void push(const command_record& record) {
+        node* n = new node{record, head_.load(std::memory_order_relaxed)};
+        while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+    /// Simulation thread: move every pending record into out, oldest first
+    void drain(std::vector<command_record>& out) {
+        node* list = head_.exchange(nullptr, std::memory_order_acquire);
+        size_t start = out.size();
+        for (node* n = list; n; n = n->next) out.push_back(n->record);
+        std::reverse(out.begin() + start, out.end());
+        free_list(list);
+    }
+
+    /// Drop all pending commands (e.g. when a game ends)
+    void discard() {
+        free_list(head_.exchange(nullptr, std::memory_order_acquire));
+    }
+
+private:
+    struct node {
+        command_record record;
+        node* next;
+    };
+
+    static void free_list(node* n) {
+        while (n) {
+            node* next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    std::atomic<node*> head_{nullptr};
+};
+
+/// Group records and append their encoded actions to out. Groups keep the
+/// order of their first record; units within a group are deduplicated and
+/// split into selections of at most max_selection units.
+/// Each command is a select action followed by one order; when command_ends
+/// is given, the end offset in out of every command is appended to it so a
+/// command the game rejects can be skipped without dropping the rest.
+inline void encode_command_actions(const std::vector<command_record>& records, std::vector<uint8_t>& out,
+                                   std::vector<size_t>* command_ends = nullptr) {
+    auto put8 = [&](uint8_t v) { out.push_back(v); };
+    auto put16 = [&](uint16_t v) {
+        out.push_back((uint8_t)(v & 0xff));
+        out.push_back((uint8_t)(v >> 8));
+    };
+
+    std::vector<bool> done(records.size(), false);
+    std::vector<uint16_t> units;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (done[i]) continue;
+        const command_record& r = records[i];
+
+        // Merge every later record of the same group
+        units.clear();
+        for (size_t j = i; j < records.size(); ++j) {
+            if (done[j] || (j != i && !records[j].same_group(r))) continue;
+            done[j] = true;
+            for (size_t k = 0; k < records[j].unit_count; ++k) {
+                uint16_t id = records[j].units[k];
+                if (id && std::find(units.begin(), units.end(), id) == units.end()) units.push_back(id);
+            }
+        }
+        if (units.empty()) continue;
+
+        for (size_t first = 0; first < units.size(); first += game_action::max_selection) {
+            size_t n = std::min(game_action::max_selection, units.size() - first);
+            put8(game_action::select);
+            put8((uint8_t)n);
+            for (size_t k = 0; k < n; ++k) put16(units[first + k]);
+
+            put8(r.action);
+            switch (r.action) {
+            case game_action::right_click:
+                put16(r.x);
+                put16(r.y);
+                put16(r.target);
+                put16(r.unit_type);
+                put8(r.queued);
+                break;
+            case game_action::targeted_order:
+                put16(r.x);
+                put16(r.y);
+                put16(r.target);
+                put16(r.unit_type);
+                put8(r.order);
+                put8(r.queued);
+                break;
+            case game_action::build:
+                put8(r.order);
+                put16(r.x);
+                put16(r.y);
+                put16(r.unit_type);
+                break;
+            case game_action::train:
+                put16(r.unit_type);
+                break;
+            case game_action::stim:
+                break;
+            default:
+                // stop, hold position, siege/unsiege, burrow/unburrow, cloak/decloak
+                put8(r.queued);
+                break;
+            }
+            if (command_ends) command_ends->push_back(out.size());
+        }
+    }
+}
+
+} // namespace openbw_ios
+
+#endif // COMMANDBUFFER_H
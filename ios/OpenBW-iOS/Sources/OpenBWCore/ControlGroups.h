@@ -0,0 +1,146 @@
+// ControlGroups.h
+// Control group membership maintained incrementally from unit events
+//
+// Each unit slot records which of the 10 groups it belongs to and where, so a
+// unit dying or changing owner is removed from every group in O(1) per group
+// it was in. Removal leaves a tombstone to keep the player's ordering; the
+// live count is kept exact, and a group is compacted the next time it is
+// recalled, so recall costs O(group size).
+
+#ifndef CONTROLGROUPS_H
+#define CONTROLGROUPS_H
+
+#include "UnitHandles.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace openbw_ios {
+
+class control_group_set {
+public:
+    static constexpr int group_count = 10;
+
+    void clear() {
+        for (group_t& g : groups_) {
+            g.members.clear();
+            g.live = 0;
+        }
+        slots_.clear();
+    }
+
+    /// Replace a group's members
+    void assign(int group, const std::vector<unit_handle>& handles) {
+        if (!valid_group(group)) return;
+        clear_group(group);
+        for (unit_handle h : handles) add(group, h);
+    }
+
+    /// Append a unit to a group (no-op if it is already a member)
+    void add(int group, unit_handle h) {
+        if (!valid_group(group) || h.empty()) return;
+        membership_t& m = membership(h.slot());
+        if (m.mask & (1u << group)) {
+            if (groups_[group].members[m.pos[group]] == h) return;
+            // Stale entry from an earlier unit in this slot
+            remove_from(group, m);
+        }
+        group_t& g = groups_[group];
+        m.mask |= (uint16_t)(1u << group);
+        m.pos[group] = (uint32_t)g.members.size();
+        g.members.push_back(h);
+        ++g.live;
+    }
+
+    /// Remove a unit from every group it belongs to. O(number of its groups).
+    void remove_unit(unit_handle h) {
+        if (h.empty() || h.slot() >= slots_.size()) return;
+        membership_t& m = slots_[h.slot()];
+        for (int group = 0; m.mask && group < group_count; ++group) {
+            if ((m.mask & (1u << group)) && groups_[group].members[m.pos[group]] == h) {
+                remove_from(group, m);
+            }
+        }
+    }
+
+    /// Exact number of live members
+    int size(int group) const {
+        return valid_group(group) ? (int)groups_[group].live : 0;
+    }
+
+    bool contains(int group, unit_handle h) const {
+        if (!valid_group(group) || h.empty() || h.slot() >= slots_.size()) return false;
+        const membership_t& m = slots_[h.slot()];
+        return (m.mask & (1u << group)) && groups_[group].members[m.pos[group]] == h;
+    }
+
+    /// Member of any group
+    bool grouped(unit_handle h) const {
+        for (int group = 0; group < group_count; ++group) {
+            if (contains(group, h)) return true;
+        }
+        return false;
+    }
+
+    /// Live members in assignment order. Compacts the group first (O(group size)).
+    const std::vector<unit_handle>& members(int group) {
+        static const std::vector<unit_handle> empty;
+        if (!valid_group(group)) return empty;
+        group_t& g = groups_[group];
+        if (g.members.size() != g.live) {
+            size_t out = 0;
+            for (size_t i = 0; i < g.members.size(); ++i) {
+                unit_handle h = g.members[i];
+                if (h.empty()) continue;
+                slots_[h.slot()].pos[group] = (uint32_t)out;
+                g.members[out++] = h;
+            }
+            g.members.resize(out);
+        }
+        return g.members;
+    }
+
+private:
+    struct group_t {
+        std::vector<unit_handle> members;   // Empty handles are tombstones
+        size_t live = 0;
+    };
+
+    struct membership_t {
+        uint16_t mask = 0;                          // Bit n set = member of group n
+        std::array<uint32_t, group_count> pos{};    // Index into group_t::members
+    };
+
+    static bool valid_group(int group) {
+        return group >= 0 && group < group_count;
+    }
+
+    membership_t& membership(size_t slot) {
+        if (slot >= slots_.size()) slots_.resize(slot + 1);
+        return slots_[slot];
+    }
+
+    void remove_from(int group, membership_t& m) {
+        groups_[group].members[m.pos[group]] = unit_handle();
+        --groups_[group].live;
+        m.mask &= (uint16_t)~(1u << group);
+    }
+
+    void clear_group(int group) {
+        group_t& g = groups_[group];
+        for (unit_handle h : g.members) {
+            if (!h.empty()) slots_[h.slot()].mask &= (uint16_t)~(1u << group);
+        }
+        g.members.clear();
+        g.live = 0;
+    }
+
+    std::array<group_t, group_count> groups_;
+    std::vector<membership_t> slots_;
+};
+
+} // namespace openbw_ios
+
+#endif // CONTROLGROUPS_H
@@ -0,0 +1,100 @@
+// FogOfWar.h
+// Per-tile fog of war state for the local player, diffed frame to frame
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). Each frame the
+// simulation thread feeds the engine's visibility/explored bits through
+// update(); only tiles whose state changed are recorded. Two consumers read
+// the changes: changed() lists this frame's tiles (the minimap applies them on
+// the same thread), and drain() hands everything since the last drain to the
+// render thread, deduplicated per tile. Work outside the bit comparison is
+// proportional to vision changes, not to map size.
+
+#ifndef FOGOFWAR_H
+#define FOGOFWAR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace openbw_ios {
+
+namespace fog_state {
+    static constexpr uint8_t unexplored = 0;
+    static constexpr uint8_t explored = 1;     // Seen before, not currently visible
+    static constexpr uint8_t visible = 2;
+}
+
+class fog_layer {
+public:
+    /// Start a new map; every tile begins unexplored
+    void reset(int tile_width, int tile_height) {
+        tile_width_ = tile_width > 0 ? tile_width : 0;
+        tile_height_ = tile_height > 0 ? tile_height : 0;
+        size_t n = (size_t)tile_width_ * tile_height_;
+        states_.assign(n, fog_state::unexplored);
+        pending_flag_.assign(n, 0);
+        pending_.clear();
+        changed_.clear();
+        ++version_;
+    }
+
+    /// Diff against the engine. state_of(index) returns the fog_state of a tile.
+    /// Returns the number of tiles that changed.
+    template<typename F>
+    size_t update(F&& state_of) {
+        changed_.clear();
+        size_t n = states_.size();
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t s = state_of(i);
+            if (s == states_[i]) continue;
+            states_[i] = s;
+            changed_.push_back((uint32_t)i);
+            if (!pending_flag_[i]) {
+                pending_flag_[i] = 1;
+                pending_.push_back((uint32_t)i);
+            }
+        }
+        if (!changed_.empty()) ++version_;
+        return changed_.size();
+    }
+
+    /// Tiles that changed in the last update()
+    const std::vector<uint32_t>& changed() const { return changed_; }
+
+    /// Tiles changed since the previous drain: f(index, current state)
+    template<typename F>
+    void drain(F&& f) {
+        for (uint32_t i : pending_) {
+            pending_flag_[i] = 0;
+            f(i, states_[i]);
+        }
+        pending_.clear();
+    }
+
+    uint8_t state(size_t index) const {
+        return index < states_.size() ? states_[index] : fog_state::visible;
+    }
+
+    uint8_t state_at(int tile_x, int tile_y) const {
+        if (tile_x < 0 || tile_y < 0 || tile_x >= tile_width_ || tile_y >= tile_height_) return fog_state::visible;
+        return states_[(size_t)tile_y * tile_width_ + tile_x];
+    }
+
+    int tile_width() const { return tile_width_; }
+    int tile_height() const { return tile_height_; }
+    bool empty() const { return states_.empty(); }
+    uint64_t version() const { return version_; }
+
+private:
+    int tile_width_ = 0;
+    int tile_height_ = 0;
+    std::vector<uint8_t> states_;
+    std::vector<uint8_t> pending_flag_;
+    std::vector<uint32_t> pending_;
+    std::vector<uint32_t> changed_;
+    uint64_t version_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // FOGOFWAR_H
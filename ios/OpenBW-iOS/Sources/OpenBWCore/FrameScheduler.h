@@ -0,0 +1,214 @@
+// FrameScheduler.h
+// Drift-free deadline scheduler for the background game loop
+//
+// Portable C++14 (no Foundation/UIKit) so it can be driven headlessly.
+// Frames are scheduled against absolute deadlines (start + n * period), so the
+// time spent inside a frame does not accumulate as drift the way a fixed sleep
+// after each frame does.
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace openbw_ios {
+
+/// What to do when a frame finishes after the next deadline has already passed
+enum class frame_pacing_policy {
+    /// Drop the missed deadlines and resynchronize to the next future one.
+    /// Game time slows down under load, but the loop never bursts.
+    skip,
+    /// Run the missed frames back to back (up to max_catch_up_frames) so game
+    /// time keeps up with wall time. Anything beyond the limit is dropped.
+    catch_up,
+};
+
+struct frame_scheduler_stats {
+    uint64_t frames = 0;            // Frames executed
+    uint64_t overruns = 0;          // Frames that finished past the next deadline
+    uint64_t skipped_frames = 0;    // Deadlines dropped by the pacing policy
+    double last_jitter_us = 0;      // |actual start - deadline| of the last frame
+    double mean_jitter_us = 0;
+    double max_jitter_us = 0;
+    double last_frame_us = 0;       // Duration of the last frame callback
+    double max_frame_us = 0;
+    double max_overrun_us = 0;      // Worst lateness past a deadline
+};
+
+template<typename clock_T = std::chrono::steady_clock>
+class basic_frame_scheduler {
+public:
+    using clock = clock_T;
+    using duration = typename clock::duration;
+    using time_point = typename clock::time_point;
+
+    explicit basic_frame_scheduler(duration period,
+                                   frame_pacing_policy policy = frame_pacing_policy::skip,
+                                   int max_catch_up_frames = 4)
+        : period_(period), policy_(policy), max_catch_up_frames_(std::max(0, max_catch_up_frames)) {}
+
+    basic_frame_scheduler(const basic_frame_scheduler&) = delete;
+    basic_frame_scheduler& operator=(const basic_frame_scheduler&) = delete;
+
+    /// Run frame_f on the calling thread at the configured rate until stop()
+    /// is called. Blocks while paused without spinning.
+    void run(const std::function<void()>& frame_f) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = true;
+        time_point deadline = clock::now();
+
+        while (!stop_requested_) {
+            if (paused_) {
+                cv_.wait(lock, [this] { return !paused_ || stop_requested_; });
+                // Restart the timeline on resume so the pause is not "caught up"
+                deadline = clock::now();
+                continue;
+            }
+
+            lock.unlock();
+            time_point start = clock::now();
+            frame_f();
+            time_point end = clock::now();
+            lock.lock();
+
+            record_frame(start - deadline, end - start);
+
+            deadline += period_;
+            if (end > deadline) {
+                deadline = handle_overrun(deadline, end);
+            }
+
+            // Sleep until the absolute deadline; pause/stop wake us immediately
+            cv_.wait_until(lock, deadline, [this] { return paused_ || stop_requested_; });
+        }
+
+        running_ = false;
+        stop_requested_ = false;
+        cv_.notify_all();
+    }
+
+    void pause() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = true;
+        cv_.notify_all();
+    }
+
+    void resume() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        paused_ = false;
+        cv_.notify_all();
+    }
+
+    /// Request the loop to exit. The current frame (if any) runs to completion.
+    /// A stop requested before run() starts makes run() return immediately.
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_requested_ = true;
+        cv_.notify_all();
+    }
+
+    /// Block until a running loop has exited
+    void wait_until_stopped() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !running_; });
+    }
+
+    bool is_paused() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return paused_;
+    }
+
+    bool is_running() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return running_;
+    }
+
+    void set_period(duration period) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        period_ = period;
+    }
+
+    void set_policy(frame_pacing_policy policy, int max_catch_up_frames) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        policy_ = policy;
+        max_catch_up_frames_ = std::max(0, max_catch_up_frames);
+    }
+
+    frame_scheduler_stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void reset_stats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = frame_scheduler_stats();
+        jitter_sum_us_ = 0;
+    }
+
+private:
+    static double to_us(duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+
+    void record_frame(duration lateness, duration frame_time) {
+        double jitter = std::abs(to_us(lateness));
+        double frame_us = to_us(frame_time);
+
+        ++stats_.frames;
+        jitter_sum_us_ += jitter;
+        stats_.last_jitter_us = jitter;
+        stats_.mean_jitter_us = jitter_sum_us_ / (double)stats_.frames;
+        stats_.max_jitter_us = std::max(stats_.max_jitter_us, jitter);
+        stats_.last_frame_us = frame_us;
+        stats_.max_frame_us = std::max(stats_.max_frame_us, frame_us);
+    }
+
+    // Called with the lock held when a frame ended after the next deadline.
+    // Returns the deadline of the next frame to run.
+    time_point handle_overrun(time_point deadline, time_point now) {
+        ++stats_.overruns;
+        stats_.max_overrun_us = std::max(stats_.max_overrun_us, to_us(now - deadline));
+
+        // Number of whole periods we are behind (the deadline itself is due now)
+        int64_t behind = period_.count() > 0 ? (int64_t)((now - deadline) / period_) : 0;
+
+        int64_t dropped = 0;
+        if (policy_ == frame_pacing_policy::skip) {
+            // Resynchronize to the first deadline that is still in the future
+            dropped = behind + 1;
+        } else if (behind > max_catch_up_frames_) {
+            dropped = behind - max_catch_up_frames_;
+        }
+        stats_.skipped_frames += (uint64_t)dropped;
+        return deadline + period_ * dropped;
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+
+    duration period_;
+    frame_pacing_policy policy_;
+    int max_catch_up_frames_;
+
+    bool running_ = false;
+    bool paused_ = false;
+    bool stop_requested_ = false;
+
+    frame_scheduler_stats stats_;
+    double jitter_sum_us_ = 0;
+};
+
+using frame_scheduler = basic_frame_scheduler<>;
+
+/// Default game loop period (~24 fps, StarCraft's native frame rate)
+static constexpr std::chrono::microseconds default_frame_period{41667};
+
+} // namespace openbw_ios
+
+#endif // FRAMESCHEDULER_H
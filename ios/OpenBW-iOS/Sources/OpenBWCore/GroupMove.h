@@ -0,0 +1,127 @@
+// GroupMove.h
+// Shared long-range path and formation layout for multi-unit move commands
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). A group move searches
+// the region graph once, from the region under the group's centroid to the
+// destination region. Each unit then only travels a few regions at a time
+// along that shared corridor, so the engine's per-unit path searches stay
+// local. At the destination, units keep their relative layout (compressed to
+// a compact formation) instead of all converging on one point.
+
+#ifndef GROUPMOVE_H
+#define GROUPMOVE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace openbw_ios {
+
+struct group_point {
+    int x = 0;
+    int y = 0;
+};
+
+/// A* over a region graph. node_T is a pointer to a region, and
+///   neighbors_f(node, visit) calls visit(neighbor) for each walkable neighbor
+///   center_f(node) returns the node's group_point center
+/// Returns the node sequence from start to goal inclusive, or empty if the
+/// goal is unreachable.
+template<typename node_T, typename neighbors_F, typename center_F>
+std::vector<node_T> find_region_corridor(node_T start, node_T goal, neighbors_F&& neighbors_f, center_F&& center_f) {
+    std::vector<node_T> path;
+    if (!start || !goal) return path;
+    if (start == goal) {
+        path.push_back(start);
+        return path;
+    }
+
+    auto distance = [&](node_T a, node_T b) {
+        group_point pa = center_f(a);
+        group_point pb = center_f(b);
+        return std::hypot((double)(pa.x - pb.x), (double)(pa.y - pb.y));
+    };
+
+    struct open_entry {
+        double f;
+        node_T node;
+        bool operator<(const open_entry& o) const { return f > o.f; }
+    };
+    struct node_state {
+        double g;
+        node_T parent;
+        bool closed;
+    };
+
+    std::priority_queue<open_entry> open;
+    std::unordered_map<node_T, node_state> nodes;
+    nodes[start] = {0.0, nullptr, false};
+    open.push({distance(start, goal), start});
+
+    while (!open.empty()) {
+        node_T current = open.top().node;
+        open.pop();
+        node_state& cs = nodes[current];
+        if (cs.closed) continue;
+        cs.closed = true;
+
+        if (current == goal) {
+            for (node_T n = goal; n; n = nodes[n].parent) path.push_back(n);
+            std::reverse(path.begin(), path.end());
+            return path;
+        }
+
+        double g = cs.g;
+        neighbors_f(current, [&](node_T next) {
+            double ng = g + distance(current, next);
+            auto it = nodes.find(next);
+            if (it != nodes.end() && (it->second.closed || it->second.g <= ng)) return;
+            nodes[next] = {ng, current, false};
+            open.push({ng + distance(next, goal), next});
+        });
+    }
+    return path;
+}
+
+inline group_point group_centroid(const std::vector<group_point>& positions) {
+    if (positions.empty()) return {};
+    int64_t sx = 0, sy = 0;
+    for (const group_point& p : positions) {
+        sx += p.x;
+        sy += p.y;
+    }
+    return {(int)(sx / (int64_t)positions.size()), (int)(sy / (int64_t)positions.size())};
+}
+
+/// Destination offsets for each member, preserving the group's current layout
+/// relative to its centroid but compressed so the formation spans at most
+/// about spacing * sqrt(n) pixels.
+inline std::vector<group_point> formation_offsets(const std::vector<group_point>& positions, int spacing) {
+    std::vector<group_point> offsets(positions.size());
+    if (positions.empty()) return offsets;
+
+    group_point centroid = group_centroid(positions);
+
+    double max_radius = 0;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        offsets[i] = {positions[i].x - centroid.x, positions[i].y - centroid.y};
+        max_radius = std::max(max_radius, std::hypot((double)offsets[i].x, (double)offsets[i].y));
+    }
+
+    double allowed = spacing * std::ceil(std::sqrt((double)positions.size())) / 2.0;
+    if (max_radius > allowed) {
+        double scale = allowed / max_radius;
+        for (group_point& o : offsets) {
+            o.x = (int)std::lround(o.x * scale);
+            o.y = (int)std::lround(o.y * scale);
+        }
+    }
+    return offsets;
+}
+
+} // namespace openbw_ios
+
+#endif // GROUPMOVE_H
@@ -0,0 +1,134 @@
+// KeyframeIndex.h
+// Periodic full-state snapshots for seeking within a replay
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). After each simulated
+// frame the caller asks due(frame) and adds a snapshot when it is. A seek
+// restores the latest keyframe at or before the target and simulates forward
+// from there, so its cost is bounded by the keyframe spacing instead of the
+// game's length. Keyframes sit on multiples of the spacing. When they exceed
+// the memory budget every other one is dropped and the spacing doubles, so
+// they stay evenly spread over a game of any length. Frame 0 is never dropped.
+
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace openbw_ios {
+
+template<typename snapshot_T>
+class keyframe_index {
+public:
+    struct keyframe {
+        int frame = 0;
+        size_t bytes = 0;
+        std::shared_ptr<const snapshot_T> snapshot;
+    };
+
+    struct stats_t {
+        size_t keyframes = 0;
+        size_t bytes = 0;
+        int spacing = 0;            // Current frames between keyframes
+        size_t captures = 0;
+        size_t thinnings = 0;       // Times the spacing doubled to fit the budget
+    };
+
+    keyframe_index(int interval, size_t budget_bytes)
+        : interval_(std::max(1, interval)), spacing_(interval_), budget_(budget_bytes) {}
+
+    /// New settings apply to the keyframes already held: a larger budget keeps
+    /// them, a smaller one thins them. A new interval takes effect on clear().
+    void configure(int interval, size_t budget_bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interval_ = std::max(1, interval);
+        if (keyframes_.empty()) spacing_ = interval_;
+        budget_ = budget_bytes;
+        fit_budget();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keyframes_.clear();
+        bytes_ = 0;
+        spacing_ = interval_;
+        captures_ = thinnings_ = 0;
+    }
+
+    /// A keyframe belongs at this frame and is not held yet
+    bool due(int frame) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frame % spacing_ == 0 && !contains(frame);
+    }
+
+    void add(int frame, std::shared_ptr<const snapshot_T> snapshot, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (contains(frame)) return;
+        keyframe k;
+        k.frame = frame;
+        k.bytes = bytes;
+        k.snapshot = std::move(snapshot);
+        keyframes_.insert(upper_bound(frame), std::move(k));
+        bytes_ += bytes;
+        ++captures_;
+        fit_budget();
+    }
+
+    /// The latest keyframe at or before frame; snapshot is null if none
+    keyframe find(int frame) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = upper_bound(frame);
+        return it == keyframes_.begin() ? keyframe() : *(it - 1);
+    }
+
+    stats_t stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_t s;
+        s.keyframes = keyframes_.size();
+        s.bytes = bytes_;
+        s.spacing = spacing_;
+        s.captures = captures_;
+        s.thinnings = thinnings_;
+        return s;
+    }
+
+private:
+    typename std::vector<keyframe>::const_iterator upper_bound(int frame) const {
+        return std::upper_bound(keyframes_.begin(), keyframes_.end(), frame,
+                                [](int f, const keyframe& k) { return f < k.frame; });
+    }
+
+    bool contains(int frame) const {
+        auto it = upper_bound(frame);
+        return it != keyframes_.begin() && (it - 1)->frame == frame;
+    }
+
+    void fit_budget() {
+        while (bytes_ > budget_ && keyframes_.size() > 1) {
+            spacing_ *= 2;
+            ++thinnings_;
+            auto keep = std::remove_if(keyframes_.begin(), keyframes_.end(), [&](const keyframe& k) {
+                if (k.frame % spacing_ == 0) return false;
+                bytes_ -= k.bytes;
+                return true;
+            });
+            keyframes_.erase(keep, keyframes_.end());
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<keyframe> keyframes_;   // Ordered by frame
+    int interval_;
+    int spacing_;
+    size_t budget_;
+    size_t bytes_ = 0;
+    size_t captures_ = 0;
+    size_t thinnings_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // KEYFRAMEINDEX_H
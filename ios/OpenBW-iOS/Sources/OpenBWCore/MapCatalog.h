@@ -0,0 +1,405 @@
+// MapCatalog.h
+// Map metadata for map selection without loading maps into the game
+//
+// Portable C++14 on POSIX (no Foundation/UIKit or OpenBW types). A map's
+// name, dimensions, tileset, player slots and start locations come from a few
+// CHK sections (SPRP/STR, DIM, ERA, OWNR, UNIT), read by parse_chk_info. The
+// catalog scans directories for .scm/.scx files and parses changed maps on
+// worker threads; extracting scenario.chk from the map archive is left to the
+// caller's reader. Results persist in a small binary file. A file whose size
+// and mtime are unchanged is not opened at all; one that changed is hashed,
+// and is only parsed again if no entry has the same contents.
+
+#ifndef MAPCATALOG_H
+#define MAPCATALOG_H
+
+#include "MappedFile.h"
+#include "MegatileColors.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace openbw_ios {
+
+struct map_start_location {
+    int player = 0;
+    int x = 0;                      // In pixels
+    int y = 0;
+};
+
+struct map_info {
+    std::string path;
+    std::string name;               // Scenario name (UTF-8, formatting codes removed)
+    std::string description;
+    int tileset = -1;
+    int width = 0;                  // In tiles
+    int height = 0;
+    int human_slots = 0;
+    int computer_slots = 0;
+    std::vector<map_start_location> start_locations;
+
+    uint64_t file_hash = 0;
+    uint64_t file_size = 0;
+    int64_t file_mtime = 0;
+
+    /// Players a melee game supports: one per start location with an open slot
+    int max_players() const {
+        int slots = human_slots + computer_slots;
+        return start_locations.empty() ? slots : std::min<int>(slots, (int)start_locations.size());
+    }
+};
+
+namespace detail {
+
+inline uint16_t chk_u16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+// Strings are stored in the map's code page; treat them as Latin-1 and drop
+// the control characters StarCraft uses for text color.
+inline std::string chk_string(const uint8_t* str, size_t size, int index) {
+    if (index <= 0 || size < 2) return {};
+    size_t count = chk_u16(str);
+    if ((size_t)index > count || size < 2 + (size_t)index * 2) return {};
+    size_t offset = chk_u16(str + (size_t)index * 2);
+    std::string out;
+    for (size_t i = offset; i < size && str[i]; ++i) {
+        uint8_t c = str[i];
+        if (c < 0x20) continue;
+        if (c < 0x80) {
+            out += (char)c;
+        } else {
+            out += (char)(0xc0 | c >> 6);
+            out += (char)(0x80 | (c & 0x3f));
+        }
+    }
+    return out;
+}
+
+} // namespace detail
+
+/// Extract the catalog fields from a scenario.chk. Later sections override
+/// earlier ones, as in the game. Returns false if DIM or ERA is missing.
+inline bool parse_chk_info(const uint8_t* data, size_t size, map_info& out) {
+    static constexpr size_t unit_entry_size = 36;
+    static constexpr int start_location_unit = 214;
+    static constexpr uint8_t slot_computer = 5;
+    static constexpr uint8_t slot_human = 6;
+
+    const uint8_t* str = nullptr;
+    size_t str_size = 0;
+    int name_index = 0, description_index = 0;
+    out.tileset = -1;
+    out.width = out.height = 0;
+    out.human_slots = out.computer_slots = 0;
+    out.start_locations.clear();
+
+    size_t pos = 0;
+    while (size - pos >= 8) {
+        const uint8_t* header = data + pos;
+        int32_t length;
+        std::memcpy(&length, header + 4, 4);
+        pos += 8;
+        size_t n = length < 0 ? 0 : std::min((size_t)length, size - pos);
+        const uint8_t* body = data + pos;
+
+        if (!std::memcmp(header, "ERA ", 4) && n >= 2) {
+            out.tileset = detail::chk_u16(body) & 7;
+        } else if (!std::memcmp(header, "DIM ", 4) && n >= 4) {
+            out.width = detail::chk_u16(body);
+            out.height = detail::chk_u16(body + 2);
+        } else if (!std::memcmp(header, "OWNR", 4) && n >= 8) {
+            out.human_slots = out.computer_slots = 0;
+            for (size_t i = 0; i < 8; ++i) {
+                if (body[i] == slot_human) ++out.human_slots;
+                else if (body[i] == slot_computer) ++out.computer_slots;
+            }
+        } else if (!std::memcmp(header, "UNIT", 4)) {
+            out.start_locations.clear();
+            for (size_t i = 0; i + unit_entry_size <= n; i += unit_entry_size) {
+                const uint8_t* unit = body + i;
+                if (detail::chk_u16(unit + 8) != start_location_unit) continue;
+                out.start_locations.push_back({unit[16], detail::chk_u16(unit + 4), detail::chk_u16(unit + 6)});
+            }
+        } else if (!std::memcmp(header, "SPRP", 4) && n >= 4) {
+            name_index = detail::chk_u16(body);
+            description_index = detail::chk_u16(body + 2);
+        } else if (!std::memcmp(header, "STR ", 4)) {
+            str = body;
+            str_size = n;
+        }
+
+        if (length < 0) {
+            // Negative lengths (protected maps) jump backwards; stop there
+            break;
+        }
+        pos += n;
+    }
+
+    out.name = detail::chk_string(str, str_size, name_index);
+    out.description = detail::chk_string(str, str_size, description_index);
+    return out.tileset >= 0 && out.width > 0 && out.height > 0;
+}
+
+class map_catalog {
+public:
+    /// Extracts staredit\scenario.chk from a map file; called concurrently
+    using chk_reader = std::function<bool(const std::string& map_path, std::vector<uint8_t>& chk)>;
+
+    struct stats_t {
+        size_t files = 0;
+        size_t unchanged = 0;       // Size and mtime matched; file not opened
+        size_t rehashed = 0;        // Changed on disk but same contents
+        size_t parsed = 0;
+        size_t failed = 0;
+        double milliseconds = 0;
+    };
+
+    explicit map_catalog(chk_reader reader) : reader_(std::move(reader)) {}
+
+    /// Scan directories (not recursive) and return every readable map, sorted
+    /// by path. Entries for files that no longer exist are dropped.
+    std::vector<map_info> refresh(const std::vector<std::string>& directories, size_t worker_count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto start = std::chrono::steady_clock::now();
+        stats_ = stats_t();
+
+        std::unordered_map<uint64_t, const map_info*> by_hash;
+        for (const auto& entry : entries_) by_hash[entry.second.file_hash] = &entry.second;
+
+        std::vector<map_info> found;
+        std::vector<size_t> changed;
+        for (const std::string& directory : directories) {
+            for (const std::string& path : list_maps(directory)) {
+                struct stat st;
+                if (stat(path.c_str(), &st) != 0) continue;
+                auto it = entries_.find(path);
+                if (it != entries_.end() && it->second.file_size == (uint64_t)st.st_size &&
+                    it->second.file_mtime == (int64_t)st.st_mtime) {
+                    found.push_back(it->second);
+                    ++stats_.unchanged;
+                    continue;
+                }
+                map_info info;
+                info.path = path;
+                info.file_size = (uint64_t)st.st_size;
+                info.file_mtime = (int64_t)st.st_mtime;
+                changed.push_back(found.size());
+                found.push_back(std::move(info));
+            }
+        }
+
+        // Changed files: hash, then parse unless the contents are already known
+        std::vector<uint8_t> ok(found.size(), 1);
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> rehashed{0};
+        auto worker = [&] {
+            std::vector<uint8_t> chk;
+            for (size_t i; (i = next++) < changed.size();) {
+                map_info& info = found[changed[i]];
+                mapped_file file;
+                if (!file.open(info.path, mapped_file::access::sequential)) {
+                    ok[changed[i]] = 0;
+                    continue;
+                }
+                info.file_hash = fnv1a64(file.data(), file.size());
+                auto known = by_hash.find(info.file_hash);
+                if (known != by_hash.end()) {
+                    copy_metadata(*known->second, info);
+                    ++rehashed;
+                    continue;
+                }
+                ok[changed[i]] = reader_(info.path, chk) && parse_chk_info(chk.data(), chk.size(), info);
+            }
+        };
+        std::vector<std::thread> threads;
+        size_t n = std::max<size_t>(1, std::min(worker_count, changed.size()));
+        for (size_t i = 1; i < n; ++i) threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads) thread.join();
+
+        stats_.rehashed = rehashed;
+        stats_.parsed = changed.size() - rehashed;
+        std::vector<map_info> result;
+        entries_.clear();
+        for (size_t i = 0; i < found.size(); ++i) {
+            if (!ok[i]) {
+                ++stats_.failed;
+                continue;
+            }
+            entries_[found[i].path] = found[i];
+            result.push_back(std::move(found[i]));
+        }
+        std::sort(result.begin(), result.end(), [](const map_info& a, const map_info& b) { return a.path < b.path; });
+        stats_.files = result.size();
+        stats_.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    stats_t stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    /// Load entries saved by save(); returns false (and keeps nothing) if the
+    /// file is missing or from another format version
+    bool load(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        mapped_file file;
+        if (!file.open(path, mapped_file::access::sequential)) return false;
+        reader r{file.data(), file.data() + file.size()};
+
+        char magic[4];
+        uint32_t version = 0, count = 0;
+        if (!r.bytes(magic, 4) || std::memcmp(magic, "OBWM", 4) || !r.get(version) || version != format_version ||
+            !r.get(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            map_info info;
+            uint32_t starts = 0;
+            int32_t fields[6];
+            if (!r.string(info.path) || !r.string(info.name) || !r.string(info.description) ||
+                !r.get(info.file_hash) || !r.get(info.file_size) || !r.get(info.file_mtime) ||
+                !r.bytes(fields, sizeof(fields)) || !r.get(starts) || starts > 256) {
+                entries_.clear();
+                return false;
+            }
+            info.tileset = fields[0];
+            info.width = fields[1];
+            info.height = fields[2];
+            info.human_slots = fields[3];
+            info.computer_slots = fields[4];
+            info.start_locations.resize(starts);
+            for (auto& s : info.start_locations) {
+                int32_t v[3];
+                if (!r.bytes(v, sizeof(v))) {
+                    entries_.clear();
+                    return false;
+                }
+                s = {v[0], v[1], v[2]};
+            }
+            entries_[info.path] = std::move(info);
+        }
+        return true;
+    }
+
+    /// Written to a temporary file and renamed, like the asset cache
+    bool save(const std::string& path) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint8_t> out;
+        auto put = [&](const void* p, size_t n) {
+            out.insert(out.end(), static_cast<const uint8_t*>(p), static_cast<const uint8_t*>(p) + n);
+        };
+        auto put_string = [&](const std::string& s) {
+            uint32_t n = (uint32_t)s.size();
+            put(&n, 4);
+            put(s.data(), s.size());
+        };
+        uint32_t version = format_version, count = (uint32_t)entries_.size();
+        put("OBWM", 4);
+        put(&version, 4);
+        put(&count, 4);
+        for (const auto& entry : entries_) {
+            const map_info& info = entry.second;
+            put_string(info.path);
+            put_string(info.name);
+            put_string(info.description);
+            put(&info.file_hash, 8);
+            put(&info.file_size, 8);
+            put(&info.file_mtime, 8);
+            int32_t fields[6] = {info.tileset, info.width, info.height, info.human_slots, info.computer_slots, 0};
+            put(fields, sizeof(fields));
+            uint32_t starts = (uint32_t)info.start_locations.size();
+            put(&starts, 4);
+            for (const auto& s : info.start_locations) {
+                int32_t v[3] = {s.player, s.x, s.y};
+                put(v, sizeof(v));
+            }
+        }
+
+        std::string temp = path + ".tmp";
+        FILE* f = std::fopen(temp.c_str(), "wb");
+        if (!f) return false;
+        bool written = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+        written = std::fclose(f) == 0 && written;
+        if (!written || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint32_t format_version = 1;
+
+    struct reader {
+        const uint8_t* p;
+        const uint8_t* end;
+
+        bool bytes(void* dst, size_t n) {
+            if ((size_t)(end - p) < n) return false;
+            std::memcpy(dst, p, n);
+            p += n;
+            return true;
+        }
+        template<typename T>
+        bool get(T& value) { return bytes(&value, sizeof(value)); }
+        bool string(std::string& s) {
+            uint32_t n;
+            if (!get(n) || (size_t)(end - p) < n) return false;
+            s.assign(reinterpret_cast<const char*>(p), n);
+            p += n;
+            return true;
+        }
+    };
+
+    // Everything parsed from the CHK; the file identity fields stay
+    static void copy_metadata(const map_info& from, map_info& to) {
+        to.name = from.name;
+        to.description = from.description;
+        to.tileset = from.tileset;
+        to.width = from.width;
+        to.height = from.height;
+        to.human_slots = from.human_slots;
+        to.computer_slots = from.computer_slots;
+        to.start_locations = from.start_locations;
+    }
+
+    static std::vector<std::string> list_maps(const std::string& directory) {
+        std::vector<std::string> paths;
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) return paths;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() < 4 || name[0] == '.') continue;
+            std::string extension = name.substr(name.size() - 4);
+            for (char& c : extension) c = (char)tolower((unsigned char)c);
+            if (extension == ".scm" || extension == ".scx") paths.push_back(directory + "/" + name);
+        }
+        closedir(dir);
+        return paths;
+    }
+
+    chk_reader reader_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, map_info> entries_;     // By path
+    stats_t stats_;
+};
+
+} // namespace openbw_ios
+
+#endif // MAPCATALOG_H
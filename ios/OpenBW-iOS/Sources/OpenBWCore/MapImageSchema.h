@@ -0,0 +1,359 @@
+// MapImageSchema.h
+// A freshly loaded map as an image: the derived game_state and the state
+//
+// C++14 over OpenBW types (no Foundation/UIKit). load_map_file parses the CHK,
+// loads the tileset and derives tile flags, the region graph and its contours;
+// on large maps that is most of a game start. A map image holds the result:
+// the game_state with its region graph, followed by a state image (see
+// StateImageSchema.h) of the state as the load left it. Reading one back into
+// a new game_state and a state replaces load_map_file for that map. The load
+// may include a game setup that depends only on the key (see MeleeSetup.h),
+// in which case the image also holds the set-up game.
+//
+// game_state is declared like the state: members that own memory are opaque
+// and saved as sections, and region pointers are saved as (pool, index). It
+// cannot be copied, so instead of a deep copy the audit compares two
+// independent loads of the map: a word holding a different address in each
+// is an owner or pointer the schema is missing, and the image is not written.
+
+#ifndef MAPIMAGESCHEMA_H
+#define MAPIMAGESCHEMA_H
+
+#include "bwgame.h"
+#include "StateImageSchema.h"
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+/// Pools of a map image, after the state image's
+namespace map_image_pool {
+    static constexpr uint8_t regions = state_image_pool::global + 1;
+}
+
+/// Sections of the game_state; the state image's follow them
+namespace map_image_section {
+    static constexpr uint32_t game = 101;
+    static constexpr uint32_t region_graph = 102;
+    static constexpr uint32_t region_list = 103;
+    static constexpr uint32_t neighbors = 104;
+    static constexpr uint32_t split_regions = 105;
+    static constexpr uint32_t tile_region_index = 106;
+    static constexpr uint32_t contours = 107;       // One per contour list
+    static constexpr uint32_t strings = 108;
+    static constexpr uint32_t sight_masks = 109;    // One per player
+    static constexpr uint32_t gfx_tiles = 110;
+    static constexpr uint32_t cv5 = 111;
+    static constexpr uint32_t vf4 = 112;
+    static constexpr uint32_t mega_tile_flags = 113;
+}
+
+static constexpr uint64_t map_image_version = 1;
+
+namespace map_image_detail {
+
+template<typename F>
+void visit_game(bwgame::game_state& g, F& f) {
+    f.opaque(g.map_strings);
+    f.opaque(g.scenario_name);
+    f.opaque(g.scenario_description);
+    for (auto& sight : g.sight_values) f.opaque(sight.maskdat);
+    f.opaque(g.gfx_tiles);
+    f.opaque(g.cv5);
+    f.opaque(g.vf4);
+    f.opaque(g.mega_tile_flags);
+    f.opaque(g.regions);
+}
+
+template<typename regions_T, typename F>
+void visit_region_graph(regions_T& r, F& f) {
+    f.opaque(r.tile_region_index);
+    f.opaque(r.split_regions);
+    f.opaque(r.regions);
+    for (auto& contours : r.contours) f.opaque(contours);
+}
+
+// Strings as a count, then a length and the characters of each
+template<typename string_T>
+void add_string(std::vector<uint8_t>& out, const string_T& s) {
+    uint32_t size = (uint32_t)s.size();
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&size);
+    out.insert(out.end(), p, p + sizeof(size));
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+class string_reader {
+public:
+    explicit string_reader(const std::vector<uint8_t>& in) : in_(in) {}
+
+    bool count(uint32_t& n) { return get(n); }
+
+    template<typename string_T>
+    bool next(string_T& s) {
+        uint32_t size = 0;
+        if (!get(size) || size > in_.size() - pos_) return false;
+        s.assign(reinterpret_cast<const char*>(in_.data() + pos_), size);
+        pos_ += size;
+        return true;
+    }
+
+private:
+    bool get(uint32_t& v) {
+        if (in_.size() - pos_ < sizeof(v)) return false;
+        std::memcpy(&v, in_.data() + pos_, sizeof(v));
+        pos_ += sizeof(v);
+        return true;
+    }
+
+    const std::vector<uint8_t>& in_;
+    size_t pos_ = 0;
+};
+
+} // namespace map_image_detail
+
+struct map_image_schema {
+    using region_graph_t = std::decay<decltype(std::declval<bwgame::game_state&>().regions)>::type;
+    using region_t = std::decay<decltype(std::declval<region_graph_t&>().regions[0])>::type;
+    using split_region_t = std::decay<decltype(std::declval<region_graph_t&>().split_regions[0])>::type;
+
+    object_layout game, region_graph, region, split_region;
+    uint64_t key = 0;               // Also covers the state image's layouts
+
+    static const map_image_schema& get() {
+        static const map_image_schema schema;
+        return schema;
+    }
+
+private:
+    map_image_schema() {
+        using namespace map_image_detail;
+        game = object_layout::of<bwgame::game_state>("game_state", [](bwgame::game_state& o, auto& f) { visit_game(o, f); });
+        region_graph = object_layout::of<region_graph_t>("regions_t", [](region_graph_t& o, auto& f) { visit_region_graph(o, f); });
+        region = object_layout::of<region_t>("region", [](region_t& o, auto& f) {
+            f.opaque(o.walkable_neighbors);
+            f.opaque(o.non_walkable_neighbors);
+        });
+        split_region = object_layout::of<split_region_t>("split_region", [](split_region_t& o, auto& f) {
+            f(o.a);
+            f(o.b);
+        });
+        uint64_t state_key = state_image_schema::get().key;
+        key = state_image_key({&game, &region_graph, &region, &split_region}, map_image_version);
+        key = fnv1a64(reinterpret_cast<const uint8_t*>(&state_key), sizeof(state_key), key);
+    }
+};
+
+/// Everything a saved pointer in a map image may refer to: the state image's
+/// objects plus the regions of st's game_state
+inline bool map_image_regions(bwgame::state& st, bwgame::state_functions& funcs, object_regions& regions) {
+    auto& list = st.game->regions.regions;
+    regions.clear();
+    add_state_image_regions(st, funcs, regions);
+    for (size_t i = 0; i < list.size(); ++i) regions.add(map_image_pool::regions, &list[i], sizeof(list[i]), 1, (uint32_t)i);
+    return regions.finish();
+}
+
+/// False, with an error naming the members to declare, if the game_state of
+/// st has members the schema does not cover. other is the same map loaded
+/// again into a game_state of its own.
+inline bool verify_map_image(bwgame::game_state& game, const bwgame::game_state& other, const object_regions& regions,
+                             std::string& error) {
+    const map_image_schema& schema = map_image_schema::get();
+    auto& list = game.regions.regions;
+    auto& splits = game.regions.split_regions;
+    if (list.size() != other.regions.regions.size() || splits.size() != other.regions.split_regions.size()) {
+        error = "Two loads of the map derived different region graphs";
+        return false;
+    }
+    std::set<std::pair<std::string, uint32_t>> missing;
+    auto check = [&](const object_layout& layout, const void* object, const void* loaded_again) {
+        for (uint32_t offset : layout.undeclared_pointers(object, regions)) missing.emplace(layout.name, offset);
+        for (uint32_t offset : layout.undeclared_owners(object, loaded_again)) missing.emplace(layout.name, offset);
+    };
+    check(schema.game, &game, &other);
+    check(schema.region_graph, &game.regions, &other.regions);
+    for (size_t i = 0; i < list.size(); ++i) check(schema.region, &list[i], &other.regions.regions[i]);
+    for (size_t i = 0; i < splits.size(); ++i) check(schema.split_region, &splits[i], &other.regions.split_regions[i]);
+    if (missing.empty()) return true;
+
+    error = "Map image schema is missing members:";
+    for (const auto& m : missing) error += " " + m.first + "+" + std::to_string(m.second);
+    return false;
+}
+
+/// Image of st as its load left it, under map_key (the map's content key, or
+/// a key of the map and a game setup). second is a state that was loaded the
+/// same way into a game_state of its own, which the game_state and the state
+/// are verified against.
+inline bool write_map_image(state_image_writer& writer, bwgame::state& st, const bwgame::state& second,
+                            uint64_t map_key, std::string& error) {
+    using namespace map_image_detail;
+    namespace section = map_image_section;
+    const map_image_schema& schema = map_image_schema::get();
+    bwgame::state_functions funcs(st);
+    bwgame::game_state& game = *st.game;
+    auto& graph = game.regions;
+    object_regions regions;
+    if (!map_image_regions(st, funcs, regions)) {
+        error = "Engine objects overlap";
+        return false;
+    }
+    if (!verify_map_image(game, *second.game, regions, error) || !verify_state_image(st, &second, regions, error)) {
+        return false;
+    }
+
+    writer.reset(schema.key, (uint32_t)st.current_frame);
+    if (!writer.add_objects(section::game, schema.game, 1, [&](size_t) { return &game; }, regions, error) ||
+        !writer.add_objects(section::region_graph, schema.region_graph, 1, [&](size_t) { return &graph; }, regions, error) ||
+        !writer.add_object_vector(section::region_list, schema.region, graph.regions, regions, error)) {
+        return false;
+    }
+
+    // Each region's neighbor counts, then the neighbors
+    std::vector<uint64_t> links;
+    auto add_links = [&](const auto& neighbors) {
+        for (const auto* n : neighbors) {
+            uint64_t v;
+            if (!regions.encode(n, v)) return false;
+            links.push_back(v);
+        }
+        return true;
+    };
+    for (const auto& r : graph.regions) {
+        links.push_back(r.walkable_neighbors.size());
+        links.push_back(r.non_walkable_neighbors.size());
+        if (!add_links(r.walkable_neighbors) || !add_links(r.non_walkable_neighbors)) {
+            error = "Region neighbor outside the region graph";
+            return false;
+        }
+    }
+    writer.add_vector(section::neighbors, links);
+    if (!writer.add_object_vector(section::split_regions, schema.split_region, graph.split_regions, regions, error)) {
+        return false;
+    }
+    writer.add_vector(section::tile_region_index, graph.tile_region_index);
+    for (const auto& contours : graph.contours) writer.add_vector(section::contours, contours);
+
+    std::vector<uint8_t> strings;
+    uint32_t count = (uint32_t)game.map_strings.size() + 2;
+    strings.insert(strings.end(), reinterpret_cast<const uint8_t*>(&count), reinterpret_cast<const uint8_t*>(&count + 1));
+    for (const auto& s : game.map_strings) add_string(strings, s);
+    add_string(strings, game.scenario_name);
+    add_string(strings, game.scenario_description);
+    writer.add_vector(section::strings, strings);
+
+    for (const auto& sight : game.sight_values) writer.add_vector(section::sight_masks, sight.maskdat);
+    writer.add_vector(section::gfx_tiles, game.gfx_tiles);
+    writer.add_vector(section::cv5, game.cv5);
+    writer.add_vector(section::vf4, game.vf4);
+    writer.add_vector(section::mega_tile_flags, game.mega_tile_flags);
+    return write_state_sections(writer, st, map_key, regions, error);
+}
+
+/// Replace the load: read a map image into st and the newly constructed
+/// game_state st.game points at. st.global must be the game data the image
+/// was written with. On failure st is left partly replaced and the map must
+/// be loaded the usual way.
+inline bool read_map_image(state_image_reader& reader, bwgame::state& st, uint64_t map_key, std::string& error) {
+    using namespace map_image_detail;
+    namespace section = map_image_section;
+    const map_image_schema& schema = map_image_schema::get();
+    bwgame::state_functions funcs(st);
+    bwgame::game_state& game = *st.game;
+    auto& graph = game.regions;
+
+    // The containers pointers resolve into are sized first
+    uint32_t region_count = 0;
+    uint32_t split_count = 0;
+    if (!reader.find_count(section::region_list, region_count) || !reader.find_count(section::split_regions, split_count) ||
+        !size_state_for_image(reader, st)) {
+        error = "Map image is missing sections";
+        return false;
+    }
+    graph.regions.resize(region_count);
+    graph.split_regions.resize(split_count);
+    object_regions regions;
+    if (!map_image_regions(st, funcs, regions)) {
+        error = "Engine objects overlap";
+        return false;
+    }
+
+    if (!reader.read_objects(section::game, schema.game, 1, [&](size_t) { return &game; }, regions, error) ||
+        !reader.read_objects(section::region_graph, schema.region_graph, 1, [&](size_t) { return &graph; }, regions, error) ||
+        !reader.read_object_vector(section::region_list, schema.region, graph.regions, regions, error)) {
+        return false;
+    }
+
+    std::vector<uint64_t> links;
+    if (!reader.read_vector(section::neighbors, links, error)) return false;
+    size_t at = 0;
+    auto read_links = [&](auto& neighbors, uint64_t n) {
+        neighbors.clear();
+        for (; n && at < links.size(); --n) {
+            void* p;
+            if (!regions.decode(links[at++], p)) return false;
+            neighbors.push_back(static_cast<map_image_schema::region_t*>(p));
+        }
+        return n == 0;
+    };
+    for (auto& r : graph.regions) {
+        if (links.size() - at < 2) {
+            error = "Map image region neighbors are corrupt";
+            return false;
+        }
+        uint64_t walkable = links[at++];
+        uint64_t non_walkable = links[at++];
+        if (!read_links(r.walkable_neighbors, walkable) || !read_links(r.non_walkable_neighbors, non_walkable)) {
+            error = "Region neighbor outside the region graph";
+            return false;
+        }
+    }
+    if (!reader.read_object_vector(section::split_regions, schema.split_region, graph.split_regions, regions, error) ||
+        !reader.read_vector(section::tile_region_index, graph.tile_region_index, error)) {
+        return false;
+    }
+    for (auto& contours : graph.contours) {
+        if (!reader.read_vector(section::contours, contours, error)) return false;
+    }
+
+    std::vector<uint8_t> strings;
+    if (!reader.read_vector(section::strings, strings, error)) return false;
+    string_reader in(strings);
+    uint32_t count = 0;
+    if (!in.count(count) || count < 2) {
+        error = "Map image strings are corrupt";
+        return false;
+    }
+    game.map_strings.resize(count - 2);
+    for (auto& s : game.map_strings) {
+        if (!in.next(s)) count = 0;
+    }
+    if (count == 0 || !in.next(game.scenario_name) || !in.next(game.scenario_description)) {
+        error = "Map image strings are corrupt";
+        return false;
+    }
+
+    for (auto& sight : game.sight_values) {
+        if (!reader.read_vector(section::sight_masks, sight.maskdat, error)) return false;
+    }
+    if (!reader.read_vector(section::gfx_tiles, game.gfx_tiles, error) ||
+        !reader.read_vector(section::cv5, game.cv5, error) ||
+        !reader.read_vector(section::vf4, game.vf4, error) ||
+        !reader.read_vector(section::mega_tile_flags, game.mega_tile_flags, error)) {
+        return false;
+    }
+
+    object_regions state_regions;
+    return prepare_state_image(reader, st, funcs, map_key, nullptr, state_regions, error) &&
+           read_state_image(reader, st, state_regions, error);
+}
+
+} // namespace openbw_ios
+
+#endif // MAPIMAGESCHEMA_H
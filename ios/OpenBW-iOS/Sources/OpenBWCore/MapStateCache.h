@@ -0,0 +1,133 @@
+// MapStateCache.h
+// Keeps freshly loaded map states so loading the same map again is a copy
+//
+// Portable C++14 on POSIX (no Foundation/UIKit or OpenBW types). Loading a map
+// derives tile flags, the region graph and contours from the CHK, which on
+// large maps dominates game start. The caller stores the state as it is right
+// after loading, or after a game setup that depends only on the key, under a
+// key built from the map file's contents, and later loads of an identical
+// file restore that copy instead.
+// Entries are shared, immutable and evicted least recently used first.
+//
+// Across launches the same state comes from map images on disk (see
+// MapImageSchema.h), named by the map's content key and a key of the game
+// data. Neither depends on paths or file times, so images built ahead of
+// time by openbw_map_prewarm match the shipped maps on a device.
+
+#ifndef MAPSTATECACHE_H
+#define MAPSTATECACHE_H
+
+#include "MappedFile.h"
+#include "MegatileColors.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+/// Key of the game data a map image was derived from: the size and sampled
+/// contents of each archive, mixed with the caller's format version; 0 if an
+/// archive cannot be read
+inline uint64_t map_data_key(const std::vector<std::string>& paths, uint64_t version) {
+    static constexpr size_t sample = 64 * 1024;
+    uint64_t key = fnv1a64(reinterpret_cast<const uint8_t*>(&version), sizeof(version));
+    for (const std::string& path : paths) {
+        mapped_file file;
+        if (!file.open(path, mapped_file::access::random)) return 0;
+        uint64_t size = file.size();
+        key = fnv1a64(reinterpret_cast<const uint8_t*>(&size), sizeof(size), key);
+        size_t head = std::min(sample, file.size());
+        key = fnv1a64(file.data(), head, key);
+        if (file.size() > head) {
+            size_t tail = std::min(sample, file.size() - head);
+            key = fnv1a64(file.data() + file.size() - tail, tail, key);
+        }
+    }
+    return key;
+}
+
+/// File name of the image of a map with content key map_key on the game
+/// data with key data_key
+inline std::string map_image_file_name(uint64_t map_key, uint64_t data_key) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx-%016llx.obwm", (unsigned long long)map_key, (unsigned long long)data_key);
+    return name;
+}
+
+template<typename snapshot_T>
+class map_state_cache {
+public:
+    struct stats_t {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t entries = 0;
+    };
+
+    explicit map_state_cache(size_t capacity) : capacity_(capacity) {}
+
+    /// Hash of a map file's contents, mixed with the caller's engine version;
+    /// 0 if the file cannot be read
+    static uint64_t content_key(const std::string& path, uint64_t engine_version) {
+        mapped_file file;
+        if (!file.open(path, mapped_file::access::sequential) || file.size() == 0) return 0;
+        uint64_t key = fnv1a64(reinterpret_cast<const uint8_t*>(&engine_version), sizeof(engine_version));
+        return fnv1a64(file.data(), file.size(), key);
+    }
+
+    std::shared_ptr<const snapshot_T> find(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->first != key) continue;
+            entries_.splice(entries_.begin(), entries_, it);
+            ++stats_.hits;
+            return entries_.front().second;
+        }
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    void insert(uint64_t key, std::shared_ptr<const snapshot_T> snapshot) {
+        if (key == 0 || capacity_ == 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.remove_if([&](const entry& e) { return e.first == key; });
+        entries_.emplace_front(key, std::move(snapshot));
+        while (entries_.size() > capacity_) entries_.pop_back();
+    }
+
+    void set_capacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        while (entries_.size() > capacity_) entries_.pop_back();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+    stats_t stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_t s = stats_;
+        s.entries = entries_.size();
+        return s;
+    }
+
+private:
+    using entry = std::pair<uint64_t, std::shared_ptr<const snapshot_T>>;
+
+    mutable std::mutex mutex_;
+    std::list<entry> entries_;      // Most recently used first
+    size_t capacity_;
+    stats_t stats_;
+};
+
+} // namespace openbw_ios
+
+#endif // MAPSTATECACHE_H
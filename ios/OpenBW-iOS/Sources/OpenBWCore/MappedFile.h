@@ -0,0 +1,281 @@
+// MappedFile.h
+// Memory-mapped, zero-copy reads of whole files and MPQ archives
+//
+// Portable C++14 on POSIX (mmap/madvise; no Foundation/UIKit or OpenBW types).
+// mapped_file maps a file read-only with an access hint. mapped_file_reader
+// exposes a mapping through the file reader interface OpenBW's MPQ code uses,
+// so sector tables and compressed data are copied straight from the page cache
+// into the decompressor instead of going through stdio buffers. mpq_directory
+// parses an archive's hash and block tables, so files stored without
+// compression or encryption can be handed out as spans into the mapping.
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+class mapped_file {
+public:
+    enum class access {
+        sequential,     // Read front to back once (maps, whole-file loads)
+        random          // Scattered reads (archives)
+    };
+
+    mapped_file() = default;
+    mapped_file(const std::string& path, access hint) { open(path, hint); }
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept { *this = std::move(other); }
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(is_open_, other.is_open_);
+        }
+        return *this;
+    }
+
+    /// Returns false if the file cannot be opened. Empty files open with size 0.
+    bool open(const std::string& path, access hint) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = (size_t)st.st_size;
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            data_ = static_cast<const uint8_t*>(p);
+            madvise(const_cast<uint8_t*>(data_), size_, hint == access::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+        ::close(fd);
+        is_open_ = true;
+        return true;
+    }
+
+    void close() {
+        if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+        is_open_ = false;
+    }
+
+    /// Ask the kernel to read a range ahead of use (e.g. a file about to be copied)
+    void will_need(size_t offset, size_t length) const {
+        if (!data_ || offset >= size_) return;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = offset / page * page;
+        size_t end = std::min(size_, offset + length);
+        madvise(const_cast<uint8_t*>(data_) + begin, end - begin, MADV_WILLNEED);
+    }
+
+    bool is_open() const { return is_open_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_open_ = false;
+};
+
+/// OpenBW file reader over a mapping (for mpq_file<mapped_file_reader>)
+class mapped_file_reader {
+public:
+    mapped_file_reader() = default;
+    template<typename string_T>
+    explicit mapped_file_reader(const string_T& filename) { open(filename); }
+
+    template<typename string_T>
+    void open(const string_T& filename) {
+        std::string path(filename.begin(), filename.end());
+        if (!file_.open(path, mapped_file::access::random)) {
+            throw std::runtime_error("mapped_file_reader: failed to open " + path);
+        }
+        pos_ = 0;
+    }
+
+    bool is_open() const { return file_.is_open(); }
+    void close() { file_.close(); }
+
+    void get_bytes(uint8_t* dst, size_t n) {
+        if (n > file_.size() - pos_) throw std::runtime_error("mapped_file_reader: read past end of file");
+        std::memcpy(dst, file_.data() + pos_, n);
+        pos_ += n;
+    }
+
+    void seek(size_t offset) {
+        if (offset > file_.size()) throw std::runtime_error("mapped_file_reader: seek past end of file");
+        pos_ = offset;
+    }
+
+    size_t tell() const { return pos_; }
+    size_t size() const { return file_.size(); }
+
+private:
+    mapped_file file_;
+    size_t pos_ = 0;
+};
+
+/// Hash and block tables of an MPQ archive, read from a mapping
+class mpq_directory {
+public:
+    struct span {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    /// Parse the tables; returns false if no MPQ header is found
+    bool parse(const uint8_t* data, size_t size) {
+        hashes_.clear();
+        blocks_.clear();
+        data_ = data;
+        size_ = size;
+
+        // The header sits at a 512-byte boundary (maps may carry a prefix)
+        for (size_t offset = 0; offset + 32 <= size; offset += 512) {
+            if (std::memcmp(data + offset, "MPQ\x1a", 4)) continue;
+            archive_offset_ = offset;
+            uint32_t hash_pos = read32(data + offset + 16);
+            uint32_t block_pos = read32(data + offset + 20);
+            uint32_t hash_count = read32(data + offset + 24);
+            uint32_t block_count = read32(data + offset + 28);
+
+            if (!read_table(offset + hash_pos, hash_count, key("(hash table)"), hashes_)) return false;
+            if (!read_table(offset + block_pos, block_count, key("(block table)"), blocks_)) return false;
+            return true;
+        }
+        return false;
+    }
+
+    /// The file's bytes if it is stored uncompressed and unencrypted
+    bool find_stored(const std::string& name, span& out) const {
+        const uint32_t* block = find_block(name);
+        if (!block) return false;
+        uint32_t flags = block[3];
+        if (!(flags & file_exists) || (flags & (compressed | imploded | encrypted))) return false;
+        size_t pos = archive_offset_ + block[0];
+        size_t file_size = block[2];
+        if (pos > size_ || file_size > size_ - pos) return false;
+        out.data = data_ + pos;
+        out.size = file_size;
+        return true;
+    }
+
+    /// The archive lists the file (stored or not)
+    bool contains(const std::string& name) const {
+        const uint32_t* block = find_block(name);
+        return block && (block[3] & file_exists);
+    }
+
+    bool empty() const { return hashes_.empty(); }
+
+private:
+    static constexpr uint32_t file_exists = 0x80000000;
+    static constexpr uint32_t encrypted = 0x00010000;
+    static constexpr uint32_t compressed = 0x00000200;
+    static constexpr uint32_t imploded = 0x00000100;
+
+    static uint32_t read32(const uint8_t* p) {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    static const uint32_t* crypt_table() {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(0x500);
+            uint32_t seed = 0x00100001;
+            for (uint32_t i = 0; i < 0x100; ++i) {
+                for (uint32_t j = i, k = 0; k < 5; ++k, j += 0x100) {
+                    seed = (seed * 125 + 3) % 0x2aaaab;
+                    uint32_t hi = (seed & 0xffff) << 16;
+                    seed = (seed * 125 + 3) % 0x2aaaab;
+                    t[j] = hi | (seed & 0xffff);
+                }
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    static uint32_t hash(const std::string& name, uint32_t type) {
+        const uint32_t* table = crypt_table();
+        uint32_t seed1 = 0x7fed7fed, seed2 = 0xeeeeeeee;
+        for (char ch : name) {
+            uint32_t c = (uint8_t)ch;
+            if (c == '/') c = '\\';
+            else if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+            seed1 = table[type * 0x100 + c] ^ (seed1 + seed2);
+            seed2 = c + seed1 + seed2 + (seed2 << 5) + 3;
+        }
+        return seed1;
+    }
+
+    static uint32_t key(const char* name) { return hash(name, 3); }
+
+    bool read_table(size_t pos, uint32_t count, uint32_t table_key, std::vector<uint32_t>& out) {
+        size_t bytes = (size_t)count * 16;
+        if (pos > size_ || bytes > size_ - pos) return false;
+        out.resize((size_t)count * 4);
+        const uint32_t* table = crypt_table();
+        uint32_t seed = 0xeeeeeeee;
+        for (size_t i = 0; i < out.size(); ++i) {
+            seed += table[0x400 + (table_key & 0xff)];
+            uint32_t v = read32(data_ + pos + i * 4) ^ (table_key + seed);
+            table_key = ((~table_key << 21) + 0x11111111) | (table_key >> 11);
+            seed = v + seed + (seed << 5) + 3;
+            out[i] = v;
+        }
+        return true;
+    }
+
+    // Hash entries: name_a, name_b, locale | platform << 16, block index
+    const uint32_t* find_block(const std::string& name) const {
+        size_t count = hashes_.size() / 4;
+        if (count == 0) return nullptr;
+        uint32_t name_a = hash(name, 1);
+        uint32_t name_b = hash(name, 2);
+        size_t start = hash(name, 0) % count;
+        for (size_t n = 0; n < count; ++n) {
+            const uint32_t* entry = &hashes_[((start + n) % count) * 4];
+            if (entry[3] == 0xffffffff) return nullptr;
+            if (entry[0] != name_a || entry[1] != name_b || entry[3] >= blocks_.size() / 4) continue;
+            return &blocks_[entry[3] * 4];
+        }
+        return nullptr;
+    }
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t archive_offset_ = 0;
+    std::vector<uint32_t> hashes_;
+    std::vector<uint32_t> blocks_;     // file_pos, compressed_size, file_size, flags
+};
+
+} // namespace openbw_ios
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,239 @@
+// MegatileColors.h
+// Per-tileset average megatile colors for minimaps and map thumbnails
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). The table is computed
+// once per tileset from the raw wpe/vr4/vx4 files: each 8x8 vr4 piece is
+// summed once, and a megatile's color is the sum of its 16 pieces, so the
+// whole tileset costs one pass over the vr4 pixels. The cv5 tile groups are
+// kept alongside, so a raw map tile (MTXM value) resolves to a color in two
+// lookups. Tables serialize to a small binary blob keyed by a hash of the
+// source files, so they survive app launches.
+
+#ifndef MEGATILECOLORS_H
+#define MEGATILECOLORS_H
+
+#include "MinimapLayers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace openbw_ios {
+
+/// FNV-1a, chained across several buffers by passing the previous result as seed
+inline uint64_t fnv1a64(const uint8_t* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+struct megatile_color_table {
+    uint64_t source_hash = 0;
+    std::vector<uint32_t> colors;           // Packed RGBA per megatile
+    std::vector<uint16_t> tile_megatiles;   // cv5: (group << 4 | subtile) -> megatile
+
+    bool empty() const { return colors.empty(); }
+
+    uint32_t megatile_color(size_t megatile) const {
+        return megatile < colors.size() ? colors[megatile] : minimap_rgba(0, 0, 0);
+    }
+
+    /// Color of a raw map tile value as stored in a map's MTXM section
+    uint32_t tile_color(uint16_t tile) const {
+        return tile < tile_megatiles.size() ? megatile_color(tile_megatiles[tile]) : minimap_rgba(0, 0, 0);
+    }
+};
+
+/// Build a table from the raw tileset files.
+///   wpe: 256 * 4 bytes (r, g, b, unused)
+///   vr4: 64 palette indices per 8x8 piece
+///   vx4: 16 uint16 piece references per megatile (bit 0 = flipped, rest = piece index)
+///   cv5: 52-byte tile groups, megatile indices at offset 20
+inline megatile_color_table build_megatile_color_table(const uint8_t* wpe, size_t wpe_size,
+                                                       const uint8_t* vr4, size_t vr4_size,
+                                                       const uint8_t* vx4, size_t vx4_size,
+                                                       const uint8_t* cv5, size_t cv5_size,
+                                                       uint64_t source_hash) {
+    megatile_color_table table;
+    table.source_hash = source_hash;
+    if (wpe_size < 256 * 4) return table;
+
+    // Sum each vr4 piece once; flipping does not change the average
+    size_t piece_count = vr4_size / 64;
+    std::vector<uint32_t> piece_sums(piece_count * 3);
+    for (size_t i = 0; i < piece_count; ++i) {
+        const uint8_t* src = vr4 + i * 64;
+        uint32_t r = 0, g = 0, b = 0;
+        for (size_t p = 0; p < 64; ++p) {
+            const uint8_t* c = wpe + src[p] * 4;
+            r += c[0];
+            g += c[1];
+            b += c[2];
+        }
+        piece_sums[i * 3 + 0] = r;
+        piece_sums[i * 3 + 1] = g;
+        piece_sums[i * 3 + 2] = b;
+    }
+
+    size_t megatile_count = vx4_size / 32;
+    table.colors.resize(megatile_count);
+    for (size_t m = 0; m < megatile_count; ++m) {
+        const uint8_t* refs = vx4 + m * 32;
+        uint32_t r = 0, g = 0, b = 0;
+        for (size_t k = 0; k < 16; ++k) {
+            size_t piece = (size_t)(refs[k * 2] | refs[k * 2 + 1] << 8) >> 1;
+            if (piece >= piece_count) continue;
+            r += piece_sums[piece * 3 + 0];
+            g += piece_sums[piece * 3 + 1];
+            b += piece_sums[piece * 3 + 2];
+        }
+        table.colors[m] = minimap_rgba((uint8_t)(r / 1024), (uint8_t)(g / 1024), (uint8_t)(b / 1024));
+    }
+
+    size_t group_count = cv5_size / 52;
+    table.tile_megatiles.resize(group_count * 16);
+    for (size_t group = 0; group < group_count; ++group) {
+        const uint8_t* src = cv5 + group * 52 + 20;
+        for (size_t sub = 0; sub < 16; ++sub) {
+            table.tile_megatiles[group * 16 + sub] = (uint16_t)(src[sub * 2] | src[sub * 2 + 1] << 8);
+        }
+    }
+    return table;
+}
+
+namespace megatile_cache_detail {
+    static constexpr uint32_t magic = 0x3143544d;   // "MTC1"
+
+    template<typename T>
+    void put(std::vector<uint8_t>& out, const T& v) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+
+    template<typename T>
+    bool get(const uint8_t*& p, const uint8_t* end, T& v) {
+        if ((size_t)(end - p) < sizeof(T)) return false;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+}
+
+/// Serialize for the on-disk cache (native byte order; the cache is per device)
+inline std::vector<uint8_t> serialize_megatile_color_table(const megatile_color_table& table) {
+    using namespace megatile_cache_detail;
+    std::vector<uint8_t> out;
+    out.reserve(24 + table.colors.size() * 4 + table.tile_megatiles.size() * 2);
+    put(out, magic);
+    put(out, table.source_hash);
+    put(out, (uint32_t)table.colors.size());
+    put(out, (uint32_t)table.tile_megatiles.size());
+    for (uint32_t c : table.colors) put(out, c);
+    for (uint16_t m : table.tile_megatiles) put(out, m);
+    return out;
+}
+
+/// Returns false if the blob is malformed or was built from different files
+inline bool deserialize_megatile_color_table(const uint8_t* data, size_t size, uint64_t expected_hash,
+                                             megatile_color_table& table) {
+    using namespace megatile_cache_detail;
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint32_t file_magic = 0, color_count = 0, tile_count = 0;
+    uint64_t hash = 0;
+    if (!get(p, end, file_magic) || file_magic != magic) return false;
+    if (!get(p, end, hash) || hash != expected_hash) return false;
+    if (!get(p, end, color_count) || !get(p, end, tile_count)) return false;
+    if ((size_t)(end - p) != (size_t)color_count * 4 + (size_t)tile_count * 2) return false;
+
+    table.source_hash = hash;
+    table.colors.resize(color_count);
+    table.tile_megatiles.resize(tile_count);
+    std::memcpy(table.colors.data(), p, (size_t)color_count * 4);
+    std::memcpy(table.tile_megatiles.data(), p + (size_t)color_count * 4, (size_t)tile_count * 2);
+    return true;
+}
+
+/// Terrain sections of a scenario.chk
+struct chk_terrain {
+    int tileset = -1;
+    int width = 0;                  // In tiles
+    int height = 0;
+    std::vector<uint16_t> tiles;    // MTXM, width * height raw tile values
+};
+
+/// Extract ERA, DIM and MTXM. Later MTXM sections overwrite earlier ones, as in
+/// the game. Returns false if a required section is missing.
+inline bool parse_chk_terrain(const uint8_t* data, size_t size, chk_terrain& out) {
+    out = chk_terrain();
+    std::vector<std::pair<const uint8_t*, size_t>> mtxm;
+
+    size_t pos = 0;
+    while (size - pos >= 8) {
+        const uint8_t* header = data + pos;
+        int32_t length;
+        std::memcpy(&length, header + 4, 4);
+        pos += 8;
+        size_t available = size - pos;
+        size_t n = length < 0 ? 0 : std::min((size_t)length, available);
+        const uint8_t* body = data + pos;
+
+        if (!std::memcmp(header, "ERA ", 4) && n >= 2) {
+            out.tileset = (body[0] | body[1] << 8) & 7;
+        } else if (!std::memcmp(header, "DIM ", 4) && n >= 4) {
+            out.width = body[0] | body[1] << 8;
+            out.height = body[2] | body[3] << 8;
+        } else if (!std::memcmp(header, "MTXM", 4)) {
+            mtxm.emplace_back(body, n);
+        }
+
+        if (length < 0) {
+            // Negative lengths (protected maps) jump backwards; stop there
+            break;
+        }
+        pos += n;
+    }
+
+    if (out.tileset < 0 || out.width <= 0 || out.height <= 0 || mtxm.empty()) return false;
+
+    out.tiles.assign((size_t)out.width * out.height, 0);
+    for (auto& section : mtxm) {
+        size_t count = std::min(section.second / 2, out.tiles.size());
+        for (size_t i = 0; i < count; ++i) {
+            out.tiles[i] = (uint16_t)(section.first[i * 2] | section.first[i * 2 + 1] << 8);
+        }
+    }
+    return true;
+}
+
+/// Render a terrain thumbnail at most max_size pixels on its longer side,
+/// keeping the map's aspect ratio. One table lookup per output pixel.
+inline void render_terrain_thumbnail(const chk_terrain& terrain, const megatile_color_table& table, int max_size,
+                                     int& out_width, int& out_height, std::vector<uint32_t>& out) {
+    int longest = std::max(terrain.width, terrain.height);
+    if (longest <= 0 || max_size <= 0) {
+        out_width = out_height = 0;
+        out.clear();
+        return;
+    }
+    out_width = std::max(1, terrain.width * max_size / longest);
+    out_height = std::max(1, terrain.height * max_size / longest);
+
+    std::vector<int> tile_x(out_width);
+    for (int x = 0; x < out_width; ++x) tile_x[x] = x * terrain.width / out_width;
+
+    out.resize((size_t)out_width * out_height);
+    for (int y = 0; y < out_height; ++y) {
+        const uint16_t* row = &terrain.tiles[(size_t)(y * terrain.height / out_height) * terrain.width];
+        uint32_t* dst = &out[(size_t)y * out_width];
+        for (int x = 0; x < out_width; ++x) dst[x] = table.tile_color(row[tile_x[x]]);
+    }
+}
+
+} // namespace openbw_ios
+
+#endif // MEGATILECOLORS_H
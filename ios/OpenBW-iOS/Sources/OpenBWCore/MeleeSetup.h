@@ -0,0 +1,89 @@
+// MeleeSetup.h
+// New melee games built by OpenBW's replay loader
+//
+// A game is described as a replay header (the players, their races and the
+// random seed) plus the map's scenario.chk, and loaded as a replay with no
+// actions. The engine's melee setup then picks the start locations and places
+// the start units, the same way it does when the game's recording is played
+// back, so the recording reproduces the game in any replay loader. The seed is
+// fixed, so a map started with the same races always sets up the same way and
+// the set-up state can be kept by the map state cache and in map images.
+
+#ifndef MELEESETUP_H
+#define MELEESETUP_H
+
+#include "bwgame.h"
+#include "actions.h"
+#include "replay.h"
+
+#include "MapCatalog.h"
+#include "MegatileColors.h"
+#include "ReplayWriter.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace openbw_ios {
+
+namespace melee_setup {
+    /// The random seed (the header's start time) every game starts from
+    static constexpr uint32_t seed = 0x4f425731;
+    static constexpr int human_slot = 0;
+    static constexpr int computer_slot = 1;
+    /// Replay header player types
+    static constexpr int computer = 1;
+    static constexpr int human = 2;
+}
+
+/// Header of a game between a human in slot 0 and a computer in slot 1 on the
+/// map; false if the CHK has no dimensions
+inline bool melee_game_header(const std::vector<uint8_t>& map_chk, const std::string& map_name,
+                              bwgame::race_t human_race, bwgame::race_t computer_race, replay_header& out) {
+    map_info info;
+    if (!parse_chk_info(map_chk.data(), map_chk.size(), info)) return false;
+    out = replay_header();
+    out.brood_war = true;
+    out.start_time = melee_setup::seed;
+    out.game_name = "OpenBW iOS";
+    out.creator = "OpenBW iOS";
+    out.map_name = map_name;
+    out.map_width = info.width;
+    out.map_height = info.height;
+    for (int slot : {melee_setup::human_slot, melee_setup::computer_slot}) {
+        replay_player& p = out.players[slot];
+        bool human = slot == melee_setup::human_slot;
+        p.slot = slot;
+        p.id = slot;
+        p.type = human ? melee_setup::human : melee_setup::computer;
+        p.race = (int)(human ? human_race : computer_race);
+        p.name = human ? "Player" : "Computer";
+    }
+    return true;
+}
+
+/// Key of a set-up game: the map's content key mixed with everything else the
+/// header decides
+inline uint64_t melee_game_key(uint64_t map_key, const replay_header& header) {
+    if (map_key == 0) return 0;
+    uint64_t key = fnv1a64(reinterpret_cast<const uint8_t*>(&header.start_time), sizeof(header.start_time), map_key);
+    for (const replay_player& p : header.players) {
+        int fields[3] = {p.type, p.type ? p.race : 0, p.type ? p.slot : 0};
+        key = fnv1a64(reinterpret_cast<const uint8_t*>(fields), sizeof(fields), key);
+    }
+    return key;
+}
+
+/// Build the game the header describes on st, whose game data is loaded and
+/// whose game_state is new. Throws what OpenBW's loader throws.
+inline void load_melee_game(bwgame::state& st, bwgame::action_state& action_st, const replay_header& header,
+                            const std::vector<uint8_t>& map_chk) {
+    std::vector<uint8_t> setup = encode_replay(header, nullptr, 0, map_chk);
+    bwgame::replay_state replay_st;
+    bwgame::replay_functions loader(st, action_st, replay_st);
+    loader.load_replay_data(setup.data(), setup.size());
+}
+
+} // namespace openbw_ios
+
+#endif // MELEESETUP_H
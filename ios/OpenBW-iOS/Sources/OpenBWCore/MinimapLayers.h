@@ -0,0 +1,262 @@
+// MinimapLayers.h
+// Persistent, incrementally updated minimap image
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). The minimap is kept as
+// three layers composited into one stable RGBA buffer:
+//   - terrain: built once per map, darkened per tile by fog of war
+//   - unit dots: only dots that moved, appeared or disappeared touch pixels
+//   - camera rectangle: drawn last, on top of everything
+// Every change bumps version(), so readers copy the buffer only when needed.
+
+#ifndef MINIMAPLAYERS_H
+#define MINIMAPLAYERS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace openbw_ios {
+
+/// RGBA color packed in memory byte order (r, g, b, a) on little-endian targets
+inline uint32_t minimap_rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+    return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+}
+
+class minimap_layers {
+public:
+    static constexpr int dot_size = 2;
+
+    /// Resize for a new map. Clears all layers; build_terrain() must follow.
+    void reset(int width, int height, int map_tile_width, int map_tile_height) {
+        width_ = std::max(1, width);
+        height_ = std::max(1, height);
+        map_tile_width_ = std::max(1, map_tile_width);
+        map_tile_height_ = std::max(1, map_tile_height);
+
+        // Pixel <-> tile mappings, so neither direction needs a divide later
+        tile_x_.resize(width_);
+        tile_y_.resize(height_);
+        for (int x = 0; x < width_; ++x) tile_x_[x] = x * map_tile_width_ / width_;
+        for (int y = 0; y < height_; ++y) tile_y_[y] = y * map_tile_height_ / height_;
+        pixel_x_begin_.assign(map_tile_width_ + 1, width_);
+        pixel_y_begin_.assign(map_tile_height_ + 1, height_);
+        for (int x = width_ - 1; x >= 0; --x) pixel_x_begin_[tile_x_[x]] = x;
+        for (int y = height_ - 1; y >= 0; --y) pixel_y_begin_[tile_y_[y]] = y;
+        for (int t = map_tile_width_ - 1; t >= 0; --t) pixel_x_begin_[t] = std::min(pixel_x_begin_[t], pixel_x_begin_[t + 1]);
+        for (int t = map_tile_height_ - 1; t >= 0; --t) pixel_y_begin_[t] = std::min(pixel_y_begin_[t], pixel_y_begin_[t + 1]);
+        tile_fog_.assign((size_t)map_tile_width_ * map_tile_height_, (uint8_t)fog_visible);
+
+        size_t n = (size_t)width_ * height_;
+        base_terrain_.assign(n, minimap_rgba(0, 0, 0));
+        terrain_.assign(n, minimap_rgba(0, 0, 0));
+        composite_.assign(n, minimap_rgba(0, 0, 0));
+        output_.assign(n, minimap_rgba(0, 0, 0));
+        dot_count_.assign(n, 0);
+        on_camera_.assign(n, 0);
+        camera_pixels_.clear();
+        camera_ = {-1, -1, -1, -1};
+        dots_.clear();
+        has_terrain_ = false;
+        ++version_;
+    }
+
+    /// Fill the terrain layer. tile_color(tile_x, tile_y) returns a packed color.
+    /// Pixel-to-tile mapping is precomputed per row and column (no per-pixel divide).
+    template<typename F>
+    void build_terrain(F&& tile_color) {
+        for (int y = 0; y < height_; ++y) {
+            size_t row = (size_t)y * width_;
+            const uint8_t* fog_row = &tile_fog_[(size_t)tile_y_[y] * map_tile_width_];
+            for (int x = 0; x < width_; ++x) {
+                uint32_t c = tile_color(tile_x_[x], tile_y_[y]);
+                base_terrain_[row + x] = c;
+                terrain_[row + x] = shade(c, fog_row[tile_x_[x]]);
+            }
+        }
+
+        // Rebuild the composite from scratch: terrain under every live dot
+        composite_ = terrain_;
+        std::fill(dot_count_.begin(), dot_count_.end(), 0);
+        for (auto& kv : dots_) stamp_dot(kv.second, true);
+        output_ = composite_;
+        for (size_t i : camera_pixels_) output_[i] = camera_color_;
+        has_terrain_ = true;
+        ++version_;
+    }
+
+    bool has_terrain() const { return has_terrain_; }
+
+    /// Fog of war for one map tile: 0 = unexplored (black), 1 = explored
+    /// (darkened), 2 = visible. Redraws only the pixels covering that tile.
+    void set_tile_fog(int tile_x, int tile_y, uint8_t state) {
+        if (tile_x < 0 || tile_y < 0 || tile_x >= map_tile_width_ || tile_y >= map_tile_height_) return;
+        uint8_t& current = tile_fog_[(size_t)tile_y * map_tile_width_ + tile_x];
+        if (current == state) return;
+        current = state;
+        if (!has_terrain_) return;
+
+        for (int y = pixel_y_begin_[tile_y]; y < pixel_y_begin_[tile_y + 1]; ++y) {
+            for (int x = pixel_x_begin_[tile_x]; x < pixel_x_begin_[tile_x + 1]; ++x) {
+                size_t i = (size_t)y * width_ + x;
+                terrain_[i] = shade(base_terrain_[i], state);
+                if (dot_count_[i]) continue;
+                composite_[i] = terrain_[i];
+                if (!on_camera_[i]) output_[i] = composite_[i];
+            }
+        }
+        ++version_;
+    }
+
+    /// Start a unit pass; every live unit must then be reported with set_unit()
+    void begin_units() {
+        ++pass_;
+    }
+
+    /// Report a unit at a minimap pixel position. Only draws if it changed.
+    void set_unit(uint32_t key, int x, int y, uint32_t color) {
+        x = std::max(0, std::min(width_ - 1, x));
+        y = std::max(0, std::min(height_ - 1, y));
+
+        auto it = dots_.find(key);
+        if (it == dots_.end()) {
+            dot d{x, y, color, pass_};
+            stamp_dot(d, true);
+            dots_.emplace(key, d);
+            ++version_;
+            return;
+        }
+
+        dot& d = it->second;
+        d.pass = pass_;
+        if (d.x == x && d.y == y && d.color == color) return;
+        stamp_dot(d, false);
+        d.x = x;
+        d.y = y;
+        d.color = color;
+        stamp_dot(d, true);
+        ++version_;
+    }
+
+    /// Finish a unit pass: erase the dots of units that were not reported
+    void end_units() {
+        for (auto it = dots_.begin(); it != dots_.end();) {
+            if (it->second.pass != pass_) {
+                stamp_dot(it->second, false);
+                it = dots_.erase(it);
+                ++version_;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Camera outline in minimap pixels (inclusive), drawn over everything
+    void set_camera(int left, int top, int right, int bottom) {
+        left = std::max(0, std::min(width_ - 1, left));
+        top = std::max(0, std::min(height_ - 1, top));
+        right = std::max(0, std::min(width_ - 1, right));
+        bottom = std::max(0, std::min(height_ - 1, bottom));
+        if (left == camera_.left && top == camera_.top && right == camera_.right && bottom == camera_.bottom) {
+            return;
+        }
+
+        for (size_t i : camera_pixels_) {
+            on_camera_[i] = 0;
+            output_[i] = composite_[i];
+        }
+        camera_pixels_.clear();
+
+        camera_ = {left, top, right, bottom};
+        auto mark = [&](int x, int y) {
+            size_t i = (size_t)y * width_ + x;
+            if (on_camera_[i]) return;
+            on_camera_[i] = 1;
+            output_[i] = camera_color_;
+            camera_pixels_.push_back(i);
+        };
+        for (int x = left; x <= right; ++x) {
+            mark(x, top);
+            mark(x, bottom);
+        }
+        for (int y = top; y <= bottom; ++y) {
+            mark(left, y);
+            mark(right, y);
+        }
+        ++version_;
+    }
+
+    const uint8_t* pixels() const { return reinterpret_cast<const uint8_t*>(output_.data()); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    uint64_t version() const { return version_; }
+
+private:
+    struct dot {
+        int x, y;
+        uint32_t color;
+        uint32_t pass;
+    };
+    struct camera_rect {
+        int left, top, right, bottom;
+    };
+
+    static constexpr uint8_t fog_visible = 2;
+
+    static uint32_t shade(uint32_t color, uint8_t fog) {
+        if (fog >= fog_visible) return color;
+        if (fog == 0) return minimap_rgba(0, 0, 0);
+        return ((color >> 1) & 0x007f7f7fu) | 0xff000000u;
+    }
+
+    // Draw (add) or erase a dot in the composite and, outside the camera
+    // outline, in the output
+    void stamp_dot(const dot& d, bool add) {
+        for (int dy = 0; dy < dot_size; ++dy) {
+            int py = d.y + dy;
+            if (py >= height_) break;
+            for (int dx = 0; dx < dot_size; ++dx) {
+                int px = d.x + dx;
+                if (px >= width_) break;
+                size_t i = (size_t)py * width_ + px;
+                if (add) {
+                    ++dot_count_[i];
+                    composite_[i] = d.color;
+                } else if (dot_count_[i] > 0 && --dot_count_[i] == 0) {
+                    composite_[i] = terrain_[i];
+                }
+                if (!on_camera_[i]) output_[i] = composite_[i];
+            }
+        }
+    }
+
+    int width_ = 1;
+    int height_ = 1;
+    int map_tile_width_ = 1;
+    int map_tile_height_ = 1;
+
+    std::vector<int> tile_x_;             // Pixel column -> tile column
+    std::vector<int> tile_y_;
+    std::vector<int> pixel_x_begin_;      // Tile column -> first pixel column
+    std::vector<int> pixel_y_begin_;
+    std::vector<uint8_t> tile_fog_;
+
+    std::vector<uint32_t> base_terrain_;  // Terrain without fog
+    std::vector<uint32_t> terrain_;       // Terrain with fog
+    std::vector<uint32_t> composite_;     // Terrain + unit dots
+    std::vector<uint32_t> output_;        // Composite + camera outline
+    std::vector<uint16_t> dot_count_;     // Dots covering each pixel
+    std::vector<uint8_t> on_camera_;
+    std::vector<size_t> camera_pixels_;
+    camera_rect camera_{-1, -1, -1, -1};
+    uint32_t camera_color_ = minimap_rgba(255, 255, 255);
+
+    std::unordered_map<uint32_t, dot> dots_;
+    uint32_t pass_ = 0;
+    bool has_terrain_ = false;
+    uint64_t version_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // MINIMAPLAYERS_H
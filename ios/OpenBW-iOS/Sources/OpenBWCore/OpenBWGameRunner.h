@@ -16,8 +16,12 @@ typedef void (^FrameUpdateCallback)(int frameCount, int minerals, int gas, int s
 /// Callback for game events
 typedef void (^GameEventCallback)(NSString* eventType, NSDictionary* eventData);
 
+/// replaySpeed value for playing a replay as fast as the device can simulate
+FOUNDATION_EXPORT const double OpenBWReplaySpeedTurbo;
+
 /// Information about a selected unit
 @interface SelectedUnitInfo : NSObject
+/// Stable unit handle (slot + generation); stays invalid once the unit dies
 @property (nonatomic, readonly) int unitId;
 @property (nonatomic, readonly) int typeId;
 @property (nonatomic, readonly, copy) NSString* typeName;
@@ -53,6 +57,97 @@ typedef void (^GameEventCallback)(NSString* eventType, NSDictionary* eventData);
                    canMove:(BOOL)canMove;
 @end
 
+/// Result of a group movement benchmark (independent vs shared-path orders)
+@interface GroupMoveBenchmarkResult : NSObject
+@property (nonatomic, readonly, copy) NSString* mapName;
+@property (nonatomic, readonly) int unitCount;
+@property (nonatomic, readonly) int frames;
+/// Simulation time with one independent order per unit
+@property (nonatomic, readonly) double independentMilliseconds;
+/// Simulation time with a shared corridor (includes corridor searches)
+@property (nonatomic, readonly) double sharedMilliseconds;
+/// Time spent in the shared corridor searches themselves
+@property (nonatomic, readonly) double corridorMilliseconds;
+/// Slowest single frame of each run
+@property (nonatomic, readonly) double independentWorstFrameMilliseconds;
+@property (nonatomic, readonly) double sharedWorstFrameMilliseconds;
+/// Path searches each run caused: one per unit move order issued, plus the
+/// corridor searches. Repaths the engine starts on its own are not counted.
+@property (nonatomic, readonly) int independentPathRequests;
+@property (nonatomic, readonly) int sharedPathRequests;
+@property (nonatomic, readonly) double speedup;
+
+- (instancetype)initWithMapName:(NSString*)mapName
+                      unitCount:(int)unitCount
+                         frames:(int)frames
+        independentMilliseconds:(double)independentMilliseconds
+             sharedMilliseconds:(double)sharedMilliseconds
+           corridorMilliseconds:(double)corridorMilliseconds
+independentWorstFrameMilliseconds:(double)independentWorstFrameMilliseconds
+   sharedWorstFrameMilliseconds:(double)sharedWorstFrameMilliseconds
+        independentPathRequests:(int)independentPathRequests
+             sharedPathRequests:(int)sharedPathRequests;
+@end
+
+/// Result of a turbo (fast-forward) run
+@interface TurboRunStats : NSObject
+@property (nonatomic, readonly) int startFrame;
+@property (nonatomic, readonly) int endFrame;
+@property (nonatomic, readonly) int framesAdvanced;
+@property (nonatomic, readonly) double elapsedSeconds;
+@property (nonatomic, readonly) double framesPerSecond;
+
+- (instancetype)initWithStartFrame:(int)startFrame
+                          endFrame:(int)endFrame
+                    elapsedSeconds:(double)elapsedSeconds;
+@end
+
+/// Result of a replay seek
+@interface ReplaySeekStats : NSObject
+@property (nonatomic, readonly) int fromFrame;
+@property (nonatomic, readonly) int targetFrame;
+/// Keyframe the seek restored, or -1 if it simulated on from the current frame
+@property (nonatomic, readonly) int keyframeFrame;
+@property (nonatomic, readonly) int framesSimulated;
+/// Wall time from the request to the target frame being presented
+@property (nonatomic, readonly) double elapsedSeconds;
+
+- (instancetype)initWithFromFrame:(int)fromFrame
+                      targetFrame:(int)targetFrame
+                    keyframeFrame:(int)keyframeFrame
+                  framesSimulated:(int)framesSimulated
+                   elapsedSeconds:(double)elapsedSeconds;
+@end
+
+/// Catalog entry for a map file, read from its CHK without loading the map
+@interface OpenBWMapInfo : NSObject
+@property (nonatomic, readonly, copy) NSString* path;
+/// Scenario name from the map; empty if the map has none
+@property (nonatomic, readonly, copy) NSString* name;
+@property (nonatomic, readonly, copy) NSString* mapDescription;
+@property (nonatomic, readonly) int tileset;
+/// Dimensions in tiles
+@property (nonatomic, readonly) int width;
+@property (nonatomic, readonly) int height;
+@property (nonatomic, readonly) int humanSlots;
+@property (nonatomic, readonly) int computerSlots;
+/// Players a melee game supports (start locations with an open slot)
+@property (nonatomic, readonly) int maxPlayers;
+/// Start locations in pixels (CGPoint values), in map order
+@property (nonatomic, readonly, copy) NSArray<NSValue*>* startLocations;
+
+- (instancetype)initWithPath:(NSString*)path
+                        name:(NSString*)name
+              mapDescription:(NSString*)mapDescription
+                     tileset:(int)tileset
+                       width:(int)width
+                      height:(int)height
+                  humanSlots:(int)humanSlots
+               computerSlots:(int)computerSlots
+                  maxPlayers:(int)maxPlayers
+              startLocations:(NSArray<NSValue*>*)startLocations;
+@end
+
 /// Core game runner managing the OpenBW engine
 @interface OpenBWGameRunner : NSObject
 
@@ -62,18 +157,193 @@ typedef void (^GameEventCallback)(NSString* eventType, NSDictionary* eventData);
 /// Load game assets from the specified path (containing MPQ files)
 - (BOOL)loadAssetsFromPath:(NSString*)path error:(NSError**)error;
 
-/// Start a new game on the specified map
+/// Threads loadAssetsFromPath:error: runs its startup tasks on; 0 (the
+/// default) picks up to 4 from the core count. 1 runs them one after another,
+/// the baseline to compare the logged startup time against.
+@property (nonatomic, assign) NSUInteger startupWorkers;
+
+/// Start a new game on the specified map against one computer player. The
+/// engine's melee setup places the start units from a fixed random seed, so a
+/// game on a map with the same races always starts the same way and its
+/// recording plays back as the same game.
 - (BOOL)startGameWithMap:(NSString*)mapPath
               playerRace:(int)race
             aiDifficulty:(int)difficulty
                    error:(NSError**)error;
 
-/// Load and play a replay file
+/// Load a replay file and start playing it back. The action stream is
+/// decoded incrementally as playback reaches it; UI commands are ignored
+/// while a replay plays. Pause and resume work as for games.
 - (BOOL)loadReplay:(NSString*)replayPath error:(NSError**)error;
 
+/// YES between a successful loadReplay and stop (or the next game start)
+@property (nonatomic, readonly) BOOL isPlayingReplay;
+
+/// Last frame of the replay being played, from its header (0 without one)
+@property (nonatomic, readonly) int replayEndFrame;
+
+/// Replay playback speed as a multiple of normal speed (default 1, up to 64).
+/// Fractions slow playback down. OpenBWReplaySpeedTurbo simulates as many
+/// frames as fit in each tick's time budget. Only the last frame of a tick
+/// is rendered; the frames before it do no render work.
+@property (nonatomic, assign) double replaySpeed;
+
+/// Jump to a frame of the replay being played. Restores the latest keyframe
+/// at or before the frame (unless the current frame is closer) and simulates
+/// forward without rendering, then presents the target frame. Call from the
+/// thread that ticks the game. Returns nil if no replay is playing.
+- (nullable ReplaySeekStats*)seekReplayToFrame:(int)frame;
+
+/// seekReplayToFrame: from any thread: the seek runs at the start of the next
+/// tick, on the thread that ticks, even while paused. The completion is
+/// called on the main queue, with nil if no replay was playing.
+- (void)seekReplayToFrame:(int)frame completion:(nullable void (^)(ReplaySeekStats* _Nullable stats))completion;
+
+/// Statistics from the most recent seek
+@property (nonatomic, readonly, nullable) ReplaySeekStats* lastReplaySeekStats;
+
+/// Game time between replay keyframes in seconds (default 30). Keyframes are
+/// full state copies taken as playback (or a seek) first reaches their frame.
+/// A new interval applies from the next replay loaded.
+@property (nonatomic, assign) double replayKeyframeInterval;
+
+/// Memory for replay keyframes in bytes (default 256 MB). When exceeded,
+/// every other keyframe is dropped and the interval doubles.
+@property (nonatomic, assign) NSUInteger replayKeyframeBudget;
+
+/// Keyframes held for the current replay and their approximate size
+@property (nonatomic, readonly) int replayKeyframeCount;
+@property (nonatomic, readonly) NSUInteger replayKeyframeBytes;
+
+/// Record games as replays (default YES). Every action a game executes is
+/// kept with its frame and compressed on a background thread; the setting
+/// applies from the next game started.
+@property (nonatomic, assign) BOOL replayRecordingEnabled;
+
+/// YES while the current game is being recorded
+@property (nonatomic, readonly) BOOL isRecordingReplay;
+
+/// Where the recording is autosaved during the game and written when it
+/// stops (default Caches/LastGame.rep; nil disables both)
+@property (nonatomic, copy, nullable) NSString* replayAutosavePath;
+
+/// Write the game recorded so far as a replay file. Recording continues.
+- (BOOL)saveReplayToPath:(NSString*)path error:(NSError**)error;
+
+/// Save the running game's state as a compact binary image. Units, sprites,
+/// images, orders and bullets are copied in bulk with their links saved as
+/// indices rather than serialized member by member. The map's static data is
+/// not saved. Debug builds also compare the state with a deep copy of it to
+/// check the image schema, which adds the cost of the copy. Call from the
+/// thread that ticks the game.
+- (BOOL)saveGameStateToPath:(NSString*)path error:(NSError**)error;
+
+/// Restore a state saved by saveGameStateToPath:error: on the map file the
+/// current game was started from. Images from a build with different engine
+/// structures are rejected. A replay or recording in progress ends.
+- (BOOL)loadGameStateFromPath:(NSString*)path error:(NSError**)error;
+
+/// The two calls above from any thread: each runs at the start of the next
+/// tick, on the thread that ticks, even while paused. The completion is
+/// called on the main queue with nil on success.
+- (void)saveGameStateToPath:(NSString*)path completion:(nullable void (^)(NSError* _Nullable error))completion;
+- (void)loadGameStateFromPath:(NSString*)path completion:(nullable void (^)(NSError* _Nullable error))completion;
+
+/// Keep recent states of live games for rewinding (default YES). State
+/// images are captured every few frames and kept as the blocks that changed
+/// since the previous one, with a full image every 32 captures. This and the
+/// settings below may be set from any thread; the game applies them at the
+/// start of its next frame.
+@property (nonatomic, assign) BOOL rewindEnabled;
+
+/// How far back a rewind can go, in seconds of game time (default 30)
+@property (nonatomic, assign) double rewindWindow;
+
+/// Memory for rewind snapshots in bytes (default 64 MB). The oldest go
+/// first when exceeded, shortening the window.
+@property (nonatomic, assign) NSUInteger rewindBudget;
+
+/// Share of frame time captures should take, averaged over the frames
+/// between them (default 0.05). A target, not a bound: costlier captures are
+/// spaced further apart, but never more than about 2 s, so captures that
+/// cost more than the budget allows at that spacing overrun it and are
+/// counted in rewindCaptureOverruns. A rewind simulates forward from the
+/// nearest capture.
+@property (nonatomic, assign) double rewindCaptureBudget;
+
+/// First frame a rewind can reach (-1 without snapshots), and the
+/// snapshots held with their approximate size
+@property (nonatomic, readonly) int rewindOldestFrame;
+@property (nonatomic, readonly) int rewindSnapshotCount;
+@property (nonatomic, readonly) NSUInteger rewindBytes;
+
+/// Average cost of one capture in milliseconds, leaving out the captures
+/// that also verify the state against a copy
+@property (nonatomic, readonly) double rewindCaptureMilliseconds;
+
+/// Frames between captures, the spacing the capture budget asks for (above
+/// the interval when the 2 s cap applies), and the captures that took more
+/// than their frames' share
+@property (nonatomic, readonly) int rewindCaptureInterval;
+@property (nonatomic, readonly) int rewindWantedCaptureInterval;
+@property (nonatomic, readonly) NSUInteger rewindCaptureOverruns;
+
+/// Return the game to a frame between rewindOldestFrame and the current
+/// frame: the nearest snapshot is restored and the commands executed since
+/// are simulated again. Group moves in progress, selections and control
+/// groups are dropped, and recording ends. Call from the thread that ticks
+/// the game.
+- (BOOL)rewindToFrame:(int)frame error:(NSError**)error;
+
+/// rewindToFrame:error: from any thread, run at the start of the next tick
+/// like the other requests above; the completion gets nil on success
+- (void)rewindToFrame:(int)frame completion:(nullable void (^)(NSError* _Nullable error))completion;
+
 /// Advance the game by one frame
 - (void)tick;
 
+/// Turbo mode - simulation only, no sprite collection, rendering, Metal upload
+/// or frame callbacks for intermediate frames. Render state is rebuilt once
+/// for the final frame. Returns nil if no frames were advanced, which
+/// includes while the game is paused: turbo does not override pause.
+
+/// Advance the simulation by frameCount frames as fast as possible
+- (nullable TurboRunStats*)advanceFrames:(int)frameCount;
+
+/// Advance the simulation as fast as possible until targetFrame is reached
+- (nullable TurboRunStats*)advanceToFrame:(int)targetFrame;
+
+/// Number of simulation frames advanced per tick (1 = normal speed)
+@property (nonatomic, assign) int turboFramesPerTick;
+
+/// Statistics from the most recent turbo run
+@property (nonatomic, readonly, nullable) TurboRunStats* lastTurboStats;
+
+/// Shared-path group movement for move and attack-move (default YES)
+/// Groups of 4+ units search the region graph once and follow a shared
+/// corridor, ending in a formation around the target.
+@property (nonatomic, assign) BOOL groupMoveEnabled;
+
+/// Fog of war for the current player (default YES)
+/// Unexplored tiles are black and explored tiles darkened, in the main view
+/// and on the minimap; enemy units outside vision are hidden. Only tiles whose
+/// vision changed are touched each frame.
+@property (nonatomic, assign) BOOL fogOfWarEnabled;
+
+/// Measure simulation CPU for a large army crossing a map, with independent
+/// orders and with a shared group path. Runs headless on separate game
+/// instances (the current game is untouched); call off the main thread.
+/// Requires assets to be loaded.
+- (nullable GroupMoveBenchmarkResult*)benchmarkGroupMoveOnMap:(NSString*)mapPath
+                                                    unitCount:(int)unitCount
+                                                       frames:(int)frames;
+
+/// Render pipelining (0 = synchronous, 1 = one frame of latency)
+/// With 1, tick returns after the simulation step and a render snapshot are
+/// done; the snapshot is rasterized on a render thread while the next frame
+/// is simulated. Frame callbacks are then invoked from the render thread.
+@property (nonatomic, assign) int pipelineLatencyFrames;
+
 /// Render current game state to the provided render pass
 - (void)renderWithEncoder:(id<MTLRenderCommandEncoder>)encoder;
 
@@ -135,8 +405,12 @@ typedef void (^GameEventCallback)(NSString* eventType, NSDictionary* eventData);
 - (void)useAbilityOnGround:(int)abilityId atX:(CGFloat)x y:(CGFloat)y;
 
 /// Use ability on unit target (e.g., Yamato Cannon, Lockdown)
+/// @param targetId Unit handle of the target (see SelectedUnitInfo.unitId)
 - (void)useAbilityOnUnit:(int)abilityId targetUnitId:(int)targetId;
 
+/// Whether a unit handle still refers to a live unit (O(1))
+- (BOOL)isUnitAlive:(int)unitId;
+
 /// Control Groups (0-9)
 /// Assign currently selected units to a control group
 - (void)assignControlGroup:(int)group;
@@ -154,7 +428,7 @@ typedef void (^GameEventCallback)(NSString* eventType, NSDictionary* eventData);
 /// Set rally point for selected production building at world coordinates
 - (void)setRallyPointAtX:(CGFloat)x y:(CGFloat)y;
 
-/// Set rally point to follow a specific unit
+/// Set rally point to follow a specific unit (by unit handle)
 - (void)setRallyPointToUnit:(int)targetUnitId;
 
 /// Callbacks
@@ -168,13 +442,47 @@ typedef void (^GameEventCallback)(NSString* eventType, NSDictionary* eventData);
 @property (nonatomic, readonly) BOOL isGameRunning;
 
 /// Minimap support
-/// Returns minimap as RGBA pixel data (caller must free with free())
+/// The minimap is a persistent RGBA image kept up to date once per presented
+/// frame: terrain is built at map load, and only moved, new or dead unit dots
+/// and the camera outline are redrawn. Polling either method below enables it.
+
+/// Incremented whenever the minimap image changes; compare before copying
+@property (nonatomic, readonly) uint64_t minimapVersion;
+
+/// Calls block with the current image while it is locked against updates
+/// (pixels are only valid inside the block). Returns the image version, or 0
+/// if no image has been built yet (block is not called).
+- (uint64_t)readMinimapPixels:(void (NS_NOESCAPE ^)(const uint8_t* pixels, int width, int height, uint64_t version))block;
+
+/// Returns a copy of the minimap as RGBA pixel data (caller must free with free())
 /// Width and height are returned in outWidth/outHeight
 - (nullable uint8_t*)getMinimapRGBA:(int*)outWidth height:(int*)outHeight;
 
 /// Get minimap size in pixels
 - (CGSize)minimapSize;
 
+/// Terrain thumbnail of a map file for map selection, as RGBA pixel data at
+/// most maxSize pixels on its longer side. Uses the same per-tileset megatile
+/// color table as the minimap, so no game state is needed; requires loaded assets.
+- (nullable NSData*)thumbnailForMapAtPath:(NSString*)mapPath
+                                  maxSize:(int)maxSize
+                                    width:(int*)outWidth
+                                   height:(int*)outHeight;
+
+/// Maps (.scm/.scx) in the given directories, sorted by path. Only the CHK
+/// sections needed for the catalog are parsed, on several threads, and the
+/// results are cached on disk; files unchanged since the last call are not
+/// opened. Does not require loaded assets; call off the main thread.
+- (NSArray<OpenBWMapInfo*>*)mapCatalogForDirectories:(NSArray<NSString*>*)directories;
+
+/// Start loading the tileset a map uses in the background (e.g. when the map
+/// is selected), so starting a game on it does not wait for tile graphics.
+/// When no game is running, a game on the map is also set up in the
+/// background for the races of the last game started and kept in the map
+/// state cache, so a game start with those races only copies it, and its map
+/// image is written so later launches skip loading the map for it.
+- (void)prefetchMapAtPath:(NSString*)mapPath;
+
 @end
 
 NS_ASSUME_NONNULL_END
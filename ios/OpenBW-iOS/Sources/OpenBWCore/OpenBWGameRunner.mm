@@ -5,6 +5,27 @@
 #import "MetalRenderer.h"
 #import "MPQLoader.h"
 #import "OpenBWRenderer.h"
+#include "SnapshotExchange.h"
+#include "SpatialGrid.h"
+#include "UnitHandles.h"
+#include "ControlGroups.h"
+#include "CommandBuffer.h"
+#include "GroupMove.h"
+#include "MinimapLayers.h"
+#include "FogOfWar.h"
+#include "ArchiveService.h"
+#include "TaskGraph.h"
+#include "MapCatalog.h"
+#include "MapStateCache.h"
+#include "MapImageSchema.h"
+#include "MeleeSetup.h"
+#include "ReplayReader.h"
+#include "ReplayWriter.h"
+#include "KeyframeIndex.h"
+#include "StateImage.h"
+#include "StateImageSchema.h"
+#include "RewindBuffer.h"
+#include "UnitTypeNames.h"
 
 // OpenBW headers
 #include "bwgame.h"
@@ -12,11 +33,18 @@
 #include "replay.h"
 #include "data_loading.h"
 
+#include <malloc/malloc.h>
+
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <string>
-#include <fstream>
 #include <functional>
+#include <chrono>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 // Use OpenBW's UI types for rendering
 namespace bwgame {
@@ -27,22 +55,49 @@ namespace bwgame {
 
 #pragma mark - Data Loading Helpers
 
-// Simple file reader for iOS
-static std::vector<uint8_t> loadFileData(const std::string& path) {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        return {};
+// scenario.chk of a map file. Each call opens its own reader, so maps can be
+// read on several threads at once.
+static bool readMapChk(const std::string& mapPath, std::vector<uint8_t>& chk) {
+    try {
+        bwgame::data_loading::mpq_file<> mpq(bwgame::a_string(mapPath.begin(), mapPath.end()));
+        bwgame::a_vector<uint8_t> data;
+        mpq(data, "staredit\\scenario.chk");
+        chk.assign(data.begin(), data.end());
+        return true;
+    }
+    catch (const std::exception& e) {
+        NSLog(@"OpenBWGameRunner: Could not read %s: %s", mapPath.c_str(), e.what());
+        return false;
     }
+}
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+static NSString* mapCatalogCachePath() {
+    NSString* caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+    return [caches stringByAppendingPathComponent:@"MapCatalog.bin"];
+}
 
-    std::vector<uint8_t> buffer(size);
-    if (!file.read(reinterpret_cast<char*>(buffer.data()), size)) {
-        return {};
-    }
+// Map images written on this device; images built by openbw_map_prewarm
+// ship in the app bundle's MapImages folder
+static NSString* mapImageCacheDirectory() {
+    NSString* caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+    NSString* dir = [caches stringByAppendingPathComponent:@"MapImages"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:YES attributes:nil error:nil];
+    return dir;
+}
+
+static NSString* defaultReplayAutosavePath() {
+    NSString* caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+    return [caches stringByAppendingPathComponent:@"LastGame.rep"];
+}
 
-    return buffer;
+// One catalog per process, loaded from disk on first use
+static openbw_ios::map_catalog& sharedMapCatalog() {
+    static openbw_ios::map_catalog* catalog = [] {
+        auto* c = new openbw_ios::map_catalog(readMapChk);
+        c->load([mapCatalogCachePath() UTF8String]);
+        return c;
+    }();
+    return *catalog;
 }
 
 #pragma mark - OpenBW State Wrapper
@@ -62,26 +117,187 @@ struct UnitInfo {
     bool isCompleted;
 };
 
+// Immutable per-frame render input. Built by the simulation thread right after
+// nextFrame() and rasterized by the render thread, so it must not reference
+// mutable game state (GRP frames live in global data and never change).
+struct RenderSnapshot {
+    int frame = 0;
+
+    // View parameters at capture time
+    float cameraX = 0;
+    float cameraY = 0;
+    float zoomLevel = 1.0f;
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+    int mapWidth = 0;
+    int mapHeight = 0;
+
+    // Visible sprites (sprite.images points into this snapshot's images)
+    std::vector<RenderSpriteInfo> sprites;
+    std::vector<RenderImageInfo> images;
+    std::vector<uint8_t> selectedMask;
+
+    // Current player's resources
+    int minerals = 50;
+    int gas = 0;
+    int supply = 4;
+    int supplyMax = 10;
+};
+
+// Marks the render queue so it can detect re-entrant drains
+static char kRenderQueueKey;
+
+// OpenBW functions bound to the game player's state, with game event hooks
+// and action execution. game_player's own functions object has neither, so
+// frames are stepped through this one instead; both operate on the same state.
+struct OpenBWEventFunctions : bwgame::action_functions {
+    std::function<void(bwgame::unit_t*)> onUnitKilled;
+    std::function<void(bwgame::unit_t*)> onUnitDeselected;
+
+    OpenBWEventFunctions(bwgame::state& st, bwgame::action_state& action_st)
+        : bwgame::action_functions(st, action_st) {}
+
+    virtual void on_kill_unit(bwgame::unit_t* u) override {
+        if (onUnitKilled) onUnitKilled(u);
+    }
+
+    // The engine drops a unit from selections when it leaves its owner's
+    // control: given away, mind controlled (both go through give_unit), or
+    // hidden on death
+    virtual void on_unit_deselect(bwgame::unit_t* u) override {
+        if (onUnitDeselected) onUnitDeselected(u);
+    }
+};
+
 // Wrapper to hold OpenBW game state with proper initialization
 struct OpenBWStateHolder {
     std::unique_ptr<bwgame::game_player> player;
-    bwgame::data_loading::data_files_loader<> dataLoader;
+    std::unique_ptr<bwgame::action_state> actionState;
+    std::unique_ptr<OpenBWEventFunctions> eventFuncs;
+
+    // UI commands waiting for the next frame boundary, and the actions they
+    // encoded to on the most recent frame
+    openbw_ios::command_buffer commandBuffer;
+    std::vector<openbw_ios::command_record> drainedCommands;
+    std::vector<uint8_t> frameActions;
+    std::vector<size_t> commandEnds;
+
+    // Group moves: UI threads post requests, the sim thread computes one
+    // shared region corridor per request and walks members along it
+    struct GroupMoveRequest {
+        bwgame::Orders order;
+        bwgame::xy target;
+        std::vector<openbw_ios::unit_handle> units;
+    };
+    struct GroupMoveMember {
+        openbw_ios::unit_handle handle;
+        bwgame::xy offset;          // Formation offset at the destination
+        size_t waypoint = 0;        // Index into GroupMove::waypoints
+        int bestDistance = INT_MAX; // Closest it has been to the current waypoint
+        int staleChecks = 0;        // Checks since it last got closer
+    };
+    struct GroupMove {
+        bwgame::Orders order;
+        std::vector<bwgame::xy> waypoints;  // Corridor region centers, then the destination
+        std::vector<GroupMoveMember> members;
+        int startFrame = 0;
+    };
+    bool groupMoveEnabled = true;
+    std::mutex groupMoveMutex;
+    std::vector<GroupMoveRequest> pendingGroupMoves;
+    std::vector<GroupMoveRequest> startingGroupMoves;
+    std::vector<GroupMove> activeGroupMoves;
+    uint64_t groupMoveCorridorNs = 0;   // Total time spent in corridor searches
+    int groupMovePathRequests = 0;      // Corridor searches plus per-unit move orders issued
+    int groupMoveStuckMembers = 0;      // Members released for not getting closer
+    int groupMoveTimeouts = 0;          // Moves retired at the frame limit
     std::string dataPath;
     bool isInitialized = false;
 
+    // State right after a map load or a melee game's setup, restored on later
+    // loads of the same map file and races. Units in it point into this player's global
+    // data, so entries are only valid for this player. The game_state is not
+    // copied (its region graph points into its own storage): each load gets
+    // its own, shared by the entry and by the game played on it, which only
+    // reads it.
+    struct LoadedMapState {
+        std::shared_ptr<bwgame::game_state> game;
+        bwgame::state st;
+    };
+    static constexpr size_t kMapStateCacheEntries = 3;
+    static constexpr uint64_t kMapStateVersion = 1;
+    openbw_ios::map_state_cache<LoadedMapState> mapStates{kMapStateCacheEntries};
+    uint64_t mapDataKey = 0;                // map_data_key of the archives; 0 disables map images
+    std::mutex mapLoadMutex;                // Held while a map is loaded into the player
+    std::shared_ptr<bwgame::game_state> activeGame;     // The player's st.game since the last load
+    uint64_t loadedMapKey = 0;              // Content key of the map file last loaded, 0 for a replay's map
+    std::atomic<bool> prewarmAllowed{true}; // Cleared while a game is being set up or played
+
+    // Replay being played back, if any. Its actions replace UI commands and
+    // are decoded a chunk at a time as frames reach them.
+    std::unique_ptr<openbw_ios::replay_file> replay;
+    openbw_ios::replay_action_stream replayActions;
+
+    // Replay keyframes for seeking: the game state, each player's action
+    // state (selections) and the action stream's read position
+    struct ReplayKeyframe {
+        bwgame::state st;
+        bwgame::action_state actionSt;
+        openbw_ios::replay_action_stream actions;
+    };
+    static constexpr double kSecondsPerFrame = 0.042;       // Game time at normal speed
+    static constexpr int kKeyframeIntervalFrames = (int)(30 / kSecondsPerFrame);
+    static constexpr size_t kKeyframeBudgetBytes = 256u << 20;
+    openbw_ios::keyframe_index<ReplayKeyframe> keyframes{kKeyframeIntervalFrames, kKeyframeBudgetBytes};
+
+    // Recording of the game being played: each frame's executed actions go to
+    // the recorder, which compresses and writes them off the sim thread
+    openbw_ios::replay_recorder recorder;
+    std::vector<size_t> recordedLengths;
+    bwgame::race_t meleeRaces[2] = {bwgame::race_t::terran, bwgame::race_t::zerg};
+    openbw_ios::replay_header meleeHeader;  // The melee game last set up, for recording it
+    std::vector<uint8_t> meleeChk;
+    bool recordingCutReported = false;
+
+    // Recent states of a live game for rewinding: state images every few
+    // frames, kept as deltas, plus the actions executed since the oldest.
+    // The buffer belongs to the sim thread. Other threads request settings,
+    // which it applies at the start of its next frame, and read the stats it
+    // publishes after every change.
+    std::atomic<bool> rewindEnabled{true};
+    openbw_ios::rewind_buffer rewind;
+    openbw_ios::state_image_writer rewindImage;     // Reused between captures
+    static constexpr size_t kRewindDeepCheckEvery = 64;  // Captures between deep schema checks in debug builds
+    std::mutex rewindMutex;                         // Guards the three below
+    openbw_ios::rewind_buffer::settings rewindSettings;     // Requested; applied when changed
+    bool rewindSettingsChanged = false;
+    openbw_ios::rewind_buffer::stats_t rewindStats; // As of the sim thread's last change
+
     // Selected units (stored as raw pointers, valid only during frame)
     std::vector<bwgame::unit_t*> selectedUnits;
 
-    // Control groups (1-10, index 0 = group 1, etc.)
-    std::vector<std::vector<bwgame::unit_t*>> controlGroups{10};
+    // Generational handles for units named outside a single frame
+    openbw_ios::unit_handle_table unitHandles;
+
+    // Control groups (1-10, index 0 = group 1, etc.), kept exact by unit events
+    openbw_ios::control_group_set controlGroups;
+    std::vector<openbw_ios::unit_handle> pendingOwnerChecks;    // Grouped units deselected this frame
 
-    // Rally points for production buildings (keyed by unit pointer)
-    std::unordered_map<bwgame::unit_t*, bwgame::xy> rallyPoints;
+    // Rally points for production buildings (keyed by unit handle)
+    std::unordered_map<openbw_ios::unit_handle, bwgame::xy, openbw_ios::unit_handle_hash> rallyPoints;
 
     // Current player (0 = player 1)
     int currentPlayer = 0;
 
+    // Per-frame spatial index over unit bounding boxes (rebuilt lazily on the
+    // first query after a frame step, so turbo runs never pay for it)
+    openbw_ios::spatial_grid<bwgame::unit_t*> unitIndex;
+    bool unitIndexDirty = true;
+    int unitIndexMapWidth = 0;
+    int unitIndexMapHeight = 0;
+
     bool initialize(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mapLoadMutex);
         try {
             // Store the data path
             dataPath = path;
@@ -91,9 +307,22 @@ struct OpenBWStateHolder {
 
             NSLog(@"OpenBW: Initializing from path: %s", dataPath.c_str());
 
-            // Create and initialize the game player
+            // Create and initialize the game player, reading through the shared
+            // archive service when it has the MPQs open
             player = std::make_unique<bwgame::game_player>();
-            player->init(dataPath.c_str());
+            mapStates.clear();
+            activeGame.reset();
+            auto& archives = openbw_ios::archive_service::shared();
+            if (archives.is_open()) {
+                player->init(archives.data_loader());
+            } else {
+                player->init(dataPath.c_str());
+            }
+
+            actionState = std::make_unique<bwgame::action_state>();
+            eventFuncs = std::make_unique<OpenBWEventFunctions>(player->st(), *actionState);
+            eventFuncs->onUnitKilled = [this](bwgame::unit_t* u) { onUnitKilled(u); };
+            eventFuncs->onUnitDeselected = [this](bwgame::unit_t* u) { onUnitDeselected(u); };
 
             isInitialized = true;
             NSLog(@"OpenBW: Game player initialized successfully");
@@ -109,16 +338,24 @@ struct OpenBWStateHolder {
         }
     }
 
+    // A map as load_map_file leaves it, with no game set up on it (the group
+    // move benchmark places its own units)
     bool loadMap(const std::string& mapPath) {
         if (!player || !isInitialized) {
             NSLog(@"OpenBW: Cannot load map - not initialized");
             return false;
         }
 
+        std::lock_guard<std::mutex> lock(mapLoadMutex);
         try {
             NSLog(@"OpenBW: Loading map: %s", mapPath.c_str());
-            player->load_map_file(mapPath);
-            NSLog(@"OpenBW: Map loaded successfully");
+            uint64_t key = openbw_ios::map_state_cache<LoadedMapState>::content_key(mapPath, kMapStateVersion);
+            endReplay();
+            loadCachedState(key, [&](bwgame::state& st) {
+                bwgame::game_load_functions(st).load_map_file(mapPath);
+            });
+            loadedMapKey = key;
+            resetRewind();
             return true;
         }
         catch (const std::exception& e) {
@@ -131,171 +368,553 @@ struct OpenBWStateHolder {
         }
     }
 
-    // Set up a melee game with starting units
-    bool setupMeleeGame(int playerRace, int aiRace) {
+    // Start a melee game on a map: the human in slot 0 against a computer in
+    // slot 1, set up by OpenBW's replay loader (see MeleeSetup.h) so that the
+    // game's recording plays back as the same game. The set-up state is
+    // cached per map and races like a plain map load.
+    bool loadMeleeGame(const std::string& mapPath, int playerRace, int aiRace) {
         if (!player || !isInitialized) {
             NSLog(@"OpenBW: Cannot setup game - not initialized");
             return false;
         }
 
+        std::lock_guard<std::mutex> lock(mapLoadMutex);
         try {
-            auto& st = player->st();
-            auto& funcs = player->funcs();
+            meleeRaces[0] = playerRace == 1 ? bwgame::race_t::protoss
+                          : playerRace == 2 ? bwgame::race_t::zerg : bwgame::race_t::terran;
+            meleeRaces[1] = aiRace == 0 ? bwgame::race_t::terran
+                          : aiRace == 1 ? bwgame::race_t::protoss : bwgame::race_t::zerg;
+            NSLog(@"OpenBW: Setting up melee game on %s - Player race: %d, AI race: %d",
+                  mapPath.c_str(), playerRace, aiRace);
+
+            std::vector<uint8_t> chk;
+            openbw_ios::replay_header header;
+            if (!readMapChk(mapPath, chk) || !meleeHeaderForMap(mapPath, chk, header)) {
+                NSLog(@"OpenBW: Cannot set up a game on %s", mapPath.c_str());
+                return false;
+            }
+            uint64_t mapKey = openbw_ios::map_state_cache<LoadedMapState>::content_key(mapPath, kMapStateVersion);
+            endReplay();
+            *actionState = bwgame::action_state();
+            loadCachedState(openbw_ios::melee_game_key(mapKey, header), [&](bwgame::state& st) {
+                openbw_ios::load_melee_game(st, *actionState, header, chk);
+            });
+            meleeHeader = header;
+            meleeChk = std::move(chk);
+            loadedMapKey = mapKey;
+            currentPlayer = openbw_ios::melee_setup::human_slot;
+            resetRewind();
+            return true;
+        }
+        catch (const std::exception& e) {
+            NSLog(@"OpenBW: Failed to setup melee game: %s", e.what());
+            return false;
+        }
+        catch (...) {
+            NSLog(@"OpenBW: Failed to setup melee game with unknown error");
+            return false;
+        }
+    }
 
-            // Get race types
-            bwgame::race_t humanRace = bwgame::race_t::terran;
-            if (playerRace == 1) humanRace = bwgame::race_t::protoss;
-            else if (playerRace == 2) humanRace = bwgame::race_t::zerg;
+    // The header of a game on the map with the races in meleeRaces
+    bool meleeHeaderForMap(const std::string& mapPath, const std::vector<uint8_t>& chk,
+                           openbw_ios::replay_header& header) const {
+        std::string fileName = mapPath.substr(mapPath.find_last_of('/') + 1);
+        return openbw_ios::melee_game_header(chk, fileName.substr(0, fileName.find_last_of('.')), meleeRaces[0],
+                                             meleeRaces[1], header);
+    }
 
-            bwgame::race_t computerRace = bwgame::race_t::zerg;
-            if (aiRace == 0) computerRace = bwgame::race_t::terran;
-            else if (aiRace == 1) computerRace = bwgame::race_t::protoss;
+    // mapLoadMutex held. Put the state cached under key into the player: from
+    // the map state cache, else from its map image, else by calling load on a
+    // new game_state. A state that had to be loaded is cached.
+    template<typename Load>
+    void loadCachedState(uint64_t key, Load&& load) {
+        auto start = std::chrono::steady_clock::now();
+        auto elapsedMs = [&] {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        if (auto cached = key ? mapStates.find(key) : nullptr) {
+            restoreMapState(*cached);
+            NSLog(@"OpenBW: Restored from the map state cache in %.1f ms", elapsedMs());
+            return;
+        }
+        if (key && loadMapImage(key)) {
+            mapStates.insert(key, captureMapState());
+            NSLog(@"OpenBW: Restored from its map image in %.1f ms", elapsedMs());
+            return;
+        }
+        useFreshGameState();
+        load(player->st());
+        mapStates.insert(key, captureMapState());
+        NSLog(@"OpenBW: Loaded successfully in %.1f ms", elapsedMs());
+    }
 
-            NSLog(@"OpenBW: Setting up melee game - Player race: %d, AI race: %d", playerRace, aiRace);
+    // OpenBW loads the map and sets up the players from the replay's header,
+    // given a copy of the replay with an empty action stream; the actions are
+    // then read from the file as playback reaches them.
+    bool loadReplay(const std::string& replayPath, std::string& error) {
+        if (!player || !isInitialized) {
+            error = "OpenBW not initialized";
+            return false;
+        }
 
-            // Find start locations
-            auto* game_st = st.game;
-            if (!game_st) {
-                NSLog(@"OpenBW: No game state available");
-                return false;
+        std::lock_guard<std::mutex> lock(mapLoadMutex);
+        auto file = std::make_unique<openbw_ios::replay_file>();
+        if (!file->open(replayPath, error)) return false;
+        try {
+            auto start = std::chrono::steady_clock::now();
+            endReplay();
+            recorder.stop();
+            loadedMapKey = 0;
+            resetRewind();
+            useFreshGameState();
+            std::vector<uint8_t> setup = file->without_actions();
+            bwgame::replay_state replayState;
+            bwgame::replay_functions loader(player->st(), *actionState, replayState);
+            loader.load_replay_data(setup.data(), setup.size());
+
+            const auto& header = file->header();
+            for (size_t i = 0; i < header.players.size(); ++i) {
+                if (header.players[i].type == 2) {
+                    currentPlayer = (int)i;
+                    break;
+                }
             }
+            NSLog(@"OpenBW: Replay loaded in %.1f ms (%u frames, %u bytes of actions left to decode)",
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                  header.frame_count, file->actions().size);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+            return false;
+        }
+        replay = std::move(file);
+        replayActions.reset(*replay);
+        captureKeyframe();
+        return true;
+    }
 
-            // Get start locations from the map
-            std::vector<bwgame::xy> startLocations;
-            for (size_t i = 0; i < 8; ++i) {
-                if (game_st->start_locations[i] != bwgame::xy()) {
-                    startLocations.push_back(game_st->start_locations[i]);
-                    NSLog(@"OpenBW: Found start location %zu at (%d, %d)",
-                          i, game_st->start_locations[i].x, game_st->start_locations[i].y);
+    void endReplay() {
+        keyframes.clear();
+        replayActions = openbw_ios::replay_action_stream();
+        replay.reset();
+        currentPlayer = 0;
+    }
+
+    // Lower bound on a keyframe's size: the state object with its fixed
+    // object pools, plus the per-tile arrays
+    size_t keyframeMinimumBytes() const {
+        const bwgame::state& st = player->st();
+        return sizeof(ReplayKeyframe) + replayActions.buffered_bytes() +
+            st.tiles.size() * sizeof(st.tiles[0]) +
+            st.tiles_mega_tile_index.size() * sizeof(st.tiles_mega_tile_index[0]);
+    }
+
+    // Bytes in use across all malloc zones
+    static size_t mallocBytesInUse() {
+        malloc_statistics_t stats;
+        malloc_zone_statistics(nullptr, &stats);
+        return stats.size_in_use;
+    }
+
+    // A keyframe is charged what allocating it took: copy_state duplicates
+    // every container the state owns, not only the ones named above. Other
+    // threads allocating meanwhile can skew the measurement either way, so
+    // the lower bound still applies.
+    void captureKeyframe() {
+        bwgame::state& st = player->st();
+        size_t before = mallocBytesInUse();
+        auto saved = std::make_shared<ReplayKeyframe>();
+        saved->st = bwgame::copy_state(st);
+        saved->actionSt = bwgame::copy_state(*actionState, st, saved->st);
+        saved->actions = replayActions;
+        size_t after = mallocBytesInUse();
+        size_t measured = after > before ? after - before : 0;
+        keyframes.add(st.current_frame, std::move(saved), std::max(measured, keyframeMinimumBytes()));
+    }
+
+    // The game and global state are shared with the keyframe, so only the
+    // per-game state is copied back. UI-side unit references are dropped.
+    void restoreKeyframe(const ReplayKeyframe& saved) {
+        bwgame::state& st = player->st();
+        st = bwgame::copy_state(saved.st);
+        *actionState = bwgame::copy_state(saved.actionSt, saved.st, st);
+        replayActions = saved.actions;
+
+        selectedUnits.clear();
+        controlGroups.clear();
+        pendingOwnerChecks.clear();
+        rallyPoints.clear();
+        unitHandles.reset();
+        unitIndexDirty = true;
+    }
+
+    // Every action has been executed and the recorded game length reached
+    bool replayFinished() {
+        return replay && replayActions.done() && player->st().current_frame >= (int)replay->header().frame_count;
+    }
+
+    // Set up a game on a map into the map state cache ahead of its start
+    // (e.g. while the player confirms the map), for the races of the last
+    // game started, and write its map image if there is none yet. The loads
+    // go to states of their own on the player's game data, which they only
+    // read, so the player is not touched. Does nothing once a game is being
+    // set up.
+    void prewarmMap(const std::string& mapPath) {
+        if (!player || !isInitialized) return;
+        std::lock_guard<std::mutex> lock(mapLoadMutex);
+        if (!prewarmAllowed) return;
+        try {
+            std::vector<uint8_t> chk;
+            openbw_ios::replay_header header;
+            if (!readMapChk(mapPath, chk) || !meleeHeaderForMap(mapPath, chk, header)) return;
+            uint64_t mapKey = openbw_ios::map_state_cache<LoadedMapState>::content_key(mapPath, kMapStateVersion);
+            uint64_t key = openbw_ios::melee_game_key(mapKey, header);
+            if (key == 0 || mapStates.find(key)) return;
+            auto start = std::chrono::steady_clock::now();
+            auto load = [&](bwgame::state& st) {
+                bwgame::action_state actionSt;
+                openbw_ios::load_melee_game(st, actionSt, header, chk);
+            };
+            std::shared_ptr<LoadedMapState> loaded = loadSeparateMapState(load);
+
+            // The image is audited against a second, independent load
+            std::string imagePath = mapImagePath(key);
+            if (!imagePath.empty() && findMapImage(key).empty()) {
+                std::shared_ptr<LoadedMapState> second = loadSeparateMapState(load);
+                openbw_ios::state_image_writer writer;
+                std::string error;
+                if (!openbw_ios::write_map_image(writer, loaded->st, second->st, key, error)) {
+                    NSLog(@"OpenBW: No map image for %s: %s", mapPath.c_str(), error.c_str());
+                } else if (!writer.write(imagePath)) {
+                    NSLog(@"OpenBW: Could not write map image %s", imagePath.c_str());
                 }
             }
+            mapStates.insert(key, std::move(loaded));
+            NSLog(@"OpenBW: Prewarmed map %s in %.1f ms", mapPath.c_str(),
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        catch (const std::exception& e) {
+            NSLog(@"OpenBW: Could not prewarm map %s: %s", mapPath.c_str(), e.what());
+        }
+    }
 
-            if (startLocations.size() < 2) {
-                NSLog(@"OpenBW: Not enough start locations found (%zu), creating default positions",
-                      startLocations.size());
-                // Create default start locations
-                startLocations.clear();
-                startLocations.push_back(bwgame::xy(game_st->map_width / 4, game_st->map_height / 4));
-                startLocations.push_back(bwgame::xy(game_st->map_width * 3 / 4, game_st->map_height * 3 / 4));
-            }
+    // mapLoadMutex held. load run on a state and game_state of their own that
+    // share the player's game data
+    template<typename Load>
+    std::shared_ptr<LoadedMapState> loadSeparateMapState(Load&& load) {
+        auto loaded = std::make_shared<LoadedMapState>();
+        loaded->game = std::make_shared<bwgame::game_state>();
+        loaded->st.global = player->st().global;
+        loaded->st.game = loaded->game.get();
+        load(loaded->st);
+        return loaded;
+    }
+
+    std::string mapImagePath(uint64_t key) const {
+        if (mapDataKey == 0) return std::string();
+        return [mapImageCacheDirectory() UTF8String] + ("/" + openbw_ios::map_image_file_name(key, mapDataKey));
+    }
+
+    // The map's image from the app bundle or the cache directory, or empty
+    std::string findMapImage(uint64_t key) const {
+        if (mapDataKey == 0) return std::string();
+        NSString* name = @(openbw_ios::map_image_file_name(key, mapDataKey).c_str());
+        NSString* bundled = [[[NSBundle mainBundle] resourcePath] stringByAppendingPathComponent:@"MapImages"];
+        for (NSString* dir in @[bundled ?: @"", mapImageCacheDirectory()]) {
+            NSString* path = [dir stringByAppendingPathComponent:name];
+            if (dir.length > 0 && [[NSFileManager defaultManager] fileExistsAtPath:path]) return [path UTF8String];
+        }
+        return std::string();
+    }
+
+    // mapLoadMutex held. Read the map's image into a new game_state instead
+    // of loading the map file; false if there is no image or it does not
+    // load, and the map must be loaded from its file.
+    bool loadMapImage(uint64_t key) {
+        std::string path = findMapImage(key);
+        if (path.empty()) return false;
+        openbw_ios::state_image_reader reader;
+        std::string error;
+        bool ok = reader.open(path, openbw_ios::map_image_schema::get().key, error);
+        if (ok) {
+            useFreshGameState();
+            ok = openbw_ios::read_map_image(reader, player->st(), key, error);
+        }
+        if (!ok) {
+            NSLog(@"OpenBW: Could not read map image %s: %s", path.c_str(), error.c_str());
+            std::remove(path.c_str());
+        }
+        return ok;
+    }
 
-            // Create starting units for player 0 (human)
-            createStartingUnits(0, startLocations[0], humanRace);
+    // mapLoadMutex held. Every map or replay load gets a game_state of its
+    // own, as the previous one may be held by a map state cache entry.
+    void useFreshGameState() {
+        activeGame = std::make_shared<bwgame::game_state>();
+        player->st().game = activeGame.get();
+    }
 
-            // Create starting units for player 1 (computer)
-            createStartingUnits(1, startLocations[1], computerRace);
+    // mapLoadMutex held. The entry keeps the game_state just loaded alive and
+    // its state copy points at it.
+    std::shared_ptr<const LoadedMapState> captureMapState() {
+        auto saved = std::make_shared<LoadedMapState>();
+        saved->game = activeGame;
+        saved->st = bwgame::copy_state(player->st());
+        return saved;
+    }
 
-            // Set player as active
-            currentPlayer = 0;
+    // mapLoadMutex held. The player's state is pointed at the entry's
+    // game_state, which stays alive while the game uses it even if the entry
+    // is evicted.
+    void restoreMapState(const LoadedMapState& saved) {
+        bwgame::state& st = player->st();
+        bwgame::global_state* global = st.global;
+        st = bwgame::copy_state(saved.st);
+        activeGame = saved.game;
+        st.game = activeGame.get();
+        st.global = global;
+    }
 
-            // Center camera on player's starting location
-            // (will be done by the caller)
+    // Center of a player's units, which right after the melee setup is its
+    // start location; false if it has none
+    bool startPosition(int owner, bwgame::xy& out) {
+        int64_t x = 0, y = 0;
+        int count = 0;
+        for (bwgame::unit_t* u : bwgame::ptr(player->st().visible_units)) {
+            if (!u->sprite || u->owner != owner) continue;
+            x += u->sprite->position.x;
+            y += u->sprite->position.y;
+            ++count;
+        }
+        if (count == 0) return false;
+        out = bwgame::xy((int)(x / count), (int)(y / count));
+        return true;
+    }
 
-            NSLog(@"OpenBW: Melee game setup complete");
-            return true;
+    // Record the game loadMeleeGame just set up. The replay's header is the
+    // one the game was built from and the map's scenario.chk is embedded, so
+    // a replay loader sets up the same game.
+    void startRecording(const std::string& autosavePath) {
+        if (meleeChk.empty()) {
+            NSLog(@"OpenBW: Not recording - no melee game set up");
+            return;
         }
-        catch (const std::exception& e) {
-            NSLog(@"OpenBW: Failed to setup melee game: %s", e.what());
+        recorder.start(meleeHeader, meleeChk, autosavePath);
+        recordingCutReported = false;
+        NSLog(@"OpenBW: Recording replay (%zu bytes of map data)", meleeChk.size());
+    }
+
+    bool saveRecording(const std::string& path) {
+        return recorder.save(path, (uint32_t)player->st().current_frame);
+    }
+
+    // MARK: - State Images
+
+    // Whether saving and loading state images also compare the state with a
+    // copy_state of it, to find members that own memory the schema does not
+    // list. The copy costs as much as the rest of a save, and what it finds
+    // only changes with the engine's structures, so release builds leave it
+    // to debug builds and StateImageTests.
+#ifndef NDEBUG
+    static constexpr bool kDeepStateChecks = true;
+#else
+    static constexpr bool kDeepStateChecks = false;
+#endif
+
+    // Save the per-game state as a state image. The map's static data is not
+    // in it, so loading needs the same map file loaded first.
+    bool saveState(const std::string& path, std::string& error) {
+        openbw_ios::state_image_writer writer;
+        if (!buildStateImage(writer, kDeepStateChecks, error)) return false;
+        if (!writer.write(path)) {
+            error = "Could not write " + path;
             return false;
         }
-        catch (...) {
-            NSLog(@"OpenBW: Failed to setup melee game with unknown error");
+        return true;
+    }
+
+    // deepCheck verifies the state against a copy_state of it as well, which
+    // costs a copy; see verify_state_image
+    bool buildStateImage(openbw_ios::state_image_writer& writer, bool deepCheck, std::string& error) {
+        if (loadedMapKey == 0) {
+            error = "Only games started from a map file can be saved";
             return false;
         }
+        bwgame::state& st = player->st();
+        std::unique_ptr<bwgame::state> copy;
+        if (deepCheck) copy = std::make_unique<bwgame::state>(bwgame::copy_state(st));
+        return openbw_ios::write_state_image(writer, st, player->funcs(), loadedMapKey, copy.get(), error);
     }
 
-    // Create starting units at a location for a player
-    void createStartingUnits(int owner, bwgame::xy position, bwgame::race_t race) {
-        if (!player || !isInitialized) return;
+    // Replace the per-game state with a state image saved on the loaded map.
+    // A replay or recording in progress ends, since the image's frame is not
+    // on its timeline. The image's key, map and size, and the current state
+    // against the schema, are checked before anything is written; if a
+    // section still fails to read, stateReplaced is set and the partly
+    // replaced state must not be stepped.
+    bool loadState(const std::string& path, std::string& error, bool& stateReplaced) {
+        stateReplaced = false;
+        openbw_ios::state_image_reader reader;
+        if (!reader.open(path, openbw_ios::state_image_schema::get().key, error) || !readStateImage(reader, error, stateReplaced)) {
+            return false;
+        }
+        resetRewind();
+        return true;
+    }
 
-        auto& st = player->st();
-        auto& funcs = player->funcs();
+    bool readStateImage(openbw_ios::state_image_reader& reader, std::string& error, bool& stateReplaced) {
+        bwgame::state& st = player->st();
+        openbw_ios::object_regions regions;
+        {
+            std::unique_ptr<bwgame::state> copy;
+            if (kDeepStateChecks) copy = std::make_unique<bwgame::state>(bwgame::copy_state(st));
+            if (!openbw_ios::prepare_state_image(reader, st, player->funcs(), loadedMapKey, copy.get(), regions, error)) {
+                return false;
+            }
+        }
+        endReplay();
+        recorder.stop();
+        stateReplaced = true;
+        if (!openbw_ios::read_state_image(reader, st, regions, error)) return false;
 
-        NSLog(@"OpenBW: Creating starting units for player %d at (%d, %d), race %d",
-              owner, position.x, position.y, (int)race);
+        // Selections and UI-side unit references named the replaced units
+        *actionState = bwgame::action_state();
+        selectedUnits.clear();
+        controlGroups.clear();
+        pendingOwnerChecks.clear();
+        rallyPoints.clear();
+        unitHandles.reset();
+        activeGroupMoves.clear();
+        unitIndexDirty = true;
+        return true;
+    }
 
-        try {
-            // Get unit types based on race
-            const bwgame::unit_type_t* mainBuildingType = nullptr;
-            const bwgame::unit_type_t* workerType = nullptr;
-            const bwgame::unit_type_t* overlordType = nullptr;
-
-            if (race == bwgame::race_t::terran) {
-                mainBuildingType = funcs.get_unit_type(bwgame::UnitTypes::Terran_Command_Center);
-                workerType = funcs.get_unit_type(bwgame::UnitTypes::Terran_SCV);
-            } else if (race == bwgame::race_t::protoss) {
-                mainBuildingType = funcs.get_unit_type(bwgame::UnitTypes::Protoss_Nexus);
-                workerType = funcs.get_unit_type(bwgame::UnitTypes::Protoss_Probe);
-            } else { // Zerg
-                mainBuildingType = funcs.get_unit_type(bwgame::UnitTypes::Zerg_Hatchery);
-                workerType = funcs.get_unit_type(bwgame::UnitTypes::Zerg_Drone);
-                overlordType = funcs.get_unit_type(bwgame::UnitTypes::Zerg_Overlord);
-            }
-
-            if (!mainBuildingType || !workerType) {
-                NSLog(@"OpenBW: Could not get unit types for race %d", (int)race);
-                return;
-            }
+    // MARK: - Rewind
+
+    // Capture the state for rewinding if one is due. Called at the start of a
+    // frame of a live game, before its actions. Every capture verifies the
+    // state against the image schema; in debug builds the first after a reset
+    // and every kRewindDeepCheckEvery-th also compare it with a copy.
+    void captureRewind() {
+        applyRewindSettings();
+        int frame = player->st().current_frame;
+        if (!rewindEnabled || loadedMapKey == 0 || !rewind.due(frame)) return;
+        auto start = std::chrono::steady_clock::now();
+        std::string error;
+        bool deepCheck = kDeepStateChecks && rewind.stats().captures % kRewindDeepCheckEvery == 0;
+        if (!buildStateImage(rewindImage, deepCheck, error)) {
+            NSLog(@"OpenBW: Rewind disabled - could not capture the state: %s", error.c_str());
+            rewindEnabled = false;
+            resetRewind();
+            return;
+        }
+        const std::vector<uint8_t>& image = rewindImage.finish();
+        rewind.add(frame, image.data(), image.size(),
+                   std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                   !deepCheck);   // A deep check's copy is not what captures cost
+        publishRewindStats();
+    }
 
-            // Calculate building position (centered and aligned to grid)
-            bwgame::xy buildingPos = position;
-            buildingPos.x = (buildingPos.x / 32) * 32 + 16;
-            buildingPos.y = (buildingPos.y / 32) * 32 + 16;
+    // Sim thread: clear the buffer once rewinding is switched off, and apply
+    // settings requested since the last frame
+    void applyRewindSettings() {
+        if (!rewindEnabled && rewind.stats().snapshots) resetRewind();
+        std::lock_guard<std::mutex> lock(rewindMutex);
+        if (!rewindSettingsChanged) return;
+        rewindSettingsChanged = false;
+        rewind.configure(rewindSettings);
+        rewindStats = rewind.stats();
+    }
 
-            // Create main building
-            bwgame::unit_t* mainBuilding = funcs.create_unit(mainBuildingType, buildingPos, owner);
-            if (mainBuilding) {
-                funcs.finish_building_unit(mainBuilding);
-                NSLog(@"OpenBW: Created %s at (%d, %d)",
-                      mainBuildingType->id == bwgame::UnitTypes::Terran_Command_Center ? "Command Center" :
-                      mainBuildingType->id == bwgame::UnitTypes::Protoss_Nexus ? "Nexus" : "Hatchery",
-                      buildingPos.x, buildingPos.y);
+    void publishRewindStats() {
+        std::lock_guard<std::mutex> lock(rewindMutex);
+        rewindStats = rewind.stats();
+    }
 
-                // For Zerg, spread creep
-                if (race == bwgame::race_t::zerg) {
-                    // Creep spreading is handled automatically by OpenBW
-                }
-            } else {
-                NSLog(@"OpenBW: Failed to create main building");
-            }
+    void resetRewind() {
+        rewind.clear();
+        publishRewindStats();
+    }
 
-            // Create overlord for Zerg
-            if (overlordType) {
-                bwgame::xy overlordPos = position;
-                overlordPos.y -= 64;
-                bwgame::unit_t* overlord = funcs.create_unit(overlordType, overlordPos, owner);
-                if (overlord) {
-                    NSLog(@"OpenBW: Created Overlord");
-                }
-            }
+    // Any thread: settings for the sim thread to apply at its next frame
+    void requestRewindSettings(const openbw_ios::rewind_buffer::settings& settings) {
+        std::lock_guard<std::mutex> lock(rewindMutex);
+        rewindSettings = settings;
+        rewindSettingsChanged = true;
+    }
 
-            // Create 4 workers
-            for (int i = 0; i < 4; ++i) {
-                bwgame::xy workerPos = position;
-                // Spread workers around the building
-                workerPos.x += (i % 2) * 32 - 16;
-                workerPos.y += (i / 2) * 32 - 16 + 48;
+    openbw_ios::rewind_buffer::settings requestedRewindSettings() {
+        std::lock_guard<std::mutex> lock(rewindMutex);
+        return rewindSettings;
+    }
 
-                bwgame::unit_t* worker = funcs.create_unit(workerType, workerPos, owner);
-                if (worker) {
-                    NSLog(@"OpenBW: Created worker %d", i + 1);
-                }
-            }
+    openbw_ios::rewind_buffer::stats_t publishedRewindStats() {
+        std::lock_guard<std::mutex> lock(rewindMutex);
+        return rewindStats;
+    }
 
-            // Set initial resources for the player
-            st.current_minerals[owner] = 50;
-            st.current_gas[owner] = 0;
+    // Restore the latest snapshot at or before frame and simulate forward to
+    // it with the actions logged since. Later snapshots and actions are
+    // dropped, and recording ends, as the game now diverges from them.
+    bool rewindTo(int frame, std::string& error, bool& stateReplaced) {
+        stateReplaced = false;
+        std::vector<uint8_t> image;
+        int imageFrame = 0;
+        if (frame > player->st().current_frame || !rewind.restore(frame, image, imageFrame)) {
+            error = "Frame " + std::to_string(frame) + " is outside the rewind window";
+            return false;
+        }
+        openbw_ios::state_image_reader reader;
+        if (!reader.open(image.data(), image.size(), openbw_ios::state_image_schema::get().key, error) ||
+            !readStateImage(reader, error, stateReplaced)) {
+            return false;
+        }
 
-        } catch (const std::exception& e) {
-            NSLog(@"OpenBW: Error creating starting units: %s", e.what());
-        } catch (...) {
-            NSLog(@"OpenBW: Unknown error creating starting units");
+        struct LoggedActions {
+            int frame;
+            int owner;
+            std::vector<uint8_t> data;
+        };
+        std::vector<LoggedActions> actions;
+        rewind.for_each_action(imageFrame, frame, [&](int f, int owner, const uint8_t* data, size_t size) {
+            actions.push_back({f, owner, std::vector<uint8_t>(data, data + size)});
+        });
+        auto next = actions.begin();
+        try {
+            while (player->st().current_frame < frame) {
+                for (; next != actions.end() && next->frame == player->st().current_frame; ++next) {
+                    bwgame::data_loading::data_reader_le r(next->data.data(), next->data.data() + next->data.size());
+                    while (r.left() && eventFuncs->read_action(r, next->owner)) {}
+                }
+                eventFuncs->next_frame();
+            }
         }
+        catch (const std::exception& e) {
+            error = std::string("Re-simulating to the rewind frame failed: ") + e.what();
+            return false;
+        }
+        rewind.truncate_after(frame);
+        publishRewindStats();
+        checkControlGroupOwners();
+        unitIndexDirty = true;
+        return true;
     }
 
     void nextFrame() {
         if (player && isInitialized) {
-            player->next_frame();
+            if (replay) {
+                applyReplayActions();
+            } else {
+                captureRewind();
+                applyPendingCommands();
+            }
+            eventFuncs->next_frame();
+            updateControlGroups();
+            unitIndexDirty = true;
+            if (replay && keyframes.due(player->st().current_frame)) captureKeyframe();
+            if (!replay) recorder.set_frame((uint32_t)player->st().current_frame);
         }
     }
 
@@ -311,96 +930,147 @@ struct OpenBWStateHolder {
     }
 
     void reset() {
+        commandBuffer.discard();
+        frameActions.clear();
+        {
+            std::lock_guard<std::mutex> lock(groupMoveMutex);
+            pendingGroupMoves.clear();
+        }
+        activeGroupMoves.clear();
+        endReplay();
+        recorder.stop();
+        resetRewind();
+        eventFuncs.reset();
+        actionState.reset();
         player.reset();
         selectedUnits.clear();
+        controlGroups.clear();
+        rallyPoints.clear();
+        unitHandles.reset();
+        unitIndex.clear();
+        unitIndexDirty = true;
+        unitIndexMapWidth = 0;
+        unitIndexMapHeight = 0;
         isInitialized = false;
     }
 
-    // Find unit at world position
-    bwgame::unit_t* findUnitAtPosition(float worldX, float worldY) {
-        if (!player || !isInitialized) return nullptr;
-
-        auto& st = player->st();
-        bwgame::xy pos((int)worldX, (int)worldY);
+    // MARK: - Unit Spatial Index
 
-        // Search in a small area around the click point
-        int searchRadius = 32;  // Half a tile
-        bwgame::rect searchArea;
-        searchArea.from = bwgame::xy(pos.x - searchRadius, pos.y - searchRadius);
-        searchArea.to = bwgame::xy(pos.x + searchRadius, pos.y + searchRadius);
-
-        bwgame::unit_t* closestUnit = nullptr;
-        int closestDist = INT_MAX;
+    // World-space bounding box of a unit from its type dimensions
+    static openbw_ios::grid_rect unitBounds(const bwgame::unit_t* u) {
+        const bwgame::xy pos = u->sprite->position;
+        const auto& dim = u->unit_type->dimensions;
+        return {pos.x - dim.from.x, pos.y - dim.from.y, pos.x + dim.to.x + 1, pos.y + dim.to.y + 1};
+    }
 
-        // Iterate through visible units
-        for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
-            if (!u->sprite) continue;
+    // Units that can never be picked or box selected (larvae, eggs)
+    static bool isUnselectable(const bwgame::unit_t* u) {
+        return u->unit_type->id == bwgame::UnitTypes::Enum::Zerg_Larva ||
+               u->unit_type->id == bwgame::UnitTypes::Enum::Zerg_Egg;
+    }
 
-            // Skip units not owned by the current player
-            if (u->owner != _stateHolder->currentPlayer) continue;
+    // Rebuild the unit index if the simulation advanced since the last query
+    openbw_ios::spatial_grid<bwgame::unit_t*>& ensureUnitIndex() {
+        if (!unitIndexDirty) return unitIndex;
 
-            // Skip non-selectable units (larvae, eggs)
-            if (u->unit_type->id == bwgame::UnitTypes::Enum::Zerg_Larva ||
-                u->unit_type->id == bwgame::UnitTypes::Enum::Zerg_Egg) {
-                continue;
-            }
+        auto& st = player->st();
+        if (unitIndexMapWidth != st.game->map_width || unitIndexMapHeight != st.game->map_height) {
+            unitIndexMapWidth = st.game->map_width;
+            unitIndexMapHeight = st.game->map_height;
+            unitIndex.reset(unitIndexMapWidth, unitIndexMapHeight);
+        }
 
-            bwgame::xy unitPos = u->sprite->position;
+        unitIndex.clear();
+        for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
+            if (!u->sprite || !u->unit_type) continue;
+            unitIndex.insert(u, unitBounds(u));
+        }
+        unitIndex.build();
+        unitIndexDirty = false;
+        return unitIndex;
+    }
 
-            // Check if unit is in search area
-            if (unitPos.x >= searchArea.from.x && unitPos.x <= searchArea.to.x &&
-                unitPos.y >= searchArea.from.y && unitPos.y <= searchArea.to.y) {
+    // Visit every visible unit whose bounding box intersects a world rect.
+    // Shared entry point for picking, minimap/overlay culling and AI queries.
+    template<typename F>
+    void queryUnitsInArea(const openbw_ios::grid_rect& area, F&& f) {
+        if (!player || !isInitialized) return;
+        ensureUnitIndex().query(area, [&](const openbw_ios::spatial_grid<bwgame::unit_t*>::entry& e) {
+            f(e.value);
+        });
+    }
 
-                int dx = unitPos.x - pos.x;
-                int dy = unitPos.y - pos.y;
-                int dist = dx * dx + dy * dy;
+    // Find the unit under a world position (owner -1 = any player).
+    // Units are preferred over buildings, then the closest center wins. A tap
+    // that hits no bounding box falls back to the nearest box within a few
+    // pixels, since touch input is less precise than a mouse.
+    bwgame::unit_t* findUnitAtPosition(float worldX, float worldY, int owner = -1) {
+        if (!player || !isInitialized) return nullptr;
 
-                if (dist < closestDist) {
-                    closestDist = dist;
-                    closestUnit = u;
+        auto& funcs = player->funcs();
+        const int px = (int)worldX;
+        const int py = (int)worldY;
+        const int touchSlop = 8;
+
+        bwgame::unit_t* best = nullptr;
+        bool bestExact = false;
+        bool bestIsBuilding = true;
+        int64_t bestDist = INT64_MAX;
+
+        queryUnitsInArea({px - touchSlop, py - touchSlop, px + touchSlop + 1, py + touchSlop + 1},
+                         [&](bwgame::unit_t* u) {
+            if (owner >= 0 && u->owner != owner) return;
+            if (isUnselectable(u)) return;
+
+            openbw_ios::grid_rect b = unitBounds(u);
+            bool exact = b.contains(px, py);
+            bool isBuilding = funcs.ut_building(u);
+            int64_t dx = u->sprite->position.x - px;
+            int64_t dy = u->sprite->position.y - py;
+            int64_t dist = dx * dx + dy * dy;
+
+            // Priority: direct hit > slop hit, unit > building, then distance
+            if (best) {
+                if (exact != bestExact) {
+                    if (!exact) return;
+                } else if (isBuilding != bestIsBuilding) {
+                    if (isBuilding) return;
+                } else if (dist >= bestDist) {
+                    return;
                 }
             }
-        }
+            best = u;
+            bestExact = exact;
+            bestIsBuilding = isBuilding;
+            bestDist = dist;
+        });
 
-        return closestUnit;
+        return best;
     }
 
-    // Find all units in a rectangle
-    std::vector<bwgame::unit_t*> findUnitsInRect(float x1, float y1, float x2, float y2) {
+    // Find all units whose bounding boxes overlap a world rectangle (owner -1 = any).
+    // Like the original game, a drag that catches any mobile unit selects only
+    // the mobile units; buildings are returned only when nothing else is caught.
+    std::vector<bwgame::unit_t*> findUnitsInRect(float x1, float y1, float x2, float y2, int owner = -1) {
         std::vector<bwgame::unit_t*> result;
         if (!player || !isInitialized) return result;
 
-        auto& st = player->st();
-
-        // Normalize rect
-        float minX = std::min(x1, x2);
-        float maxX = std::max(x1, x2);
-        float minY = std::min(y1, y2);
-        float maxY = std::max(y1, y2);
-
-        // Iterate through visible units
-        for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
-            if (!u->sprite) continue;
-
-            // Skip units not owned by the current player
-            if (u->owner != _stateHolder->currentPlayer) continue;
-
-            // Skip non-selectable units (larvae, eggs)
-            if (u->unit_type->id == bwgame::UnitTypes::Enum::Zerg_Larva ||
-                u->unit_type->id == bwgame::UnitTypes::Enum::Zerg_Egg) {
-                continue;
-            }
-
-            bwgame::xy unitPos = u->sprite->position;
-
-            // Check if unit is in the rectangle
-            if (unitPos.x >= minX && unitPos.x <= maxX &&
-                unitPos.y >= minY && unitPos.y <= maxY) {
-                result.push_back(u);
-            }
-        }
-
-        return result;
+        auto& funcs = player->funcs();
+        openbw_ios::grid_rect area;
+        area.left = (int)std::min(x1, x2);
+        area.top = (int)std::min(y1, y2);
+        area.right = (int)std::max(x1, x2) + 1;
+        area.bottom = (int)std::max(y1, y2) + 1;
+
+        std::vector<bwgame::unit_t*> buildings;
+        queryUnitsInArea(area, [&](bwgame::unit_t* u) {
+            if (owner >= 0 && u->owner != owner) return;
+            if (isUnselectable(u)) return;
+            if (funcs.ut_building(u)) buildings.push_back(u);
+            else result.push_back(u);
+        });
+
+        return result.empty() ? buildings : result;
     }
 
     // Select a single unit
@@ -424,109 +1094,454 @@ struct OpenBWStateHolder {
         selectedUnits.clear();
     }
 
-    // Issue move command to selected units
-    void moveSelectedTo(float worldX, float worldY) {
-        if (!player || !isInitialized || selectedUnits.empty()) return;
+    // MARK: - Command Buffer
 
-        bwgame::xy targetPos((int)worldX, (int)worldY);
+    // Queue a command for the given units. Safe to call from any thread; the
+    // command is executed as a game action at the start of the next frame.
+    void queueCommand(openbw_ios::command_record record, const std::vector<bwgame::unit_t*>& units) {
+        if (!player || !isInitialized) return;
         auto& funcs = player->funcs();
 
-        for (bwgame::unit_t* u : selectedUnits) {
-            if (u && u->owner == currentPlayer) {
-                try {
-                    // Issue move order through state_functions
-                    funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::Move), targetPos);
-                    NSLog(@"OpenBW: Move command issued to unit at (%d, %d) -> (%d, %d)",
-                          u->sprite->position.x, u->sprite->position.y,
-                          targetPos.x, targetPos.y);
-                }
-                catch (...) {
-                    NSLog(@"OpenBW: Failed to issue move command");
-                }
+        record.unit_count = 0;
+        for (bwgame::unit_t* u : units) {
+            if (!u || u->owner != currentPlayer) continue;
+            record.units[record.unit_count++] = funcs.get_unit_id(u).raw_value;
+            if (record.unit_count == openbw_ios::game_action::max_selection) {
+                commandBuffer.push(record);
+                record.unit_count = 0;
             }
         }
+        if (record.unit_count) commandBuffer.push(record);
     }
 
-    // Issue attack-move command to selected units
-    void attackMoveTo(float worldX, float worldY) {
-        if (!player || !isInitialized || selectedUnits.empty()) return;
+    // Targeted order (move, attack-move, patrol, spells, rally) for the given units
+    void queueOrder(bwgame::Orders order, bwgame::xy pos, const std::vector<bwgame::unit_t*>& units,
+                    const bwgame::unit_t* target = nullptr) {
+        openbw_ios::command_record record;
+        record.action = openbw_ios::game_action::targeted_order;
+        record.order = (uint8_t)order;
+        record.x = (uint16_t)std::max(0, pos.x);
+        record.y = (uint16_t)std::max(0, pos.y);
+        if (target) {
+            record.target = player->funcs().get_unit_id(target).raw_value;
+            record.unit_type = (uint16_t)target->unit_type->id;
+        }
+        queueCommand(record, units);
+    }
 
-        bwgame::xy targetPos((int)worldX, (int)worldY);
-        auto& funcs = player->funcs();
+    // Simple action without arguments besides the queue flag (stop, hold, toggles)
+    void queueAction(uint8_t action, const std::vector<bwgame::unit_t*>& units) {
+        openbw_ios::command_record record;
+        record.action = action;
+        queueCommand(record, units);
+    }
 
-        for (bwgame::unit_t* u : selectedUnits) {
-            if (u && u->owner == currentPlayer) {
-                try {
-                    funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::AttackMove), targetPos);
-                    NSLog(@"OpenBW: Attack-move command issued to unit -> (%d, %d)",
-                          targetPos.x, targetPos.y);
-                }
-                catch (...) {
-                    NSLog(@"OpenBW: Failed to issue attack-move command");
+    // Sim thread, frame start: drain every queued command, group them and
+    // execute the encoded actions for the local player
+    void applyPendingCommands() {
+        drainedCommands.clear();
+        frameActions.clear();
+        commandBuffer.drain(drainedCommands);
+
+        // Explicit commands take units out of any group move they were in
+        if (!activeGroupMoves.empty()) {
+            for (const auto& record : drainedCommands) releaseFromGroupMoves(record);
+        }
+        startPendingGroupMoves();
+        advanceGroupMoves();
+        if (drainedCommands.empty()) return;
+
+        commandEnds.clear();
+        openbw_ios::encode_command_actions(drainedCommands, frameActions, &commandEnds);
+
+        // Each command runs on its own: one the game rejects is skipped and
+        // the rest still execute. The actions that executed are packed to the
+        // front of frameActions and recorded by their lengths.
+        recordedLengths.clear();
+        uint32_t frame = (uint32_t)player->st().current_frame;
+        uint8_t* actions = frameActions.data();
+        size_t executed = 0;
+        size_t begin = 0;
+        for (size_t end : commandEnds) {
+            try {
+                bwgame::data_loading::data_reader_le r(actions + begin, actions + end);
+                while (r.left()) {
+                    size_t offset = end - r.left();
+                    if (!eventFuncs->read_action(r, currentPlayer)) {
+                        NSLog(@"OpenBW: Rejected queued action %#x", actions[offset]);
+                        break;
+                    }
+                    size_t length = end - r.left() - offset;
+                    std::memmove(actions + executed, actions + offset, length);
+                    executed += length;
+                    recordedLengths.push_back(length);
                 }
             }
+            catch (const std::exception& e) {
+                NSLog(@"OpenBW: Failed to execute queued command: %s", e.what());
+            }
+            catch (...) {
+                NSLog(@"OpenBW: Failed to execute queued command");
+            }
+            begin = end;
+        }
+        frameActions.resize(executed);
+        if (!recorder.record(frame, currentPlayer, frameActions.data(), recordedLengths) && !recordingCutReported) {
+            recordingCutReported = true;
+            NSLog(@"OpenBW: Replay recording ends at frame %u: an action is too long for a replay block",
+                  recorder.stats().cut_frame);
+        }
+        if (rewindEnabled) {
+            rewind.add_actions((int)frame, currentPlayer, frameActions.data(), executed);
         }
     }
 
-    // Issue stop command to selected units
-    void stopSelected() {
-        if (!player || !isInitialized || selectedUnits.empty()) return;
-
-        auto& funcs = player->funcs();
-
-        for (bwgame::unit_t* u : selectedUnits) {
-            if (u && u->owner == currentPlayer) {
-                try {
-                    funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::Stop));
-                    NSLog(@"OpenBW: Stop command issued");
-                }
-                catch (...) {
-                    NSLog(@"OpenBW: Failed to issue stop command");
+    // Sim thread, frame start: execute the replay's actions for this frame,
+    // decoding further into the action stream only when they run out. UI
+    // commands are dropped; a replay can only be watched.
+    void applyReplayActions() {
+        commandBuffer.discard();
+        frameActions.clear();
+
+        int frame = player->st().current_frame;
+        const uint8_t* data;
+        size_t size;
+        while (replayActions.next_block((uint32_t)frame, data, size)) {
+            try {
+                bwgame::data_loading::data_reader_le r(data, data + size);
+                while (r.left()) {
+                    int owner = replay->header().owner_for_id(r.get<uint8_t>());
+                    if (owner < 0 || !eventFuncs->read_action(r, owner)) {
+                        NSLog(@"OpenBW: Skipping unreadable replay action at frame %d", frame);
+                        break;
+                    }
                 }
             }
+            catch (const std::exception& e) {
+                NSLog(@"OpenBW: Failed to execute replay actions at frame %d: %s", frame, e.what());
+            }
         }
     }
 
-    // Issue hold position command to selected units
-    void holdPosition() {
+    // Smart command (the game's right click): attack, follow, gather or move
+    // depending on the target
+    void rightClickSelected(float worldX, float worldY, const bwgame::unit_t* target) {
         if (!player || !isInitialized || selectedUnits.empty()) return;
 
-        auto& funcs = player->funcs();
+        openbw_ios::command_record record;
+        record.action = openbw_ios::game_action::right_click;
+        record.x = (uint16_t)std::max(0, (int)worldX);
+        record.y = (uint16_t)std::max(0, (int)worldY);
+        if (target) {
+            record.target = player->funcs().get_unit_id(target).raw_value;
+            record.unit_type = (uint16_t)target->unit_type->id;
+        }
+        queueCommand(record, selectedUnits);
+    }
 
-        for (bwgame::unit_t* u : selectedUnits) {
-            if (u && u->owner == currentPlayer) {
-                try {
-                    funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::HoldPosition));
-                    NSLog(@"OpenBW: Hold position command issued");
-                }
-                catch (...) {
-                    NSLog(@"OpenBW: Failed to issue hold position command");
-                }
+    // MARK: - Group Movement
+
+    // Fewer units than this are ordered directly; the corridor search would
+    // cost more than it saves
+    static constexpr size_t kGroupMoveMinUnits = 4;
+    // Distance at which a member moves on to its next corridor waypoint
+    static constexpr int kWaypointRadius = 128;
+    // Frames between waypoint checks
+    static constexpr int kGroupMoveInterval = 8;
+    // A member that gets no closer to its waypoint by this many pixels for
+    // this many checks (about 2.7 s) is stuck, e.g. blocked by buildings
+    static constexpr int kGroupMoveProgressPixels = 16;
+    static constexpr int kGroupMoveStaleChecks = 8;
+    // Frames after which a move is retired whatever its members' progress
+    static constexpr int kGroupMoveMaxFrames = (int)(120 / kSecondsPerFrame);
+    // Spacing between units in the destination formation
+    static constexpr int kFormationSpacing = 32;
+
+    // Move or attack-move the selection, sharing one long-range path when the
+    // group is large enough
+    void orderSelectedTo(bwgame::Orders order, bwgame::xy target) {
+        std::vector<openbw_ios::unit_handle> handles;
+        if (groupMoveEnabled) {
+            for (bwgame::unit_t* u : selectedUnits) {
+                if (u && u->owner == currentPlayer) handles.push_back(handleForUnit(u));
             }
         }
+        if (handles.size() < kGroupMoveMinUnits) {
+            queueOrder(order, target, selectedUnits);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(groupMoveMutex);
+        pendingGroupMoves.push_back({order, target, std::move(handles)});
     }
 
-    // Issue patrol command to selected units
-    void patrolTo(float worldX, float worldY) {
-        if (!player || !isInitialized || selectedUnits.empty()) return;
+    // Sim thread: append a move order for one unit to this frame's commands
+    void appendOrder(bwgame::Orders order, bwgame::xy pos, const bwgame::unit_t* u) {
+        openbw_ios::command_record record;
+        record.action = openbw_ios::game_action::targeted_order;
+        record.order = (uint8_t)order;
+        record.x = (uint16_t)std::max(0, pos.x);
+        record.y = (uint16_t)std::max(0, pos.y);
+        record.unit_count = 1;
+        record.units[0] = player->funcs().get_unit_id(u).raw_value;
+        drainedCommands.push_back(record);
+        ++groupMovePathRequests;
+    }
 
-        bwgame::xy targetPos((int)worldX, (int)worldY);
-        auto& funcs = player->funcs();
+    static bwgame::xy regionCenter(const bwgame::regions_t::region* r) {
+        return bwgame::xy(r->center.x.integer_part(), r->center.y.integer_part());
+    }
 
-        for (bwgame::unit_t* u : selectedUnits) {
-            if (u && u->owner == currentPlayer) {
-                try {
-                    funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::Patrol), targetPos);
-                    NSLog(@"OpenBW: Patrol command issued to unit -> (%d, %d)",
-                          targetPos.x, targetPos.y);
+    // Sim thread: turn posted requests into group moves with a shared corridor
+    void startPendingGroupMoves() {
+        {
+            std::lock_guard<std::mutex> lock(groupMoveMutex);
+            if (pendingGroupMoves.empty()) return;
+            std::swap(startingGroupMoves, pendingGroupMoves);
+        }
+
+        auto& funcs = player->funcs();
+        for (GroupMoveRequest& request : startingGroupMoves) {
+            std::vector<bwgame::unit_t*> units;
+            std::vector<openbw_ios::group_point> positions;
+            for (openbw_ios::unit_handle h : request.units) {
+                bwgame::unit_t* u = resolveHandle(h);
+                if (!u || u->owner != currentPlayer) continue;
+                releaseUnitFromGroupMoves(h);
+                units.push_back(u);
+                positions.push_back({u->sprite->position.x, u->sprite->position.y});
+            }
+            if (units.empty()) continue;
+
+            // One long-range search for the whole group, from its centroid
+            auto searchStart = std::chrono::steady_clock::now();
+            openbw_ios::group_point centroid = openbw_ios::group_centroid(positions);
+            auto* from = funcs.get_region_at(bwgame::xy(centroid.x, centroid.y));
+            auto* to = funcs.get_region_at(request.target);
+            auto corridor = openbw_ios::find_region_corridor(from, to,
+                [](const bwgame::regions_t::region* r, auto&& visit) {
+                    for (auto* n : r->walkable_neighbors) visit(n);
+                },
+                [](const bwgame::regions_t::region* r) {
+                    bwgame::xy c = regionCenter(r);
+                    return openbw_ios::group_point{c.x, c.y};
+                });
+            groupMoveCorridorNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - searchStart).count();
+            ++groupMovePathRequests;
+
+            auto offsets = openbw_ios::formation_offsets(positions, kFormationSpacing);
+
+            if (corridor.size() <= 2) {
+                // Short or unreachable: go straight to the formation slots
+                for (size_t i = 0; i < units.size(); ++i) {
+                    appendOrder(request.order,
+                                bwgame::xy(request.target.x + offsets[i].x, request.target.y + offsets[i].y),
+                                units[i]);
                 }
-                catch (...) {
-                    NSLog(@"OpenBW: Failed to issue patrol command");
+                continue;
+            }
+
+            GroupMove move;
+            move.order = request.order;
+            move.startFrame = player->st().current_frame;
+            for (size_t i = 1; i + 1 < corridor.size(); ++i) move.waypoints.push_back(regionCenter(corridor[i]));
+            move.waypoints.push_back(request.target);
+
+            for (size_t i = 0; i < units.size(); ++i) {
+                GroupMoveMember member;
+                member.handle = handleForUnit(units[i]);
+                member.offset = bwgame::xy(offsets[i].x, offsets[i].y);
+                move.members.push_back(member);
+                appendOrder(move.order, move.waypoints[0], units[i]);
+            }
+            activeGroupMoves.push_back(std::move(move));
+        }
+        startingGroupMoves.clear();
+    }
+
+    // Sim thread: move members that reached their waypoint on to the next one.
+    // Each order only spans neighboring regions, so the engine's path search
+    // for it stays local. Members that stop getting closer, and every member
+    // of a move past kGroupMoveMaxFrames, are released and sent straight to
+    // their formation slot, leaving the way there to the engine.
+    void advanceGroupMoves() {
+        if (activeGroupMoves.empty()) return;
+        int frame = player->st().current_frame;
+        if (frame % kGroupMoveInterval != 0) return;
+
+        for (GroupMove& move : activeGroupMoves) {
+            size_t last = move.waypoints.size() - 1;
+            bwgame::xy destination = move.waypoints[last];
+            auto release = [&](const GroupMoveMember& m, bwgame::unit_t* u) {
+                appendOrder(move.order, bwgame::xy(destination.x + m.offset.x, destination.y + m.offset.y), u);
+                return true;
+            };
+            bool expired = frame - move.startFrame >= kGroupMoveMaxFrames;
+            if (expired) ++groupMoveTimeouts;
+
+            move.members.erase(std::remove_if(move.members.begin(), move.members.end(), [&](GroupMoveMember& m) {
+                bwgame::unit_t* u = resolveHandle(m.handle);
+                if (!u) return true;
+                if (expired) return release(m, u);
+
+                bwgame::xy wp = move.waypoints[m.waypoint];
+                int dx = u->sprite->position.x - wp.x;
+                int dy = u->sprite->position.y - wp.y;
+                int distance = (int)std::hypot((double)dx, (double)dy);
+                if (distance > kWaypointRadius) {
+                    if (distance + kGroupMoveProgressPixels <= m.bestDistance) {
+                        m.bestDistance = distance;
+                        m.staleChecks = 0;
+                        return false;
+                    }
+                    if (++m.staleChecks < kGroupMoveStaleChecks) return false;
+                    ++groupMoveStuckMembers;
+                    return release(m, u);
                 }
+
+                ++m.waypoint;
+                m.bestDistance = INT_MAX;
+                m.staleChecks = 0;
+                // Final leg: straight to this unit's formation slot
+                if (m.waypoint == last) return release(m, u);
+                appendOrder(move.order, move.waypoints[m.waypoint], u);
+                return false;
+            }), move.members.end());
+        }
+        activeGroupMoves.erase(std::remove_if(activeGroupMoves.begin(), activeGroupMoves.end(),
+                                              [](const GroupMove& m) { return m.members.empty(); }),
+                               activeGroupMoves.end());
+    }
+
+    void releaseUnitFromGroupMoves(openbw_ios::unit_handle h) {
+        for (GroupMove& move : activeGroupMoves) {
+            move.members.erase(std::remove_if(move.members.begin(), move.members.end(),
+                                              [&](const GroupMoveMember& m) { return m.handle == h; }),
+                               move.members.end());
+        }
+    }
+
+    void releaseFromGroupMoves(const openbw_ios::command_record& record) {
+        auto& funcs = player->funcs();
+        for (size_t i = 0; i < record.unit_count; ++i) {
+            bwgame::unit_t* u = funcs.get_unit(bwgame::unit_id(record.units[i]));
+            if (u) releaseUnitFromGroupMoves(handleForUnit(u));
+        }
+    }
+
+    struct GroupMoveBenchmarkRun {
+        double simMs = 0;           // Whole run
+        double worstFrameMs = 0;    // Slowest single frame
+        double corridorMs = 0;      // Corridor searches
+        int pathRequests = 0;       // Path searches asked of the engine or done for the group
+    };
+
+    // Headless benchmark run: spawn an army at the first start location,
+    // order it to the farthest one and time the simulation. Each unit move
+    // order makes the engine search a path, so path requests count those
+    // orders plus the corridor searches; repaths the engine starts on its own
+    // are not seen. Returns false if the game could not be set up.
+    static bool runGroupMoveBenchmark(const std::string& dataPath, const std::string& mapPath,
+                                      int unitCount, int frames, bool shared, GroupMoveBenchmarkRun& out) {
+        OpenBWStateHolder bench;
+        if (!bench.initialize(dataPath) || !bench.loadMap(mapPath)) return false;
+
+        try {
+            auto& st = bench.getState();
+            auto& funcs = bench.player->funcs();
+            const bwgame::unit_type_t* marine = funcs.get_unit_type(bwgame::UnitTypes::Terran_Marine);
+
+            std::vector<bwgame::xy> starts;
+            for (size_t i = 0; i < 8; ++i) {
+                if (st.game->start_locations[i] != bwgame::xy()) starts.push_back(st.game->start_locations[i]);
             }
+            if (starts.size() < 2) return false;
+
+            bwgame::xy from = starts[0];
+            auto distanceSq = [&](bwgame::xy p) {
+                int64_t dx = p.x - from.x, dy = p.y - from.y;
+                return dx * dx + dy * dy;
+            };
+            bwgame::xy to = starts[1];
+            for (const bwgame::xy& p : starts) {
+                if (distanceSq(p) > distanceSq(to)) to = p;
+            }
+
+            // Square block of units next to the start location
+            std::vector<bwgame::unit_t*> army;
+            int side = (int)std::ceil(std::sqrt((double)unitCount));
+            for (int i = 0; i < unitCount; ++i) {
+                bwgame::xy pos(from.x + (i % side - side / 2) * 24, from.y + 96 + (i / side) * 24);
+                bwgame::unit_t* u = funcs.create_unit(marine, pos, 0);
+                if (!u) continue;
+                funcs.finish_building_unit(u);
+                funcs.complete_unit(u);
+                army.push_back(u);
+            }
+            if (army.empty()) return false;
+
+            bench.currentPlayer = 0;
+            bench.groupMoveEnabled = shared;
+            bench.selectUnits(army);
+            bench.moveSelectedTo((float)to.x, (float)to.y);
+            // Ordered directly: one engine search per unit
+            if (!shared || army.size() < kGroupMoveMinUnits) bench.groupMovePathRequests += (int)army.size();
+
+            auto start = std::chrono::steady_clock::now();
+            auto frameStart = start;
+            for (int f = 0; f < frames; ++f) {
+                bench.nextFrame();
+                auto frameEnd = std::chrono::steady_clock::now();
+                out.worstFrameMs = std::max(out.worstFrameMs,
+                                            std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+                frameStart = frameEnd;
+            }
+            out.simMs = std::chrono::duration<double, std::milli>(frameStart - start).count();
+            out.corridorMs = bench.groupMoveCorridorNs / 1e6;
+            out.pathRequests = bench.groupMovePathRequests;
+            if (shared) {
+                NSLog(@"OpenBW: Group move benchmark released %d stuck members, %d moves timed out",
+                      bench.groupMoveStuckMembers, bench.groupMoveTimeouts);
+            }
+            return true;
+        }
+        catch (const std::exception& e) {
+            NSLog(@"OpenBW: Group move benchmark failed: %s", e.what());
+            return false;
         }
     }
 
+    // Issue move command to selected units
+    void moveSelectedTo(float worldX, float worldY) {
+        if (!player || !isInitialized || selectedUnits.empty()) return;
+        orderSelectedTo(bwgame::Orders::Move, bwgame::xy((int)worldX, (int)worldY));
+    }
+
+    // Issue attack-move command to selected units
+    void attackMoveTo(float worldX, float worldY) {
+        if (!player || !isInitialized || selectedUnits.empty()) return;
+        orderSelectedTo(bwgame::Orders::AttackMove, bwgame::xy((int)worldX, (int)worldY));
+    }
+
+    // Issue stop command to selected units
+    void stopSelected() {
+        if (!player || !isInitialized || selectedUnits.empty()) return;
+        queueAction(openbw_ios::game_action::stop, selectedUnits);
+    }
+
+    // Issue hold position command to selected units
+    void holdPosition() {
+        if (!player || !isInitialized || selectedUnits.empty()) return;
+        queueAction(openbw_ios::game_action::hold_position, selectedUnits);
+    }
+
+    // Issue patrol command to selected units
+    void patrolTo(float worldX, float worldY) {
+        if (!player || !isInitialized || selectedUnits.empty()) return;
+        queueOrder(bwgame::Orders::Patrol, bwgame::xy((int)worldX, (int)worldY), selectedUnits);
+    }
+
     // Build structure at location
     void buildStructure(int structureTypeId, float worldX, float worldY) {
         if (!player || !isInitialized || selectedUnits.empty()) return;
@@ -554,16 +1569,10 @@ struct OpenBWStateHolder {
             return;
         }
 
-        // Convert world coordinates to tile coordinates
+        // Convert world coordinates to tile coordinates (top-left of placement)
         size_t tileX = (size_t)((int)worldX / 32);
         size_t tileY = (size_t)((int)worldY / 32);
 
-        // Calculate center position for building
-        bwgame::xy buildPos(
-            (int)(tileX * 32) + buildingType->placement_size.x / 2,
-            (int)(tileY * 32) + buildingType->placement_size.y / 2
-        );
-
         // Determine order type based on race
         bwgame::race_t race = funcs.unit_race(worker->unit_type);
         bwgame::Orders orderType;
@@ -575,21 +1584,16 @@ struct OpenBWStateHolder {
             orderType = bwgame::Orders::PlaceBuilding;
         }
 
-        // Check if building can be placed
-        if (!funcs.can_place_building(worker, currentPlayer, buildingType, buildPos, false, false)) {
-            NSLog(@"OpenBW: Cannot place building at (%d, %d)", buildPos.x, buildPos.y);
-            return;
-        }
-
-        try {
-            // Issue the build order
-            funcs.place_building(worker, funcs.get_order_type(orderType), buildingType, buildPos);
-            NSLog(@"OpenBW: Build order issued for type %d at tile (%zu, %zu)",
-                  (int)buildingType->id, tileX, tileY);
-        }
-        catch (...) {
-            NSLog(@"OpenBW: Failed to issue build command");
-        }
+        // Placement is validated by the build action when it executes
+        openbw_ios::command_record record;
+        record.action = openbw_ios::game_action::build;
+        record.order = (uint8_t)orderType;
+        record.x = (uint16_t)tileX;
+        record.y = (uint16_t)tileY;
+        record.unit_type = (uint16_t)buildingType->id;
+        queueCommand(record, {worker});
+        NSLog(@"OpenBW: Queued build order for type %d at tile (%zu, %zu)",
+              (int)buildingType->id, tileX, tileY);
     }
 
     // Train unit from selected building
@@ -619,25 +1623,12 @@ struct OpenBWStateHolder {
             return;
         }
 
-        // Check if building can train this unit
-        if (!funcs.unit_can_build(building, unitType)) {
-            NSLog(@"OpenBW: Building cannot train unit type %d", unitTypeId);
-            return;
-        }
-
-        try {
-            // Add to build queue
-            if (!funcs.build_queue_push(building, unitType)) {
-                NSLog(@"OpenBW: Build queue full");
-                return;
-            }
-            // Set training order
-            funcs.set_secondary_order(building, funcs.get_order_type(bwgame::Orders::Train));
-            NSLog(@"OpenBW: Training unit type %d", unitTypeId);
-        }
-        catch (...) {
-            NSLog(@"OpenBW: Failed to issue train command");
-        }
+        // Requirements, resources and queue space are checked by the train action
+        openbw_ios::command_record record;
+        record.action = openbw_ios::game_action::train;
+        record.unit_type = (uint16_t)unitType->id;
+        queueCommand(record, {building});
+        NSLog(@"OpenBW: Queued training of unit type %d", unitTypeId);
     }
 
     // Get available abilities for selected unit(s)
@@ -736,72 +1727,51 @@ struct OpenBWStateHolder {
 
         auto& funcs = player->funcs();
 
-        for (bwgame::unit_t* unit : selectedUnits) {
-            if (!unit || unit->owner != currentPlayer) continue;
-
-            try {
-                // Handle stim pack specially (it's an action, not an order)
-                if (abilityId == (int)bwgame::TechTypes::Stim_Packs) {
-                    // Check if unit can use stim and has enough HP
-                    if (!funcs.unit_can_use_tech(unit, funcs.get_tech_type(bwgame::TechTypes::Stim_Packs))) {
-                        NSLog(@"OpenBW: Unit cannot use Stim Pack");
-                        continue;
-                    }
-                    if (unit->hp <= bwgame::fp8::integer(10)) {
-                        NSLog(@"OpenBW: Not enough HP for Stim Pack");
-                        continue;
-                    }
-                    // Apply stim: deal 10 damage, set timer
-                    funcs.unit_deal_damage(unit, bwgame::fp8::integer(10), nullptr, ~0);
-                    if (unit->stim_timer < 37) {
-                        unit->stim_timer = 37;
-                        funcs.update_unit_speed(unit);
-                    }
-                    NSLog(@"OpenBW: Used Stim Pack");
-                    continue;
-                }
+        // Toggles depend on each unit's current state, so units are bucketed
+        // by the action they need; each bucket is queued as one command
+        std::vector<bwgame::unit_t*> forward;
+        std::vector<bwgame::unit_t*> reverse;
+        uint8_t forwardAction = 0;
+        uint8_t reverseAction = 0;
 
-                // Map tech/ability ID to order type
-                bwgame::Orders orderType;
+        if (abilityId == (int)bwgame::TechTypes::Stim_Packs) {
+            forwardAction = openbw_ios::game_action::stim;
+        }
+        else if (abilityId == (int)bwgame::TechTypes::Tank_Siege_Mode) {
+            forwardAction = openbw_ios::game_action::siege;
+            reverseAction = openbw_ios::game_action::unsiege;
+        }
+        else if (abilityId == (int)bwgame::TechTypes::Burrowing) {
+            forwardAction = openbw_ios::game_action::burrow;
+            reverseAction = openbw_ios::game_action::unburrow;
+        }
+        else if (abilityId == (int)bwgame::TechTypes::Cloaking_Field ||
+                 abilityId == (int)bwgame::TechTypes::Personnel_Cloaking) {
+            forwardAction = openbw_ios::game_action::cloak;
+            reverseAction = openbw_ios::game_action::decloak;
+        }
+        else {
+            NSLog(@"OpenBW: Unknown no-target ability %d", abilityId);
+            return;
+        }
 
-                if (abilityId == (int)bwgame::TechTypes::Tank_Siege_Mode) {
-                    // Toggle between siege and tank mode
-                    int unitTypeId = (int)unit->unit_type->id;
-                    if (unitTypeId == 5) { // Tank mode -> Siege
-                        orderType = bwgame::Orders::Sieging;
-                    } else { // Siege mode -> Tank
-                        orderType = bwgame::Orders::Unsieging;
-                    }
-                }
-                else if (abilityId == (int)bwgame::TechTypes::Burrowing) {
-                    // Toggle burrow
-                    if (funcs.u_burrowed(unit)) {
-                        orderType = bwgame::Orders::Unburrowing;
-                    } else {
-                        orderType = bwgame::Orders::Burrowing;
-                    }
-                }
-                else if (abilityId == (int)bwgame::TechTypes::Cloaking_Field ||
-                         abilityId == (int)bwgame::TechTypes::Personnel_Cloaking) {
-                    // Toggle cloak
-                    if (funcs.u_cloaked(unit)) {
-                        orderType = bwgame::Orders::Decloak;
-                    } else {
-                        orderType = bwgame::Orders::Cloak;
-                    }
-                }
-                else {
-                    NSLog(@"OpenBW: Unknown no-target ability %d", abilityId);
-                    return;
-                }
+        for (bwgame::unit_t* unit : selectedUnits) {
+            if (!unit || unit->owner != currentPlayer) continue;
 
-                funcs.set_unit_order(unit, funcs.get_order_type(orderType));
-                NSLog(@"OpenBW: Used ability %d", abilityId);
-            }
-            catch (...) {
-                NSLog(@"OpenBW: Failed to use ability %d", abilityId);
+            bool reversed = false;
+            if (forwardAction == openbw_ios::game_action::siege) {
+                reversed = (int)unit->unit_type->id != 5;  // Not in tank mode -> unsiege
+            } else if (forwardAction == openbw_ios::game_action::burrow) {
+                reversed = funcs.u_burrowed(unit);
+            } else if (forwardAction == openbw_ios::game_action::cloak) {
+                reversed = funcs.u_cloaked(unit);
             }
+            (reversed ? reverse : forward).push_back(unit);
         }
+
+        if (!forward.empty()) queueAction(forwardAction, forward);
+        if (!reverse.empty()) queueAction(reverseAction, reverse);
+        NSLog(@"OpenBW: Queued ability %d", abilityId);
     }
 
     // Use ability on ground target (e.g., Psionic Storm, Scanner Sweep)
@@ -817,7 +1787,6 @@ struct OpenBWStateHolder {
         }
         if (!unit) return;
 
-        auto& funcs = player->funcs();
         bwgame::xy targetPos((int)worldX, (int)worldY);
 
         try {
@@ -858,8 +1827,8 @@ struct OpenBWStateHolder {
                 return;
             }
 
-            funcs.set_unit_order(unit, funcs.get_order_type(orderType), targetPos);
-            NSLog(@"OpenBW: Used ground ability %d at (%f, %f)", abilityId, worldX, worldY);
+            queueOrder(orderType, targetPos, {unit});
+            NSLog(@"OpenBW: Queued ground ability %d at (%f, %f)", abilityId, worldX, worldY);
         }
         catch (...) {
             NSLog(@"OpenBW: Failed to use ground ability %d", abilityId);
@@ -878,8 +1847,6 @@ struct OpenBWStateHolder {
         }
         if (!unit) return;
 
-        auto& funcs = player->funcs();
-
         try {
             bwgame::Orders orderType;
 
@@ -927,25 +1894,68 @@ struct OpenBWStateHolder {
                 return;
             }
 
-            funcs.set_unit_order(unit, funcs.get_order_type(orderType), target);
-            NSLog(@"OpenBW: Used unit ability %d on target", abilityId);
+            queueOrder(orderType, target->sprite ? target->sprite->position : bwgame::xy(), {unit}, target);
+            NSLog(@"OpenBW: Queued unit ability %d on target", abilityId);
         }
         catch (...) {
             NSLog(@"OpenBW: Failed to use unit ability %d", abilityId);
         }
     }
 
-    // Find unit by ID (pointer cast)
-    bwgame::unit_t* findUnitById(int unitId) {
+    // Stable handle for a unit, for use outside the current frame
+    openbw_ios::unit_handle handleForUnit(const bwgame::unit_t* u) {
+        return unitHandles.handle_for(u);
+    }
+
+    // Resolve a unit handle in O(1); nullptr if the unit is gone
+    bwgame::unit_t* resolveHandle(openbw_ios::unit_handle handle) {
         if (!player || !isInitialized) return nullptr;
-        auto& st = player->st();
+        return unitHandles.resolve(player->funcs(), handle);
+    }
 
-        for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
-            if ((int)(size_t)u == unitId) {
-                return u;
-            }
+    // Find unit by ID (an int-encoded unit handle)
+    bwgame::unit_t* findUnitById(int unitId) {
+        return resolveHandle(openbw_ios::unit_handle::from_int(unitId));
+    }
+
+    // MARK: - Unit Events
+
+    // A unit died: retire its handle and drop it from every control group
+    void onUnitKilled(bwgame::unit_t* u) {
+        openbw_ios::unit_handle h = unitHandles.handle_for(u);
+        controlGroups.remove_unit(h);
+        rallyPoints.erase(h);
+        unitHandles.invalidate(u);
+    }
+
+    // A unit left its owner's control, or is about to: its owner may not
+    // have changed yet, so grouped units are checked after the frame
+    void onUnitDeselected(bwgame::unit_t* u) {
+        openbw_ios::unit_handle h = unitHandles.handle_for(u);
+        if (controlGroups.grouped(h)) pendingOwnerChecks.push_back(h);
+    }
+
+    // After each frame: grouped units deselected during it that changed
+    // owner are dropped. Only units an event named are visited.
+    void updateControlGroups() {
+        if (pendingOwnerChecks.empty()) return;
+        for (openbw_ios::unit_handle h : pendingOwnerChecks) removeIfNotOwned(h);
+        pendingOwnerChecks.clear();
+    }
+
+    // Every group at once, after the state was replaced by re-simulation
+    void checkControlGroupOwners() {
+        for (int group = 0; group < openbw_ios::control_group_set::group_count; ++group) {
+            if (controlGroups.size(group) == 0) continue;
+            pendingOwnerChecks = controlGroups.members(group);
+            for (openbw_ios::unit_handle h : pendingOwnerChecks) removeIfNotOwned(h);
         }
-        return nullptr;
+        pendingOwnerChecks.clear();
+    }
+
+    void removeIfNotOwned(openbw_ios::unit_handle h) {
+        bwgame::unit_t* u = resolveHandle(h);
+        if (!u || u->owner != currentPlayer) controlGroups.remove_unit(h);
     }
 
     // MARK: - Control Groups
@@ -955,14 +1965,15 @@ struct OpenBWStateHolder {
         if (group < 0 || group >= 10) return;
         if (selectedUnits.empty()) return;
 
-        // Clear existing group and assign selected units
-        controlGroups[group].clear();
+        // Replace the group with the selected units
+        std::vector<openbw_ios::unit_handle> handles;
         for (bwgame::unit_t* u : selectedUnits) {
             if (u && u->owner == currentPlayer) {
-                controlGroups[group].push_back(u);
+                handles.push_back(handleForUnit(u));
             }
         }
-        NSLog(@"OpenBW: Assigned %zu units to control group %d", controlGroups[group].size(), group + 1);
+        controlGroups.assign(group, handles);
+        NSLog(@"OpenBW: Assigned %d units to control group %d", controlGroups.size(group), group + 1);
     }
 
     // Add selected units to a control group (Shift+number)
@@ -972,44 +1983,27 @@ struct OpenBWStateHolder {
 
         for (bwgame::unit_t* u : selectedUnits) {
             if (u && u->owner == currentPlayer) {
-                // Check if unit is already in the group
-                auto& grp = controlGroups[group];
-                if (std::find(grp.begin(), grp.end(), u) == grp.end()) {
-                    grp.push_back(u);
-                }
+                controlGroups.add(group, handleForUnit(u));
             }
         }
-        NSLog(@"OpenBW: Added units to control group %d (total: %zu)", group + 1, controlGroups[group].size());
+        NSLog(@"OpenBW: Added units to control group %d (total: %d)", group + 1, controlGroups.size(group));
     }
 
-    // Select units in a control group
+    // Select units in a control group. Membership is kept current by unit
+    // events, so this is O(group size) with no liveness scan.
     void selectControlGroup(int group) {
         if (group < 0 || group >= 10) return;
 
         selectedUnits.clear();
-
-        // Filter out dead/invalid units
-        auto& grp = controlGroups[group];
-        grp.erase(std::remove_if(grp.begin(), grp.end(), [this](bwgame::unit_t* u) {
-            if (!u) return true;
-            // Check if unit is still alive by verifying it's in visible_units
-            auto& st = player->st();
-            for (bwgame::unit_t* v : bwgame::ptr(st.visible_units)) {
-                if (v == u && u->owner == currentPlayer) return false;
-            }
-            return true; // Unit not found, remove it
-        }), grp.end());
-
-        for (bwgame::unit_t* u : grp) {
-            selectedUnits.push_back(u);
+        for (openbw_ios::unit_handle h : controlGroups.members(group)) {
+            if (bwgame::unit_t* u = resolveHandle(h)) selectedUnits.push_back(u);
         }
         NSLog(@"OpenBW: Selected control group %d (%zu units)", group + 1, selectedUnits.size());
     }
 
-    // Get control group info for UI
+    // Get control group info for UI (exact; dead and converted units are removed)
     int getControlGroupSize(int group) {
-        if (group < 0 || group >= 10) return 0;
-        return (int)controlGroups[group].size();
+        return controlGroups.size(group);
     }
 
     // MARK: - Rally Points
@@ -1019,18 +2013,20 @@ struct OpenBWStateHolder {
         if (!player || !isInitialized || selectedUnits.empty()) return;
 
         auto& funcs = player->funcs();
+        bwgame::xy pos((int)worldX, (int)worldY);
 
+        std::vector<bwgame::unit_t*> buildings;
         for (bwgame::unit_t* u : selectedUnits) {
             if (u && u->owner == currentPlayer && funcs.ut_building(u->unit_type)) {
-                // Store rally point
-                rallyPoints[u] = bwgame::xy((int)worldX, (int)worldY);
-
-                // Set the rally order on the building
-                funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::RallyPointTile),
-                                     bwgame::xy((int)worldX, (int)worldY));
-                NSLog(@"OpenBW: Set rally point at (%f, %f)", worldX, worldY);
+                // Store rally point for UI display
+                rallyPoints[handleForUnit(u)] = pos;
+                buildings.push_back(u);
             }
         }
+        if (buildings.empty()) return;
+
+        queueOrder(bwgame::Orders::RallyPointTile, pos, buildings);
+        NSLog(@"OpenBW: Set rally point at (%f, %f)", worldX, worldY);
     }
 
     // Set rally point to a unit (for following/escorting)
@@ -1039,23 +2035,31 @@ struct OpenBWStateHolder {
 
         auto& funcs = player->funcs();
 
+        std::vector<bwgame::unit_t*> buildings;
         for (bwgame::unit_t* u : selectedUnits) {
             if (u && u->owner == currentPlayer && funcs.ut_building(u->unit_type)) {
-                funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::RallyPointUnit), target);
-                NSLog(@"OpenBW: Set rally point to unit");
+                buildings.push_back(u);
             }
         }
+        if (buildings.empty()) return;
+
+        queueOrder(bwgame::Orders::RallyPointUnit, target->sprite ? target->sprite->position : bwgame::xy(),
+                   buildings, target);
+        NSLog(@"OpenBW: Set rally point to unit");
     }
 
     // Get rally point for a building (for UI display)
-    bool getRallyPoint(bwgame::unit_t* building, float& outX, float& outY) {
+    bool getRallyPoint(openbw_ios::unit_handle building, float& outX, float& outY) {
         auto it = rallyPoints.find(building);
-        if (it != rallyPoints.end()) {
-            outX = (float)it->second.x;
-            outY = (float)it->second.y;
-            return true;
+        if (it == rallyPoints.end()) return false;
+        if (!resolveHandle(building)) {
+            // Building is gone; forget its rally point
+            rallyPoints.erase(it);
+            return false;
         }
-        return false;
+        outX = (float)it->second.x;
+        outY = (float)it->second.y;
+        return true;
     }
 
     // Get info for all visible units
@@ -1070,7 +2074,7 @@ struct OpenBWStateHolder {
             if (!u->sprite) continue;
 
             UnitInfo info;
-            info.unitId = (int)(size_t)u;  // Use pointer as ID for now
+            info.unitId = handleForUnit(u).to_int();
             info.typeId = (int)u->unit_type->id;
             info.owner = u->owner;
             info.x = (float)u->sprite->position.x;
@@ -1104,117 +2108,8 @@ struct OpenBWStateHolder {
 
 // Get unit type name from ID
 static NSString* getUnitTypeName(int typeId) {
-    // Common unit type names
-    static NSDictionary* unitNames = @{
-        // Terran
-        @0: @"Marine",
-        @1: @"Ghost",
-        @2: @"Vulture",
-        @3: @"Goliath",
-        @5: @"Siege Tank",
-        @7: @"SCV",
-        @8: @"Wraith",
-        @9: @"Science Vessel",
-        @11: @"Dropship",
-        @12: @"Battlecruiser",
-        @14: @"Nuclear Missile",
-        @32: @"Firebat",
-        @34: @"Medic",
-        // Terran Buildings
-        @106: @"Command Center",
-        @107: @"Comsat Station",
-        @108: @"Nuclear Silo",
-        @109: @"Supply Depot",
-        @110: @"Refinery",
-        @111: @"Barracks",
-        @112: @"Academy",
-        @113: @"Factory",
-        @114: @"Starport",
-        @115: @"Control Tower",
-        @116: @"Science Facility",
-        @117: @"Covert Ops",
-        @118: @"Physics Lab",
-        @120: @"Machine Shop",
-        @122: @"Engineering Bay",
-        @123: @"Armory",
-        @124: @"Missile Turret",
-        @125: @"Bunker",
-        // Zerg
-        @35: @"Larva",
-        @36: @"Egg",
-        @37: @"Zergling",
-        @38: @"Hydralisk",
-        @39: @"Ultralisk",
-        @40: @"Broodling",
-        @41: @"Drone",
-        @42: @"Overlord",
-        @43: @"Mutalisk",
-        @44: @"Guardian",
-        @45: @"Queen",
-        @46: @"Defiler",
-        @47: @"Scourge",
-        @50: @"Infested Terran",
-        @62: @"Devourer",
-        @103: @"Lurker",
-        // Zerg Buildings
-        @131: @"Hatchery",
-        @132: @"Lair",
-        @133: @"Hive",
-        @134: @"Nydus Canal",
-        @135: @"Hydralisk Den",
-        @136: @"Defiler Mound",
-        @137: @"Greater Spire",
-        @138: @"Queens Nest",
-        @139: @"Evolution Chamber",
-        @140: @"Ultralisk Cavern",
-        @141: @"Spire",
-        @142: @"Spawning Pool",
-        @143: @"Creep Colony",
-        @144: @"Spore Colony",
-        @146: @"Sunken Colony",
-        @149: @"Extractor",
-        // Protoss
-        @60: @"Corsair",
-        @61: @"Dark Templar",
-        @63: @"Dark Archon",
-        @64: @"Probe",
-        @65: @"Zealot",
-        @66: @"Dragoon",
-        @67: @"High Templar",
-        @68: @"Archon",
-        @69: @"Shuttle",
-        @70: @"Scout",
-        @71: @"Arbiter",
-        @72: @"Carrier",
-        @73: @"Interceptor",
-        @83: @"Reaver",
-        @84: @"Observer",
-        @85: @"Scarab",
-        // Protoss Buildings
-        @154: @"Nexus",
-        @155: @"Robotics Facility",
-        @156: @"Pylon",
-        @157: @"Assimilator",
-        @159: @"Observatory",
-        @160: @"Gateway",
-        @162: @"Photon Cannon",
-        @163: @"Citadel of Adun",
-        @164: @"Cybernetics Core",
-        @165: @"Templar Archives",
-        @166: @"Forge",
-        @167: @"Stargate",
-        @169: @"Fleet Beacon",
-        @170: @"Arbiter Tribunal",
-        @171: @"Robotics Support Bay",
-        @172: @"Shield Battery",
-        // Resources
-        @176: @"Mineral Field",
-        @188: @"Vespene Geyser",
-    };
-
-    NSNumber* key = @(typeId);
-    NSString* name = unitNames[key];
-    return name ?: [NSString stringWithFormat:@"Unit %d", typeId];
+    const char* name = openbw_ios::unit_type_name(typeId);
+    return name ? @(name) : [NSString stringWithFormat:@"Unit %d", typeId];
 }
 
 #pragma mark - SelectedUnitInfo Implementation
@@ -1261,6 +2156,111 @@ static NSString* getUnitTypeName(int typeId) {
 
 @end
 
+#pragma mark - TurboRunStats Implementation
+
+@implementation TurboRunStats
+
+- (instancetype)initWithStartFrame:(int)startFrame
+                          endFrame:(int)endFrame
+                    elapsedSeconds:(double)elapsedSeconds {
+    self = [super init];
+    if (self) {
+        _startFrame = startFrame;
+        _endFrame = endFrame;
+        _framesAdvanced = endFrame - startFrame;
+        _elapsedSeconds = elapsedSeconds;
+        _framesPerSecond = elapsedSeconds > 0 ? _framesAdvanced / elapsedSeconds : 0;
+    }
+    return self;
+}
+
+@end
+
+#pragma mark - ReplaySeekStats Implementation
+
+@implementation ReplaySeekStats
+
+- (instancetype)initWithFromFrame:(int)fromFrame
+                      targetFrame:(int)targetFrame
+                    keyframeFrame:(int)keyframeFrame
+                  framesSimulated:(int)framesSimulated
+                   elapsedSeconds:(double)elapsedSeconds {
+    self = [super init];
+    if (self) {
+        _fromFrame = fromFrame;
+        _targetFrame = targetFrame;
+        _keyframeFrame = keyframeFrame;
+        _framesSimulated = framesSimulated;
+        _elapsedSeconds = elapsedSeconds;
+    }
+    return self;
+}
+
+@end
+
+@implementation GroupMoveBenchmarkResult
+
+- (instancetype)initWithMapName:(NSString*)mapName
+                      unitCount:(int)unitCount
+                         frames:(int)frames
+        independentMilliseconds:(double)independentMilliseconds
+             sharedMilliseconds:(double)sharedMilliseconds
+           corridorMilliseconds:(double)corridorMilliseconds
+independentWorstFrameMilliseconds:(double)independentWorstFrameMilliseconds
+   sharedWorstFrameMilliseconds:(double)sharedWorstFrameMilliseconds
+        independentPathRequests:(int)independentPathRequests
+             sharedPathRequests:(int)sharedPathRequests {
+    self = [super init];
+    if (self) {
+        _mapName = [mapName copy];
+        _unitCount = unitCount;
+        _frames = frames;
+        _independentMilliseconds = independentMilliseconds;
+        _sharedMilliseconds = sharedMilliseconds;
+        _corridorMilliseconds = corridorMilliseconds;
+        _independentWorstFrameMilliseconds = independentWorstFrameMilliseconds;
+        _sharedWorstFrameMilliseconds = sharedWorstFrameMilliseconds;
+        _independentPathRequests = independentPathRequests;
+        _sharedPathRequests = sharedPathRequests;
+        _speedup = sharedMilliseconds > 0 ? independentMilliseconds / sharedMilliseconds : 0;
+    }
+    return self;
+}
+
+@end
+
+#pragma mark - OpenBWMapInfo Implementation
+
+@implementation OpenBWMapInfo
+
+- (instancetype)initWithPath:(NSString*)path
+                        name:(NSString*)name
+              mapDescription:(NSString*)mapDescription
+                     tileset:(int)tileset
+                       width:(int)width
+                      height:(int)height
+                  humanSlots:(int)humanSlots
+               computerSlots:(int)computerSlots
+                  maxPlayers:(int)maxPlayers
+              startLocations:(NSArray<NSValue*>*)startLocations {
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+        _name = [name copy];
+        _mapDescription = [mapDescription copy];
+        _tileset = tileset;
+        _width = width;
+        _height = height;
+        _humanSlots = humanSlots;
+        _computerSlots = computerSlots;
+        _maxPlayers = maxPlayers;
+        _startLocations = [startLocations copy];
+    }
+    return self;
+}
+
+@end
+
 #pragma mark - OpenBWGameRunner Implementation
 
 @interface OpenBWGameRunner ()
@@ -1291,11 +2291,50 @@ static NSString* getUnitTypeName(int typeId) {
     BOOL _gameRunning;
     BOOL _assetsLoaded;
 
-    // Sprite rendering data
-    std::vector<RenderSpriteInfo> _spriteRenderInfos;
-    std::vector<RenderImageInfo> _imageRenderInfos;
-    std::vector<uint8_t> _selectedMask;  // Use uint8_t instead of BOOL to avoid vector<bool> specialization
+    // Sprite collection scratch space
     std::vector<std::pair<uint32_t, bwgame::sprite_t*>> _sortedSprites;
+
+    // Render snapshots handed from the simulation thread to the render thread
+    openbw_ios::snapshot_exchange<RenderSnapshot> _snapshots;
+    dispatch_queue_t _renderQueue;
+    std::atomic<bool> _renderScheduled;
+    int _pipelineLatencyFrames;
+
+    // Turbo mode
+    int _turboFramesPerTick;
+    TurboRunStats* _lastTurboStats;
+
+    // Replay playback
+    BOOL _playingReplay;
+    BOOL _replayFinishReported;
+    double _replaySpeed;
+    double _replayFrameCredit;              // Fractional frames carried between ticks
+    double _replayKeyframeInterval;
+    NSUInteger _replayKeyframeBudget;
+    ReplaySeekStats* _lastReplaySeekStats;
+
+    // Persistent minimap (updated on the simulation thread, read under the mutex)
+    openbw_ios::minimap_layers _minimap;
+    std::mutex _minimapMutex;
+    std::atomic<uint64_t> _minimapVersion;
+    std::atomic<bool> _minimapActive;
+    BOOL _minimapNeedsTerrain;
+
+    // Fog of war for the current player (diffed on the simulation thread,
+    // drained into the renderer on the render thread)
+    openbw_ios::fog_layer _fog;
+    std::mutex _fogMutex;
+    BOOL _fogEnabled;
+    BOOL _fogResetPending;                  // Renderer must restart its fog
+    std::atomic<bool> _fogResetRequested;   // Simulation thread must restart the diff
+    std::vector<uint32_t> _fogDrainIndices;
+    std::vector<uint8_t> _fogDrainStates;
+
+    // Work other threads hand to the thread that ticks the game, run at the
+    // start of its next tick (paused or not)
+    std::mutex _gameTaskMutex;
+    std::vector<dispatch_block_t> _gameTasks;
+    std::atomic<bool> _gameTasksPending;
 }
 
 - (instancetype)initWithDevice:(id<MTLDevice>)device {
@@ -1315,6 +2354,26 @@ static NSString* getUnitTypeName(int typeId) {
         _currentFrame = 0;
         _mapWidth = 0;
         _mapHeight = 0;
+        _turboFramesPerTick = 1;
+        _playingReplay = NO;
+        _replayFinishReported = NO;
+        _replaySpeed = 1.0;
+        _replayFrameCredit = 0;
+        _replayKeyframeInterval = OpenBWStateHolder::kKeyframeIntervalFrames * OpenBWStateHolder::kSecondsPerFrame;
+        _replayKeyframeBudget = OpenBWStateHolder::kKeyframeBudgetBytes;
+        _replayRecordingEnabled = YES;
+        _replayAutosavePath = defaultReplayAutosavePath();
+        _pipelineLatencyFrames = 0;
+        _renderScheduled = false;
+        _minimapVersion = 0;
+        _minimapActive = false;
+        _minimapNeedsTerrain = YES;
+        _fogEnabled = YES;
+        _fogResetPending = YES;
+        _fogResetRequested = false;
+        _gameTasksPending = false;
+        _renderQueue = dispatch_queue_create("com.openbw.render", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_renderQueue, &kRenderQueueKey, &kRenderQueueKey, NULL);
 
         // Initialize state holder
         _stateHolder = std::make_unique<OpenBWStateHolder>();
@@ -1355,46 +2414,87 @@ static NSString* getUnitTypeName(int typeId) {
 
     NSLog(@"OpenBWGameRunner: MPQ files validated at %@", path);
 
-    // Initialize OpenBW global state with the data files
-    @try {
-        if (!_stateHolder->initialize([path UTF8String])) {
-            if (error) {
-                *error = [NSError errorWithDomain:@"OpenBW"
-                                             code:10
-                                         userInfo:@{NSLocalizedDescriptionKey:
-                                             @"Failed to initialize OpenBW game engine"}];
-            }
-            return NO;
+    // Startup runs as a task graph: the archive service opens first, then the
+    // game data and the renderer's image data decode concurrently
+    std::vector<std::string> mpqPaths;
+    for (NSString* mpq in @[@"patch_rt.mpq", @"BROODAT.MPQ", @"STARDAT.MPQ"]) {
+        NSString* resolvedPath = [mpqLoader resolvedPathForFile:mpq];
+        if (resolvedPath.length > 0) mpqPaths.push_back([resolvedPath UTF8String]);
+    }
+    auto& archives = openbw_ios::archive_service::shared();
+    std::string dataPath = [path UTF8String];
+    OpenBWStateHolder* holder = _stateHolder.get();
+    OpenBWRenderer* renderer = _renderer;
+    bool gameReady = false;
+    BOOL rendererReady = NO;
+    NSError* rendererError = nil;
+
+    openbw_ios::task_graph startup;
+    startup.add("archives", [&] {
+        // On failure the game falls back to opening the data files itself
+        try {
+            archives.open(mpqPaths);
         }
-
-        _assetsLoaded = YES;
-        NSLog(@"OpenBWGameRunner: OpenBW initialized successfully");
-
-        // Load tileset and image data into the renderer
-        NSError* rendererError = nil;
-        if ([_renderer loadImageDataFromPath:path error:&rendererError]) {
-            NSLog(@"OpenBWGameRunner: Renderer image data loaded");
-            // Update Metal renderer with the loaded palette
-            MetalRenderer_SetPalette(_renderer.palette);
-        } else {
-            NSLog(@"OpenBWGameRunner: Could not load renderer image data: %@",
-                  rendererError.localizedDescription);
-            // Fall back to test palette
-            [self loadTestPalette];
+        catch (const std::exception& e) {
+            NSLog(@"OpenBWGameRunner: Could not open archives: %s", e.what());
+        }
+    });
+    startup.add("game data", [&] {
+        holder->mapDataKey = archives.is_open() ? openbw_ios::map_data_key(mpqPaths, OpenBWStateHolder::kMapStateVersion) : 0;
+        gameReady = holder->initialize(dataPath);
+    }, {"archives"});
+    startup.add("renderer data", [&] {
+        @autoreleasepool {
+            NSError* loadError = nil;
+            rendererReady = [renderer loadImageDataFromPath:path error:&loadError];
+            rendererError = loadError;
+        }
+    }, {"archives"});
+
+    size_t workers = _startupWorkers ? _startupWorkers : std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+    bool graphOk = startup.run(workers);
+    for (size_t i = 0; i < startup.size(); i++) {
+        const auto& result = startup.result(i);
+        if (result.failed) {
+            NSLog(@"OpenBWGameRunner: Startup task '%s' failed: %s", result.name.c_str(), result.error.c_str());
         }
-
-        return YES;
     }
-    @catch (NSException* exception) {
+
+    if (!graphOk || !gameReady) {
         if (error) {
             *error = [NSError errorWithDomain:@"OpenBW"
-                                         code:11
+                                         code:10
                                      userInfo:@{NSLocalizedDescriptionKey:
-                                         [NSString stringWithFormat:@"OpenBW initialization exception: %@",
-                                          exception.reason ?: @"Unknown"]}];
+                                         @"Failed to initialize OpenBW game engine"}];
         }
         return NO;
     }
+
+    _assetsLoaded = YES;
+    NSLog(@"OpenBWGameRunner: OpenBW initialized successfully");
+
+    if (rendererReady) {
+        NSLog(@"OpenBWGameRunner: Renderer image data loaded");
+        // Update Metal renderer with the loaded palette
+        MetalRenderer_SetPalette(_renderer.palette);
+    } else {
+        NSLog(@"OpenBWGameRunner: Could not load renderer image data: %@",
+              rendererError.localizedDescription);
+        // Fall back to test palette
+        [self loadTestPalette];
+    }
+
+    auto stats = archives.stats();
+    // With several workers, busy time above total time is the overlap won;
+    // run with startupWorkers = 1 for the serial baseline
+    NSLog(@"OpenBWGameRunner: Assets loaded in %.0f ms on %zu workers (%.0f ms in tasks), critical path: %s",
+          startup.total_ms(), workers, startup.busy_ms(), startup.describe_critical_path().c_str());
+    NSLog(@"OpenBWGameRunner: Archives: %zu opened in %.1f ms, %zu reads, %zu cache hits, %zu mapped, "
+          "%zu decompressed in %.1f ms (summed over threads), %zu concurrent readers opened, %.1f MB cached",
+          stats.archives_opened, stats.open_ns / 1e6, stats.reads, stats.cache_hits, stats.mapped_reads,
+          stats.decompressed_reads, stats.read_ns / 1e6, stats.extra_readers, stats.cached_bytes / (1024.0 * 1024.0));
+
+    return YES;
 }
 
 - (void)loadPaletteFromGameData {
@@ -1428,6 +2528,9 @@ static NSString* getUnitTypeName(int typeId) {
         return NO;
     }
 
+    // A prewarm in flight finishes first (loadMeleeGame waits for it) and no new one starts
+    _stateHolder->prewarmAllowed = false;
+
     @try {
         NSString* resolvedMapPath = mapPath;
         NSFileManager* fm = [NSFileManager defaultManager];
@@ -1457,7 +2560,10 @@ static NSString* getUnitTypeName(int typeId) {
 
         // Try to load the map
         if (resolvedMapPath && resolvedMapPath.length > 0) {
-            mapLoaded = _stateHolder->loadMap([resolvedMapPath UTF8String]);
+            // Load the map's tileset graphics while OpenBW sets up the game
+            [_renderer prefetchTilesetForMapAtPath:resolvedMapPath];
+            mapLoaded = _stateHolder->loadMeleeGame([resolvedMapPath UTF8String], race,
+                                                    difficulty > 0 ? 2 : 1);  // Use difficulty to pick AI race
         }
 
         if (!mapLoaded) {
@@ -1472,26 +2578,17 @@ static NSString* getUnitTypeName(int typeId) {
                 _mapWidth = (int)gameState->map_width;
                 _mapHeight = (int)gameState->map_height;
 
-                // Configure renderer with map data and tileset
-                [_renderer setTilesetIndex:(int)gameState->tileset_index];
-
-                auto& st = _stateHolder->getState();
-                [_renderer setMapTiles:st.tiles_mega_tile_index.data()
-                                 count:st.tiles_mega_tile_index.size()
-                             tileWidth:(int)gameState->map_tile_width
-                            tileHeight:(int)gameState->map_tile_height];
-                MetalRenderer_SetPalette(_renderer.palette);
-
-                // Set up selection circle GRP pointers for sprite rendering
-                [self setupSelectionCircleGRPs];
+                [self configureRendererForMap:gameState];
 
-                // Set up melee game with starting units
-                _stateHolder->setupMeleeGame(race, difficulty > 0 ? 2 : 1);  // Use difficulty to pick AI race
+                if (_replayRecordingEnabled) {
+                    _stateHolder->startRecording(_replayAutosavePath ? [_replayAutosavePath UTF8String] : "");
+                }
 
-                // Find player's starting location for camera
-                if (gameState->start_locations[0] != bwgame::xy()) {
-                    _cameraX = (float)gameState->start_locations[0].x;
-                    _cameraY = (float)gameState->start_locations[0].y;
+                // The engine picked the player's start location
+                bwgame::xy start;
+                if (_stateHolder->startPosition(_stateHolder->currentPlayer, start)) {
+                    _cameraX = (float)start.x;
+                    _cameraY = (float)start.y;
                     NSLog(@"OpenBWGameRunner: Camera centered on player start at (%.0f, %.0f)", _cameraX, _cameraY);
                 }
             } else {
@@ -1500,8 +2597,14 @@ static NSString* getUnitTypeName(int typeId) {
             }
         }
 
+        _playingReplay = NO;
         _gameRunning = YES;
         _currentFrame = 0;
+        [self resetFog];
+        {
+            std::lock_guard<std::mutex> lock(_minimapMutex);
+            _minimapNeedsTerrain = YES;
+        }
 
         // Only center on map middle if we didn't find a start location
         if (_cameraX == 0 && _cameraY == 0) {
@@ -1522,6 +2625,7 @@ static NSString* getUnitTypeName(int typeId) {
         return YES;
     }
     @catch (NSException* exception) {
+        _stateHolder->prewarmAllowed = true;
         if (error) {
             *error = [NSError errorWithDomain:@"OpenBW"
                                          code:3
@@ -1531,14 +2635,96 @@ static NSString* getUnitTypeName(int typeId) {
     }
 }
 
+- (void)configureRendererForMap:(const bwgame::game_state*)gameState {
+    // Configure renderer with map data and tileset
+    [_renderer setTilesetIndex:(int)gameState->tileset_index];
+
+    auto& st = _stateHolder->getState();
+    [_renderer setMapTiles:st.tiles_mega_tile_index.data()
+                     count:st.tiles_mega_tile_index.size()
+                 tileWidth:(int)gameState->map_tile_width
+                tileHeight:(int)gameState->map_tile_height];
+    MetalRenderer_SetPalette(_renderer.palette);
+
+    // Set up selection circle GRP pointers for sprite rendering
+    [self setupSelectionCircleGRPs];
+}
+
 - (BOOL)loadReplay:(NSString*)replayPath error:(NSError**)error {
-    // TODO: Implement replay loading
-    if (error) {
-        *error = [NSError errorWithDomain:@"OpenBW"
-                                     code:4
-                                 userInfo:@{NSLocalizedDescriptionKey: @"Replay loading not yet implemented"}];
+    if (!_assetPath || !_assetsLoaded) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:2
+                                     userInfo:@{NSLocalizedDescriptionKey: @"Assets not loaded"}];
+        }
+        return NO;
+    }
+
+    if (!_stateHolder || !_stateHolder->isInitialized) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:12
+                                     userInfo:@{NSLocalizedDescriptionKey: @"OpenBW not initialized"}];
+        }
+        return NO;
+    }
+
+    _stateHolder->prewarmAllowed = false;
+    [self configureReplayKeyframes];
+
+    std::string message;
+    if (!replayPath || !_stateHolder->loadReplay([replayPath UTF8String], message)) {
+        _stateHolder->prewarmAllowed = true;
+        NSLog(@"OpenBWGameRunner: Could not load replay %@: %s", replayPath, message.c_str());
+        if (error) {
+            NSString* reason = [NSString stringWithFormat:@"Could not load replay: %s", message.c_str()];
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:4
+                                     userInfo:@{NSLocalizedDescriptionKey: reason}];
+        }
+        return NO;
+    }
+
+    const bwgame::game_state* gameState = _stateHolder->getGameState();
+    _mapWidth = (int)gameState->map_width;
+    _mapHeight = (int)gameState->map_height;
+    [self configureRendererForMap:gameState];
+
+    // Start on the recording player's base
+    int owner = _stateHolder->currentPlayer;
+    if (gameState->start_locations[owner] != bwgame::xy()) {
+        _cameraX = (float)gameState->start_locations[owner].x;
+        _cameraY = (float)gameState->start_locations[owner].y;
+    } else {
+        _cameraX = _mapWidth / 2.0f;
+        _cameraY = _mapHeight / 2.0f;
+    }
+
+    _playingReplay = YES;
+    _replayFinishReported = NO;
+    _replayFrameCredit = 0;
+    _lastReplaySeekStats = nil;
+    _gameRunning = YES;
+    _currentFrame = 0;
+    [self resetFog];
+    {
+        std::lock_guard<std::mutex> lock(_minimapMutex);
+        _minimapNeedsTerrain = YES;
+    }
+
+    const auto& header = _stateHolder->replay->header();
+    NSLog(@"OpenBWGameRunner: Replay started - %s, %u frames", header.map_name.c_str(), header.frame_count);
+
+    if (self.onGameEvent) {
+        self.onGameEvent(@"replay_started", @{
+            @"replay": replayPath,
+            @"map": [NSString stringWithUTF8String:header.map_name.c_str()] ?: @"",
+            @"frames": @(header.frame_count),
+            @"width": @(_mapWidth),
+            @"height": @(_mapHeight)
+        });
     }
-    return NO;
+    return YES;
 }
 
 - (void)loadTestPalette {
@@ -1563,22 +2749,22 @@ static NSString* getUnitTypeName(int typeId) {
     return score;
 }
 
-- (void)collectVisibleSprites {
+- (void)collectVisibleSprites:(RenderSnapshot&)snapshot {
     if (!_stateHolder || !_stateHolder->isInitialized) return;
 
     auto& st = _stateHolder->getState();
     auto& global_st = *st.global;
 
-    // Clear previous frame data
+    // Clear previous frame data (the snapshot keeps its capacity)
     _sortedSprites.clear();
-    _spriteRenderInfos.clear();
-    _imageRenderInfos.clear();
-    _selectedMask.clear();
+    snapshot.sprites.clear();
+    snapshot.images.clear();
+    snapshot.selectedMask.clear();
 
     // Calculate visible tile range (with margin for large sprites)
-    int fromTileY = std::max(0, (int)(_cameraY - _viewportHeight/2) / 32 - 4);
+    int fromTileY = std::max(0, (int)(snapshot.cameraY - snapshot.viewportHeight/2) / 32 - 4);
     int toTileY = std::min((int)st.game->map_tile_height,
-                          (int)(_cameraY + _viewportHeight/2) / 32 + 5);
+                          (int)(snapshot.cameraY + snapshot.viewportHeight/2) / 32 + 5);
 
     // Collect sprites from tile lines
     for (int y = fromTileY; y < toTileY; ++y) {
@@ -1611,224 +2797,899 @@ static NSString* getUnitTypeName(int typeId) {
     }
 
     // Pre-allocate to prevent reallocation (which would invalidate pointers)
-    _imageRenderInfos.reserve(totalImages);
-    _spriteRenderInfos.reserve(_sortedSprites.size());
-    _selectedMask.reserve(_sortedSprites.size());
+    snapshot.images.reserve(totalImages);
+    snapshot.sprites.reserve(_sortedSprites.size());
+    snapshot.selectedMask.reserve(_sortedSprites.size());
 
     // Build render info for each sprite
     for (size_t i = 0; i < _sortedSprites.size(); ++i) {
         bwgame::sprite_t* sprite = _sortedSprites[i].second;
         if (!sprite) continue;
-        [self buildSpriteRenderInfo:sprite globalState:global_st state:st];
+        [self buildSpriteRenderInfo:sprite globalState:global_st state:st snapshot:snapshot];
+    }
+}
+
+- (void)buildSpriteRenderInfo:(bwgame::sprite_t*)sprite
+                  globalState:(const bwgame::global_state&)global_st
+                        state:(bwgame::state&)st
+                     snapshot:(RenderSnapshot&)snapshot {
+    if (!sprite) return;
+
+    RenderSpriteInfo spriteInfo = {};
+
+    // Find the unit that owns this sprite (if any)
+    bwgame::unit_t* ownerUnit = nullptr;
+    for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
+        if (!u) continue;
+        if (u->sprite == sprite) {
+            ownerUnit = u;
+            break;
+        }
+    }
+    if ([self isUnitHiddenByFog:ownerUnit]) return;
+
+    // Start index for this sprite's images
+    size_t imageStartIndex = snapshot.images.size();
+
+    // Collect images for this sprite (in reverse order for proper z-ordering)
+    for (bwgame::image_t* image : bwgame::ptr(bwgame::reverse(sprite->images))) {
+        if (!image) continue;
+        if (image->flags & bwgame::image_t::flag_hidden) continue;
+        if (!image->grp) continue;
+        if (image->frame_index >= image->grp->frames.size()) continue;
+
+        RenderImageInfo imgInfo = {};
+
+        const auto& frame = image->grp->frames.at(image->frame_index);
+        imgInfo.grpFrame = &frame;
+
+        // Calculate screen position
+        // Image position = sprite position + image offset - grp center + frame offset
+        int mapX = sprite->position.x + image->offset.x - (int)image->grp->width/2 + (int)frame.offset.x;
+        int mapY = sprite->position.y + image->offset.y - (int)image->grp->height/2 + (int)frame.offset.y;
+
+        // Convert to screen coordinates with zoom applied
+        float zoomedX = (mapX - snapshot.cameraX) * snapshot.zoomLevel;
+        float zoomedY = (mapY - snapshot.cameraY) * snapshot.zoomLevel;
+        imgInfo.screenX = (int)(zoomedX + snapshot.viewportWidth/2);
+        imgInfo.screenY = (int)(zoomedY + snapshot.viewportHeight/2);
+        imgInfo.frameWidth = (int)frame.size.x;
+        imgInfo.frameHeight = (int)frame.size.y;
+        imgInfo.flipped = (image->flags & bwgame::image_t::flag_horizontally_flipped) != 0;
+        imgInfo.modifier = image->modifier;
+
+        // Get player color index
+        int colorIndex = 0;
+        if (sprite->owner >= 0 && sprite->owner < (int)st.players.size()) {
+            colorIndex = st.players[sprite->owner].color;
+        }
+        imgInfo.colorIndex = std::max(0, std::min(15, colorIndex));
+
+        snapshot.images.push_back(imgInfo);
+    }
+
+    // Set up sprite info
+    spriteInfo.images = snapshot.images.data() + imageStartIndex;
+    spriteInfo.imageCount = (int)(snapshot.images.size() - imageStartIndex);
+    spriteInfo.owner = sprite->owner;
+
+    // Screen center for selection circle with zoom applied
+    float zoomedCenterX = (sprite->position.x - snapshot.cameraX) * snapshot.zoomLevel;
+    float zoomedCenterY = (sprite->position.y - snapshot.cameraY) * snapshot.zoomLevel;
+    spriteInfo.screenCenterX = (int)(zoomedCenterX + snapshot.viewportWidth/2);
+    spriteInfo.screenCenterY = (int)(zoomedCenterY + snapshot.viewportHeight/2);
+
+    // Selection circle info from sprite type
+    if (sprite->sprite_type) {
+        spriteInfo.selectionCircleIndex = sprite->sprite_type->selection_circle;
+        spriteInfo.selectionCircleVPos = sprite->sprite_type->selection_circle_vpos;
+        spriteInfo.healthBarWidth = sprite->sprite_type->health_bar_size;
+    } else {
+        spriteInfo.selectionCircleIndex = -1;
+        spriteInfo.selectionCircleVPos = 0;
+        spriteInfo.healthBarWidth = 0;
+    }
+
+    // HP/Shield/Energy from owning unit
+    if (ownerUnit && ownerUnit->unit_type) {
+        spriteInfo.hp = ownerUnit->hp.integer_part();
+        spriteInfo.maxHp = ownerUnit->unit_type->hitpoints.integer_part();
+        spriteInfo.shields = ownerUnit->shield_points.integer_part();
+        // Shield max - check if unit type has shields
+        spriteInfo.maxShields = 0; // Will be set properly for Protoss
+        spriteInfo.energy = ownerUnit->energy.integer_part();
+        spriteInfo.maxEnergy = 200; // Default
+        spriteInfo.invincible = (ownerUnit->status_flags & 0x4000000) != 0; // Invincible flag
+    } else {
+        spriteInfo.hp = 0;
+        spriteInfo.maxHp = 0;
+        spriteInfo.shields = 0;
+        spriteInfo.maxShields = 0;
+        spriteInfo.energy = 0;
+        spriteInfo.maxEnergy = 0;
+        spriteInfo.invincible = false;
+    }
+
+    snapshot.sprites.push_back(spriteInfo);
+
+    // Check if this sprite belongs to a selected unit
+    uint8_t isSelected = 0;
+    if (ownerUnit) {
+        for (bwgame::unit_t* selectedUnit : _stateHolder->selectedUnits) {
+            if (selectedUnit == ownerUnit) {
+                isSelected = 1;
+                break;
+            }
+        }
+    }
+    snapshot.selectedMask.push_back(isSelected);
+}
+
+- (void)setupSelectionCircleGRPs {
+    if (!_stateHolder || !_stateHolder->isInitialized) return;
+
+    auto& st = _stateHolder->getState();
+    auto& global_st = *st.global;
+
+    // Selection circles are ImageTypes starting from IMAGEID_Selection_Circle_22pixels (561)
+    // There are typically 10 different sizes
+    std::vector<const void*> grps;
+
+    for (int i = 0; i < 10; ++i) {
+        int imageId = 561 + i;  // IMAGEID_Selection_Circle_22pixels + i
+        if (imageId < (int)global_st.image_grp.size()) {
+            grps.push_back(global_st.image_grp[imageId]);
+        } else {
+            grps.push_back(nullptr);
+        }
+    }
+
+    [_renderer setSelectionCircleGRPs:grps.data() count:grps.size()];
+}
+
+- (void)tick {
+    [self runGameThreadTasks];
+    if (!_gameRunning || _paused) return;
+
+    if (_playingReplay) {
+        [self tickReplay];
+        return;
+    }
+
+    // Turbo mode: advance several frames and only present the last one
+    if (_turboFramesPerTick > 1) {
+        [self runTurboToFrame:_currentFrame + _turboFramesPerTick];
+        return;
+    }
+
+    [self stepSimulation];
+    [self presentCurrentFrame];
+}
+
+- (void)stepSimulation {
+    _currentFrame++;
+
+    // Advance OpenBW game state by one frame (if initialized)
+    if (_stateHolder && _stateHolder->isInitialized) {
+        try {
+            _stateHolder->nextFrame();
+        }
+        catch (const std::exception& e) {
+            NSLog(@"OpenBWGameRunner: Error in game tick: %s", e.what());
+        }
+        catch (...) {
+            // Ignore errors during tick for now
+        }
+    }
+}
+
+- (void)presentCurrentFrame {
+    // Capture an immutable snapshot of everything the renderer and HUD need
+    RenderSnapshot& snapshot = _snapshots.back();
+    [self captureSnapshot:snapshot];
+    _snapshots.publish();
+
+    if (_pipelineLatencyFrames == 0) {
+        // Synchronous: rasterize on this thread before returning
+        [self renderLatestSnapshot];
+        return;
+    }
+
+    // Pipelined: the render queue rasterizes this snapshot while the caller
+    // simulates the next frame. Only one render block is queued at a time; it
+    // always picks up the newest snapshot, so a slow render drops stale frames.
+    if (!_renderScheduled.exchange(true)) {
+        __weak OpenBWGameRunner* weakSelf = self;
+        dispatch_async(_renderQueue, ^{
+            OpenBWGameRunner* strongSelf = weakSelf;
+            if (!strongSelf) return;
+            strongSelf->_renderScheduled = false;
+            [strongSelf renderLatestSnapshot];
+        });
+    }
+}
+
+- (void)captureSnapshot:(RenderSnapshot&)snapshot {
+    snapshot.frame = _currentFrame;
+    snapshot.cameraX = _cameraX;
+    snapshot.cameraY = _cameraY;
+    snapshot.zoomLevel = _zoomLevel;
+    snapshot.viewportWidth = _viewportWidth;
+    snapshot.viewportHeight = _viewportHeight;
+    snapshot.mapWidth = _mapWidth;
+    snapshot.mapHeight = _mapHeight;
+
+    // Bring fog of war and the minimap up to date with this frame
+    [self updateFog];
+    [self updateMinimap];
+
+    // Default resource values if game state is not available
+    snapshot.minerals = 50;
+    snapshot.gas = 0;
+    snapshot.supply = 4;
+    snapshot.supplyMax = 10;
+
+    if (!_stateHolder || !_stateHolder->isInitialized) {
+        snapshot.sprites.clear();
+        snapshot.images.clear();
+        snapshot.selectedMask.clear();
+        return;
+    }
+
+    // Collect visible sprites
+    [self collectVisibleSprites:snapshot];
+
+    // Get actual resource values from game state
+    auto& st = _stateHolder->getState();
+    int player = _stateHolder->currentPlayer;
+
+    if (player >= 0 && player < 12) {
+        snapshot.minerals = st.current_minerals[player];
+        snapshot.gas = st.current_gas[player];
+
+        // Get player's race to index supply correctly (0=Terran, 1=Protoss, 2=Zerg)
+        int race = 0;  // Default to Terran
+        if (st.players.size() > (size_t)player) {
+            race = (int)st.players[player].race;
+            if (race < 0 || race > 2) race = 0;
+        }
+
+        // Supply is stored as fp1 fixed-point, divide by 2 to get actual value
+        snapshot.supply = st.supply_used[player][race].raw_value / 2;
+        snapshot.supplyMax = std::min(st.supply_available[player][race].raw_value / 2, 200);
+    }
+}
+
+// Runs on the render queue in pipelined mode, on the caller's thread otherwise
+- (void)renderLatestSnapshot {
+    if (!_snapshots.acquire()) return;
+    const RenderSnapshot& snapshot = _snapshots.front();
+
+    // The renderer is only touched from here, so resizes are applied here too
+    if (_renderer.width != snapshot.viewportWidth || _renderer.height != snapshot.viewportHeight) {
+        [_renderer resizeWithWidth:snapshot.viewportWidth height:snapshot.viewportHeight];
+    }
+
+    // Hand fog tiles changed since the last render to the renderer
+    {
+        std::lock_guard<std::mutex> lock(_fogMutex);
+        if (_fogResetPending) {
+            if (_fogEnabled && !_fog.empty()) {
+                [_renderer resetFogWithTileWidth:_fog.tile_width() tileHeight:_fog.tile_height()];
+            } else {
+                [_renderer disableFog];
+            }
+            _fogResetPending = NO;
+        }
+        _fogDrainIndices.clear();
+        _fogDrainStates.clear();
+        _fog.drain([&](uint32_t index, uint8_t state) {
+            _fogDrainIndices.push_back(index);
+            _fogDrainStates.push_back(state);
+        });
+    }
+    if (!_fogDrainIndices.empty()) {
+        [_renderer updateFogTiles:_fogDrainIndices.data()
+                           states:_fogDrainStates.data()
+                            count:_fogDrainIndices.size()];
+    }
+
+    // Pass sprites to renderer (uint8_t mask can be safely cast to BOOL*)
+    [_renderer setSprites:snapshot.sprites.data()
+                    count:snapshot.sprites.size()
+             selectedMask:(const BOOL*)snapshot.selectedMask.data()];
+
+    // Render the snapshot using OpenBWRenderer
+    [_renderer renderWithCameraX:snapshot.cameraX cameraY:snapshot.cameraY
+                        mapWidth:snapshot.mapWidth mapHeight:snapshot.mapHeight
+                       zoomLevel:snapshot.zoomLevel];
+
+    // Upload the rendered framebuffer to Metal
+    MetalRenderer_UploadIndexedPixels(_renderer.framebuffer,
+                                      _renderer.width, _renderer.height,
+                                      _renderer.width);
+
+    // Notify callback
+    FrameUpdateCallback callback = self.onFrameUpdate;
+    if (callback) {
+        callback(snapshot.frame, snapshot.minerals, snapshot.gas, snapshot.supply, snapshot.supplyMax);
+    }
+}
+
+#pragma mark - Fog of War
+
+- (BOOL)fogOfWarEnabled {
+    return _fogEnabled;
+}
+
+- (void)setFogOfWarEnabled:(BOOL)enabled {
+    if (_fogEnabled == enabled) return;
+    _fogEnabled = enabled;
+    // Applied by the simulation thread, which is the only reader of fog state
+    _fogResetRequested = true;
+}
+
+// Start fog over for the current map; the next update marks every seen tile
+- (void)resetFog {
+    int tileWidth = 0;
+    int tileHeight = 0;
+    if (_fogEnabled && _stateHolder && _stateHolder->isInitialized) {
+        const bwgame::game_state* gameState = _stateHolder->getGameState();
+        if (gameState) {
+            tileWidth = (int)gameState->map_tile_width;
+            tileHeight = (int)gameState->map_tile_height;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_fogMutex);
+    _fog.reset(tileWidth, tileHeight);
+    _fogResetPending = YES;
+}
+
+// Simulation thread: diff the engine's per-tile vision bits for the current
+// player. A cleared bit in tile_t::visible/explored means seen by that player.
+- (void)updateFog {
+    if (_fogResetRequested.exchange(false)) {
+        [self resetFog];
+        std::lock_guard<std::mutex> lock(_minimapMutex);
+        _minimapNeedsTerrain = YES;
+    }
+    if (!_fogEnabled || !_stateHolder || !_stateHolder->isInitialized) return;
+
+    std::lock_guard<std::mutex> lock(_fogMutex);
+    auto& st = _stateHolder->getState();
+    size_t tileCount = (size_t)_fog.tile_width() * _fog.tile_height();
+    if (tileCount == 0 || st.tiles.size() < tileCount) return;
+
+    int player = _stateHolder->currentPlayer;
+    uint8_t mask = (player >= 0 && player < 8) ? (uint8_t)(1 << player) : 0;
+    const auto* tiles = st.tiles.data();
+    _fog.update([&](size_t i) {
+        if (!(tiles[i].visible & mask)) return openbw_ios::fog_state::visible;
+        if (!(tiles[i].explored & mask)) return openbw_ios::fog_state::explored;
+        return openbw_ios::fog_state::unexplored;
+    });
+}
+
+// Enemy units outside the current player's vision are not shown. Buildings
+// stay drawn (darkened by fog), as the player would remember them.
+- (BOOL)isUnitHiddenByFog:(const bwgame::unit_t*)u {
+    if (!_fogEnabled || _fog.empty() || !u || !u->sprite) return NO;
+    int player = _stateHolder->currentPlayer;
+    if (u->owner == player || u->owner < 0 || u->owner >= 8) return NO;
+    if (_stateHolder->player->funcs().ut_building(u)) return NO;
+    return _fog.state_at(u->sprite->position.x / 32, u->sprite->position.y / 32) != openbw_ios::fog_state::visible;
+}
+
+#pragma mark - Group Movement
+
+- (BOOL)groupMoveEnabled {
+    return _stateHolder ? _stateHolder->groupMoveEnabled : NO;
+}
+
+- (void)setGroupMoveEnabled:(BOOL)enabled {
+    if (_stateHolder) _stateHolder->groupMoveEnabled = enabled;
+}
+
+- (nullable GroupMoveBenchmarkResult*)benchmarkGroupMoveOnMap:(NSString*)mapPath
+                                                    unitCount:(int)unitCount
+                                                       frames:(int)frames {
+    if (!_assetsLoaded || !_stateHolder) {
+        NSLog(@"OpenBWGameRunner: Cannot benchmark - assets not loaded");
+        return nil;
+    }
+
+    std::string dataPath = _stateHolder->dataPath;
+    std::string map = [mapPath UTF8String];
+    unitCount = std::max(1, unitCount);
+    frames = std::max(1, frames);
+
+    OpenBWStateHolder::GroupMoveBenchmarkRun independent, shared;
+    if (!OpenBWStateHolder::runGroupMoveBenchmark(dataPath, map, unitCount, frames, false, independent) ||
+        !OpenBWStateHolder::runGroupMoveBenchmark(dataPath, map, unitCount, frames, true, shared)) {
+        NSLog(@"OpenBWGameRunner: Group move benchmark could not run on %@", mapPath);
+        return nil;
+    }
+
+    GroupMoveBenchmarkResult* result = [[GroupMoveBenchmarkResult alloc]
+        initWithMapName:mapPath.lastPathComponent
+              unitCount:unitCount
+                 frames:frames
+independentMilliseconds:independent.simMs
+     sharedMilliseconds:shared.simMs
+   corridorMilliseconds:shared.corridorMs
+independentWorstFrameMilliseconds:independent.worstFrameMs
+sharedWorstFrameMilliseconds:shared.worstFrameMs
+independentPathRequests:independent.pathRequests
+     sharedPathRequests:shared.pathRequests];
+    NSLog(@"OpenBWGameRunner: Group move benchmark on %@, %d units, %d frames: "
+          @"independent %.1f ms (%.3f ms/frame, worst %.2f ms, %d path requests), "
+          @"shared %.1f ms (%.3f ms/frame, worst %.2f ms, %d path requests, corridor %.2f ms), %.2fx",
+          result.mapName, unitCount, frames,
+          independent.simMs, independent.simMs / frames, independent.worstFrameMs, independent.pathRequests,
+          shared.simMs, shared.simMs / frames, shared.worstFrameMs, shared.pathRequests, shared.corridorMs,
+          result.speedup);
+    return result;
+}
+
+- (int)pipelineLatencyFrames {
+    return _pipelineLatencyFrames;
+}
+
+- (void)setPipelineLatencyFrames:(int)latencyFrames {
+    int clamped = std::max(0, std::min(1, latencyFrames));
+    if (clamped == _pipelineLatencyFrames) return;
+
+    // Let any in-flight render finish so only one thread consumes snapshots
+    [self drainRenderQueue];
+    _pipelineLatencyFrames = clamped;
+}
+
+- (void)drainRenderQueue {
+    // The last reference may be released by a render block; never sync onto ourselves
+    if (dispatch_get_specific(&kRenderQueueKey)) return;
+    dispatch_sync(_renderQueue, ^{});
+}
+
+#pragma mark - Replay Playback
+
+const double OpenBWReplaySpeedTurbo = 0;
+
+// Fastest fixed multiplier, and the time a turbo-speed tick may spend
+// simulating before it presents
+static constexpr double kReplayMaxSpeed = 64;
+static constexpr auto kReplayTurboTickBudget = std::chrono::milliseconds(12);
+
+- (void)tickReplay {
+    if (_stateHolder->replayFinished()) {
+        [self finishReplay];
+        return;
+    }
+
+    // Frames this tick, with fractional speeds carried over to later ticks
+    bool turbo = _replaySpeed == OpenBWReplaySpeedTurbo;
+    int frames = INT_MAX;
+    if (!turbo) {
+        _replayFrameCredit += _replaySpeed;
+        frames = (int)_replayFrameCredit;
+        _replayFrameCredit -= frames;
+        if (frames == 0) return;    // Slower than real time: the shown frame is unchanged
+    }
+
+    // Only the last frame of the tick is shown, so the ones before it are
+    // simulated without any render work, as in turbo mode
+    auto deadline = std::chrono::steady_clock::now() + kReplayTurboTickBudget;
+    for (int i = 0; i < frames && !_stateHolder->replayFinished(); ++i) {
+        [self stepSimulation];
+        if (turbo && std::chrono::steady_clock::now() >= deadline) break;
+    }
+    [self presentCurrentFrame];
+}
+
+- (void)finishReplay {
+    if (_replayFinishReported) return;
+    _replayFinishReported = YES;
+
+    auto& actions = _stateHolder->replayActions;
+    NSLog(@"OpenBWGameRunner: Replay finished at frame %d (%zu bytes of actions decoded, %zu buffered at most)%s",
+          _currentFrame, actions.decoded_bytes(), actions.buffered_bytes(),
+          actions.failed() ? ", action stream corrupt" : "");
+
+    if (self.onGameEvent) {
+        self.onGameEvent(@"replay_finished", @{@"frame": @(_currentFrame)});
+    }
+}
+
+- (BOOL)isPlayingReplay {
+    return _playingReplay;
+}
+
+- (int)replayEndFrame {
+    return _playingReplay ? (int)_stateHolder->replay->header().frame_count : 0;
+}
+
+- (double)replaySpeed {
+    return _replaySpeed;
+}
+
+- (void)setReplaySpeed:(double)replaySpeed {
+    _replaySpeed = replaySpeed > 0 ? std::min(replaySpeed, kReplayMaxSpeed) : OpenBWReplaySpeedTurbo;
+    _replayFrameCredit = 0;
+}
+
+- (nullable ReplaySeekStats*)seekReplayToFrame:(int)frame {
+    if (!_gameRunning || !_playingReplay) return nil;
+
+    int fromFrame = _currentFrame;
+    int targetFrame = std::max(0, std::min(frame, self.replayEndFrame));
+    auto start = std::chrono::steady_clock::now();
+
+    // Restore a keyframe unless simulating on from the current frame is shorter
+    int keyframeFrame = -1;
+    auto keyframe = _stateHolder->keyframes.find(targetFrame);
+    if (keyframe.snapshot && (targetFrame < _currentFrame || keyframe.frame > _currentFrame)) {
+        _stateHolder->restoreKeyframe(*keyframe.snapshot);
+        _currentFrame = _stateHolder->getState().current_frame;
+        keyframeFrame = keyframe.frame;
+        [self resetFog];
+    }
+
+    // Simulate without render work, then present the target frame once
+    int simulatedFrom = _currentFrame;
+    while (_currentFrame < targetFrame && !_stateHolder->replayFinished()) {
+        [self stepSimulation];
+    }
+    [self presentCurrentFrame];
+    _replayFinishReported = NO;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ReplaySeekStats* stats = [[ReplaySeekStats alloc] initWithFromFrame:fromFrame
+                                                            targetFrame:_currentFrame
+                                                          keyframeFrame:keyframeFrame
+                                                        framesSimulated:_currentFrame - simulatedFrom
+                                                         elapsedSeconds:elapsed];
+    _lastReplaySeekStats = stats;
+
+    auto keyframeStats = _stateHolder->keyframes.stats();
+    NSLog(@"OpenBWGameRunner: Seek %d -> %d in %.1f ms (keyframe %d, %d frames simulated; %zu keyframes, %.1f MB)",
+          fromFrame, _currentFrame, elapsed * 1000.0, keyframeFrame, stats.framesSimulated,
+          keyframeStats.keyframes, keyframeStats.bytes / (1024.0 * 1024.0));
+    return stats;
+}
+
+- (nullable ReplaySeekStats*)lastReplaySeekStats {
+    return _lastReplaySeekStats;
+}
+
+- (double)replayKeyframeInterval {
+    return _replayKeyframeInterval;
+}
+
+- (void)setReplayKeyframeInterval:(double)replayKeyframeInterval {
+    _replayKeyframeInterval = std::max(OpenBWStateHolder::kSecondsPerFrame, replayKeyframeInterval);
+}
+
+- (NSUInteger)replayKeyframeBudget {
+    return _replayKeyframeBudget;
+}
+
+- (void)setReplayKeyframeBudget:(NSUInteger)replayKeyframeBudget {
+    _replayKeyframeBudget = replayKeyframeBudget;
+    [self configureReplayKeyframes];
+}
+
+- (void)configureReplayKeyframes {
+    int intervalFrames = (int)(_replayKeyframeInterval / OpenBWStateHolder::kSecondsPerFrame);
+    _stateHolder->keyframes.configure(std::max(1, intervalFrames), (size_t)_replayKeyframeBudget);
+}
+
+- (int)replayKeyframeCount {
+    return (int)_stateHolder->keyframes.stats().keyframes;
+}
+
+- (NSUInteger)replayKeyframeBytes {
+    return (NSUInteger)_stateHolder->keyframes.stats().bytes;
+}
+
+#pragma mark - Replay Recording
+
+- (BOOL)isRecordingReplay {
+    return _stateHolder && _stateHolder->recorder.recording();
+}
+
+- (BOOL)saveReplayToPath:(NSString*)path error:(NSError**)error {
+    if (![self isRecordingReplay]) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:13
+                                     userInfo:@{NSLocalizedDescriptionKey: @"No game is being recorded"}];
+        }
+        return NO;
     }
 
-    // Pass sprites to renderer
-    if (!_spriteRenderInfos.empty()) {
-        // _selectedMask is uint8_t array which can be safely cast to BOOL*
-        [_renderer setSprites:_spriteRenderInfos.data()
-                        count:_spriteRenderInfos.size()
-                 selectedMask:(const BOOL*)_selectedMask.data()];
+    if (!_stateHolder->saveRecording([path UTF8String])) {
+        if (error) {
+            NSString* reason = [NSString stringWithFormat:@"Could not write replay to %@", path];
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:14
+                                     userInfo:@{NSLocalizedDescriptionKey: reason}];
+        }
+        return NO;
     }
+    return YES;
 }
 
-- (void)buildSpriteRenderInfo:(bwgame::sprite_t*)sprite
-                  globalState:(const bwgame::global_state&)global_st
-                        state:(bwgame::state&)st {
-    if (!sprite) return;
+// Final write of the recording when the game stops, in place of the autosave
+- (void)finishRecording {
+    if (![self isRecordingReplay] || !_replayAutosavePath) return;
+    auto stats = _stateHolder->recorder.stats();
+    if (_stateHolder->saveRecording([_replayAutosavePath UTF8String])) {
+        NSLog(@"OpenBWGameRunner: Replay saved to %@ (%zu actions, %zu bytes compressed on the recorder thread in %.1f ms)",
+              _replayAutosavePath, stats.actions, stats.compressed_bytes, stats.compress_ms);
+    } else {
+        NSLog(@"OpenBWGameRunner: Could not save replay to %@", _replayAutosavePath);
+    }
+}
 
-    RenderSpriteInfo spriteInfo = {};
+#pragma mark - State Images
 
-    // Find the unit that owns this sprite (if any)
-    bwgame::unit_t* ownerUnit = nullptr;
-    for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
-        if (!u) continue;
-        if (u->sprite == sprite) {
-            ownerUnit = u;
-            break;
+- (BOOL)saveGameStateToPath:(NSString*)path error:(NSError**)error {
+    std::string reason = "No game is running";
+    auto start = std::chrono::steady_clock::now();
+    if (!_gameRunning || !_stateHolder->saveState([path UTF8String], reason)) {
+        if (error) {
+            NSString* message = [NSString stringWithFormat:@"Could not save game state: %s", reason.c_str()];
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:15
+                                     userInfo:@{NSLocalizedDescriptionKey: message}];
         }
+        return NO;
     }
+    NSLog(@"OpenBWGameRunner: Saved game state at frame %d to %@ in %.2f ms", _currentFrame, path,
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return YES;
+}
 
-    // Start index for this sprite's images
-    size_t imageStartIndex = _imageRenderInfos.size();
+- (BOOL)loadGameStateFromPath:(NSString*)path error:(NSError**)error {
+    std::string reason = _playingReplay ? "Game states cannot be loaded into a replay" : "No game is running";
+    bool stateReplaced = false;
+    auto start = std::chrono::steady_clock::now();
+    if (!_gameRunning || _playingReplay || !_stateHolder->loadState([path UTF8String], reason, stateReplaced)) {
+        if (stateReplaced) {
+            NSLog(@"OpenBWGameRunner: Stopping the game - state image %@ failed partway: %s", path, reason.c_str());
+            [self stop];
+        }
+        if (error) {
+            NSString* message = [NSString stringWithFormat:@"Could not load game state: %s", reason.c_str()];
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:16
+                                     userInfo:@{NSLocalizedDescriptionKey: message}];
+        }
+        return NO;
+    }
+    _currentFrame = _stateHolder->getState().current_frame;
+    [self resetFog];
+    [self presentCurrentFrame];
+    NSLog(@"OpenBWGameRunner: Loaded game state at frame %d from %@ in %.2f ms", _currentFrame, path,
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return YES;
+}
 
-    // Collect images for this sprite (in reverse order for proper z-ordering)
-    for (bwgame::image_t* image : bwgame::ptr(bwgame::reverse(sprite->images))) {
-        if (!image) continue;
-        if (image->flags & bwgame::image_t::flag_hidden) continue;
-        if (!image->grp) continue;
-        if (image->frame_index >= image->grp->frames.size()) continue;
+#pragma mark - Rewind
 
-        RenderImageInfo imgInfo = {};
+- (BOOL)rewindEnabled {
+    return _stateHolder->rewindEnabled;
+}
 
-        const auto& frame = image->grp->frames.at(image->frame_index);
-        imgInfo.grpFrame = &frame;
+// The settings below are requests: the simulation thread applies them at the
+// start of its next frame, and the buffer is never touched from here
+- (void)setRewindEnabled:(BOOL)rewindEnabled {
+    _stateHolder->rewindEnabled = rewindEnabled;
+}
 
-        // Calculate screen position
-        // Image position = sprite position + image offset - grp center + frame offset
-        int mapX = sprite->position.x + image->offset.x - (int)image->grp->width/2 + (int)frame.offset.x;
-        int mapY = sprite->position.y + image->offset.y - (int)image->grp->height/2 + (int)frame.offset.y;
+- (double)rewindWindow {
+    return _stateHolder->requestedRewindSettings().window_frames * OpenBWStateHolder::kSecondsPerFrame;
+}
 
-        // Convert to screen coordinates with zoom applied
-        float zoomedX = (mapX - _cameraX) * _zoomLevel;
-        float zoomedY = (mapY - _cameraY) * _zoomLevel;
-        imgInfo.screenX = (int)(zoomedX + _viewportWidth/2);
-        imgInfo.screenY = (int)(zoomedY + _viewportHeight/2);
-        imgInfo.frameWidth = (int)frame.size.x;
-        imgInfo.frameHeight = (int)frame.size.y;
-        imgInfo.flipped = (image->flags & bwgame::image_t::flag_horizontally_flipped) != 0;
-        imgInfo.modifier = image->modifier;
+- (void)setRewindWindow:(double)rewindWindow {
+    auto settings = _stateHolder->requestedRewindSettings();
+    settings.window_frames = std::max(1, (int)(rewindWindow / OpenBWStateHolder::kSecondsPerFrame));
+    _stateHolder->requestRewindSettings(settings);
+}
 
-        // Get player color index
-        int colorIndex = 0;
-        if (sprite->owner >= 0 && sprite->owner < (int)st.players.size()) {
-            colorIndex = st.players[sprite->owner].color;
-        }
-        imgInfo.colorIndex = std::max(0, std::min(15, colorIndex));
+- (NSUInteger)rewindBudget {
+    return (NSUInteger)_stateHolder->requestedRewindSettings().budget_bytes;
+}
 
-        _imageRenderInfos.push_back(imgInfo);
-    }
+- (void)setRewindBudget:(NSUInteger)rewindBudget {
+    auto settings = _stateHolder->requestedRewindSettings();
+    settings.budget_bytes = rewindBudget;
+    _stateHolder->requestRewindSettings(settings);
+}
 
-    // Set up sprite info
-    spriteInfo.images = _imageRenderInfos.data() + imageStartIndex;
-    spriteInfo.imageCount = (int)(_imageRenderInfos.size() - imageStartIndex);
-    spriteInfo.owner = sprite->owner;
+- (double)rewindCaptureBudget {
+    return _stateHolder->requestedRewindSettings().capture_fraction;
+}
 
-    // Screen center for selection circle with zoom applied
-    float zoomedCenterX = (sprite->position.x - _cameraX) * _zoomLevel;
-    float zoomedCenterY = (sprite->position.y - _cameraY) * _zoomLevel;
-    spriteInfo.screenCenterX = (int)(zoomedCenterX + _viewportWidth/2);
-    spriteInfo.screenCenterY = (int)(zoomedCenterY + _viewportHeight/2);
+- (void)setRewindCaptureBudget:(double)rewindCaptureBudget {
+    auto settings = _stateHolder->requestedRewindSettings();
+    settings.capture_fraction = std::max(0.001, rewindCaptureBudget);
+    _stateHolder->requestRewindSettings(settings);
+}
 
-    // Selection circle info from sprite type
-    if (sprite->sprite_type) {
-        spriteInfo.selectionCircleIndex = sprite->sprite_type->selection_circle;
-        spriteInfo.selectionCircleVPos = sprite->sprite_type->selection_circle_vpos;
-        spriteInfo.healthBarWidth = sprite->sprite_type->health_bar_size;
-    } else {
-        spriteInfo.selectionCircleIndex = -1;
-        spriteInfo.selectionCircleVPos = 0;
-        spriteInfo.healthBarWidth = 0;
-    }
+- (int)rewindOldestFrame {
+    return _stateHolder->publishedRewindStats().oldest_frame;
+}
 
-    // HP/Shield/Energy from owning unit
-    if (ownerUnit && ownerUnit->unit_type) {
-        spriteInfo.hp = ownerUnit->hp.integer_part();
-        spriteInfo.maxHp = ownerUnit->unit_type->hitpoints.integer_part();
-        spriteInfo.shields = ownerUnit->shield_points.integer_part();
-        // Shield max - check if unit type has shields
-        spriteInfo.maxShields = 0; // Will be set properly for Protoss
-        spriteInfo.energy = ownerUnit->energy.integer_part();
-        spriteInfo.maxEnergy = 200; // Default
-        spriteInfo.invincible = (ownerUnit->status_flags & 0x4000000) != 0; // Invincible flag
-    } else {
-        spriteInfo.hp = 0;
-        spriteInfo.maxHp = 0;
-        spriteInfo.shields = 0;
-        spriteInfo.maxShields = 0;
-        spriteInfo.energy = 0;
-        spriteInfo.maxEnergy = 0;
-        spriteInfo.invincible = false;
-    }
+- (int)rewindSnapshotCount {
+    return (int)_stateHolder->publishedRewindStats().snapshots;
+}
 
-    _spriteRenderInfos.push_back(spriteInfo);
+- (NSUInteger)rewindBytes {
+    return (NSUInteger)_stateHolder->publishedRewindStats().bytes;
+}
 
-    // Check if this sprite belongs to a selected unit
-    uint8_t isSelected = 0;
-    if (ownerUnit) {
-        for (bwgame::unit_t* selectedUnit : _stateHolder->selectedUnits) {
-            if (selectedUnit == ownerUnit) {
-                isSelected = 1;
-                break;
-            }
-        }
-    }
-    _selectedMask.push_back(isSelected);
+- (double)rewindCaptureMilliseconds {
+    return _stateHolder->publishedRewindStats().capture_ms;
 }
 
-- (void)setupSelectionCircleGRPs {
-    if (!_stateHolder || !_stateHolder->isInitialized) return;
+- (int)rewindCaptureInterval {
+    return _stateHolder->publishedRewindStats().interval;
+}
 
-    auto& st = _stateHolder->getState();
-    auto& global_st = *st.global;
+- (int)rewindWantedCaptureInterval {
+    return _stateHolder->publishedRewindStats().wanted_interval;
+}
 
-    // Selection circles are ImageTypes starting from IMAGEID_Selection_Circle_22pixels (561)
-    // There are typically 10 different sizes
-    std::vector<const void*> grps;
+- (NSUInteger)rewindCaptureOverruns {
+    return (NSUInteger)_stateHolder->publishedRewindStats().overruns;
+}
 
-    for (int i = 0; i < 10; ++i) {
-        int imageId = 561 + i;  // IMAGEID_Selection_Circle_22pixels + i
-        if (imageId < (int)global_st.image_grp.size()) {
-            grps.push_back(global_st.image_grp[imageId]);
-        } else {
-            grps.push_back(nullptr);
+- (BOOL)rewindToFrame:(int)frame error:(NSError**)error {
+    std::string reason = _playingReplay ? "Replays seek instead of rewinding" : "No game is running";
+    bool stateReplaced = false;
+    int fromFrame = _currentFrame;
+    auto start = std::chrono::steady_clock::now();
+    if (!_gameRunning || _playingReplay || !_stateHolder->rewindTo(frame, reason, stateReplaced)) {
+        if (stateReplaced) {
+            NSLog(@"OpenBWGameRunner: Stopping the game - rewind to frame %d failed partway: %s", frame, reason.c_str());
+            [self stop];
         }
+        if (error) {
+            NSString* message = [NSString stringWithFormat:@"Could not rewind: %s", reason.c_str()];
+            *error = [NSError errorWithDomain:@"OpenBW"
+                                         code:17
+                                     userInfo:@{NSLocalizedDescriptionKey: message}];
+        }
+        return NO;
     }
-
-    [_renderer setSelectionCircleGRPs:grps.data() count:grps.size()];
+    _currentFrame = _stateHolder->getState().current_frame;
+    [self resetFog];
+    [self presentCurrentFrame];
+
+    auto stats = _stateHolder->publishedRewindStats();
+    NSLog(@"OpenBWGameRunner: Rewound %d -> %d in %.1f ms (%zu snapshots, %.1f MB, %.2f ms per capture every %d frames, "
+          @"%d wanted, %zu overruns)",
+          fromFrame, _currentFrame, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+          stats.snapshots, stats.bytes / (1024.0 * 1024.0), stats.capture_ms, stats.interval, stats.wanted_interval,
+          stats.overruns);
+    return YES;
 }
 
-- (void)tick {
-    if (!_gameRunning || _paused) return;
+#pragma mark - Game Thread Requests
 
-    _currentFrame++;
+- (void)enqueueGameThreadTask:(dispatch_block_t)task {
+    {
+        std::lock_guard<std::mutex> lock(_gameTaskMutex);
+        _gameTasks.push_back(task);
+    }
+    _gameTasksPending = true;
+}
 
-    // Advance OpenBW game state by one frame (if initialized)
-    if (_stateHolder && _stateHolder->isInitialized) {
-        try {
-            _stateHolder->nextFrame();
-        }
-        catch (const std::exception& e) {
-            NSLog(@"OpenBWGameRunner: Error in game tick: %s", e.what());
-        }
-        catch (...) {
-            // Ignore errors during tick for now
-        }
+// Tick thread
+- (void)runGameThreadTasks {
+    if (!_gameTasksPending.exchange(false)) return;
+    std::vector<dispatch_block_t> tasks;
+    {
+        std::lock_guard<std::mutex> lock(_gameTaskMutex);
+        tasks.swap(_gameTasks);
+    }
+    for (dispatch_block_t task : tasks) task();
+}
 
-        // Collect visible sprites and pass to renderer
-        [self collectVisibleSprites];
+static void completeOnMain(void (^completion)(NSError* _Nullable), BOOL ok, NSError* error) {
+    if (!completion) return;
+    if (!ok && !error) {
+        error = [NSError errorWithDomain:@"OpenBW"
+                                    code:18
+                                userInfo:@{NSLocalizedDescriptionKey: @"The game runner went away"}];
     }
+    NSError* result = ok ? nil : error;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        completion(result);
+    });
+}
 
-    // Render the current frame using OpenBWRenderer
-    [_renderer renderWithCameraX:_cameraX cameraY:_cameraY
-                        mapWidth:_mapWidth mapHeight:_mapHeight
-                       zoomLevel:_zoomLevel];
+- (void)seekReplayToFrame:(int)frame completion:(void (^)(ReplaySeekStats* _Nullable))completion {
+    __weak OpenBWGameRunner* weakSelf = self;
+    [self enqueueGameThreadTask:^{
+        ReplaySeekStats* stats = [weakSelf seekReplayToFrame:frame];
+        if (!completion) return;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(stats);
+        });
+    }];
+}
 
-    // Upload the rendered framebuffer to Metal
-    MetalRenderer_UploadIndexedPixels(_renderer.framebuffer,
-                                      _renderer.width, _renderer.height,
-                                      _renderer.width);
+- (void)saveGameStateToPath:(NSString*)path completion:(void (^)(NSError* _Nullable))completion {
+    NSString* savePath = [path copy];
+    __weak OpenBWGameRunner* weakSelf = self;
+    [self enqueueGameThreadTask:^{
+        NSError* error = nil;
+        BOOL ok = [weakSelf saveGameStateToPath:savePath error:&error];
+        completeOnMain(completion, ok, error);
+    }];
+}
 
-    // Get actual resource values from game state if available
-    int minerals = 50;
-    int gas = 0;
-    int supply = 4;
-    int supplyMax = 10;
+- (void)loadGameStateFromPath:(NSString*)path completion:(void (^)(NSError* _Nullable))completion {
+    NSString* loadPath = [path copy];
+    __weak OpenBWGameRunner* weakSelf = self;
+    [self enqueueGameThreadTask:^{
+        NSError* error = nil;
+        BOOL ok = [weakSelf loadGameStateFromPath:loadPath error:&error];
+        completeOnMain(completion, ok, error);
+    }];
+}
 
-    if (_stateHolder && _stateHolder->isInitialized) {
-        auto& st = _stateHolder->getState();
-        int player = _stateHolder->currentPlayer;
+- (void)rewindToFrame:(int)frame completion:(void (^)(NSError* _Nullable))completion {
+    __weak OpenBWGameRunner* weakSelf = self;
+    [self enqueueGameThreadTask:^{
+        NSError* error = nil;
+        BOOL ok = [weakSelf rewindToFrame:frame error:&error];
+        completeOnMain(completion, ok, error);
+    }];
+}
 
-        if (player >= 0 && player < 12) {
-            minerals = st.current_minerals[player];
-            gas = st.current_gas[player];
+#pragma mark - Turbo Mode
 
-            // Get player's race to index supply correctly (0=Terran, 1=Protoss, 2=Zerg)
-            int race = 0;  // Default to Terran
-            if (st.players.size() > (size_t)player) {
-                race = (int)st.players[player].race;
-                if (race < 0 || race > 2) race = 0;
-            }
+- (nullable TurboRunStats*)advanceFrames:(int)frameCount {
+    if (frameCount <= 0) return nil;
+    return [self advanceToFrame:_currentFrame + frameCount];
+}
 
-            // Supply is stored as fp1 fixed-point, divide by 2 to get actual value
-            supply = st.supply_used[player][race].raw_value / 2;
-            supplyMax = std::min(st.supply_available[player][race].raw_value / 2, 200);
-        }
+- (nullable TurboRunStats*)advanceToFrame:(int)targetFrame {
+    if (targetFrame <= _currentFrame) return nil;
+
+    TurboRunStats* stats = [self runTurboToFrame:targetFrame];
+    if (stats) {
+        NSLog(@"OpenBWGameRunner: Turbo advanced %d frames in %.3f s (%.0f frames/sec)",
+              stats.framesAdvanced, stats.elapsedSeconds, stats.framesPerSecond);
     }
+    return stats;
+}
 
-    // Notify callback
-    if (self.onFrameUpdate) {
-        self.onFrameUpdate(_currentFrame, minerals, gas, supply, supplyMax);
+- (nullable TurboRunStats*)runTurboToFrame:(int)targetFrame {
+    if (!_gameRunning || _paused) return nil;
+
+    int startFrame = _currentFrame;
+    auto start = std::chrono::steady_clock::now();
+
+    // Pure simulation: no sprite collection, rasterization, Metal upload or callbacks
+    while (_currentFrame < targetFrame && _gameRunning) {
+        [self stepSimulation];
     }
+
+    auto end = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(end - start).count();
+
+    // Rebuild render state once for the frame that will actually be shown
+    [self presentCurrentFrame];
+
+    TurboRunStats* stats = [[TurboRunStats alloc] initWithStartFrame:startFrame
+                                                             endFrame:_currentFrame
+                                                       elapsedSeconds:elapsed];
+    _lastTurboStats = stats;
+    return stats;
 }
 
 - (void)renderWithEncoder:(id<MTLRenderCommandEncoder>)encoder {
@@ -1865,9 +3726,15 @@ static NSString* getUnitTypeName(int typeId) {
 
 - (void)stop {
     _gameRunning = NO;
+    _playingReplay = NO;
+
+    // The render queue may still reference GRP data owned by the game state
+    [self drainRenderQueue];
+    [self finishRecording];
 
     if (_stateHolder) {
         _stateHolder->reset();
+        _stateHolder->prewarmAllowed = true;
     }
 
     if (self.onGameEvent) {
@@ -1900,10 +3767,8 @@ static NSString* getUnitTypeName(int typeId) {
     _viewportHeight = (int)height;
     NSLog(@"OpenBW: Viewport updated to %d x %d", _viewportWidth, _viewportHeight);
 
-    // Also update the renderer if it exists
-    if (_renderer) {
-        [_renderer resizeWithWidth:_viewportWidth height:_viewportHeight];
-    }
+    // The renderer picks up the new size with the next snapshot, on the
+    // thread that rasterizes it
 }
 
 - (float)viewportWidth {
@@ -1949,7 +3814,7 @@ static NSString* getUnitTypeName(int typeId) {
     [self screenToWorld:CGPointMake(x, y) worldX:&worldX worldY:&worldY];
 
     // Find and select unit at position
-    bwgame::unit_t* unit = _stateHolder->findUnitAtPosition(worldX, worldY);
+    bwgame::unit_t* unit = _stateHolder->findUnitAtPosition(worldX, worldY, _stateHolder->currentPlayer);
     _stateHolder->selectUnit(unit);
 
     if (unit) {
@@ -1970,7 +3835,7 @@ static NSString* getUnitTypeName(int typeId) {
     [self screenToWorld:bottomRight worldX:&worldX2 worldY:&worldY2];
 
     // Find and select all units in rect
-    auto units = _stateHolder->findUnitsInRect(worldX1, worldY1, worldX2, worldY2);
+    auto units = _stateHolder->findUnitsInRect(worldX1, worldY1, worldX2, worldY2, _stateHolder->currentPlayer);
     _stateHolder->selectUnits(units);
 
     NSLog(@"OpenBWGameRunner: Box selected %zu units in world rect (%.0f, %.0f) to (%.0f, %.0f)",
@@ -2018,7 +3883,7 @@ static NSString* getUnitTypeName(int typeId) {
         }
 
         SelectedUnitInfo* info = [[SelectedUnitInfo alloc]
-            initWithId:(int)(size_t)u
+            initWithId:_stateHolder->handleForUnit(u).to_int()
                 typeId:typeId
               typeName:typeName
                  owner:u->owner
@@ -2069,16 +3934,10 @@ static NSString* getUnitTypeName(int typeId) {
     if (!_stateHolder || !_stateHolder->isInitialized) return;
 
     if (rightClick) {
-        // Right-click: smart command (move or attack based on target)
-        // Check if there's an enemy unit at the position
+        // Right-click: smart command; the game picks attack, follow, gather
+        // or move based on the unit under the cursor
         bwgame::unit_t* targetUnit = _stateHolder->findUnitAtPosition(worldPos.x, worldPos.y);
-        if (targetUnit && targetUnit->owner != _stateHolder->currentPlayer) {
-            // Attack the enemy unit
-            _stateHolder->attackMoveTo(worldPos.x, worldPos.y);
-        } else {
-            // Move to position
-            _stateHolder->moveSelectedTo(worldPos.x, worldPos.y);
-        }
+        _stateHolder->rightClickSelected(worldPos.x, worldPos.y, targetUnit);
     } else {
         // Left-click with pending command
         _stateHolder->moveSelectedTo(worldPos.x, worldPos.y);
@@ -2200,6 +4059,11 @@ static NSString* getUnitTypeName(int typeId) {
     _stateHolder->useAbilityOnUnit(abilityId, target);
 }
 
+- (BOOL)isUnitAlive:(int)unitId {
+    if (!_stateHolder || !_stateHolder->isInitialized) return NO;
+    return _stateHolder->findUnitById(unitId) != nullptr;
+}
+
 #pragma mark - Control Groups
 
 - (void)assignControlGroup:(int)group {
@@ -2263,6 +4127,18 @@ static NSString* getUnitTypeName(int typeId) {
     return _gameRunning;
 }
 
+- (int)turboFramesPerTick {
+    return _turboFramesPerTick;
+}
+
+- (void)setTurboFramesPerTick:(int)framesPerTick {
+    _turboFramesPerTick = std::max(1, framesPerTick);
+}
+
+- (nullable TurboRunStats*)lastTurboStats {
+    return _lastTurboStats;
+}
+
 #pragma mark - Minimap Support
 
 - (CGSize)minimapSize {
@@ -2279,32 +4155,9 @@ static NSString* getUnitTypeName(int typeId) {
     return CGSizeMake(mmWidth, mmHeight);
 }
 
-- (uint8_t*)getMinimapRGBA:(int*)outWidth height:(int*)outHeight {
-    CGSize mmSize = [self minimapSize];
-    int mmWidth = (int)mmSize.width;
-    int mmHeight = (int)mmSize.height;
-
-    if (outWidth) *outWidth = mmWidth;
-    if (outHeight) *outHeight = mmHeight;
-
-    // Allocate RGBA buffer
-    uint8_t* pixels = (uint8_t*)malloc(mmWidth * mmHeight * 4);
-    if (!pixels) return NULL;
-
-    // Map tile dimensions
-    int mapTileWidth = _mapWidth / 32;
-    int mapTileHeight = _mapHeight / 32;
-
-    // Get tileset index for terrain colors
-    int tilesetIndex = 0;
-    if (_stateHolder && _stateHolder->isInitialized) {
-        const bwgame::game_state* gameState = _stateHolder->getGameState();
-        if (gameState) {
-            tilesetIndex = (int)gameState->tileset_index;
-        }
-    }
-
-    // Base terrain colors by tileset
+// Approximate terrain color for a megatile, by tileset (used when the
+// renderer has no megatile color table, e.g. tileset data failed to load)
+static uint32_t minimapTerrainColor(int tilesetIndex, int megatile) {
     // 0=Badlands, 1=Platform, 2=Installation, 3=Ashworld, 4=Jungle, 5=Desert, 6=Ice, 7=Twilight
     struct TilesetColors {
         uint8_t groundR, groundG, groundB;
@@ -2326,150 +4179,214 @@ static NSString* getUnitTypeName(int typeId) {
     int colorIdx = (tilesetIndex >= 0 && tilesetIndex < 8) ? tilesetIndex : 0;
     const TilesetColors& colors = tilesetColors[colorIdx];
 
-    // Fill terrain
-    for (int y = 0; y < mmHeight; y++) {
-        for (int x = 0; x < mmWidth; x++) {
-            // Map minimap pixel to tile
-            int tileX = (x * mapTileWidth) / mmWidth;
-            int tileY = (y * mapTileHeight) / mmHeight;
-
-            // Get terrain info from tile data if available
-            uint8_t r = colors.groundR;
-            uint8_t g = colors.groundG;
-            uint8_t b = colors.groundB;
-
-            if (_stateHolder && _stateHolder->isInitialized) {
-                auto& st = _stateHolder->getState();
-                int tileIndex = tileY * mapTileWidth + tileX;
-
-                if (tileIndex >= 0 && tileIndex < (int)st.tiles_mega_tile_index.size()) {
-                    uint16_t megatile = st.tiles_mega_tile_index[tileIndex];
-
-                    // Use megatile index to vary color slightly
-                    // Low megatiles = ground, high = elevated/special
-                    if (megatile > 200) {
-                        r = colors.highR;
-                        g = colors.highG;
-                        b = colors.highB;
-                    } else if (megatile < 50) {
-                        r = colors.waterR;
-                        g = colors.waterG;
-                        b = colors.waterB;
-                    }
+    int r = colors.groundR;
+    int g = colors.groundG;
+    int b = colors.groundB;
+    if (megatile < 0) return openbw_ios::minimap_rgba(r, g, b);
+
+    // Low megatiles = ground, high = elevated/special
+    if (megatile > 200) {
+        r = colors.highR;
+        g = colors.highG;
+        b = colors.highB;
+    } else if (megatile < 50) {
+        r = colors.waterR;
+        g = colors.waterG;
+        b = colors.waterB;
+    }
 
-                    // Add some variation based on megatile
-                    int variation = (megatile % 20) - 10;
-                    r = (uint8_t)MAX(0, MIN(255, (int)r + variation));
-                    g = (uint8_t)MAX(0, MIN(255, (int)g + variation));
-                    b = (uint8_t)MAX(0, MIN(255, (int)b + variation));
-                }
-            }
+    // Add some variation based on megatile
+    int variation = (megatile % 20) - 10;
+    return openbw_ios::minimap_rgba((uint8_t)MAX(0, MIN(255, r + variation)),
+                                    (uint8_t)MAX(0, MIN(255, g + variation)),
+                                    (uint8_t)MAX(0, MIN(255, b + variation)));
+}
 
-            int idx = (y * mmWidth + x) * 4;
-            pixels[idx + 0] = r;
-            pixels[idx + 1] = g;
-            pixels[idx + 2] = b;
-            pixels[idx + 3] = 255;
-        }
+static uint32_t minimapPlayerColor(int owner) {
+    switch (owner) {
+        case 0: return openbw_ios::minimap_rgba(255, 0, 0);       // Red
+        case 1: return openbw_ios::minimap_rgba(0, 0, 255);       // Blue
+        case 2: return openbw_ios::minimap_rgba(0, 255, 255);     // Teal
+        case 3: return openbw_ios::minimap_rgba(128, 0, 128);     // Purple
+        case 4: return openbw_ios::minimap_rgba(255, 165, 0);     // Orange
+        case 5: return openbw_ios::minimap_rgba(139, 69, 19);     // Brown
+        case 6: return openbw_ios::minimap_rgba(255, 255, 255);   // White
+        case 7: return openbw_ios::minimap_rgba(255, 255, 0);     // Yellow
+        default: return openbw_ios::minimap_rgba(128, 128, 128);  // Gray (neutral)
     }
+}
 
-    // Draw units as colored dots
-    if (_stateHolder && _stateHolder->isInitialized) {
-        auto units = _stateHolder->getVisibleUnits();
-
-        for (const auto& unit : units) {
-            // Convert world position to minimap pixel
-            int mmX = (int)((unit.x / _mapWidth) * mmWidth);
-            int mmY = (int)((unit.y / _mapHeight) * mmHeight);
-
-            // Clamp to minimap bounds
-            mmX = MAX(0, MIN(mmWidth - 1, mmX));
-            mmY = MAX(0, MIN(mmHeight - 1, mmY));
-
-            // Color based on owner
-            uint8_t unitR, unitG, unitB;
-            switch (unit.owner) {
-                case 0: unitR = 255; unitG = 0; unitB = 0; break;     // Red
-                case 1: unitR = 0; unitG = 0; unitB = 255; break;     // Blue
-                case 2: unitR = 0; unitG = 255; unitB = 255; break;   // Teal
-                case 3: unitR = 128; unitG = 0; unitB = 128; break;   // Purple
-                case 4: unitR = 255; unitG = 165; unitB = 0; break;   // Orange
-                case 5: unitR = 139; unitG = 69; unitB = 19; break;   // Brown
-                case 6: unitR = 255; unitG = 255; unitB = 255; break; // White
-                case 7: unitR = 255; unitG = 255; unitB = 0; break;   // Yellow
-                default: unitR = 128; unitG = 128; unitB = 128; break; // Gray (neutral)
-            }
-
-            // Draw 2x2 dot for visibility
-            for (int dy = 0; dy < 2; dy++) {
-                for (int dx = 0; dx < 2; dx++) {
-                    int px = mmX + dx;
-                    int py = mmY + dy;
-                    if (px >= 0 && px < mmWidth && py >= 0 && py < mmHeight) {
-                        int idx = (py * mmWidth + px) * 4;
-                        pixels[idx + 0] = unitR;
-                        pixels[idx + 1] = unitG;
-                        pixels[idx + 2] = unitB;
-                        pixels[idx + 3] = 255;
+// Simulation thread, once per presented frame while the minimap is in use.
+// Terrain is rebuilt only after a map load; dots and the camera outline are
+// updated in place, so an idle frame costs one pass over the visible units.
+- (void)updateMinimap {
+    if (!_minimapActive) return;
+
+    CGSize mmSize = [self minimapSize];
+    int mmWidth = (int)mmSize.width;
+    int mmHeight = (int)mmSize.height;
+    int mapTileWidth = MAX(1, _mapWidth / 32);
+    int mapTileHeight = MAX(1, _mapHeight / 32);
+    bool haveState = _stateHolder && _stateHolder->isInitialized;
+
+    std::lock_guard<std::mutex> lock(_minimapMutex);
+
+    if (_minimapNeedsTerrain || _minimap.width() != mmWidth || _minimap.height() != mmHeight) {
+        _minimap.reset(mmWidth, mmHeight, mapTileWidth, mapTileHeight);
+
+        int tilesetIndex = 0;
+        const uint16_t* megatiles = nullptr;
+        size_t megatileCount = 0;
+        if (haveState) {
+            const bwgame::game_state* gameState = _stateHolder->getGameState();
+            if (gameState) tilesetIndex = (int)gameState->tileset_index;
+            auto& st = _stateHolder->getState();
+            megatiles = st.tiles_mega_tile_index.data();
+            megatileCount = st.tiles_mega_tile_index.size();
+        }
+
+        // Current fog for every tile, before the terrain is shaded
+        {
+            std::lock_guard<std::mutex> fogLock(_fogMutex);
+            if (_fogEnabled && !_fog.empty()) {
+                for (int tileY = 0; tileY < _fog.tile_height(); tileY++) {
+                    for (int tileX = 0; tileX < _fog.tile_width(); tileX++) {
+                        _minimap.set_tile_fog(tileX, tileY, _fog.state_at(tileX, tileY));
                     }
                 }
             }
         }
+
+        NSUInteger colorCount = 0;
+        const uint32_t* megatileColors = [_renderer megatileColorsForTileset:tilesetIndex count:&colorCount];
+
+        _minimap.build_terrain([&](int tileX, int tileY) {
+            size_t tileIndex = (size_t)tileY * mapTileWidth + tileX;
+            int megatile = tileIndex < megatileCount ? (int)megatiles[tileIndex] : -1;
+            if (megatileColors && megatile >= 0 && (NSUInteger)megatile < colorCount) {
+                return megatileColors[megatile];
+            }
+            return minimapTerrainColor(tilesetIndex, megatile);
+        });
+        _minimapNeedsTerrain = NO;
+    } else if (_fogEnabled) {
+        // Only tiles whose vision changed this frame
+        std::lock_guard<std::mutex> fogLock(_fogMutex);
+        int fogWidth = _fog.tile_width();
+        for (uint32_t index : _fog.changed()) {
+            _minimap.set_tile_fog((int)(index % fogWidth), (int)(index / fogWidth), _fog.state(index));
+        }
+    }
+
+    if (haveState && _mapWidth > 0 && _mapHeight > 0) {
+        auto& st = _stateHolder->getState();
+        _minimap.begin_units();
+        for (bwgame::unit_t* u : bwgame::ptr(st.visible_units)) {
+            if (!u->sprite) continue;
+            if ([self isUnitHiddenByFog:u]) continue;
+            int mmX = u->sprite->position.x * mmWidth / _mapWidth;
+            int mmY = u->sprite->position.y * mmHeight / _mapHeight;
+            _minimap.set_unit(_stateHolder->handleForUnit(u).raw, mmX, mmY, minimapPlayerColor(u->owner));
+        }
+        _minimap.end_units();
+    }
+
+    if (_mapWidth > 0 && _mapHeight > 0) {
+        float viewportWorldWidth = _viewportWidth / _zoomLevel;
+        float viewportWorldHeight = _viewportHeight / _zoomLevel;
+        _minimap.set_camera((int)(((_cameraX - viewportWorldWidth/2) / _mapWidth) * mmWidth),
+                            (int)(((_cameraY - viewportWorldHeight/2) / _mapHeight) * mmHeight),
+                            (int)(((_cameraX + viewportWorldWidth/2) / _mapWidth) * mmWidth),
+                            (int)(((_cameraY + viewportWorldHeight/2) / _mapHeight) * mmHeight));
     }
 
-    // Draw camera viewport rectangle (white outline)
-    float viewportWorldWidth = _viewportWidth / _zoomLevel;
-    float viewportWorldHeight = _viewportHeight / _zoomLevel;
+    _minimapVersion = _minimap.version();
+}
 
-    int camLeft = (int)(((_cameraX - viewportWorldWidth/2) / _mapWidth) * mmWidth);
-    int camTop = (int)(((_cameraY - viewportWorldHeight/2) / _mapHeight) * mmHeight);
-    int camRight = (int)(((_cameraX + viewportWorldWidth/2) / _mapWidth) * mmWidth);
-    int camBottom = (int)(((_cameraY + viewportWorldHeight/2) / _mapHeight) * mmHeight);
+- (uint64_t)minimapVersion {
+    _minimapActive = true;
+    return _minimapVersion;
+}
 
-    // Clamp to minimap bounds
-    camLeft = MAX(0, MIN(mmWidth - 1, camLeft));
-    camTop = MAX(0, MIN(mmHeight - 1, camTop));
-    camRight = MAX(0, MIN(mmWidth - 1, camRight));
-    camBottom = MAX(0, MIN(mmHeight - 1, camBottom));
+- (uint64_t)readMinimapPixels:(void (NS_NOESCAPE ^)(const uint8_t* pixels, int width, int height, uint64_t version))block {
+    _minimapActive = true;
+    std::lock_guard<std::mutex> lock(_minimapMutex);
+    if (_minimap.version() == 0 || !_minimap.has_terrain()) return 0;
+    if (block) block(_minimap.pixels(), _minimap.width(), _minimap.height(), _minimap.version());
+    return _minimap.version();
+}
 
-    // Draw viewport rectangle outline
-    for (int x = camLeft; x <= camRight; x++) {
-        // Top edge
-        if (camTop >= 0 && camTop < mmHeight) {
-            int idx = (camTop * mmWidth + x) * 4;
-            pixels[idx + 0] = 255;
-            pixels[idx + 1] = 255;
-            pixels[idx + 2] = 255;
-            pixels[idx + 3] = 255;
-        }
-        // Bottom edge
-        if (camBottom >= 0 && camBottom < mmHeight) {
-            int idx = (camBottom * mmWidth + x) * 4;
-            pixels[idx + 0] = 255;
-            pixels[idx + 1] = 255;
-            pixels[idx + 2] = 255;
-            pixels[idx + 3] = 255;
-        }
+- (nullable NSData*)thumbnailForMapAtPath:(NSString*)mapPath
+                                  maxSize:(int)maxSize
+                                    width:(int*)outWidth
+                                   height:(int*)outHeight {
+    return [_renderer terrainThumbnailForMapAtPath:mapPath maxSize:maxSize width:outWidth height:outHeight];
+}
+
+- (NSArray<OpenBWMapInfo*>*)mapCatalogForDirectories:(NSArray<NSString*>*)directories {
+    std::vector<std::string> paths;
+    for (NSString* directory in directories) paths.push_back([directory UTF8String]);
+
+    auto& catalog = sharedMapCatalog();
+    size_t workers = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    std::vector<openbw_ios::map_info> maps = catalog.refresh(paths, workers);
+    auto stats = catalog.stats();
+    if (stats.parsed + stats.rehashed > 0 && !catalog.save([mapCatalogCachePath() UTF8String])) {
+        NSLog(@"OpenBWGameRunner: Could not write map catalog cache");
     }
-    for (int y = camTop; y <= camBottom; y++) {
-        // Left edge
-        if (camLeft >= 0 && camLeft < mmWidth) {
-            int idx = (y * mmWidth + camLeft) * 4;
-            pixels[idx + 0] = 255;
-            pixels[idx + 1] = 255;
-            pixels[idx + 2] = 255;
-            pixels[idx + 3] = 255;
-        }
-        // Right edge
-        if (camRight >= 0 && camRight < mmWidth) {
-            int idx = (y * mmWidth + camRight) * 4;
-            pixels[idx + 0] = 255;
-            pixels[idx + 1] = 255;
-            pixels[idx + 2] = 255;
-            pixels[idx + 3] = 255;
+    NSLog(@"OpenBWGameRunner: Map catalog: %zu maps (%zu parsed, %zu unchanged, %zu failed) in %.2f ms",
+          stats.files, stats.parsed, stats.unchanged, stats.failed, stats.milliseconds);
+
+    NSMutableArray<OpenBWMapInfo*>* result = [NSMutableArray arrayWithCapacity:maps.size()];
+    for (const auto& map : maps) {
+        NSMutableArray<NSValue*>* starts = [NSMutableArray arrayWithCapacity:map.start_locations.size()];
+        for (const auto& start : map.start_locations) {
+            [starts addObject:[NSValue valueWithCGPoint:CGPointMake(start.x, start.y)]];
         }
+        [result addObject:[[OpenBWMapInfo alloc] initWithPath:@(map.path.c_str())
+                                                         name:@(map.name.c_str()) ?: @""
+                                               mapDescription:@(map.description.c_str()) ?: @""
+                                                      tileset:map.tileset
+                                                        width:map.width
+                                                       height:map.height
+                                                   humanSlots:map.human_slots
+                                                computerSlots:map.computer_slots
+                                                   maxPlayers:map.max_players()
+                                               startLocations:starts]];
+    }
+    return result;
+}
+
+- (void)prefetchMapAtPath:(NSString*)mapPath {
+    [_renderer prefetchTilesetForMapAtPath:mapPath];
+
+    // Set up a game on the map now, so the game start restores it. The
+    // prewarm loads into states of its own, never the player's.
+    if (_gameRunning || !_stateHolder || !_stateHolder->isInitialized) return;
+    std::string path = [mapPath UTF8String];
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        self->_stateHolder->prewarmMap(path);
+    });
+}
+
+- (uint8_t*)getMinimapRGBA:(int*)outWidth height:(int*)outHeight {
+    _minimapActive = true;
+    std::lock_guard<std::mutex> lock(_minimapMutex);
+    if (!_minimap.has_terrain()) {
+        if (outWidth) *outWidth = 0;
+        if (outHeight) *outHeight = 0;
+        return NULL;
     }
 
+    int mmWidth = _minimap.width();
+    int mmHeight = _minimap.height();
+    if (outWidth) *outWidth = mmWidth;
+    if (outHeight) *outHeight = mmHeight;
+
+    size_t size = (size_t)mmWidth * mmHeight * 4;
+    uint8_t* pixels = (uint8_t*)malloc(size);
+    if (!pixels) return NULL;
+    memcpy(pixels, _minimap.pixels(), size);
     return pixels;
 }
 
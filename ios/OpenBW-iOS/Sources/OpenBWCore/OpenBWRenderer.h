@@ -33,13 +33,24 @@ NS_ASSUME_NONNULL_BEGIN
 /// Resize the framebuffer
 - (void)resizeWithWidth:(int)width height:(int)height;
 
-/// Load tileset and image data from game data path
-/// Must be called after OpenBW is initialized
+/// Prepare the data loader and load sprite image data from game data path
+/// Tilesets are loaded lazily. Must be called after OpenBW is initialized
 - (BOOL)loadImageDataFromPath:(NSString*)path error:(NSError**)error;
 
 /// Set the tileset to use for rendering (0-7)
+/// Loads the tileset on first use (waiting for a prefetch already in flight)
 - (void)setTilesetIndex:(int)tilesetIndex;
 
+/// Start loading a tileset in the background so setTilesetIndex: is instant
+- (void)prefetchTileset:(int)tilesetIndex;
+
+/// Read a map's tileset from its file and prefetch it in the background
+- (void)prefetchTilesetForMapAtPath:(NSString*)mapPath;
+
+/// Free the tile graphics of every tileset except the active one
+/// Called automatically under memory pressure; megatile color tables are kept.
+- (void)releaseUnusedTilesets;
+
 /// Provide map tile indices for rendering (megatile indices, size = tileWidth * tileHeight)
 /// @param tiles Pointer to tile indices (uint16_t values)
 /// @param count Number of entries in tiles
@@ -50,6 +61,31 @@ NS_ASSUME_NONNULL_BEGIN
           tileWidth:(int)tileWidth
          tileHeight:(int)tileHeight;
 
+/// Average color of every megatile in a tileset, as packed RGBA (bytes r, g, b, a),
+/// indexed by megatile. Computed when the tileset loads and cached on disk keyed
+/// by a hash of the tileset files. Returns NULL if the tileset is not loaded.
+- (nullable const uint32_t*)megatileColorsForTileset:(int)tilesetIndex count:(NSUInteger* _Nullable)count;
+
+/// Terrain thumbnail of a map file (.scm/.scx) from the megatile color table
+/// Returns RGBA pixel data at most maxSize pixels on its longer side, or nil
+/// if the map cannot be read or its tileset is not loaded. Safe to call from
+/// any thread once image data is loaded.
+- (nullable NSData*)terrainThumbnailForMapAtPath:(NSString*)mapPath
+                                         maxSize:(int)maxSize
+                                           width:(int*)outWidth
+                                          height:(int*)outHeight;
+
+/// Fog of war, applied as a per-tile darkening pass after tiles and sprites
+/// Tile states: 0 = unexplored (black), 1 = explored (darkened), 2 = visible.
+/// Starts a new map with every tile unexplored; fog is off until this is called.
+- (void)resetFogWithTileWidth:(int)tileWidth tileHeight:(int)tileHeight;
+
+/// Apply changed tiles (indices are y * tileWidth + x)
+- (void)updateFogTiles:(const uint32_t*)indices states:(const uint8_t*)states count:(NSUInteger)count;
+
+/// Turn fog of war off (everything is drawn visible)
+- (void)disableFog;
+
 /// Simple unit info for rendering (legacy - kept for compatibility)
 typedef struct {
     float x;
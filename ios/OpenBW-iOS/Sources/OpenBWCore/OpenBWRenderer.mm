@@ -3,6 +3,10 @@
 
 #import "OpenBWRenderer.h"
 #import "MPQLoader.h"
+#include "MegatileColors.h"
+#include "FogOfWar.h"
+#include "ArchiveService.h"
+#include "AssetCache.h"
 
 // OpenBW headers
 #include "bwgame.h"
@@ -15,14 +19,16 @@
 #include <array>
 #include <memory>
 #include <cstring>
+#include <climits>
+#include <atomic>
 
 namespace ios_renderer {
 
 // VR4 entry - tile bitmap data (8x8 pixels per tile piece)
+// Stored in one orientation; flipped tiles are mirrored per row while drawing.
 struct vr4_entry {
-    using bitmap_t = uint64_t;  // 8 bytes = 8 pixels
-    std::array<bitmap_t, 8> bitmap;           // Normal orientation
-    std::array<bitmap_t, 8> inverted_bitmap;  // Horizontally flipped
+    using bitmap_t = uint64_t;  // 8 bytes = 8 pixels, leftmost in the low byte
+    std::array<bitmap_t, 8> bitmap;
 };
 
 // VX4 entry - megatile composition (4x4 VR4 tiles = 32x32 pixels)
@@ -30,14 +36,42 @@ struct vx4_entry {
     std::array<uint16_t, 16> images;  // 16 image indices (4x4 grid)
 };
 
-// Tileset image data
+// Tileset image data (bitmaps are decoded here or mapped from the asset cache)
 struct tileset_image_data {
-    std::vector<uint8_t> wpe;         // Palette (256 * 4 bytes RGBX)
-    std::vector<vr4_entry> vr4;       // Tile graphics
-    std::vector<vx4_entry> vx4;       // Megatile references
-    bool loaded = false;
+    std::vector<uint8_t> wpe;                       // Palette (256 * 4 bytes RGBX)
+    openbw_ios::cached_array<vr4_entry> vr4;        // Tile graphics
+    openbw_ios::cached_array<vx4_entry> vx4;        // Megatile references
+    std::atomic<bool> loaded{false};                // Written on the tileset queue
 };
 
+// Terrain graphics of one map: only the megatiles and VR4 tiles the map uses,
+// renumbered densely. A map typically uses a few percent of its tileset.
+struct map_terrain {
+    int tileset = -1;
+    std::vector<vr4_entry> vr4;
+    std::vector<vx4_entry> vx4;
+    std::vector<uint16_t> tiles;        // Map tiles with remapped megatile indices
+
+    bool empty() const { return vx4.empty(); }
+    size_t bytes() const {
+        return vr4.size() * sizeof(vr4_entry) + vx4.size() * sizeof(vx4_entry) + tiles.size() * sizeof(uint16_t);
+    }
+};
+
+// Sections of the preprocessed asset cache; per-tileset ids add the tileset index
+namespace asset_section {
+    static constexpr uint32_t wpe = 0x100;
+    static constexpr uint32_t vr4 = 0x200;
+    static constexpr uint32_t vx4 = 0x300;
+    static constexpr uint32_t megatile_colors = 0x400;
+    static constexpr uint32_t tile_megatiles = 0x500;
+    static constexpr uint32_t player_unit_colors = 0x600;
+    static constexpr uint32_t hp_bar_colors = 0x601;
+}
+
+// Bump whenever a cached layout or its decoding changes
+static constexpr uint64_t asset_cache_version = 2 | (uint64_t)sizeof(vr4_entry) << 16 | (uint64_t)sizeof(vx4_entry) << 32;
+
 // Load VR4 data (tile graphics)
 template<typename data_T>
 void load_vr4(std::vector<vr4_entry>& vr4, const data_T& data) {
@@ -54,13 +88,6 @@ void load_vr4(std::vector<vr4_entry>& vr4, const data_T& data) {
                 bitmap_row |= (uint64_t)src[row * 8 + col] << (col * 8);
             }
             vr4[i].bitmap[row] = bitmap_row;
-
-            // Create inverted (horizontally flipped) version
-            uint64_t inv_row = 0;
-            for (size_t col = 0; col < 8; ++col) {
-                inv_row |= (uint64_t)src[row * 8 + (7 - col)] << (col * 8);
-            }
-            vr4[i].inverted_bitmap[row] = inv_row;
         }
         src += element_size;
     }
@@ -81,8 +108,56 @@ void load_vx4(std::vector<vx4_entry>& vx4, const data_T& data) {
     }
 }
 
-// Draw a single 32x32 megatile to the framebuffer
-void draw_tile(const tileset_image_data& img, size_t megatile_index,
+// Extract the megatiles and VR4 tiles a map uses from its tileset. Megatile
+// and image indices that are out of range stay out of range (0x7fff), so
+// draw_tile skips them as before. The flip bit of each image is kept.
+template<typename tileset_T>
+void build_map_terrain(map_terrain& out, int tileset_index, const tileset_T& tileset,
+                       const uint16_t* tiles, size_t count) {
+    static constexpr uint16_t unused = 0xffff;
+    static constexpr uint16_t missing = 0x7fff;
+    std::vector<uint16_t> megatile_map(tileset.vx4.size(), unused);
+    std::vector<uint16_t> vr4_map(tileset.vr4.size(), unused);
+
+    out = map_terrain();
+    out.tileset = tileset_index;
+    out.tiles.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t megatile = tiles[i] & 0x7fff;
+        uint16_t remapped = missing;
+        if (megatile < megatile_map.size()) {
+            if (megatile_map[megatile] == unused) {
+                megatile_map[megatile] = (uint16_t)out.vx4.size();
+                vx4_entry entry = tileset.vx4[megatile];
+                for (uint16_t& image : entry.images) {
+                    size_t vr4_index = image / 2;
+                    uint16_t flip = image & 1;
+                    if (vr4_index >= vr4_map.size()) {
+                        image = missing * 2 | flip;
+                        continue;
+                    }
+                    if (vr4_map[vr4_index] == unused) {
+                        vr4_map[vr4_index] = (uint16_t)out.vr4.size();
+                        out.vr4.push_back(tileset.vr4[vr4_index]);
+                    }
+                    image = (uint16_t)(vr4_map[vr4_index] * 2 | flip);
+                }
+                out.vx4.push_back(entry);
+            }
+            remapped = megatile_map[megatile];
+        }
+        out.tiles[i] = (uint16_t)((tiles[i] & 0x8000) | remapped);
+    }
+}
+
+// Mirror an 8-pixel row horizontally (a single REV on arm64, BSWAP on x86)
+static inline uint64_t flip_row(uint64_t row) {
+    return __builtin_bswap64(row);
+}
+
+// Draw a single 32x32 megatile to the framebuffer from a tileset or map terrain
+template<typename tiles_T>
+void draw_tile(const tiles_T& img, size_t megatile_index,
                uint8_t* dst, size_t pitch,
                int offset_x, int offset_y, int width, int height) {
     if (megatile_index >= img.vx4.size()) return;
@@ -98,21 +173,26 @@ void draw_tile(const tileset_image_data& img, size_t megatile_index,
 
             if (vr4_index >= img.vr4.size()) continue;
 
-            const uint64_t* bitmap = inverted ?
-                img.vr4[vr4_index].inverted_bitmap.data() :
-                img.vr4[vr4_index].bitmap.data();
+            const uint64_t* bitmap = img.vr4[vr4_index].bitmap.data();
 
             int base_x = tile_x * 8;
             int base_y = tile_y * 8;
+            bool whole_row = base_x >= offset_x && base_x + 8 <= width;
 
             // Draw 8x8 tile
             for (int row = 0; row < 8; ++row) {
                 int screen_y = base_y + row;
                 if (screen_y < offset_y || screen_y >= height) continue;
 
-                uint64_t row_data = bitmap[row];
+                uint64_t row_data = inverted ? flip_row(bitmap[row]) : bitmap[row];
                 uint8_t* row_dst = dst + screen_y * pitch + base_x;
 
+                // Unclipped rows are one 8-byte store (pixels are in little-endian order)
+                if (whole_row) {
+                    std::memcpy(row_dst, &row_data, 8);
+                    continue;
+                }
+
                 for (int col = 0; col < 8; ++col) {
                     int screen_x = base_x + col;
                     if (screen_x < offset_x || screen_x >= width) continue;
@@ -253,6 +333,22 @@ struct sprite_image_data {
     bool loaded = false;
 };
 
+// Read the terrain sections of a map file (.scm/.scx)
+bool read_map_terrain(NSString* mapPath, openbw_ios::chk_terrain& terrain) {
+    try {
+        auto chk = openbw_ios::archive_service::shared().read_view_from([mapPath UTF8String], "staredit\\scenario.chk");
+        if (!openbw_ios::parse_chk_terrain(chk.data, chk.size, terrain)) {
+            NSLog(@"OpenBWRenderer: No terrain in %@", mapPath.lastPathComponent);
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        NSLog(@"OpenBWRenderer: Could not read %@: %s", mapPath.lastPathComponent, e.what());
+        return false;
+    }
+}
+
 } // namespace ios_renderer
 
 #pragma mark - OpenBWRenderer Implementation
@@ -261,13 +357,19 @@ struct sprite_image_data {
     std::vector<uint8_t> _framebuffer;
     std::vector<uint8_t> _palette;
     std::array<ios_renderer::tileset_image_data, 8> _tilesets;
-    int _currentTileset;
-    bwgame::data_loading::data_files_loader<> _dataLoader;
+    std::array<openbw_ios::megatile_color_table, 8> _megatileColors;
+    std::shared_ptr<openbw_ios::asset_cache> _assetCache;  // Kept for the renderer's lifetime once mapped
+    uint64_t _assetCacheKey;
+    std::string _assetCachePath;
+    std::atomic<int> _currentTileset;           // Tileset queue writes
+    openbw_ios::archive_service::loader _dataLoader;   // Shared with the game
     bool _dataLoaderInitialized;
     std::vector<uint16_t> _mapTiles;
     int _mapTileWidth;
     int _mapTileHeight;
     bool _hasMapTiles;
+    ios_renderer::map_terrain _mapTerrain;      // Tileset queue writes; replaces the full tileset once built
+    std::atomic<int> _mapTerrainTileset;        // _mapTerrain.tileset, for reads off the queue
     std::vector<RenderUnitInfo> _units;
 
     // Sprite rendering data
@@ -276,6 +378,17 @@ struct sprite_image_data {
     std::vector<RenderImageInfo> _spriteImages;  // Flat storage for all images
     std::vector<BOOL> _selectedMask;
     std::vector<const bwgame::grp_t*> _selectionCircleGRPs;
+
+    // Fog of war (per map tile) and its palette remap tables
+    std::vector<uint8_t> _fogStates;
+    int _fogTileWidth;
+    int _fogTileHeight;
+    bool _fogEnabled;
+    std::array<std::array<uint8_t, 256>, 2> _fogLUT;   // [unexplored, explored]
+
+    // Serial queue for all tileset loading
+    dispatch_queue_t _tilesetQueue;
+    dispatch_source_t _memoryPressureSource;
 }
 
 - (instancetype)initWithWidth:(int)width height:(int)height {
@@ -284,10 +397,26 @@ struct sprite_image_data {
         _width = width;
         _height = height;
         _currentTileset = 0;
+        _mapTerrainTileset = -1;
         _dataLoaderInitialized = NO;
+        _assetCacheKey = 0;
         _mapTileWidth = 0;
         _mapTileHeight = 0;
         _hasMapTiles = NO;
+        _fogTileWidth = 0;
+        _fogTileHeight = 0;
+        _fogEnabled = false;
+        _tilesetQueue = dispatch_queue_create("com.openbw.tilesets", DISPATCH_QUEUE_SERIAL);
+
+        // Drop tilesets other than the active one when the system is low on memory
+        _memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                       DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                       dispatch_get_main_queue());
+        __weak OpenBWRenderer* weakSelf = self;
+        dispatch_source_set_event_handler(_memoryPressureSource, ^{
+            [weakSelf releaseUnusedTilesets];
+        });
+        dispatch_resume(_memoryPressureSource);
 
         // Allocate framebuffer
         _framebuffer.resize(width * height, 0);
@@ -300,10 +429,15 @@ struct sprite_image_data {
             _palette[i * 4 + 2] = i;      // B
             _palette[i * 4 + 3] = 255;    // A
         }
+        [self buildFogLUTs];
     }
     return self;
 }
 
+- (void)dealloc {
+    if (_memoryPressureSource) dispatch_source_cancel(_memoryPressureSource);
+}
+
 - (void)resizeWithWidth:(int)width height:(int)height {
     if (_width == width && _height == height) return;
     
@@ -326,56 +460,55 @@ struct sprite_image_data {
     return _palette.data();
 }
 
+// Reads only atomics, so it can be asked every frame from any thread without
+// waiting for the tileset queue
 - (BOOL)isReady {
-    return _dataLoaderInitialized && _tilesets[_currentTileset].loaded;
+    int tilesetIndex = _currentTileset;
+    return _dataLoaderInitialized && (_mapTerrainTileset == tilesetIndex || _tilesets[tilesetIndex].loaded);
 }
 
 - (BOOL)loadImageDataFromPath:(NSString*)path error:(NSError**)error {
     @try {
-        // Initialize data loader
-        _dataLoader = bwgame::data_loading::data_files_loader<>();
-
-        // Add MPQs in priority order
+        // Resolve MPQs in priority order; archives the game already opened are reused
+        std::vector<std::string> mpqPaths;
         MPQLoader* loader = [MPQLoader shared];
         NSArray<NSString*>* mpqFiles = @[@"patch_rt.mpq", @"BROODAT.MPQ", @"STARDAT.MPQ"];
         NSFileManager* fm = [NSFileManager defaultManager];
         for (NSString* mpq in mpqFiles) {
             NSString* resolvedPath = [loader resolvedPathForFile:mpq];
             if (resolvedPath.length > 0) {
-                _dataLoader.add_mpq_file([resolvedPath UTF8String]);
+                mpqPaths.push_back([resolvedPath UTF8String]);
                 continue;
             }
 
             // Fallback to direct path resolution if MPQLoader is not initialized
             NSString* directPath = [path stringByAppendingPathComponent:mpq];
             if ([fm fileExistsAtPath:directPath]) {
-                _dataLoader.add_mpq_file([directPath UTF8String]);
+                mpqPaths.push_back([directPath UTF8String]);
                 continue;
             }
 
             NSString* lowerPath = [path stringByAppendingPathComponent:[mpq lowercaseString]];
             if ([fm fileExistsAtPath:lowerPath]) {
-                _dataLoader.add_mpq_file([lowerPath UTF8String]);
+                mpqPaths.push_back([lowerPath UTF8String]);
                 continue;
             }
 
             NSString* upperPath = [path stringByAppendingPathComponent:[mpq uppercaseString]];
             if ([fm fileExistsAtPath:upperPath]) {
-                _dataLoader.add_mpq_file([upperPath UTF8String]);
+                mpqPaths.push_back([upperPath UTF8String]);
             }
         }
 
+        auto& archives = openbw_ios::archive_service::shared();
+        archives.open(mpqPaths);
+        _dataLoader = archives.data_loader();
         _dataLoaderInitialized = YES;
 
-        // Load all tilesets
-        NSArray<NSString*>* tilesetNames = @[
-            @"badlands", @"platform", @"install", @"AshWorld",
-            @"Jungle", @"Desert", @"Ice", @"Twilight"
-        ];
+        // Map the preprocessed asset cache if it was built from these archives
+        BOOL cacheValid = [self openAssetCacheForArchives:mpqPaths];
 
-        for (int i = 0; i < 8; i++) {
-            [self loadTileset:i name:tilesetNames[i]];
-        }
+        // Tilesets are loaded on demand by setTilesetIndex: / prefetchTileset:
 
         // Load sprite image data (player colors, HP bar colors)
         NSError* spriteError = nil;
@@ -384,6 +517,13 @@ struct sprite_image_data {
             NSLog(@"OpenBWRenderer: Warning - %@", spriteError.localizedDescription);
         }
 
+        // First run (or changed archives): convert everything once in the background
+        if (!cacheValid && !_assetCachePath.empty()) {
+            dispatch_async(_tilesetQueue, ^{
+                [self buildAssetCache];
+            });
+        }
+
         NSLog(@"OpenBWRenderer: Image data loaded successfully");
         return YES;
     }
@@ -399,59 +539,220 @@ struct sprite_image_data {
     }
 }
 
-- (void)loadTileset:(int)index name:(NSString*)name {
-    if (!_dataLoaderInitialized) return;
+static NSString* tilesetName(int index) {
+    static NSArray<NSString*>* names = @[
+        @"badlands", @"platform", @"install", @"AshWorld",
+        @"Jungle", @"Desert", @"Ice", @"Twilight"
+    ];
+    return names[index];
+}
+
+// Tileset queue only (it owns the tileset storage). With bitmaps, loads
+// everything needed to draw the tileset; without, only its megatile colors.
+- (void)loadTileset:(int)index withBitmaps:(BOOL)withBitmaps {
+    if (!_dataLoaderInitialized || index < 0 || index >= 8) return;
 
     auto& tileset = _tilesets[index];
+    bool needColors = _megatileColors[index].empty();
+    if (withBitmaps ? tileset.loaded.load() : !needColors) return;
+
+    NSString* name = tilesetName(index);
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+
+    if ([self loadTilesetFromCache:index withBitmaps:withBitmaps]) {
+        if (withBitmaps) {
+            NSLog(@"OpenBWRenderer: Mapped tileset %@ from the asset cache in %.2f ms",
+                  name, (CFAbsoluteTimeGetCurrent() - start) * 1000.0);
+        }
+        return;
+    }
 
     @try {
-        bwgame::a_vector<uint8_t> data;
-        std::string prefix = "Tileset/" + std::string([name UTF8String]);
+        // Raw copies for the megatile color table
+        std::vector<uint8_t> vr4Raw, vx4Raw, cv5Raw;
+        auto readRaw = [&](const char* extension, std::vector<uint8_t>& out) {
+            return [self readTilesetFile:name extension:extension into:out];
+        };
 
         // Load WPE (palette)
-        try {
-            _dataLoader(data, prefix + ".wpe");
-            if (data.size() >= 256 * 4) {
-                tileset.wpe.assign(data.begin(), data.end());
-                NSLog(@"OpenBWRenderer: Loaded %@ palette (%zu bytes)", name, data.size());
-            }
+        std::vector<uint8_t> wpe;
+        if (readRaw(".wpe", wpe) && wpe.size() >= 256 * 4) {
+            tileset.wpe = std::move(wpe);
         }
-        catch (...) {
-            NSLog(@"OpenBWRenderer: Could not load %@.wpe", name);
+
+        if (needColors && [self loadCachedMegatileColors:index name:name]) needColors = false;
+        if (!withBitmaps && !needColors) return;
+
+        // VR4 (tile graphics) and VX4 (megatile indices)
+        readRaw(".vr4", vr4Raw);
+        readRaw(".vx4", vx4Raw);
+
+        // CV5 (tile groups, only needed to color raw map tiles)
+        if (needColors) readRaw(".cv5", cv5Raw);
+
+        if (needColors && !tileset.wpe.empty() && !vr4Raw.empty() && !vx4Raw.empty()) {
+            [self buildMegatileColors:index name:name vr4:vr4Raw vx4:vx4Raw cv5:cv5Raw];
         }
 
-        // Load VR4 (tile graphics)
-        try {
-            _dataLoader(data, prefix + ".vr4");
-            ios_renderer::load_vr4(tileset.vr4, data);
-            NSLog(@"OpenBWRenderer: Loaded %@ VR4 (%zu tiles)", name, tileset.vr4.size());
+        if (withBitmaps) {
+            std::vector<ios_renderer::vr4_entry> vr4;
+            std::vector<ios_renderer::vx4_entry> vx4;
+            ios_renderer::load_vr4(vr4, vr4Raw);
+            ios_renderer::load_vx4(vx4, vx4Raw);
+            tileset.vr4.assign(std::move(vr4));
+            tileset.vx4.assign(std::move(vx4));
+            tileset.loaded = !tileset.vr4.empty() && !tileset.vx4.empty();
+            NSLog(@"OpenBWRenderer: Loaded tileset %@ (%zu tiles, %zu megatiles) in %.1f ms",
+                  name, tileset.vr4.size(), tileset.vx4.size(), (CFAbsoluteTimeGetCurrent() - start) * 1000.0);
         }
-        catch (...) {
-            NSLog(@"OpenBWRenderer: Could not load %@.vr4", name);
+    }
+    @catch (...) {
+        NSLog(@"OpenBWRenderer: Failed to load tileset %@", name);
+    }
+}
+
+// Tileset queue only
+- (BOOL)readTilesetFile:(NSString*)name extension:(const char*)extension into:(std::vector<uint8_t>&)out {
+    try {
+        bwgame::a_vector<uint8_t> data;
+        _dataLoader(data, "Tileset/" + std::string([name UTF8String]) + extension);
+        out.assign(data.begin(), data.end());
+        return YES;
+    }
+    catch (...) {
+        NSLog(@"OpenBWRenderer: Could not load %@%s", name, extension);
+        return NO;
+    }
+}
+
+- (void)prefetchTileset:(int)tilesetIndex {
+    if (tilesetIndex < 0 || tilesetIndex >= 8) return;
+    dispatch_async(_tilesetQueue, ^{
+        [self loadTileset:tilesetIndex withBitmaps:YES];
+    });
+}
+
+- (void)prefetchTilesetForMapAtPath:(NSString*)mapPath {
+    NSString* path = [mapPath copy];
+    dispatch_async(_tilesetQueue, ^{
+        openbw_ios::chk_terrain terrain;
+        if (ios_renderer::read_map_terrain(path, terrain)) {
+            [self loadTileset:terrain.tileset withBitmaps:YES];
         }
+    });
+}
 
-        // Load VX4 (megatile indices)
-        try {
-            _dataLoader(data, prefix + ".vx4");
-            ios_renderer::load_vx4(tileset.vx4, data);
-            NSLog(@"OpenBWRenderer: Loaded %@ VX4 (%zu megatiles)", name, tileset.vx4.size());
+- (void)releaseUnusedTilesets {
+    dispatch_async(_tilesetQueue, ^{
+        size_t released = 0;
+        for (int i = 0; i < 8; i++) {
+            auto& tileset = self->_tilesets[i];
+            if (i == self->_currentTileset || !tileset.loaded) continue;
+            tileset.loaded = false;
+            released += tileset.vr4.owned_bytes() + tileset.vx4.owned_bytes();
+            tileset.vr4.clear();
+            tileset.vx4.clear();
         }
-        catch (...) {
-            NSLog(@"OpenBWRenderer: Could not load %@.vx4", name);
+        if (released > 0) {
+            NSLog(@"OpenBWRenderer: Released %.1f MB of unused tilesets", released / (1024.0 * 1024.0));
         }
+        openbw_ios::archive_service::shared().trim();
+    });
+}
 
-        tileset.loaded = !tileset.vr4.empty() && !tileset.vx4.empty();
+// Megatile color cache files are keyed by the archives they were built from
+// (the asset cache key), known before any tileset file is read. Without a
+// key the colors are built every time.
+- (nullable NSString*)megatileColorCachePath:(NSString*)name {
+    if (_assetCacheKey == 0) return nil;
+    return [[OpenBWRenderer megatileColorCacheDirectory]
+        stringByAppendingPathComponent:[NSString stringWithFormat:@"%@-%016llx.bin", name, (unsigned long long)_assetCacheKey]];
+}
 
-        // If this is the current tileset and we have a palette, update it
-        if (index == _currentTileset && !tileset.wpe.empty()) {
-            [self updatePaletteFromTileset:index];
-        }
-    }
-    @catch (...) {
-        NSLog(@"OpenBWRenderer: Failed to load tileset %@", name);
+// Average megatile colors from the on-disk cache, so VR4/VX4/CV5 need not be
+// read for them
+- (BOOL)loadCachedMegatileColors:(int)index name:(NSString*)name {
+    NSString* cachePath = [self megatileColorCachePath:name];
+    if (!cachePath) return NO;
+    NSData* cached = [NSData dataWithContentsOfFile:cachePath];
+    return cached && openbw_ios::deserialize_megatile_color_table((const uint8_t*)cached.bytes, cached.length,
+                                                                  _assetCacheKey, _megatileColors[index]);
+}
+
+// Average megatile colors from the tileset files, written to the cache
+- (void)buildMegatileColors:(int)index
+                       name:(NSString*)name
+                        vr4:(const std::vector<uint8_t>&)vr4
+                        vx4:(const std::vector<uint8_t>&)vx4
+                        cv5:(const std::vector<uint8_t>&)cv5 {
+    const auto& wpe = _tilesets[index].wpe;
+    auto& table = _megatileColors[index];
+    table = openbw_ios::build_megatile_color_table(wpe.data(), wpe.size(), vr4.data(), vr4.size(),
+                                                   vx4.data(), vx4.size(), cv5.data(), cv5.size(), _assetCacheKey);
+
+    NSString* cachePath = [self megatileColorCachePath:name];
+    if (!cachePath) return;
+    std::vector<uint8_t> blob = openbw_ios::serialize_megatile_color_table(table);
+    NSData* data = [NSData dataWithBytes:blob.data() length:blob.size()];
+    if (![data writeToFile:cachePath atomically:YES]) {
+        NSLog(@"OpenBWRenderer: Could not write megatile color cache for %@", name);
     }
 }
 
++ (NSString*)megatileColorCacheDirectory {
+    NSString* caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+    NSString* dir = [caches stringByAppendingPathComponent:@"MegatileColors"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:YES attributes:nil error:nil];
+    return dir;
+}
+
+// A table is only written on the tileset queue, and never again once built,
+// so it is safe to read after checking on the queue that it is there
+- (const uint32_t*)megatileColorsForTileset:(int)tilesetIndex count:(NSUInteger*)count {
+    if (count) *count = 0;
+    if (tilesetIndex < 0 || tilesetIndex >= 8) return NULL;
+    __block bool built = false;
+    dispatch_sync(_tilesetQueue, ^{
+        built = !self->_megatileColors[tilesetIndex].empty();
+    });
+    if (!built) return NULL;
+    const auto& table = _megatileColors[tilesetIndex];
+    if (count) *count = table.colors.size();
+    return table.colors.data();
+}
+
+- (nullable NSData*)terrainThumbnailForMapAtPath:(NSString*)mapPath
+                                         maxSize:(int)maxSize
+                                           width:(int*)outWidth
+                                          height:(int*)outHeight {
+    if (outWidth) *outWidth = 0;
+    if (outHeight) *outHeight = 0;
+
+    openbw_ios::chk_terrain terrain;
+    if (!ios_renderer::read_map_terrain(mapPath, terrain)) return nil;
+
+    // Only the color table is needed, not the tileset's bitmaps. Checked and
+    // built on the tileset queue; loadTileset: returns at once if it is there.
+    int tilesetIndex = terrain.tileset;
+    if (tilesetIndex < 0 || tilesetIndex >= 8) return nil;
+    __block bool built = false;
+    dispatch_sync(_tilesetQueue, ^{
+        [self loadTileset:tilesetIndex withBitmaps:NO];
+        built = !self->_megatileColors[tilesetIndex].empty();
+    });
+    if (!built) return nil;
+    const auto& table = _megatileColors[tilesetIndex];
+
+    int w = 0, h = 0;
+    std::vector<uint32_t> pixels;
+    openbw_ios::render_terrain_thumbnail(terrain, table, maxSize, w, h, pixels);
+    if (pixels.empty()) return nil;
+
+    if (outWidth) *outWidth = w;
+    if (outHeight) *outHeight = h;
+    return [NSData dataWithBytes:pixels.data() length:pixels.size() * 4];
+}
+
 - (void)updatePaletteFromTileset:(int)index {
     auto& tileset = _tilesets[index];
     if (tileset.wpe.size() >= 256 * 4) {
@@ -461,12 +762,106 @@ struct sprite_image_data {
             _palette[i * 4 + 2] = tileset.wpe[i * 4 + 2];  // B
             _palette[i * 4 + 3] = (i == 0) ? 0 : 255;      // A (index 0 transparent)
         }
+        [self buildFogLUTs];
+    }
+}
+
+// Palette remaps for fog: explored tiles at half brightness, unexplored black.
+// Each entry is the nearest palette color, so the pass stays 8-bit.
+- (void)buildFogLUTs {
+    auto nearest = [&](int r, int g, int b) {
+        int best = 0;
+        int bestDistance = INT_MAX;
+        for (int i = 0; i < 256; i++) {
+            int dr = _palette[i * 4 + 0] - r;
+            int dg = _palette[i * 4 + 1] - g;
+            int db = _palette[i * 4 + 2] - b;
+            int d = dr * dr + dg * dg + db * db;
+            if (d < bestDistance) {
+                bestDistance = d;
+                best = i;
+            }
+        }
+        return (uint8_t)best;
+    };
+
+    uint8_t black = nearest(0, 0, 0);
+    for (int i = 0; i < 256; i++) {
+        _fogLUT[openbw_ios::fog_state::unexplored][i] = black;
+        _fogLUT[openbw_ios::fog_state::explored][i] =
+            nearest(_palette[i * 4 + 0] / 2, _palette[i * 4 + 1] / 2, _palette[i * 4 + 2] / 2);
+    }
+}
+
+- (void)resetFogWithTileWidth:(int)tileWidth tileHeight:(int)tileHeight {
+    if (tileWidth <= 0 || tileHeight <= 0) {
+        [self disableFog];
+        return;
+    }
+    _fogTileWidth = tileWidth;
+    _fogTileHeight = tileHeight;
+    _fogStates.assign((size_t)tileWidth * tileHeight, openbw_ios::fog_state::unexplored);
+    _fogEnabled = true;
+}
+
+- (void)updateFogTiles:(const uint32_t*)indices states:(const uint8_t*)states count:(NSUInteger)count {
+    if (!_fogEnabled || !indices || !states) return;
+    for (NSUInteger i = 0; i < count; i++) {
+        if (indices[i] < _fogStates.size()) _fogStates[indices[i]] = states[i];
+    }
+}
+
+- (void)disableFog {
+    _fogEnabled = false;
+    _fogStates.clear();
+    _fogTileWidth = 0;
+    _fogTileHeight = 0;
+}
+
+// Darken every on-screen tile that is not currently visible
+- (void)applyFogFromTileX:(int)startTileX tileY:(int)startTileY
+                  toTileX:(int)endTileX tileY:(int)endTileY
+                  cameraX:(float)cameraX cameraY:(float)cameraY {
+    if (!_fogEnabled) return;
+    uint8_t* fb = _framebuffer.data();
+
+    endTileX = std::min(endTileX, _fogTileWidth);
+    endTileY = std::min(endTileY, _fogTileHeight);
+    for (int tileY = startTileY; tileY < endTileY; tileY++) {
+        int screenY = tileY * 32 - (int)cameraY + _height / 2;
+        int y0 = std::max(0, screenY);
+        int y1 = std::min(_height, screenY + 32);
+        if (y0 >= y1) continue;
+
+        const uint8_t* states = &_fogStates[(size_t)tileY * _fogTileWidth];
+        for (int tileX = startTileX; tileX < endTileX; tileX++) {
+            uint8_t state = states[tileX];
+            if (state == openbw_ios::fog_state::visible) continue;
+
+            int screenX = tileX * 32 - (int)cameraX + _width / 2;
+            int x0 = std::max(0, screenX);
+            int x1 = std::min(_width, screenX + 32);
+            if (x0 >= x1) continue;
+
+            const uint8_t* lut = _fogLUT[state].data();
+            for (int y = y0; y < y1; y++) {
+                uint8_t* row = fb + (size_t)y * _width;
+                for (int x = x0; x < x1; x++) row[x] = lut[row[x]];
+            }
+        }
     }
 }
 
 - (void)setTilesetIndex:(int)tilesetIndex {
     if (tilesetIndex >= 0 && tilesetIndex < 8) {
-        _currentTileset = tilesetIndex;
+        // Waits for a prefetch of this tileset that is already in flight.
+        // The previous map's terrain is dropped; setMapTiles: builds the next.
+        dispatch_sync(_tilesetQueue, ^{
+            self->_mapTerrain = ios_renderer::map_terrain();
+            self->_mapTerrainTileset = -1;
+            [self loadTileset:tilesetIndex withBitmaps:YES];
+            self->_currentTileset = tilesetIndex;
+        });
         [self updatePaletteFromTileset:tilesetIndex];
     }
 }
@@ -484,6 +879,12 @@ struct sprite_image_data {
         _hasMapTiles = NO;
         _mapTileWidth = 0;
         _mapTileHeight = 0;
+        int tilesetIndex = _currentTileset;
+        dispatch_sync(_tilesetQueue, ^{
+            self->_mapTerrain = ios_renderer::map_terrain();
+            self->_mapTerrainTileset = -1;
+            [self loadTileset:tilesetIndex withBitmaps:YES];
+        });
         return;
     }
 
@@ -491,6 +892,34 @@ struct sprite_image_data {
     _mapTileWidth = tileWidth;
     _mapTileHeight = tileHeight;
     _hasMapTiles = YES;
+    [self buildMapTerrain];
+}
+
+// Extract the tiles this map uses into a dense table, then release the full
+// tileset's bitmaps; setTilesetIndex: reloads them for the next map.
+- (void)buildMapTerrain {
+    int tilesetIndex = _currentTileset;
+    dispatch_sync(_tilesetQueue, ^{
+        auto& tileset = self->_tilesets[tilesetIndex];
+        if (!tileset.loaded) return;
+
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        ios_renderer::map_terrain terrain;
+        ios_renderer::build_map_terrain(terrain, tilesetIndex, tileset, self->_mapTiles.data(), self->_mapTiles.size());
+        size_t fullBytes = tileset.vr4.size() * sizeof(ios_renderer::vr4_entry) +
+                           tileset.vx4.size() * sizeof(ios_renderer::vx4_entry);
+        NSLog(@"OpenBWRenderer: Map terrain uses %zu of %zu megatiles and %zu of %zu tiles "
+              "(%.2f MB instead of %.2f MB) in %.1f ms",
+              terrain.vx4.size(), tileset.vx4.size(), terrain.vr4.size(), tileset.vr4.size(),
+              terrain.bytes() / (1024.0 * 1024.0), fullBytes / (1024.0 * 1024.0),
+              (CFAbsoluteTimeGetCurrent() - start) * 1000.0);
+
+        self->_mapTerrain = std::move(terrain);
+        self->_mapTerrainTileset = tilesetIndex;
+        tileset.loaded = false;
+        tileset.vr4.clear();
+        tileset.vx4.clear();
+    });
 }
 
 - (void)setUnits:(const RenderUnitInfo*)units count:(NSUInteger)count {
@@ -534,6 +963,8 @@ struct sprite_image_data {
         return NO;
     }
 
+    if ([self loadSpriteImageDataFromCache]) return YES;
+
     @try {
         bwgame::a_vector<uint8_t> data;
 
@@ -630,6 +1061,142 @@ struct sprite_image_data {
     }
 }
 
+#pragma mark - Asset Cache
+
+// Caller's thread, before the tileset queue uses the cache. The cache lives
+// next to the MPQs when that directory is writable, else in Caches.
+- (BOOL)openAssetCacheForArchives:(const std::vector<std::string>&)archivePaths {
+    if (_assetCache || archivePaths.empty()) return _assetCache != nullptr;
+
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    _assetCacheKey = openbw_ios::asset_source_key(archivePaths, ios_renderer::asset_cache_version);
+    if (_assetCacheKey == 0) return NO;
+
+    NSString* fileName = @"openbw-assets.cache";
+    NSString* archiveDir = [@(archivePaths.front().c_str()) stringByDeletingLastPathComponent];
+    NSString* cachesDir = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+    NSArray<NSString*>* candidates = @[[archiveDir stringByAppendingPathComponent:fileName],
+                                       [cachesDir stringByAppendingPathComponent:fileName]];
+
+    for (NSString* candidate in candidates) {
+        auto cache = std::make_shared<openbw_ios::asset_cache>();
+        if (cache->open([candidate UTF8String], _assetCacheKey)) {
+            _assetCache = cache;
+            _assetCachePath = [candidate UTF8String];
+            NSLog(@"OpenBWRenderer: Mapped asset cache %@ in %.2f ms", candidate,
+                  (CFAbsoluteTimeGetCurrent() - start) * 1000.0);
+            return YES;
+        }
+    }
+
+    NSFileManager* fm = [NSFileManager defaultManager];
+    _assetCachePath = [([fm isWritableFileAtPath:archiveDir] ? candidates[0] : candidates[1]) UTF8String];
+    NSLog(@"OpenBWRenderer: Asset cache missing or stale; decoding from the MPQs");
+    return NO;
+}
+
+// Tileset queue only. Points the tileset into the mapped cache; returns NO if
+// the cache is not mapped or lacks the tileset.
+- (BOOL)loadTilesetFromCache:(int)index withBitmaps:(BOOL)withBitmaps {
+    if (!_assetCache) return NO;
+
+    const uint8_t* wpe;
+    const ios_renderer::vr4_entry* vr4;
+    const ios_renderer::vx4_entry* vx4;
+    const uint32_t* colors;
+    const uint16_t* tileMegatiles;
+    size_t wpeSize, vr4Count, vx4Count, colorCount, tileCount;
+    if (!_assetCache->array(ios_renderer::asset_section::wpe + index, wpe, wpeSize) ||
+        !_assetCache->array(ios_renderer::asset_section::vr4 + index, vr4, vr4Count) ||
+        !_assetCache->array(ios_renderer::asset_section::vx4 + index, vx4, vx4Count) ||
+        !_assetCache->array(ios_renderer::asset_section::megatile_colors + index, colors, colorCount) ||
+        !_assetCache->array(ios_renderer::asset_section::tile_megatiles + index, tileMegatiles, tileCount)) {
+        return NO;
+    }
+
+    auto& tileset = _tilesets[index];
+    tileset.wpe.assign(wpe, wpe + wpeSize);
+
+    auto& table = _megatileColors[index];
+    if (table.empty()) {
+        table.source_hash = _assetCacheKey;
+        table.colors.assign(colors, colors + colorCount);
+        table.tile_megatiles.assign(tileMegatiles, tileMegatiles + tileCount);
+    }
+
+    if (withBitmaps && !tileset.loaded) {
+        tileset.vr4.point_to(vr4, vr4Count);
+        tileset.vx4.point_to(vx4, vx4Count);
+        tileset.loaded = vr4Count > 0 && vx4Count > 0;
+    }
+    return YES;
+}
+
+// Tileset queue only. Decodes every tileset once and writes the cache; later
+// tileset loads (this launch and the next) map it instead.
+- (void)buildAssetCache {
+    if (_assetCache || _assetCachePath.empty()) return;
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+
+    openbw_ios::asset_cache_writer writer;
+    for (int i = 0; i < 8; i++) {
+        NSString* name = tilesetName(i);
+        std::vector<uint8_t> wpe, vr4Raw, vx4Raw, cv5Raw;
+        if (![self readTilesetFile:name extension:".wpe" into:wpe] || wpe.size() < 256 * 4 ||
+            ![self readTilesetFile:name extension:".vr4" into:vr4Raw] ||
+            ![self readTilesetFile:name extension:".vx4" into:vx4Raw] ||
+            ![self readTilesetFile:name extension:".cv5" into:cv5Raw]) {
+            continue;
+        }
+
+        std::vector<ios_renderer::vr4_entry> vr4;
+        std::vector<ios_renderer::vx4_entry> vx4;
+        ios_renderer::load_vr4(vr4, vr4Raw);
+        ios_renderer::load_vx4(vx4, vx4Raw);
+        auto table = openbw_ios::build_megatile_color_table(wpe.data(), wpe.size(), vr4Raw.data(), vr4Raw.size(),
+                                                            vx4Raw.data(), vx4Raw.size(), cv5Raw.data(), cv5Raw.size(),
+                                                            _assetCacheKey);
+
+        writer.add_array(ios_renderer::asset_section::wpe + i, wpe);
+        writer.add_array(ios_renderer::asset_section::vr4 + i, vr4);
+        writer.add_array(ios_renderer::asset_section::vx4 + i, vx4);
+        writer.add_array(ios_renderer::asset_section::megatile_colors + i, table.colors);
+        writer.add_array(ios_renderer::asset_section::tile_megatiles + i, table.tile_megatiles);
+    }
+    if (_spriteImageData.loaded) {
+        writer.add(ios_renderer::asset_section::player_unit_colors, &_spriteImageData.player_unit_colors,
+                   sizeof(_spriteImageData.player_unit_colors));
+        writer.add(ios_renderer::asset_section::hp_bar_colors, &_spriteImageData.hp_bar_colors,
+                   sizeof(_spriteImageData.hp_bar_colors));
+    }
+
+    if (!writer.write(_assetCachePath, _assetCacheKey)) {
+        NSLog(@"OpenBWRenderer: Could not write asset cache to %s", _assetCachePath.c_str());
+        return;
+    }
+    auto cache = std::make_shared<openbw_ios::asset_cache>();
+    if (cache->open(_assetCachePath, _assetCacheKey)) _assetCache = cache;
+    NSLog(@"OpenBWRenderer: Built asset cache in %.0f ms", (CFAbsoluteTimeGetCurrent() - start) * 1000.0);
+}
+
+// Player and HP bar colors from the mapped cache
+- (BOOL)loadSpriteImageDataFromCache {
+    if (!_assetCache) return NO;
+    const uint8_t* playerColors;
+    const uint8_t* hpBarColors;
+    size_t playerSize, hpBarSize;
+    if (!_assetCache->section(ios_renderer::asset_section::player_unit_colors, playerColors, playerSize) ||
+        playerSize != sizeof(_spriteImageData.player_unit_colors) ||
+        !_assetCache->section(ios_renderer::asset_section::hp_bar_colors, hpBarColors, hpBarSize) ||
+        hpBarSize != sizeof(_spriteImageData.hp_bar_colors)) {
+        return NO;
+    }
+    std::memcpy(&_spriteImageData.player_unit_colors, playerColors, playerSize);
+    std::memcpy(&_spriteImageData.hp_bar_colors, hpBarColors, hpBarSize);
+    _spriteImageData.loaded = true;
+    return YES;
+}
+
 #pragma mark - Sprite Rendering
 
 - (void)drawImage:(const RenderImageInfo&)image toBuffer:(uint8_t*)fb pitch:(size_t)pitch {
@@ -876,6 +1443,7 @@ struct sprite_image_data {
     }
 
     auto& tileset = _tilesets[_currentTileset];
+    bool useMapTerrain = _hasMapTiles && _mapTerrain.tileset == _currentTileset;
     uint8_t* fb = _framebuffer.data();
 
     // Calculate visible tile range accounting for zoom
@@ -909,7 +1477,11 @@ struct sprite_image_data {
             // Note: In actual game, this comes from st.tiles_mega_tile_index
             // For now, use a simple repeating pattern based on position
             size_t megatileIndex = 0;
-            if (_hasMapTiles && mapTileWidth > 0) {
+            if (useMapTerrain) {
+                size_t tileIndex = static_cast<size_t>(tileX + tileY * mapTileWidth);
+                if (tileIndex >= _mapTerrain.tiles.size()) continue;
+                megatileIndex = static_cast<size_t>(_mapTerrain.tiles[tileIndex] & 0x7fff);
+            } else if (_hasMapTiles && mapTileWidth > 0) {
                 size_t tileIndex = static_cast<size_t>(tileX + tileY * mapTileWidth);
                 if (tileIndex < _mapTiles.size()) {
                     uint16_t tile = _mapTiles[tileIndex];
@@ -931,13 +1503,23 @@ struct sprite_image_data {
             uint8_t* dst = fb + std::max(0, screenY) * _width + std::max(0, screenX);
 
             // Draw the tile
-            ios_renderer::draw_tile(tileset, megatileIndex, dst, _width,
-                                   offsetX, offsetY, drawWidth, drawHeight);
+            if (useMapTerrain) {
+                ios_renderer::draw_tile(_mapTerrain, megatileIndex, dst, _width,
+                                       offsetX, offsetY, drawWidth, drawHeight);
+            } else {
+                ios_renderer::draw_tile(tileset, megatileIndex, dst, _width,
+                                       offsetX, offsetY, drawWidth, drawHeight);
+            }
         }
     }
 
     // Render sprites on top of tiles
     [self drawSprites];
+
+    // Fog of war over both
+    [self applyFogFromTileX:startTileX tileY:startTileY
+                    toTileX:endTileX tileY:endTileY
+                    cameraX:cameraX cameraY:cameraY];
 }
 
 - (void)renderTestPatternWithCameraX:(float)cameraX
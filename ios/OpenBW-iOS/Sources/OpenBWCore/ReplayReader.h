@@ -0,0 +1,432 @@
+// ReplayReader.h
+// Streaming reader for StarCraft replay files (.rep)
+//
+// Portable C++14 on POSIX (no Foundation/UIKit or OpenBW types). A replay is a
+// sequence of sections (id, header, action stream, map), each stored as chunks
+// that decode to at most 8 KB and are either raw or PKWare DCL imploded.
+// replay_file maps the file and finds the sections by walking chunk headers,
+// without decompressing anything but the small id and header sections.
+// replay_action_stream then decodes the action stream one chunk at a time as
+// playback reaches it, so a long game costs a few KB instead of its whole
+// action log. without_actions() builds a copy of the replay whose action
+// stream is empty, for handing the header and map to OpenBW's own loader.
+
+#ifndef REPLAYREADER_H
+#define REPLAYREADER_H
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace openbw_ios {
+
+namespace detail {
+
+struct explode_huffman {
+    short count[14] = {};       // Codes of each length (max 13 bits)
+    short symbol[256] = {};     // Symbols ordered by code
+
+    /// Tables are stored as bytes of (repeat - 1) << 4 | code length
+    explode_huffman(const uint8_t* rep, size_t n) {
+        uint8_t length[256];
+        size_t symbols = 0;
+        for (size_t i = 0; i < n; ++i) {
+            for (int left = (rep[i] >> 4) + 1; left > 0 && symbols < 256; --left) length[symbols++] = rep[i] & 15;
+        }
+        for (size_t s = 0; s < symbols; ++s) ++count[length[s]];
+        int left = 1;
+        for (int len = 1; len <= 13; ++len) {
+            left = (left << 1) - count[len];
+            if (left < 0) return;
+        }
+        short offsets[14] = {};
+        for (int len = 1; len < 13; ++len) offsets[len + 1] = offsets[len] + count[len];
+        for (size_t s = 0; s < symbols; ++s) {
+            if (length[s]) symbol[offsets[length[s]]++] = (short)s;
+        }
+    }
+};
+
+/// The format's fixed Huffman tables, shared by explode and implode
+struct pkware_tables {
+    explode_huffman literals;
+    explode_huffman lengths;
+    explode_huffman distances;
+    short length_base[16] = {3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
+    uint8_t length_extra[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+
+    static const pkware_tables& get() {
+        static const uint8_t literal_rep[] = {
+            11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
+            9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+            7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
+            8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+            44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
+            44, 173};
+        static const uint8_t length_rep[] = {2, 35, 36, 53, 38, 23};
+        static const uint8_t distance_rep[] = {2, 20, 53, 230, 247, 151, 248};
+        static const pkware_tables tables{explode_huffman(literal_rep, sizeof(literal_rep)),
+                                          explode_huffman(length_rep, sizeof(length_rep)),
+                                          explode_huffman(distance_rep, sizeof(distance_rep))};
+        return tables;
+    }
+};
+
+class explode_bits {
+public:
+    explode_bits(const uint8_t* data, size_t size) : data_(data), end_(data + size) {}
+
+    /// Least significant bit first; returns -1 past the end of the input
+    int get(int n) {
+        while (count_ < n) {
+            if (data_ == end_) return -1;
+            buffer_ |= (uint32_t)*data_++ << count_;
+            count_ += 8;
+        }
+        int value = (int)(buffer_ & ((1u << n) - 1));
+        buffer_ >>= n;
+        count_ -= n;
+        return value;
+    }
+
+    /// PKWare stores codes bit-reversed and complemented
+    int decode(const explode_huffman& h) {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= 13; ++len) {
+            int bit = get(1);
+            if (bit < 0) return -1;
+            code |= bit ^ 1;
+            int count = h.count[len];
+            if (code < first + count) return h.symbol[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+    uint32_t buffer_ = 0;
+    int count_ = 0;
+};
+
+/// Pass a previous result as crc to continue it over more data
+inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t c = crc ^ 0xffffffffu;
+    for (size_t i = 0; i < size; ++i) c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffu;
+}
+
+inline uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+inline void append_u32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+} // namespace detail
+
+/// Decompress PKWare DCL imploded data (replay chunks, MPQ sectors). Returns
+/// the number of bytes written, or -1 if the input is malformed or would
+/// overflow dst.
+inline long pkware_explode(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    const detail::pkware_tables& t = detail::pkware_tables::get();
+    detail::explode_bits in(src, src_size);
+    int coded_literals = in.get(8);
+    int dict_bits = in.get(8);
+    if (coded_literals < 0 || coded_literals > 1 || dict_bits < 4 || dict_bits > 6) return -1;
+
+    size_t out = 0;
+    while (true) {
+        int flag = in.get(1);
+        if (flag < 0) return -1;
+        if (flag) {
+            int symbol = in.decode(t.lengths);
+            if (symbol < 0) return -1;
+            int extra = in.get(t.length_extra[symbol]);
+            if (extra < 0) return -1;
+            int length = t.length_base[symbol] + extra;
+            if (length == 519) break;
+
+            int shift = length == 2 ? 2 : dict_bits;
+            int high = in.decode(t.distances);
+            int low = in.get(shift);
+            if (high < 0 || low < 0) return -1;
+            size_t distance = (size_t)((high << shift) + low + 1);
+            if (distance > out || (size_t)length > dst_size - out) return -1;
+            // Overlapping copies repeat the most recent bytes, so copy forwards
+            for (int i = 0; i < length; ++i, ++out) dst[out] = dst[out - distance];
+        }
+        else {
+            int symbol = coded_literals ? in.decode(t.literals) : in.get(8);
+            if (symbol < 0 || out == dst_size) return -1;
+            dst[out++] = (uint8_t)symbol;
+        }
+    }
+    return (long)out;
+}
+
+struct replay_player {
+    int slot = 0;
+    int id = -1;                // Player id used by the action stream
+    int type = 0;               // 0 inactive, 1 computer, 2 human
+    int race = 0;
+    int team = 0;
+    std::string name;
+};
+
+struct replay_header {
+    bool brood_war = false;
+    uint32_t frame_count = 0;
+    uint32_t start_time = 0;    // Also the game's initial random seed
+    std::string game_name;
+    std::string creator;
+    std::string map_name;
+    int map_width = 0;          // In tiles
+    int map_height = 0;
+    std::array<replay_player, 12> players;
+
+    /// Game player index for an action's player id byte, or -1
+    int owner_for_id(int id) const {
+        for (size_t i = 0; i < players.size(); ++i) {
+            if (players[i].type != 0 && players[i].id == id) return (int)i;
+        }
+        return -1;
+    }
+};
+
+class replay_file {
+public:
+    /// One stored section: where its chunks start and how big it decodes to
+    struct section {
+        size_t begin = 0;       // Offset of the checksum word
+        size_t chunks = 0;      // Offset of the first chunk
+        size_t end = 0;         // Offset just past the last chunk
+        uint32_t size = 0;
+        uint32_t chunk_count = 0;
+    };
+
+    static constexpr size_t chunk_size = 8192;
+    static constexpr size_t header_size = 0x279;
+
+    bool open(const std::string& path, std::string& error) {
+        if (!file_.open(path, mapped_file::access::sequential)) return fail(error, "cannot open " + path);
+
+        std::vector<uint8_t> id, header, length;
+        size_t pos = 0;
+        if (!read_section(pos, 4, id_) || !decode(id_, id)) return fail(error, "not a replay file");
+        if (std::memcmp(id.data(), "reRS", 4) != 0) {
+            return fail(error, std::memcmp(id.data(), "seRS", 4) == 0
+                ? "replays from StarCraft: Remastered are not supported"
+                : "not a replay file");
+        }
+        if (!read_section(pos, header_size, header_) || !decode(header_, header)) return fail(error, "bad replay header");
+        if (!read_section(pos, 4, action_length_) || !decode(action_length_, length)) return fail(error, "bad action stream");
+        if (!read_section(pos, detail::read_u32(length.data()), actions_)) return fail(error, "truncated action stream");
+        if (!read_section(pos, 4, map_length_) || !decode(map_length_, length)) return fail(error, "bad map section");
+        if (!read_section(pos, detail::read_u32(length.data()), map_)) return fail(error, "truncated map section");
+
+        parse_header(header);
+        return true;
+    }
+
+    bool is_open() const { return file_.is_open(); }
+    const replay_header& header() const { return parsed_; }
+    const section& actions() const { return actions_; }
+    const uint8_t* data() const { return file_.data(); }
+    size_t size() const { return file_.size(); }
+
+    /// Decode a whole section; false if any chunk is malformed
+    bool decode(const section& s, std::vector<uint8_t>& out) const {
+        out.resize(s.size);
+        size_t pos = s.chunks;
+        for (size_t offset = 0; offset < s.size; offset += chunk_size) {
+            long n = decode_chunk(pos, out.data() + offset, std::min(size_t(chunk_size), (size_t)s.size - offset));
+            if (n < 0) return false;
+        }
+        return true;
+    }
+
+    /// Decode the chunk at pos (a length word followed by its data) into dst,
+    /// which holds the chunk's expected size. Advances pos past the chunk.
+    long decode_chunk(size_t& pos, uint8_t* dst, size_t expected) const {
+        if (file_.size() - pos < 4) return -1;
+        size_t length = detail::read_u32(file_.data() + pos);
+        pos += 4;
+        if (file_.size() - pos < length) return -1;
+        const uint8_t* src = file_.data() + pos;
+        pos += length;
+        if (length == expected) {
+            std::memcpy(dst, src, length);
+            return (long)length;
+        }
+        long n = pkware_explode(src, length, dst, expected);
+        return n == (long)expected ? n : -1;
+    }
+
+    /// The map's CHK data
+    bool map_data(std::vector<uint8_t>& out) const { return decode(map_, out); }
+
+    /// The replay with its action stream replaced by an empty one. The other
+    /// sections are copied as stored, without decoding them.
+    std::vector<uint8_t> without_actions() const {
+        std::vector<uint8_t> out(file_.data(), file_.data() + action_length_.begin);
+        uint8_t zero[4] = {};
+        detail::append_u32(out, detail::crc32(zero, 4));
+        detail::append_u32(out, 1);
+        detail::append_u32(out, 4);
+        detail::append_u32(out, 0);
+        detail::append_u32(out, 0);     // Empty action section: no chunks
+        detail::append_u32(out, 0);
+        out.insert(out.end(), file_.data() + map_length_.begin, file_.data() + map_.end);
+        return out;
+    }
+
+private:
+    bool fail(std::string& error, std::string message) {
+        error = std::move(message);
+        file_.close();
+        return false;
+    }
+
+    /// Locate a section of the given decoded size by walking its chunk headers
+    bool read_section(size_t& pos, size_t size, section& s) const {
+        if (file_.size() - pos < 8) return false;
+        s.begin = pos;
+        s.size = (uint32_t)size;
+        s.chunk_count = detail::read_u32(file_.data() + pos + 4);
+        if (s.chunk_count != (size + chunk_size - 1) / chunk_size) return false;
+        pos += 8;
+        s.chunks = pos;
+        for (uint32_t i = 0; i < s.chunk_count; ++i) {
+            if (file_.size() - pos < 4) return false;
+            size_t length = detail::read_u32(file_.data() + pos);
+            if (file_.size() - pos - 4 < length) return false;
+            pos += 4 + length;
+        }
+        s.end = pos;
+        return true;
+    }
+
+    static std::string cstring(const uint8_t* p, size_t max) {
+        size_t n = 0;
+        while (n < max && p[n]) ++n;
+        return std::string(reinterpret_cast<const char*>(p), n);
+    }
+
+    void parse_header(const std::vector<uint8_t>& h) {
+        parsed_.brood_war = h[0x00] != 0;
+        parsed_.frame_count = detail::read_u32(&h[0x01]);
+        parsed_.start_time = detail::read_u32(&h[0x08]);
+        parsed_.game_name = cstring(&h[0x18], 28);
+        parsed_.map_width = h[0x34] | h[0x35] << 8;
+        parsed_.map_height = h[0x36] | h[0x37] << 8;
+        parsed_.creator = cstring(&h[0x48], 24);
+        parsed_.map_name = cstring(&h[0x61], 26);
+        for (size_t i = 0; i < parsed_.players.size(); ++i) {
+            const uint8_t* p = &h[0xa1 + i * 36];
+            replay_player& player = parsed_.players[i];
+            player.slot = p[0] | p[1] << 8;
+            player.id = (int)detail::read_u32(p + 4);
+            player.type = p[8];
+            player.race = p[9];
+            player.team = p[10];
+            player.name = cstring(p + 11, 25);
+        }
+    }
+
+    mapped_file file_;
+    section id_, header_, action_length_, actions_, map_length_, map_;
+    replay_header parsed_;
+};
+
+/// Incremental reader of a replay's action stream. The stream is a series of
+/// blocks {u32 frame, u8 size, size bytes of (player id, action) pairs}; only
+/// the chunks covering the blocks handed out so far are decoded.
+class replay_action_stream {
+public:
+    void reset(const replay_file& file) {
+        file_ = &file;
+        next_chunk_ = 0;
+        chunk_pos_ = file.actions().chunks;
+        decoded_ = 0;
+        buffer_.clear();
+        read_ = 0;
+        failed_ = false;
+    }
+
+    /// The next block if it is for `frame` or earlier. Blocks for one frame
+    /// may be split, so call until it returns false. The data stays valid
+    /// until the next call.
+    bool next_block(uint32_t frame, const uint8_t*& data, size_t& size) {
+        if (!fill(5)) return false;
+        uint32_t block_frame = detail::read_u32(buffer_.data() + read_);
+        if (block_frame > frame) return false;
+        size_t block_size = buffer_[read_ + 4];
+        if (!fill(5 + block_size)) return false;
+        data = buffer_.data() + read_ + 5;
+        size = block_size;
+        read_ += 5 + block_size;
+        return true;
+    }
+
+    /// Every block has been handed out (or the stream was truncated)
+    bool done() { return !fill(1); }
+    bool failed() const { return failed_; }
+
+    /// Decoded bytes held right now, and bytes decoded so far
+    size_t buffered_bytes() const { return buffer_.capacity(); }
+    size_t decoded_bytes() const { return decoded_; }
+
+private:
+    /// Make at least n unread bytes available, decoding chunks as needed
+    bool fill(size_t n) {
+        if (!file_) return false;
+        const replay_file::section& s = file_->actions();
+        while (buffer_.size() - read_ < n) {
+            if (failed_ || next_chunk_ == s.chunk_count) return false;
+            buffer_.erase(buffer_.begin(), buffer_.begin() + read_);
+            read_ = 0;
+            size_t expected = std::min(size_t(replay_file::chunk_size), (size_t)s.size - decoded_);
+            size_t old_size = buffer_.size();
+            buffer_.resize(old_size + expected);
+            if (file_->decode_chunk(chunk_pos_, buffer_.data() + old_size, expected) < 0) {
+                buffer_.resize(old_size);
+                failed_ = true;
+                return false;
+            }
+            decoded_ += expected;
+            ++next_chunk_;
+        }
+        return true;
+    }
+
+    const replay_file* file_ = nullptr;
+    uint32_t next_chunk_ = 0;
+    size_t chunk_pos_ = 0;
+    size_t decoded_ = 0;
+    std::vector<uint8_t> buffer_;   // Decoded bytes; [read_, size) not yet handed out
+    size_t read_ = 0;
+    bool failed_ = false;
+};
+
+} // namespace openbw_ios
+
+#endif // REPLAYREADER_H
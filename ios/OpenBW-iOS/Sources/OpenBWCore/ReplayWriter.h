@@ -0,0 +1,539 @@
+// ReplayWriter.h
+// Records game actions and writes them as StarCraft replay files (.rep)
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types), the counterpart of
+// ReplayReader.h. The simulation thread hands replay_recorder each frame's
+// executed actions; they are appended to an in-memory action stream in the
+// replay's block format, which costs a copy of a few bytes per action. A
+// background thread implodes the stream in 8 KB chunks as they fill and keeps
+// an autosave file current, so a crash leaves a replay of everything up to the
+// last autosave. save() writes a complete replay at any time from whatever is
+// recorded so far, compressing only the unfinished tail.
+
+#ifndef REPLAYWRITER_H
+#define REPLAYWRITER_H
+
+#include "ReplayReader.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace openbw_ios {
+
+namespace detail {
+
+class implode_bits {
+public:
+    explicit implode_bits(std::vector<uint8_t>& out) : out_(out) {}
+
+    /// Least significant bit first, matching explode_bits::get
+    void put(uint32_t value, int n) {
+        buffer_ |= (value & ((1u << n) - 1)) << count_;
+        count_ += n;
+        while (count_ >= 8) {
+            out_.push_back((uint8_t)buffer_);
+            buffer_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    void flush() {
+        if (count_) out_.push_back((uint8_t)buffer_);
+        buffer_ = 0;
+        count_ = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint32_t buffer_ = 0;
+    int count_ = 0;
+};
+
+struct implode_code {
+    uint16_t bits = 0;      // In the order put() emits them
+    uint8_t length = 0;
+};
+
+/// Encoder codes for a decoder table: canonical codes assigned the way
+/// explode_bits::decode walks them, then complemented and bit-reversed
+template<size_t N>
+std::array<implode_code, N> implode_codes(const explode_huffman& h) {
+    std::array<implode_code, N> codes{};
+    int code = 0, index = 0;
+    for (int len = 1; len <= 13; ++len) {
+        for (int i = 0; i < h.count[len]; ++i, ++code, ++index) {
+            if ((size_t)h.symbol[index] >= N) continue;
+            implode_code& c = codes[h.symbol[index]];
+            c.length = (uint8_t)len;
+            for (int k = 0; k < len; ++k) c.bits |= (uint16_t)((((code >> (len - 1 - k)) & 1) ^ 1) << k);
+        }
+        code <<= 1;
+    }
+    return codes;
+}
+
+inline void write_le(uint8_t* p, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+inline void write_cstring(uint8_t* p, const std::string& s, size_t max) {
+    std::memcpy(p, s.data(), std::min(s.size(), max - 1));
+}
+
+} // namespace detail
+
+/// Compress with PKWare DCL implode: uncoded literals and a 4 KB window, the
+/// variant StarCraft writes. Matches come from a hash chain over 3-byte
+/// prefixes, bounded per position so the cost stays linear.
+inline void pkware_implode(const uint8_t* src, size_t size, std::vector<uint8_t>& out) {
+    static const int dict_bits = 6;
+    static const size_t window = (size_t)64 << dict_bits;
+    static const int min_match = 3;
+    static const int max_match = 518;       // 519 marks the end of the data
+    static const int max_chain = 32;
+    static const int hash_bits = 12;
+
+    const detail::pkware_tables& t = detail::pkware_tables::get();
+    static const auto length_codes = detail::implode_codes<16>(t.lengths);
+    static const auto distance_codes = detail::implode_codes<64>(t.distances);
+
+    out.push_back(0);
+    out.push_back(dict_bits);
+    detail::implode_bits bits(out);
+
+    auto put_length = [&](int length) {
+        // Bases ascend from symbol 2; symbol 0 is length 3 and 1 is length 2
+        int symbol = 15;
+        while (symbol > 2 && t.length_base[symbol] > length) --symbol;
+        if (length < 4) symbol = length == 3 ? 0 : 1;
+        bits.put(1, 1);
+        bits.put(length_codes[symbol].bits, length_codes[symbol].length);
+        bits.put((uint32_t)(length - t.length_base[symbol]), t.length_extra[symbol]);
+    };
+
+    std::vector<int> head((size_t)1 << hash_bits, -1);
+    std::vector<int> prev(size, -1);
+    auto hash = [&](size_t pos) {
+        uint32_t v = (uint32_t)src[pos] | (uint32_t)src[pos + 1] << 8 | (uint32_t)src[pos + 2] << 16;
+        return (v * 2654435761u) >> (32 - hash_bits);
+    };
+    auto insert = [&](size_t pos) {
+        if (pos + min_match > size) return;
+        uint32_t h = hash(pos);
+        prev[pos] = head[h];
+        head[h] = (int)pos;
+    };
+
+    size_t pos = 0;
+    while (pos < size) {
+        int best_length = 0;
+        size_t best_distance = 0;
+        if (pos + min_match <= size) {
+            int limit = (int)std::min<size_t>(max_match, size - pos);
+            int candidate = head[hash(pos)];
+            for (int chain = 0; candidate >= 0 && chain < max_chain; ++chain, candidate = prev[candidate]) {
+                size_t distance = pos - (size_t)candidate;
+                if (distance > window) break;
+                int length = 0;
+                while (length < limit && src[candidate + length] == src[pos + length]) ++length;
+                if (length > best_length) {
+                    best_length = length;
+                    best_distance = distance;
+                    if (length == limit) break;
+                }
+            }
+        }
+
+        if (best_length >= min_match) {
+            put_length(best_length);
+            uint32_t d = (uint32_t)(best_distance - 1);
+            const detail::implode_code& c = distance_codes[d >> dict_bits];
+            bits.put(c.bits, c.length);
+            bits.put(d & ((1u << dict_bits) - 1), dict_bits);
+            for (int i = 0; i < best_length; ++i) insert(pos + i);
+            pos += best_length;
+        } else {
+            bits.put(0, 1);
+            bits.put(src[pos], 8);
+            insert(pos);
+            ++pos;
+        }
+    }
+    put_length(519);
+    bits.flush();
+}
+
+/// One stored chunk: its length word, then the imploded data, or the raw data
+/// if implode does not make it smaller (readers tell the two apart by size)
+inline void append_replay_chunk(std::vector<uint8_t>& out, const uint8_t* data, size_t size) {
+    std::vector<uint8_t> packed;
+    pkware_implode(data, size, packed);
+    bool raw = packed.size() >= size;
+    detail::append_u32(out, (uint32_t)(raw ? size : packed.size()));
+    if (raw) out.insert(out.end(), data, data + size);
+    else out.insert(out.end(), packed.begin(), packed.end());
+}
+
+/// A whole section: checksum, chunk count, then each 8 KB chunk
+inline void append_replay_section(std::vector<uint8_t>& out, const uint8_t* data, size_t size) {
+    const size_t chunk = replay_file::chunk_size;
+    detail::append_u32(out, detail::crc32(data, size));
+    detail::append_u32(out, (uint32_t)((size + chunk - 1) / chunk));
+    for (size_t offset = 0; offset < size; offset += chunk) {
+        append_replay_chunk(out, data + offset, std::min(chunk, size - offset));
+    }
+}
+
+/// The fixed-size header section for a melee game at fastest speed, the only
+/// kind this app creates. Fields not in replay_header are left zero.
+inline std::vector<uint8_t> encode_replay_header(const replay_header& h) {
+    std::vector<uint8_t> out(replay_file::header_size, 0);
+    int slots = 0;
+    for (const replay_player& p : h.players) slots += p.type != 0;
+
+    out[0x00] = h.brood_war ? 1 : 0;
+    detail::write_le(&out[0x01], h.frame_count, 4);
+    detail::write_le(&out[0x08], h.start_time, 4);
+    detail::write_cstring(&out[0x18], h.game_name, 28);
+    detail::write_le(&out[0x34], (uint32_t)h.map_width, 2);
+    detail::write_le(&out[0x36], (uint32_t)h.map_height, 2);
+    out[0x39] = (uint8_t)slots;
+    out[0x3a] = 6;                                  // Fastest
+    detail::write_le(&out[0x3c], 2, 2);             // Melee
+    detail::write_cstring(&out[0x48], h.creator, 24);
+    detail::write_cstring(&out[0x61], h.map_name, 26);
+    for (size_t i = 0; i < h.players.size(); ++i) {
+        const replay_player& p = h.players[i];
+        if (p.type == 0) continue;
+        uint8_t* d = &out[0xa1 + i * 36];
+        detail::write_le(d, (uint32_t)p.slot, 2);
+        detail::write_le(d + 4, (uint32_t)p.id, 4);
+        d[8] = (uint8_t)p.type;
+        d[9] = (uint8_t)p.race;
+        d[10] = (uint8_t)p.team;
+        detail::write_cstring(d + 11, p.name, 25);
+    }
+    for (uint32_t i = 0; i < 8; ++i) detail::write_le(&out[0x251 + i * 4], i, 4);
+    return out;
+}
+
+/// The sections every replay starts with: the id, the header with the game's
+/// length, and the length of the action stream that follows
+inline void append_replay_start(std::vector<uint8_t>& out, const replay_header& header, size_t action_bytes) {
+    append_replay_section(out, reinterpret_cast<const uint8_t*>("reRS"), 4);
+    std::vector<uint8_t> h = encode_replay_header(header);
+    append_replay_section(out, h.data(), h.size());
+    uint8_t length[4];
+    detail::write_le(length, (uint32_t)action_bytes, 4);
+    append_replay_section(out, length, 4);
+}
+
+/// A whole replay of an action stream in block format, compressed in one go.
+/// With no actions this is a game's setup, which OpenBW's replay loader turns
+/// into the game (see MeleeSetup.h).
+inline std::vector<uint8_t> encode_replay(const replay_header& header, const uint8_t* actions, size_t size,
+                                          const std::vector<uint8_t>& map_chk) {
+    std::vector<uint8_t> out;
+    append_replay_start(out, header, size);
+    append_replay_section(out, actions, size);
+    uint8_t length[4];
+    detail::write_le(length, (uint32_t)map_chk.size(), 4);
+    append_replay_section(out, length, 4);
+    append_replay_section(out, map_chk.data(), map_chk.size());
+    return out;
+}
+
+class replay_recorder {
+public:
+    /// The longest action a replay block can hold: a block's length byte
+    /// also counts the player id before each action
+    static constexpr size_t max_action_size = 254;
+
+    struct stats_t {
+        size_t actions = 0;
+        size_t stream_bytes = 0;        // Action stream, uncompressed
+        size_t compressed_bytes = 0;    // Chunks imploded so far
+        double compress_ms = 0;         // Background thread time spent imploding
+        size_t autosaves = 0;
+        uint32_t cut_frame = 0;         // Frame an action did not fit a block on, 0 if none
+    };
+
+    replay_recorder() = default;
+    replay_recorder(const replay_recorder&) = delete;
+    replay_recorder& operator=(const replay_recorder&) = delete;
+    ~replay_recorder() { stop(); }
+
+    /// Begin a new recording, discarding any previous one. header describes
+    /// the players and map (its frame count is filled in on each write) and
+    /// map_chk is embedded in every file. With an autosave path the file there
+    /// is rewritten every autosave_seconds while new actions arrive.
+    void start(const replay_header& header, std::vector<uint8_t> map_chk,
+               const std::string& autosave_path = std::string(), double autosave_seconds = 30) {
+        stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        header_ = header;
+        map_chk_ = std::make_shared<const std::vector<uint8_t>>(std::move(map_chk));
+        map_section_.reset();
+        autosave_path_ = autosave_path;
+        autosave_interval_ = std::chrono::duration<double>(std::max(1.0, autosave_seconds));
+        stream_.clear();
+        chunks_.clear();
+        chunk_crc_ = 0;
+        chunk_bytes_ = 0;
+        frame_ = 0;
+        cut_ = false;
+        dirty_ = false;
+        stats_ = stats_t();
+        stopping_ = false;
+        recording_ = true;
+        worker_ = std::thread([this] { run(); });
+    }
+
+    /// Finish the background thread. Nothing is written; call save() first
+    /// to keep the recording.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!recording_) return;
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        recording_ = false;
+    }
+
+    bool recording() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return recording_;
+    }
+
+    /// Simulation thread: the actions one player executed on frame, stored
+    /// back to back with each one's length in lengths. The frame's blocks are
+    /// built locally and appended under the lock in one step.
+    ///
+    /// An action is never split or dropped on its own, since the replay would
+    /// no longer play out as the game did. If one is longer than
+    /// max_action_size, the recording is cut before frame instead: nothing
+    /// from frame on is recorded, every file written ends there, and false is
+    /// returned (also once the cut has happened).
+    bool record(uint32_t frame, int player_id, const uint8_t* actions, const std::vector<size_t>& lengths) {
+        if (lengths.empty()) return true;
+        for (size_t length : lengths) {
+            if (length <= max_action_size) continue;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (recording_ && !cut_) {
+                cut_ = true;
+                stats_.cut_frame = frame;
+            }
+            return false;
+        }
+        block_.clear();
+        size_t block_start = 0;
+        for (size_t length : lengths) {
+            if (length == 0) continue;
+            if (block_.empty() || block_.size() - block_start - 5 + 1 + length > 255) {
+                block_start = block_.size();
+                detail::append_u32(block_, frame);
+                block_.push_back(0);
+            }
+            block_.push_back((uint8_t)player_id);
+            block_.insert(block_.end(), actions, actions + length);
+            block_[block_start + 4] = (uint8_t)(block_.size() - block_start - 5);
+            actions += length;
+        }
+        if (block_.empty()) return true;
+
+        bool chunk_ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!recording_) return true;
+            if (cut_) return false;
+            stream_.insert(stream_.end(), block_.begin(), block_.end());
+            stats_.actions += lengths.size();
+            stats_.stream_bytes += block_.size();
+            dirty_ = true;
+            chunk_ready = stream_.size() >= replay_file::chunk_size;
+        }
+        if (chunk_ready) cv_.notify_all();
+        return true;
+    }
+
+    /// Simulation thread: the game's current frame, the length written to
+    /// autosaves
+    void set_frame(uint32_t frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!cut_) frame_ = frame;
+    }
+
+    /// Write a replay of everything recorded so far, ending at end_frame.
+    /// Safe to call while recording continues; only the tail of the action
+    /// stream that the background thread has not compressed yet is imploded
+    /// here.
+    bool save(const std::string& path, uint32_t end_frame) {
+        snapshot s;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!recording_) return false;
+            s = take_snapshot();
+            if (cut_) end_frame = std::min(end_frame, stats_.cut_frame);
+        }
+        return write(path, s, end_frame);
+    }
+
+    stats_t stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    /// What a write needs, copied under the lock. Compressed chunks are
+    /// shared; only the uncompressed tail is copied.
+    struct snapshot {
+        replay_header header;
+        std::shared_ptr<const std::vector<uint8_t>> map_chk;
+        std::shared_ptr<const std::vector<uint8_t>> map_section;     // Null if not compressed yet
+        std::vector<std::shared_ptr<const std::vector<uint8_t>>> chunks;
+        uint32_t chunk_crc = 0;
+        size_t chunk_bytes = 0;
+        std::vector<uint8_t> tail;
+    };
+
+    snapshot take_snapshot() {
+        snapshot s;
+        s.header = header_;
+        s.map_chk = map_chk_;
+        s.map_section = map_section_;
+        s.chunks = chunks_;
+        s.chunk_crc = chunk_crc_;
+        s.chunk_bytes = chunk_bytes_;
+        s.tail = stream_;
+        return s;
+    }
+
+    static bool write(const std::string& path, const snapshot& s, uint32_t end_frame) {
+        const size_t chunk = replay_file::chunk_size;
+        size_t action_bytes = s.chunk_bytes + s.tail.size();
+        uint32_t crc = detail::crc32(s.tail.data(), s.tail.size(), s.chunk_crc);
+
+        std::vector<uint8_t> out;
+        replay_header header = s.header;
+        header.frame_count = end_frame;
+        append_replay_start(out, header, action_bytes);
+        detail::append_u32(out, crc);
+        detail::append_u32(out, (uint32_t)((action_bytes + chunk - 1) / chunk));
+        for (const auto& c : s.chunks) out.insert(out.end(), c->begin(), c->end());
+        for (size_t offset = 0; offset < s.tail.size(); offset += chunk) {
+            append_replay_chunk(out, s.tail.data() + offset, std::min(chunk, s.tail.size() - offset));
+        }
+
+        uint8_t length[4];
+        detail::write_le(length, (uint32_t)s.map_chk->size(), 4);
+        append_replay_section(out, length, 4);
+        if (s.map_section) out.insert(out.end(), s.map_section->begin(), s.map_section->end());
+        else append_replay_section(out, s.map_chk->data(), s.map_chk->size());
+
+        // Written to a temporary file and renamed, like the asset cache, so an
+        // interrupted autosave leaves the previous one intact
+        std::string temp = path + ".tmp";
+        FILE* f = std::fopen(temp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /// Background thread: compress the map once, then each full chunk of the
+    /// action stream as it fills, and autosave on the interval
+    void run() {
+        using clock = std::chrono::steady_clock;
+        const size_t chunk = replay_file::chunk_size;
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        std::shared_ptr<const std::vector<uint8_t>> map_chk = map_chk_;
+        lock.unlock();
+        auto section = std::make_shared<std::vector<uint8_t>>();
+        append_replay_section(*section, map_chk->data(), map_chk->size());
+        lock.lock();
+        map_section_ = section;
+
+        auto next_autosave = clock::now() + std::chrono::duration_cast<clock::duration>(autosave_interval_);
+        while (!stopping_) {
+            cv_.wait_until(lock, next_autosave, [&] { return stopping_ || stream_.size() >= chunk; });
+            if (stopping_) break;
+
+            while (stream_.size() >= chunk) {
+                // The bytes stay in stream_ until their chunk is stored, so a
+                // save() meanwhile still sees them, as part of the tail
+                std::vector<uint8_t> raw(stream_.begin(), stream_.begin() + chunk);
+                lock.unlock();
+                auto begin = clock::now();
+                auto packed = std::make_shared<std::vector<uint8_t>>();
+                append_replay_chunk(*packed, raw.data(), raw.size());
+                uint32_t crc = detail::crc32(raw.data(), raw.size(), chunk_crc_);
+                double ms = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+                lock.lock();
+                chunks_.push_back(packed);
+                chunk_crc_ = crc;
+                chunk_bytes_ += chunk;
+                stream_.erase(stream_.begin(), stream_.begin() + chunk);
+                stats_.compressed_bytes += packed->size();
+                stats_.compress_ms += ms;
+            }
+
+            if (clock::now() >= next_autosave) {
+                next_autosave = clock::now() + std::chrono::duration_cast<clock::duration>(autosave_interval_);
+                if (autosave_path_.empty() || !dirty_) continue;
+                dirty_ = false;
+                snapshot s = take_snapshot();
+                uint32_t frame = frame_;
+                std::string path = autosave_path_;
+                lock.unlock();
+                bool ok = write(path, s, frame);
+                lock.lock();
+                if (ok) ++stats_.autosaves;
+            }
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    bool recording_ = false;
+    bool stopping_ = false;
+
+    replay_header header_;
+    std::shared_ptr<const std::vector<uint8_t>> map_chk_;
+    std::shared_ptr<const std::vector<uint8_t>> map_section_;   // Null until compressed
+    std::string autosave_path_;
+    std::chrono::duration<double> autosave_interval_{30};
+
+    std::vector<uint8_t> stream_;               // Recorded blocks not yet in chunks_
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> chunks_;
+    uint32_t chunk_crc_ = 0;                    // Over the bytes in chunks_
+    size_t chunk_bytes_ = 0;
+    uint32_t frame_ = 0;
+    bool cut_ = false;                          // An action did not fit; see record()
+    bool dirty_ = false;                        // Actions since the last autosave
+    stats_t stats_;
+
+    std::vector<uint8_t> block_;                // Simulation thread scratch
+};
+
+} // namespace openbw_ios
+
+#endif // REPLAYWRITER_H
@@ -0,0 +1,298 @@
+// RewindBuffer.h
+// Recent game states for rewinding, kept as deltas between state images
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). Every few frames the
+// caller adds a state image (StateImage.h). Images of one game share their
+// layout, so consecutive ones are compared in fixed blocks and only the
+// blocks that changed are kept, with a full image every keyframe_every
+// captures. The actions executed each frame are logged alongside, so a
+// rewind restores the latest snapshot at or before its target and simulates
+// forward to it: any frame from the oldest snapshot on can be reached.
+//
+// Memory stays under a budget: the oldest snapshots go first, the next delta
+// becoming the new full image. Snapshots further back than the window go too.
+// The newest snapshot and the diff base are always kept, so a budget below
+// two images holds just those.
+// Capture cost is aimed at a fraction of frame time by spacing captures out:
+// the spacing follows an average of the measured cost per capture. This is a
+// target, not a bound. Spacing never exceeds max_interval, so captures that
+// cost more than that many frames' share overrun it, and a single capture
+// (a keyframe, say) can cost more than the average. stats_t reports both:
+// the spacing the fraction asked for and the captures that overran. Captures
+// doing extra work the others do not (a verification) can be kept out of the
+// average.
+
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace openbw_ios {
+
+class rewind_buffer {
+public:
+    static constexpr size_t block_bytes = 256;
+
+    struct settings {
+        int window_frames = 714;            // About 30 s at normal speed
+        size_t budget_bytes = 64u << 20;
+        int keyframe_every = 32;            // Captures per full image
+        double frame_ms = 42;
+        double capture_fraction = 0.05;     // Of frame time, averaged over the spacing
+        int max_interval = 48;              // Frames between captures at most
+    };
+
+    struct stats_t {
+        size_t snapshots = 0;
+        size_t keyframes = 0;
+        size_t bytes = 0;                   // Snapshots, action log and the diff base
+        int oldest_frame = -1;
+        int newest_frame = -1;
+        int interval = 1;                   // Current frames between captures
+        int wanted_interval = 1;            // Spacing the capture fraction asks for; above
+                                            // interval when max_interval caps it
+        double capture_ms = 0;              // Average cost of one measured capture
+        size_t captures = 0;                // Since the last clear, measured or not
+        size_t overruns = 0;                // Captures costlier than their frames' share
+        double unmeasured_ms = 0;           // Total cost of captures kept out of the average
+    };
+
+    rewind_buffer() = default;
+    explicit rewind_buffer(const settings& s) : settings_(s) {}
+
+    /// New limits apply to the snapshots already held
+    void configure(const settings& s) {
+        settings_ = s;
+        settings_.keyframe_every = std::max(1, settings_.keyframe_every);
+        settings_.max_interval = std::max(1, settings_.max_interval);
+        interval_ = std::min(interval_, settings_.max_interval);
+        trim(newest_frame());
+    }
+
+    const settings& config() const { return settings_; }
+
+    void clear() {
+        snapshots_.clear();
+        actions_.clear();
+        base_.clear();
+        snapshot_bytes_ = action_bytes_ = 0;
+        since_keyframe_ = 0;
+        interval_ = 1;
+        wanted_interval_ = 1;
+        capture_ms_ = 0;
+        captures_ = 0;
+        measured_ = 0;
+        overruns_ = 0;
+        unmeasured_ms_ = 0;
+    }
+
+    /// A capture is due at this frame
+    bool due(int frame) const {
+        return snapshots_.empty() || frame - snapshots_.back().frame >= interval_;
+    }
+
+    /// The image of the state at the start of frame (before its actions).
+    /// build_ms is what producing the image cost the caller; the spacing of
+    /// later captures follows it plus the cost of diffing here. With measure
+    /// false the capture did extra work later ones will not repeat: its cost
+    /// is added to unmeasured_ms instead of the average and is not counted
+    /// as an overrun.
+    void add(int frame, const uint8_t* image, size_t size, double build_ms, bool measure = true) {
+        auto start = std::chrono::steady_clock::now();
+        int spacing = snapshots_.empty() ? 1 : std::max(1, frame - snapshots_.back().frame);
+        if (!snapshots_.empty() && frame <= snapshots_.back().frame) {
+            drop_snapshots_after(frame - 1);
+            base_.clear();
+        }
+
+        snapshot s;
+        s.frame = frame;
+        s.size = size;
+        if (snapshots_.empty() || size != base_.size() || since_keyframe_ + 1 >= (size_t)settings_.keyframe_every) {
+            s.full = true;
+            s.data.assign(image, image + size);
+            base_.assign(image, image + size);
+            since_keyframe_ = 0;
+        } else {
+            for (size_t at = 0; at < size; at += block_bytes) {
+                size_t n = std::min(size_t(block_bytes), size - at);
+                if (std::memcmp(image + at, &base_[at], n) == 0) continue;
+                s.blocks.push_back((uint32_t)(at / block_bytes));
+                s.data.insert(s.data.end(), image + at, image + at + n);
+                std::memcpy(&base_[at], image + at, n);
+            }
+            ++since_keyframe_;
+        }
+        snapshot_bytes_ += s.bytes();
+        snapshots_.push_back(std::move(s));
+        trim(frame);
+
+        double ms = build_ms + std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double per_frame = settings_.frame_ms * settings_.capture_fraction;
+        ++captures_;
+        if (!measure) {
+            unmeasured_ms_ += ms;
+            return;
+        }
+        if (ms > per_frame * spacing) ++overruns_;
+        capture_ms_ = measured_++ == 0 ? ms : capture_ms_ * 0.875 + ms * 0.125;
+        wanted_interval_ = per_frame > 0 ? std::max(1, (int)std::ceil(capture_ms_ / per_frame)) : settings_.max_interval;
+        interval_ = std::min(wanted_interval_, settings_.max_interval);
+    }
+
+    /// Actions player executed at the start of frame
+    void add_actions(int frame, int player, const uint8_t* data, size_t size) {
+        if (size == 0 || snapshots_.empty()) return;
+        if (!actions_.empty() && frame < actions_.back().frame) return;
+        frame_actions a;
+        a.frame = frame;
+        a.player = player;
+        a.data.assign(data, data + size);
+        action_bytes_ += a.data.size();
+        actions_.push_back(std::move(a));
+    }
+
+    /// The image of the latest snapshot at or before frame; false if frame is
+    /// before the oldest one
+    bool restore(int frame, std::vector<uint8_t>& image, int& image_frame) const {
+        auto it = std::upper_bound(snapshots_.begin(), snapshots_.end(), frame,
+                                   [](int f, const snapshot& s) { return f < s.frame; });
+        if (it == snapshots_.begin()) return false;
+        auto target = it - 1;
+        auto key = target;
+        while (!key->full) --key;
+        image = key->data;
+        for (auto d = key + 1; d != it; ++d) apply(*d, image);
+        image_frame = target->frame;
+        return true;
+    }
+
+    /// Calls f(frame, player, data, size) for the logged actions of frames
+    /// from up to (not including) to, in order
+    template<typename F>
+    void for_each_action(int from, int to, F f) const {
+        auto it = std::lower_bound(actions_.begin(), actions_.end(), from,
+                                   [](const frame_actions& a, int frame) { return a.frame < frame; });
+        for (; it != actions_.end() && it->frame < to; ++it) f(it->frame, it->player, it->data.data(), it->data.size());
+    }
+
+    /// Forget snapshots after frame and actions from it on: the game went
+    /// back to frame, so they belong to a timeline that no longer exists.
+    /// The next capture is a full image.
+    void truncate_after(int frame) {
+        drop_snapshots_after(frame);
+        while (!actions_.empty() && actions_.back().frame >= frame) {
+            action_bytes_ -= actions_.back().data.size();
+            actions_.pop_back();
+        }
+        base_.clear();
+    }
+
+    int oldest_frame() const { return snapshots_.empty() ? -1 : snapshots_.front().frame; }
+    int newest_frame() const { return snapshots_.empty() ? -1 : snapshots_.back().frame; }
+
+    stats_t stats() const {
+        stats_t st;
+        st.snapshots = snapshots_.size();
+        for (const auto& s : snapshots_) st.keyframes += s.full;
+        st.bytes = snapshot_bytes_ + action_bytes_ + base_.size();
+        st.oldest_frame = oldest_frame();
+        st.newest_frame = newest_frame();
+        st.interval = interval_;
+        st.wanted_interval = wanted_interval_;
+        st.capture_ms = capture_ms_;
+        st.captures = captures_;
+        st.overruns = overruns_;
+        st.unmeasured_ms = unmeasured_ms_;
+        return st;
+    }
+
+private:
+    struct snapshot {
+        int frame = 0;
+        bool full = false;
+        size_t size = 0;                    // Image size
+        std::vector<uint32_t> blocks;       // Changed blocks, for a delta
+        std::vector<uint8_t> data;          // The image, or the changed blocks in order
+
+        size_t bytes() const { return sizeof(*this) + data.size() + blocks.size() * sizeof(uint32_t); }
+    };
+
+    struct frame_actions {
+        int frame = 0;
+        int player = 0;
+        std::vector<uint8_t> data;
+    };
+
+    void drop_snapshots_after(int frame) {
+        while (!snapshots_.empty() && snapshots_.back().frame > frame) {
+            snapshot_bytes_ -= snapshots_.back().bytes();
+            snapshots_.pop_back();
+        }
+    }
+
+    static void apply(const snapshot& delta, std::vector<uint8_t>& image) {
+        const uint8_t* p = delta.data.data();
+        for (uint32_t block : delta.blocks) {
+            size_t at = (size_t)block * block_bytes;
+            size_t n = std::min(size_t(block_bytes), delta.size - at);
+            std::memcpy(&image[at], p, n);
+            p += n;
+        }
+    }
+
+    // Drop snapshots before the window and past the budget, always keeping
+    // the newest. The oldest is always a full image: when it goes, the delta
+    // after it is applied to its data and takes its place.
+    void trim(int newest) {
+        auto over = [&] {
+            if (snapshots_.size() < 2) return false;
+            if (snapshots_[1].frame <= newest - settings_.window_frames) return true;
+            return snapshot_bytes_ + action_bytes_ + base_.size() > settings_.budget_bytes;
+        };
+        while (over()) {
+            snapshot& first = snapshots_[0];
+            snapshot& next = snapshots_[1];
+            snapshot_bytes_ -= first.bytes() + next.bytes();
+            if (!next.full) {
+                apply(next, first.data);
+                next.data = std::move(first.data);
+                next.blocks.clear();
+                next.blocks.shrink_to_fit();
+                next.full = true;
+            }
+            snapshot_bytes_ += next.bytes();
+            snapshots_.pop_front();
+        }
+        int oldest = oldest_frame();
+        while (!actions_.empty() && actions_.front().frame < oldest) {
+            action_bytes_ -= actions_.front().data.size();
+            actions_.pop_front();
+        }
+    }
+
+    settings settings_;
+    std::deque<snapshot> snapshots_;
+    std::deque<frame_actions> actions_;
+    std::vector<uint8_t> base_;             // The newest image, for diffing the next
+    size_t snapshot_bytes_ = 0;
+    size_t action_bytes_ = 0;
+    size_t since_keyframe_ = 0;
+    int interval_ = 1;
+    int wanted_interval_ = 1;
+    double capture_ms_ = 0;
+    size_t captures_ = 0;
+    size_t measured_ = 0;                   // Captures in the average
+    size_t overruns_ = 0;
+    double unmeasured_ms_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // REWINDBUFFER_H
@@ -0,0 +1,64 @@
+// SnapshotExchange.h
+// Lock-free triple buffer for handing per-frame snapshots between threads
+//
+// One producer (the simulation thread) and one consumer (the render thread).
+// The producer always has a private slot to write into, the consumer always has
+// a private slot to read from, and the third slot is swapped between them with
+// a single atomic exchange. Neither side ever blocks; a consumer that falls
+// behind simply skips to the newest published snapshot. Slots are reused, so
+// any containers inside T keep their capacity from frame to frame.
+
+#ifndef SNAPSHOTEXCHANGE_H
+#define SNAPSHOTEXCHANGE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace openbw_ios {
+
+template<typename T>
+class snapshot_exchange {
+public:
+    snapshot_exchange() = default;
+    snapshot_exchange(const snapshot_exchange&) = delete;
+    snapshot_exchange& operator=(const snapshot_exchange&) = delete;
+
+    /// Producer: the slot to fill for the next publish()
+    T& back() {
+        return slots_[back_];
+    }
+
+    /// Producer: make back() the newest snapshot and take over a free slot
+    void publish() {
+        uint8_t prev = middle_.exchange((uint8_t)(back_ | fresh_bit), std::memory_order_acq_rel);
+        back_ = prev & index_mask;
+    }
+
+    /// Consumer: switch front() to the newest published snapshot.
+    /// Returns false (and leaves front() unchanged) if nothing new was published.
+    bool acquire() {
+        if (!(middle_.load(std::memory_order_relaxed) & fresh_bit)) return false;
+        uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & index_mask;
+        return true;
+    }
+
+    /// Consumer: the snapshot obtained by the last successful acquire()
+    const T& front() const {
+        return slots_[front_];
+    }
+
+private:
+    static constexpr uint8_t index_mask = 0x3;
+    static constexpr uint8_t fresh_bit = 0x4;
+
+    std::array<T, 3> slots_;
+    uint8_t back_ = 0;                  // Owned by the producer
+    std::atomic<uint8_t> middle_{1};    // Shared; fresh_bit set when unread
+    uint8_t front_ = 2;                 // Owned by the consumer
+};
+
+} // namespace openbw_ios
+
+#endif // SNAPSHOTEXCHANGE_H
@@ -0,0 +1,157 @@
+// SpatialGrid.h
+// Uniform grid over axis-aligned bounding boxes for fast area queries
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types), so the same index can
+// back unit picking, box selection, minimap/overlay culling and AI queries.
+// The grid is rebuilt in bulk (clear, insert..., build) into a compact
+// cell-offset table, and queries only visit the cells the query rect covers.
+// An entry spanning several cells is reported once per query.
+
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+/// Half-open rectangle in world pixels: [left, right) x [top, bottom)
+struct grid_rect {
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+
+    bool intersects(const grid_rect& o) const {
+        return left < o.right && o.left < right && top < o.bottom && o.top < bottom;
+    }
+    bool contains(int x, int y) const {
+        return x >= left && x < right && y >= top && y < bottom;
+    }
+};
+
+template<typename T>
+class spatial_grid {
+public:
+    struct entry {
+        T value;
+        grid_rect bounds;
+    };
+
+    /// Size the grid for a world of width x height pixels.
+    /// cell_shift is log2 of the cell size (5 = one 32px tile per cell).
+    void reset(int world_width, int world_height, int cell_shift = 5) {
+        cell_shift_ = cell_shift;
+        cells_x_ = std::max(1, (world_width + (1 << cell_shift) - 1) >> cell_shift);
+        cells_y_ = std::max(1, (world_height + (1 << cell_shift) - 1) >> cell_shift);
+        cell_start_.assign((size_t)cells_x_ * cells_y_ + 1, 0);
+        clear();
+    }
+
+    /// Remove all entries, keeping allocated capacity
+    void clear() {
+        entries_.clear();
+        cell_entries_.clear();
+        built_ = false;
+    }
+
+    /// Add an entry; call build() once all entries are inserted
+    void insert(const T& value, const grid_rect& bounds) {
+        entries_.push_back({value, bounds});
+        built_ = false;
+    }
+
+    /// Bucket the inserted entries into cells (two-pass counting sort)
+    void build() {
+        std::fill(cell_start_.begin(), cell_start_.end(), 0);
+        for (const entry& e : entries_) {
+            int x0, y0, x1, y1;
+            if (!cell_range(e.bounds, x0, y0, x1, y1)) continue;
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) ++cell_start_[(size_t)y * cells_x_ + x + 1];
+            }
+        }
+        for (size_t i = 1; i < cell_start_.size(); ++i) cell_start_[i] += cell_start_[i - 1];
+
+        cell_entries_.resize(cell_start_.back());
+        fill_pos_.assign(cell_start_.begin(), cell_start_.end() - 1);
+        for (uint32_t i = 0; i < (uint32_t)entries_.size(); ++i) {
+            int x0, y0, x1, y1;
+            if (!cell_range(entries_[i].bounds, x0, y0, x1, y1)) continue;
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) cell_entries_[fill_pos_[(size_t)y * cells_x_ + x]++] = i;
+            }
+        }
+
+        visit_stamp_.assign(entries_.size(), 0);
+        query_stamp_ = 0;
+        built_ = true;
+    }
+
+    bool is_built() const { return built_; }
+    size_t size() const { return entries_.size(); }
+    const std::vector<entry>& entries() const { return entries_; }
+
+    /// Call f(const entry&) for every entry whose bounds intersect area
+    template<typename F>
+    void query(const grid_rect& area, F&& f) {
+        int x0, y0, x1, y1;
+        if (!built_ || !cell_range(area, x0, y0, x1, y1)) return;
+
+        if (++query_stamp_ == 0) {
+            // Stamp wrapped; forget every earlier visit
+            std::fill(visit_stamp_.begin(), visit_stamp_.end(), 0);
+            query_stamp_ = 1;
+        }
+
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                size_t cell = (size_t)y * cells_x_ + x;
+                for (uint32_t i = cell_start_[cell]; i != cell_start_[cell + 1]; ++i) {
+                    uint32_t index = cell_entries_[i];
+                    if (visit_stamp_[index] == query_stamp_) continue;
+                    visit_stamp_[index] = query_stamp_;
+                    const entry& e = entries_[index];
+                    if (e.bounds.intersects(area)) f(e);
+                }
+            }
+        }
+    }
+
+    /// Call f(const entry&) for every entry whose bounds contain (x, y)
+    template<typename F>
+    void query_point(int x, int y, F&& f) {
+        query({x, y, x + 1, y + 1}, std::forward<F>(f));
+    }
+
+private:
+    // Inclusive cell range covered by r, clamped to the grid.
+    // Returns false if r is empty or entirely outside the grid.
+    bool cell_range(const grid_rect& r, int& x0, int& y0, int& x1, int& y1) const {
+        if (r.right <= r.left || r.bottom <= r.top) return false;
+        x0 = std::max(0, r.left >> cell_shift_);
+        y0 = std::max(0, r.top >> cell_shift_);
+        x1 = std::min(cells_x_ - 1, (r.right - 1) >> cell_shift_);
+        y1 = std::min(cells_y_ - 1, (r.bottom - 1) >> cell_shift_);
+        return x0 <= x1 && y0 <= y1;
+    }
+
+    int cell_shift_ = 5;
+    int cells_x_ = 1;
+    int cells_y_ = 1;
+
+    std::vector<entry> entries_;
+    std::vector<uint32_t> cell_start_{0, 0};  // Offsets into cell_entries_, one per cell + end
+    std::vector<uint32_t> cell_entries_;      // Entry indices grouped by cell
+    std::vector<uint32_t> fill_pos_;          // Scratch for build()
+
+    std::vector<uint32_t> visit_stamp_;       // Per-entry dedupe for multi-cell entries
+    uint32_t query_stamp_ = 0;
+    bool built_ = false;
+};
+
+} // namespace openbw_ios
+
+#endif // SPATIALGRID_H
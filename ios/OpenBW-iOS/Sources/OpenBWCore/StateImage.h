@@ -0,0 +1,541 @@
+// StateImage.h
+// Compact binary images of pointer-linked game state
+//
+// Portable C++14 on POSIX (no Foundation/UIKit or OpenBW types). A game state
+// is a set of objects (the state struct, pooled units, sprites, images and so
+// on) that point at each other and at type tables in static data. Everything
+// a pointer may refer to is registered in object_regions under a pool id and
+// an index, so a pointer is saved as (pool, index, byte offset) and resolved
+// against wherever those objects live when the image is loaded.
+//
+// Objects are copied in bulk and only their declared pointer members are
+// rewritten, in the copy, so saving and loading each cost a memcpy per object
+// plus a fix-up per pointer. Members that own memory (std::vector and the
+// like) are declared opaque: their bytes are never written, the destination
+// keeps its own, and their contents are saved as separate sections. The
+// header carries a layout key built from the size, pointer offsets and opaque
+// ranges of every saved type, so an image from a build with different
+// layouts is rejected instead of misread.
+//
+// Everything else in an object is copied as is, so a pointer or owner left
+// out of its layout would be restored as a stale address. object_layout can
+// find such members in a live object: words that point into a registered
+// region, and words that change when the object is deep-copied (the copy
+// allocates memory of its own for whatever the original owns).
+//
+// Layout: header, then sections of {tag, count, bytes} padded to 8 bytes.
+
+#ifndef STATEIMAGE_H
+#define STATEIMAGE_H
+
+#include "MappedFile.h"
+#include "MegatileColors.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace openbw_ios {
+
+static_assert(sizeof(void*) == sizeof(uint64_t), "saved pointers are rewritten in place");
+
+/// Where pointers may point, by pool and index. Saved pointers are
+/// (pool + 1) << 56 | index << 32 | offset, and 0 is null.
+class object_regions {
+public:
+    void clear() {
+        regions_.clear();
+        by_index_.clear();
+    }
+
+    /// count objects of stride bytes at base, numbered first, first + 1, ...
+    /// within pool. Contiguous runs may be added one object at a time; they
+    /// are merged by finish().
+    void add(uint8_t pool, const void* base, size_t stride, size_t count = 1, uint32_t first = 0) {
+        if (!base || count == 0) return;
+        region r;
+        r.begin = reinterpret_cast<uintptr_t>(base);
+        r.end = r.begin + stride * count;
+        r.stride = stride;
+        r.first = first;
+        r.count = (uint32_t)count;
+        r.pool = pool;
+        regions_.push_back(r);
+    }
+
+    /// Sort and merge for lookups. A region may lie inside another (a pool
+    /// inside the state object), and pointers resolve to the innermost one;
+    /// false if two regions overlap without one containing the other.
+    bool finish() {
+        std::sort(regions_.begin(), regions_.end(), [](const region& a, const region& b) {
+            return a.begin != b.begin ? a.begin < b.begin : a.end > b.end;
+        });
+        std::vector<region> merged;
+        std::vector<int> open;              // Regions containing the current one, innermost last
+        for (region r : regions_) {
+            while (!open.empty() && merged[open.back()].end <= r.begin) open.pop_back();
+            if (!open.empty() && r.end > merged[open.back()].end) return false;
+            r.parent = open.empty() ? -1 : open.back();
+            if (!merged.empty()) {
+                region& last = merged.back();
+                if (r.begin == last.end && r.parent == last.parent && r.pool == last.pool &&
+                    r.stride == last.stride && r.first == last.first + last.count) {
+                    last.end = r.end;
+                    last.count += r.count;
+                    continue;
+                }
+            }
+            merged.push_back(r);
+            open.push_back((int)merged.size() - 1);
+        }
+        regions_ = std::move(merged);
+        by_index_ = regions_;
+        std::sort(by_index_.begin(), by_index_.end(), [](const region& a, const region& b) {
+            return a.pool != b.pool ? a.pool < b.pool : a.first < b.first;
+        });
+        return true;
+    }
+
+    bool encode(const void* p, uint64_t& out) const {
+        if (!p) {
+            out = 0;
+            return true;
+        }
+        uintptr_t address = reinterpret_cast<uintptr_t>(p);
+        auto it = std::upper_bound(regions_.begin(), regions_.end(), address,
+                                   [](uintptr_t a, const region& r) { return a < r.begin; });
+        if (it == regions_.begin()) return false;
+        const region* r = &*--it;
+        while (address >= r->end) {
+            if (r->parent < 0) return false;
+            r = &regions_[r->parent];
+        }
+        uint64_t offset = address - r->begin;
+        uint64_t index = r->first + offset / r->stride;
+        offset %= r->stride;
+        if (index >= (1u << 24) || offset > 0xffffffffu) return false;
+        out = (uint64_t)(r->pool + 1) << 56 | index << 32 | offset;
+        return true;
+    }
+
+    bool decode(uint64_t v, void*& out) const {
+        if (v == 0) {
+            out = nullptr;
+            return true;
+        }
+        uint8_t pool = (uint8_t)((v >> 56) - 1);
+        uint32_t index = (uint32_t)(v >> 32) & 0xffffff;
+        uint32_t offset = (uint32_t)v;
+        auto it = std::upper_bound(by_index_.begin(), by_index_.end(), std::make_pair(pool, index),
+                                   [](const std::pair<uint8_t, uint32_t>& k, const region& r) {
+                                       return k.first != r.pool ? k.first < r.pool : k.second < r.first;
+                                   });
+        if (it == by_index_.begin()) return false;
+        --it;
+        if (it->pool != pool || index - it->first >= it->count || offset >= it->stride) return false;
+        out = reinterpret_cast<void*>(it->begin + (index - it->first) * it->stride + offset);
+        return true;
+    }
+
+    size_t size() const { return regions_.size(); }
+
+private:
+    struct region {
+        uintptr_t begin = 0;
+        uintptr_t end = 0;
+        size_t stride = 0;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        int parent = -1;                // Index of the innermost containing region
+        uint8_t pool = 0;
+    };
+
+    std::vector<region> regions_;       // By address
+    std::vector<region> by_index_;      // By pool, then index
+};
+
+/// Size, pointer members and opaque members of one object type
+struct object_layout {
+    const char* name = "";
+    size_t size = 0;
+    std::vector<uint32_t> pointers;                         // Offsets of pointer members
+    std::vector<std::pair<uint32_t, uint32_t>> opaque;      // {offset, size} kept by the destination
+    std::vector<uint32_t> free_words;                       // Offsets of 8-byte words outside both
+
+    /// visit(object, members) calls members(m) for each pointer member m of
+    /// object and members.opaque(m) for each member that owns memory. Only
+    /// member addresses are taken; the object is never constructed or read.
+    template<typename T, typename visit_F>
+    static object_layout of(const char* name, visit_F visit) {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        T& object = reinterpret_cast<T&>(storage);
+        object_layout layout;
+        layout.name = name;
+        layout.size = sizeof(T);
+        recorder r{reinterpret_cast<const unsigned char*>(&object), &layout};
+        visit(object, r);
+        std::sort(layout.pointers.begin(), layout.pointers.end());
+        layout.pointers.erase(std::unique(layout.pointers.begin(), layout.pointers.end()), layout.pointers.end());
+        std::sort(layout.opaque.begin(), layout.opaque.end());
+
+        std::vector<bool> declared(layout.size / 8 + 1);
+        for (uint32_t offset : layout.pointers) declared[offset / 8] = true;
+        for (const auto& range : layout.opaque) {
+            for (uint32_t o = range.first & ~7u; o < range.first + range.second; o += 8) declared[o / 8] = true;
+        }
+        for (uint32_t offset = 0; offset + 8 <= layout.size; offset += 8) {
+            if (!declared[offset / 8]) layout.free_words.push_back(offset);
+        }
+        return layout;
+    }
+
+    /// Offsets of undeclared words in object that point into a registered
+    /// region: pointer members missing from the layout
+    std::vector<uint32_t> undeclared_pointers(const void* object, const object_regions& regions) const {
+        std::vector<uint32_t> found;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(object);
+        for (uint32_t offset : free_words) {
+            const void* word;
+            std::memcpy(&word, p + offset, sizeof(word));
+            uint64_t v;
+            if (word && regions.encode(word, v)) found.push_back(offset);
+        }
+        return found;
+    }
+
+    /// Offsets of undeclared words holding an address in object and a
+    /// different one in copy, a deep copy of it: members that own memory or
+    /// point into the object's own storage, missing from the layout
+    std::vector<uint32_t> undeclared_owners(const void* object, const void* copy) const {
+        std::vector<uint32_t> found;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(object);
+        const unsigned char* q = reinterpret_cast<const unsigned char*>(copy);
+        for (uint32_t offset : free_words) {
+            uint64_t a, b;
+            std::memcpy(&a, p + offset, sizeof(a));
+            std::memcpy(&b, q + offset, sizeof(b));
+            if (a != b && looks_like_address(a) && looks_like_address(b)) found.push_back(offset);
+        }
+        return found;
+    }
+
+    uint64_t key(uint64_t seed) const {
+        uint64_t h = fnv1a64(reinterpret_cast<const uint8_t*>(&size), sizeof(size), seed);
+        h = fnv1a64(reinterpret_cast<const uint8_t*>(pointers.data()), pointers.size() * sizeof(uint32_t), h);
+        return fnv1a64(reinterpret_cast<const uint8_t*>(opaque.data()), opaque.size() * sizeof(opaque[0]), h);
+    }
+
+private:
+    // User-space, 4-aligned and past the zero page. Copied values never
+    // differ between object and copy; this screens out padding, whose bytes
+    // a copy need not keep.
+    static bool looks_like_address(uint64_t v) {
+        return v >= 0x10000 && v < (uint64_t(1) << 48) && (v & 3) == 0;
+    }
+
+    struct recorder {
+        const unsigned char* base;
+        object_layout* layout;
+
+        template<typename P>
+        void operator()(P* const& member) const {
+            layout->pointers.push_back(offset(&member));
+        }
+
+        template<typename M>
+        void opaque(const M& member) const {
+            layout->opaque.emplace_back(offset(&member), (uint32_t)sizeof(M));
+        }
+
+        uint32_t offset(const void* member) const {
+            return (uint32_t)(reinterpret_cast<const unsigned char*>(member) - base);
+        }
+    };
+};
+
+/// Key over every layout in an image plus the caller's format version
+inline uint64_t state_image_key(const std::vector<const object_layout*>& layouts, uint64_t version) {
+    uint64_t h = fnv1a64(reinterpret_cast<const uint8_t*>(&version), sizeof(version));
+    for (const object_layout* layout : layouts) h = layout->key(h);
+    return h;
+}
+
+namespace detail {
+
+struct state_image_header {
+    char magic[4] = {'O', 'B', 'W', 'S'};
+    uint32_t version = 1;               // Of this container format
+    uint64_t key = 0;                   // state_image_key of the saved layouts
+    uint32_t frame = 0;
+    uint32_t section_count = 0;
+    uint64_t size = 0;                  // Whole image, header included
+};
+
+struct state_image_section {
+    uint32_t tag = 0;
+    uint32_t count = 0;                 // Objects or elements
+    uint64_t bytes = 0;                 // Payload, before padding
+};
+
+inline size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+} // namespace detail
+
+class state_image_writer {
+public:
+    state_image_writer() = default;
+
+    state_image_writer(uint64_t key, uint32_t frame) {
+        reset(key, frame);
+    }
+
+    /// Start a new image, keeping the buffer's memory for repeated captures
+    void reset(uint64_t key, uint32_t frame) {
+        detail::state_image_header h;
+        h.key = key;
+        h.frame = frame;
+        out_.clear();
+        out_.resize(sizeof(h));
+        std::memcpy(out_.data(), &h, sizeof(h));
+        sections_ = 0;
+    }
+
+    /// Plain bytes without pointers
+    void add_bytes(uint32_t tag, const void* data, size_t size, uint32_t count = 1) {
+        unsigned char* p = begin_section(tag, count, size);
+        if (size) std::memcpy(p, data, size);
+    }
+
+    template<typename T>
+    void add_vector(uint32_t tag, const std::vector<T>& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "add_objects handles elements with pointers");
+        add_bytes(tag, v.data(), v.size() * sizeof(T), (uint32_t)v.size());
+    }
+
+    /// count objects laid out as layout, where get(i) returns the i'th. False
+    /// with an error naming the member if a pointer is outside every region.
+    template<typename get_F>
+    bool add_objects(uint32_t tag, const object_layout& layout, size_t count, get_F get,
+                     const object_regions& regions, std::string& error) {
+        unsigned char* out = begin_section(tag, (uint32_t)count, layout.size * count);
+        for (size_t i = 0; i < count; ++i, out += layout.size) {
+            const unsigned char* object = reinterpret_cast<const unsigned char*>(get(i));
+            std::memcpy(out, object, layout.size);
+            for (const auto& range : layout.opaque) std::memset(out + range.first, 0, range.second);
+            for (uint32_t offset : layout.pointers) {
+                const void* p;
+                std::memcpy(&p, object + offset, sizeof(p));
+                uint64_t v;
+                if (!regions.encode(p, v)) {
+                    error = std::string(layout.name) + " #" + std::to_string(i) + ": pointer at +" +
+                            std::to_string(offset) + " is outside the registered objects";
+                    return false;
+                }
+                std::memcpy(out + offset, &v, sizeof(v));
+            }
+        }
+        return true;
+    }
+
+    template<typename T>
+    bool add_object_vector(uint32_t tag, const object_layout& layout, const std::vector<T>& v,
+                           const object_regions& regions, std::string& error) {
+        return add_objects(tag, layout, v.size(), [&](size_t i) { return &v[i]; }, regions, error);
+    }
+
+    const std::vector<uint8_t>& finish() {
+        detail::state_image_header h;
+        std::memcpy(&h, out_.data(), sizeof(h));
+        h.section_count = sections_;
+        h.size = out_.size();
+        std::memcpy(out_.data(), &h, sizeof(h));
+        return out_;
+    }
+
+    /// Written to a temporary file and renamed, like the asset cache
+    bool write(const std::string& path) {
+        finish();
+        std::string temp = path + ".tmp";
+        FILE* f = std::fopen(temp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(out_.data(), 1, out_.size(), f) == out_.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    unsigned char* begin_section(uint32_t tag, uint32_t count, size_t bytes) {
+        detail::state_image_section s;
+        s.tag = tag;
+        s.count = count;
+        s.bytes = bytes;
+        size_t at = out_.size();
+        out_.resize(at + sizeof(s) + detail::align8(bytes));
+        std::memcpy(&out_[at], &s, sizeof(s));
+        ++sections_;
+        return &out_[at + sizeof(s)];
+    }
+
+    std::vector<uint8_t> out_;
+    uint32_t sections_ = 0;
+};
+
+/// Reads sections back in the order they were written
+class state_image_reader {
+public:
+    bool open(const std::string& path, uint64_t key, std::string& error) {
+        if (!file_.open(path, mapped_file::access::sequential)) {
+            error = "cannot open " + path;
+            return false;
+        }
+        return open(file_.data(), file_.size(), key, error);
+    }
+
+    bool open(const uint8_t* data, size_t size, uint64_t key, std::string& error) {
+        detail::state_image_header h;
+        if (size < sizeof(h)) return fail(error, "not a state image");
+        std::memcpy(&h, data, sizeof(h));
+        if (std::memcmp(h.magic, "OBWS", 4) != 0) return fail(error, "not a state image");
+        if (h.version != detail::state_image_header().version || h.key != key) {
+            return fail(error, "state image from an incompatible build");
+        }
+        if (h.size != size) return fail(error, "truncated state image");
+        data_ = data;
+        size_ = size;
+        pos_ = sizeof(h);
+        frame_ = h.frame;
+        return true;
+    }
+
+    uint32_t frame() const { return frame_; }
+
+    bool read_bytes(uint32_t tag, void* data, size_t size, std::string& error) {
+        detail::state_image_section s;
+        const uint8_t* p = next(tag, s, error);
+        if (!p) return false;
+        if (s.bytes != size) return fail(error, "section " + std::to_string(tag) + " has the wrong size");
+        if (size) std::memcpy(data, p, size);
+        return true;
+    }
+
+    template<typename T>
+    bool read_vector(uint32_t tag, std::vector<T>& v, std::string& error) {
+        static_assert(std::is_trivially_copyable<T>::value, "read_objects handles elements with pointers");
+        detail::state_image_section s;
+        const uint8_t* p = next(tag, s, error);
+        if (!p) return false;
+        if (s.bytes != (uint64_t)s.count * sizeof(T)) return fail(error, "section " + std::to_string(tag) + " has the wrong size");
+        v.resize(s.count);
+        if (s.bytes) std::memcpy(v.data(), p, s.bytes);
+        return true;
+    }
+
+    /// count objects into get(i); the destination keeps its opaque members
+    template<typename get_F>
+    bool read_objects(uint32_t tag, const object_layout& layout, size_t count, get_F get,
+                      const object_regions& regions, std::string& error) {
+        detail::state_image_section s;
+        const uint8_t* in = next(tag, s, error);
+        if (!in) return false;
+        if (s.count != count || s.bytes != layout.size * count) {
+            return fail(error, std::string(layout.name) + " count or size differs from the image");
+        }
+        std::vector<unsigned char> kept;
+        for (size_t i = 0; i < count; ++i, in += layout.size) {
+            unsigned char* object = reinterpret_cast<unsigned char*>(get(i));
+            kept.clear();
+            for (const auto& range : layout.opaque) kept.insert(kept.end(), object + range.first, object + range.first + range.second);
+            std::memcpy(object, in, layout.size);
+            size_t k = 0;
+            for (const auto& range : layout.opaque) {
+                std::memcpy(object + range.first, &kept[k], range.second);
+                k += range.second;
+            }
+            for (uint32_t offset : layout.pointers) {
+                uint64_t v;
+                std::memcpy(&v, in + offset, sizeof(v));
+                void* p;
+                if (!regions.decode(v, p)) {
+                    return fail(error, std::string(layout.name) + " #" + std::to_string(i) + ": pointer at +" +
+                                std::to_string(offset) + " does not resolve");
+                }
+                std::memcpy(object + offset, &p, sizeof(p));
+            }
+        }
+        return true;
+    }
+
+    /// The vector must already have the saved length (pointers may refer to
+    /// its elements, so it cannot move while the image is read)
+    template<typename T>
+    bool read_object_vector(uint32_t tag, const object_layout& layout, std::vector<T>& v,
+                            const object_regions& regions, std::string& error) {
+        return read_objects(tag, layout, v.size(), [&](size_t i) { return &v[i]; }, regions, error);
+    }
+
+    /// Element count of the next section, for sizing containers before
+    /// registering them as regions
+    bool peek_count(uint32_t tag, uint32_t& count) const {
+        detail::state_image_section s;
+        if (pos_ + sizeof(s) > size_) return false;
+        std::memcpy(&s, data_ + pos_, sizeof(s));
+        if (s.tag != tag) return false;
+        count = s.count;
+        return true;
+    }
+
+    /// Element count of the first section with tag at or after the read
+    /// position, without reading anything
+    bool find_count(uint32_t tag, uint32_t& count) const {
+        detail::state_image_section s;
+        for (size_t pos = pos_; pos + sizeof(s) <= size_; pos += sizeof(s) + detail::align8(s.bytes)) {
+            std::memcpy(&s, data_ + pos, sizeof(s));
+            if (s.bytes > size_ - pos - sizeof(s)) return false;
+            if (s.tag == tag) {
+                count = s.count;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const uint8_t* next(uint32_t tag, detail::state_image_section& s, std::string& error) {
+        if (pos_ + sizeof(s) > size_) {
+            fail(error, "state image ends before section " + std::to_string(tag));
+            return nullptr;
+        }
+        std::memcpy(&s, data_ + pos_, sizeof(s));
+        if (s.tag != tag || s.bytes > size_ - pos_ - sizeof(s)) {
+            fail(error, "expected section " + std::to_string(tag));
+            return nullptr;
+        }
+        const uint8_t* p = data_ + pos_ + sizeof(s);
+        pos_ += sizeof(s) + detail::align8(s.bytes);
+        return p;
+    }
+
+    static bool fail(std::string& error, const std::string& message) {
+        error = message;
+        return false;
+    }
+
+    mapped_file file_;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+    uint32_t frame_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // STATEIMAGE_H
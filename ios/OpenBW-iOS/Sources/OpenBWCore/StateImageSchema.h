@@ -0,0 +1,426 @@
+// StateImageSchema.h
+// The engine's per-game objects as state images
+//
+// C++14 over OpenBW types (no Foundation/UIKit). Declares the pointer members
+// of the state object and its pooled units, sprites, images, orders and
+// bullets for StateImage.h: the links copy_state remaps, plus the pointers
+// into static data (type tables, GRPs, iscript programs), which resolve
+// against the loading player's global state. Members that own memory are
+// opaque and saved as their own sections. The image key covers every layout
+// here, so a change to these types rejects old images.
+//
+// Every other member is copied byte for byte, so before an image is written
+// or read into a state, the state is verified against the schema: a word
+// outside the declared members that points into engine objects, or (with a
+// deep copy to compare against) one that owns or points into memory of its
+// own, fails the save or load naming the type and offset to declare.
+
+#ifndef STATEIMAGESCHEMA_H
+#define STATEIMAGESCHEMA_H
+
+#include "bwgame.h"
+#include "StateImage.h"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+namespace openbw_ios {
+
+/// Pools of the objects saved pointers may refer to
+namespace state_image_pool {
+    static constexpr uint8_t state = 0;
+    static constexpr uint8_t tile_lines = 1;
+    static constexpr uint8_t units = 2;
+    static constexpr uint8_t sprites = 3;
+    static constexpr uint8_t images = 4;
+    static constexpr uint8_t orders = 5;
+    static constexpr uint8_t bullets = 6;
+    static constexpr uint8_t unit_types = 7;
+    static constexpr uint8_t weapon_types = 8;
+    static constexpr uint8_t upgrade_types = 9;
+    static constexpr uint8_t tech_types = 10;
+    static constexpr uint8_t order_types = 11;
+    static constexpr uint8_t flingy_types = 12;
+    static constexpr uint8_t sprite_types = 13;
+    static constexpr uint8_t image_types = 14;
+    static constexpr uint8_t grps = 15;
+    static constexpr uint8_t scripts = 16;
+    static constexpr uint8_t game = 17;         // Never saved; registered so the audit sees pointers into it
+    static constexpr uint8_t global = 18;
+}
+
+namespace state_image_section {
+    static constexpr uint32_t map = 1;
+    static constexpr uint32_t state = 2;
+    static constexpr uint32_t tiles = 3;
+    static constexpr uint32_t mega_tiles = 4;
+    static constexpr uint32_t tile_lines = 5;
+    static constexpr uint32_t units = 6;
+    static constexpr uint32_t sprites = 7;
+    static constexpr uint32_t images = 8;
+    static constexpr uint32_t orders = 9;
+    static constexpr uint32_t bullets = 10;
+}
+
+// 2: images are only written from verified states
+static constexpr uint64_t state_image_version = 2;
+
+namespace state_image_detail {
+
+template<typename link_T, typename F>
+void visit_link(link_T& link, F& f) {
+    f(link.first);
+    f(link.second);
+}
+
+template<typename list_T, typename F>
+void visit_list(list_T& list, F& f) {
+    visit_link(list.header, f);
+}
+
+template<typename F>
+void visit_flingy(bwgame::flingy_t& o, F& f) {
+    visit_link(o.link, f);
+    f(o.flingy_type);
+    f(o.sprite);
+    f(o.move_target.unit);
+}
+
+template<typename F>
+void visit_unit(bwgame::unit_t& u, F& f) {
+    visit_flingy(u, f);
+    f(u.unit_type);
+    f(u.previous_unit_type);
+    f(u.order_type);
+    f(u.order_unit_type);
+    f(u.order_target.unit);
+    visit_link(u.player_units_link, f);
+    visit_list(u.order_queue, f);
+    f(u.subunit);
+    f(u.auto_target_unit);
+    f(u.connected_unit);
+    f(u.current_build_unit);
+    for (auto& type : u.build_queue) f(type);
+    f(u.previous_attacking_unit);
+    f(u.irradiated_by);
+    f(u.building.addon);
+    f(u.building.addon_build_type);
+    f(u.building.researching_type);
+    f(u.building.upgrading_type);
+    f(u.worker.gather_target);
+    f(u.worker.target_resource_unit);
+    f(u.fighter.parent);
+    visit_link(u.fighter.fighter_link, f);
+    visit_list(u.carrier.inside_units, f);
+    visit_list(u.carrier.outside_units, f);
+}
+
+template<typename F>
+void visit_sprite(bwgame::sprite_t& s, F& f) {
+    visit_link(s.link, f);
+    f(s.sprite_type);
+    f(s.main_image);
+    visit_list(s.images, f);
+}
+
+template<typename F>
+void visit_image(bwgame::image_t& i, F& f) {
+    visit_link(i.link, f);
+    f(i.image_type);
+    f(i.sprite);
+    f(i.grp);
+    f(i.iscript_state.current_script);
+}
+
+template<typename F>
+void visit_order(bwgame::order_t& o, F& f) {
+    visit_link(o.link, f);
+    f(o.order_type);
+    f(o.unit_type);
+    f(o.target.unit);
+}
+
+template<typename F>
+void visit_bullet(bwgame::bullet_t& b, F& f) {
+    visit_flingy(b, f);
+    f(b.weapon_type);
+    f(b.bullet_target);
+    f(b.bullet_owner_unit);
+    f(b.prev_bounce_unit);
+}
+
+// The state object itself: its pools and per-tile arrays are sections of
+// their own, and the game and global pointers stay the loading player's
+template<typename F>
+void visit_state(bwgame::state& st, F& f) {
+    f.opaque(st.game);
+    f.opaque(st.global);
+    f.opaque(st.tiles);
+    f.opaque(st.tiles_mega_tile_index);
+    f.opaque(st.sprites_on_tile_line);
+    f.opaque(st.units);
+    f.opaque(st.sprites);
+    f.opaque(st.images);
+    f.opaque(st.orders);
+    f.opaque(st.bullets);
+    visit_list(st.visible_units, f);
+    visit_list(st.hidden_units, f);
+    visit_list(st.scanner_sweep_units, f);
+    visit_list(st.sight_related_units, f);
+    visit_list(st.cloaked_units, f);
+    visit_list(st.active_bullets, f);
+    visit_list(st.free_units, f);
+    visit_list(st.free_sprites, f);
+    visit_list(st.free_images, f);
+    visit_list(st.free_orders, f);
+    visit_list(st.free_bullets, f);
+    for (auto& list : st.player_units) visit_list(list, f);
+}
+
+template<typename pool_T>
+void add_pool(object_regions& regions, uint8_t pool, pool_T& objects) {
+    regions.add(pool, objects.data(), sizeof(objects[0]), objects.size());
+}
+
+// Type tables are registered an entry at a time by id; entries of one table
+// are contiguous, so they merge into one region
+template<typename get_F>
+void add_types(object_regions& regions, uint8_t pool, int count, get_F get) {
+    for (int id = 0; id < count; ++id) {
+        const auto* type = get(id);
+        regions.add(pool, type, sizeof(*type), 1, (uint32_t)id);
+    }
+}
+
+template<typename pool_T>
+bool write_pool(state_image_writer& writer, uint32_t tag, const object_layout& layout, pool_T& pool,
+                const object_regions& regions, std::string& error) {
+    return writer.add_objects(tag, layout, pool.size(), [&](size_t i) { return &pool[i]; }, regions, error);
+}
+
+template<typename pool_T>
+bool read_pool(state_image_reader& reader, uint32_t tag, const object_layout& layout, pool_T& pool,
+               const object_regions& regions, std::string& error) {
+    return reader.read_objects(tag, layout, pool.size(), [&](size_t i) { return &pool[i]; }, regions, error);
+}
+
+// Pools held in vectors take the image's size; fixed pools must match it
+template<typename T, typename A>
+bool size_pool(std::vector<T, A>& pool, uint32_t count) {
+    pool.resize(count);
+    return true;
+}
+
+template<typename pool_T>
+bool size_pool(pool_T& pool, uint32_t count) {
+    return pool.size() == count;
+}
+
+template<typename pool_T>
+bool size_pool_for(const state_image_reader& reader, uint32_t tag, pool_T& pool) {
+    uint32_t count = 0;
+    return reader.find_count(tag, count) && size_pool(pool, count);
+}
+
+} // namespace state_image_detail
+
+struct state_image_schema {
+    using tile_line_t = std::decay<decltype(std::declval<bwgame::state&>().sprites_on_tile_line[0])>::type;
+
+    object_layout state, tile_line, unit, sprite, image, order, bullet;
+    uint64_t key = 0;
+
+    static const state_image_schema& get() {
+        static const state_image_schema schema;
+        return schema;
+    }
+
+private:
+    state_image_schema() {
+        using namespace state_image_detail;
+        state = object_layout::of<bwgame::state>("state", [](bwgame::state& o, auto& f) { visit_state(o, f); });
+        tile_line = object_layout::of<tile_line_t>("sprites_on_tile_line", [](tile_line_t& o, auto& f) { visit_list(o, f); });
+        unit = object_layout::of<bwgame::unit_t>("unit_t", [](bwgame::unit_t& o, auto& f) { visit_unit(o, f); });
+        sprite = object_layout::of<bwgame::sprite_t>("sprite_t", [](bwgame::sprite_t& o, auto& f) { visit_sprite(o, f); });
+        image = object_layout::of<bwgame::image_t>("image_t", [](bwgame::image_t& o, auto& f) { visit_image(o, f); });
+        order = object_layout::of<bwgame::order_t>("order_t", [](bwgame::order_t& o, auto& f) { visit_order(o, f); });
+        bullet = object_layout::of<bwgame::bullet_t>("bullet_t", [](bwgame::bullet_t& o, auto& f) { visit_bullet(o, f); });
+        key = state_image_key({&state, &tile_line, &unit, &sprite, &image, &order, &bullet}, state_image_version);
+    }
+};
+
+/// Add everything a saved pointer may refer to in st and its global state,
+/// plus the game and global state objects themselves, to regions. Images
+/// that hold more than the state add their own objects before finishing.
+inline void add_state_image_regions(bwgame::state& st, bwgame::state_functions& funcs, object_regions& regions) {
+    using namespace state_image_detail;
+    namespace pool = state_image_pool;
+    regions.add(pool::state, &st, sizeof(st));
+    regions.add(pool::tile_lines, st.sprites_on_tile_line.data(), sizeof(st.sprites_on_tile_line[0]),
+                st.sprites_on_tile_line.size());
+    add_pool(regions, pool::units, st.units);
+    add_pool(regions, pool::sprites, st.sprites);
+    add_pool(regions, pool::images, st.images);
+    add_pool(regions, pool::orders, st.orders);
+    add_pool(regions, pool::bullets, st.bullets);
+
+    using bwgame::UnitTypes;
+    using bwgame::WeaponTypes;
+    using bwgame::UpgradeTypes;
+    using bwgame::TechTypes;
+    using bwgame::Orders;
+    using bwgame::FlingyTypes;
+    using bwgame::SpriteTypes;
+    using bwgame::ImageTypes;
+    add_types(regions, pool::unit_types, (int)UnitTypes::None, [&](int id) { return funcs.get_unit_type((UnitTypes)id); });
+    add_types(regions, pool::weapon_types, (int)WeaponTypes::None, [&](int id) { return funcs.get_weapon_type((WeaponTypes)id); });
+    add_types(regions, pool::upgrade_types, (int)UpgradeTypes::None, [&](int id) { return funcs.get_upgrade_type((UpgradeTypes)id); });
+    add_types(regions, pool::tech_types, (int)TechTypes::None, [&](int id) { return funcs.get_tech_type((TechTypes)id); });
+    add_types(regions, pool::order_types, (int)Orders::None, [&](int id) { return funcs.get_order_type((Orders)id); });
+    add_types(regions, pool::flingy_types, (int)FlingyTypes::None, [&](int id) { return funcs.get_flingy_type((FlingyTypes)id); });
+    add_types(regions, pool::sprite_types, (int)SpriteTypes::None, [&](int id) { return funcs.get_sprite_type((SpriteTypes)id); });
+    add_types(regions, pool::image_types, (int)ImageTypes::None, [&](int id) { return funcs.get_image_type((ImageTypes)id); });
+
+    // GRPs are shared between image ids; each is registered once, under the
+    // first image id that uses it
+    bwgame::global_state& global_st = *st.global;
+    std::unordered_set<const void*> grps;
+    for (size_t id = 0; id < global_st.image_grp.size(); ++id) {
+        const auto* grp = global_st.image_grp[id];
+        if (grp && grps.insert(grp).second) regions.add(pool::grps, grp, sizeof(*grp), 1, (uint32_t)id);
+    }
+    for (const auto& script : global_st.iscript.scripts) {
+        regions.add(pool::scripts, &script.second, sizeof(script.second), 1, (uint32_t)script.first);
+    }
+    regions.add(pool::game, st.game, sizeof(*st.game));
+    regions.add(pool::global, st.global, sizeof(*st.global));
+}
+
+/// Everything a saved pointer in a state image may refer to
+inline bool state_image_regions(bwgame::state& st, bwgame::state_functions& funcs, object_regions& regions) {
+    regions.clear();
+    add_state_image_regions(st, funcs, regions);
+    return regions.finish();
+}
+
+/// False, with an error naming the members to declare, if st has members the
+/// schema does not cover. copy is a deep copy of st (copy_state) to find
+/// owners with, or null to check only for pointers into regions, which is
+/// cheap enough for every rewind capture.
+inline bool verify_state_image(bwgame::state& st, const bwgame::state* copy, const object_regions& regions,
+                               std::string& error) {
+    const state_image_schema& schema = state_image_schema::get();
+    std::set<std::pair<std::string, uint32_t>> missing;
+    auto check = [&](const object_layout& layout, const void* object, const void* copied) {
+        for (uint32_t offset : layout.undeclared_pointers(object, regions)) missing.emplace(layout.name, offset);
+        if (!copied) return;
+        for (uint32_t offset : layout.undeclared_owners(object, copied)) missing.emplace(layout.name, offset);
+    };
+    check(schema.state, &st, copy);
+    for (size_t i = 0; i < st.sprites_on_tile_line.size(); ++i) {
+        check(schema.tile_line, &st.sprites_on_tile_line[i], copy ? &copy->sprites_on_tile_line[i] : nullptr);
+    }
+    for (size_t i = 0; i < st.units.size(); ++i) check(schema.unit, &st.units[i], copy ? &copy->units[i] : nullptr);
+    for (size_t i = 0; i < st.sprites.size(); ++i) check(schema.sprite, &st.sprites[i], copy ? &copy->sprites[i] : nullptr);
+    for (size_t i = 0; i < st.images.size(); ++i) check(schema.image, &st.images[i], copy ? &copy->images[i] : nullptr);
+    for (size_t i = 0; i < st.orders.size(); ++i) check(schema.order, &st.orders[i], copy ? &copy->orders[i] : nullptr);
+    for (size_t i = 0; i < st.bullets.size(); ++i) check(schema.bullet, &st.bullets[i], copy ? &copy->bullets[i] : nullptr);
+    if (missing.empty()) return true;
+
+    error = "State image schema is missing members:";
+    for (const auto& m : missing) error += " " + m.first + "+" + std::to_string(m.second);
+    return false;
+}
+
+/// Append the sections of st's image to writer, with regions covering st
+/// (add_state_image_regions) that st has been verified against
+inline bool write_state_sections(state_image_writer& writer, bwgame::state& st, uint64_t map_key,
+                                 const object_regions& regions, std::string& error) {
+    using namespace state_image_detail;
+    namespace section = state_image_section;
+    const state_image_schema& schema = state_image_schema::get();
+    writer.add_bytes(section::map, &map_key, sizeof(map_key));
+    if (!writer.add_objects(section::state, schema.state, 1, [&](size_t) { return &st; }, regions, error)) return false;
+    writer.add_vector(section::tiles, st.tiles);
+    writer.add_vector(section::mega_tiles, st.tiles_mega_tile_index);
+    return writer.add_object_vector(section::tile_lines, schema.tile_line, st.sprites_on_tile_line, regions, error) &&
+           write_pool(writer, section::units, schema.unit, st.units, regions, error) &&
+           write_pool(writer, section::sprites, schema.sprite, st.sprites, regions, error) &&
+           write_pool(writer, section::images, schema.image, st.images, regions, error) &&
+           write_pool(writer, section::orders, schema.order, st.orders, regions, error) &&
+           write_pool(writer, section::bullets, schema.bullet, st.bullets, regions, error);
+}
+
+/// Image of the per-game state of st, played on the map with content key
+/// map_key. Fails without writing if verify_state_image does.
+inline bool write_state_image(state_image_writer& writer, bwgame::state& st, bwgame::state_functions& funcs,
+                              uint64_t map_key, const bwgame::state* copy, std::string& error) {
+    object_regions regions;
+    if (!state_image_regions(st, funcs, regions)) {
+        error = "Engine objects overlap";
+        return false;
+    }
+    if (!verify_state_image(st, copy, regions, error)) return false;
+
+    writer.reset(state_image_schema::get().key, (uint32_t)st.current_frame);
+    return write_state_sections(writer, st, map_key, regions, error);
+}
+
+/// Size the tile lines and object pools of st like the image's, so a state
+/// that has not loaded the image's map (or any map) can read it. Call before
+/// prepare_state_image, which registers the containers where they are then.
+inline bool size_state_for_image(const state_image_reader& reader, bwgame::state& st) {
+    using namespace state_image_detail;
+    namespace section = state_image_section;
+    return size_pool_for(reader, section::tile_lines, st.sprites_on_tile_line) &&
+           size_pool_for(reader, section::units, st.units) &&
+           size_pool_for(reader, section::sprites, st.sprites) &&
+           size_pool_for(reader, section::images, st.images) &&
+           size_pool_for(reader, section::orders, st.orders) &&
+           size_pool_for(reader, section::bullets, st.bullets);
+}
+
+/// First half of reading an image into st: checks that it was saved on the
+/// map with content key map_key and verifies st as write_state_image does,
+/// filling regions for read_state_image. Nothing is written.
+inline bool prepare_state_image(state_image_reader& reader, bwgame::state& st, bwgame::state_functions& funcs,
+                                uint64_t map_key, const bwgame::state* copy, object_regions& regions,
+                                std::string& error) {
+    uint64_t saved_key = 0;
+    if (!reader.read_bytes(state_image_section::map, &saved_key, sizeof(saved_key), error)) return false;
+    if (saved_key == 0 || saved_key != map_key) {
+        error = "The state was saved on a different map";
+        return false;
+    }
+    if (!state_image_regions(st, funcs, regions)) {
+        error = "Engine objects overlap";
+        return false;
+    }
+    return verify_state_image(st, copy, regions, error);
+}
+
+/// Replace the per-game state of st with the image. If a section fails to
+/// read, st is left partly replaced and must not be stepped.
+inline bool read_state_image(state_image_reader& reader, bwgame::state& st, const object_regions& regions,
+                             std::string& error) {
+    using namespace state_image_detail;
+    namespace section = state_image_section;
+    const state_image_schema& schema = state_image_schema::get();
+    return reader.read_objects(section::state, schema.state, 1, [&](size_t) { return &st; }, regions, error) &&
+           reader.read_vector(section::tiles, st.tiles, error) &&
+           reader.read_vector(section::mega_tiles, st.tiles_mega_tile_index, error) &&
+           reader.read_object_vector(section::tile_lines, schema.tile_line, st.sprites_on_tile_line, regions, error) &&
+           read_pool(reader, section::units, schema.unit, st.units, regions, error) &&
+           read_pool(reader, section::sprites, schema.sprite, st.sprites, regions, error) &&
+           read_pool(reader, section::images, schema.image, st.images, regions, error) &&
+           read_pool(reader, section::orders, schema.order, st.orders, regions, error) &&
+           read_pool(reader, section::bullets, schema.bullet, st.bullets, regions, error);
+}
+
+} // namespace openbw_ios
+
+#endif // STATEIMAGESCHEMA_H
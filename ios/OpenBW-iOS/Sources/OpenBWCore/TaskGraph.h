@@ -0,0 +1,194 @@
+// TaskGraph.h
+// Small dependency-ordered task executor for startup work
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). Tasks are added with
+// the names of the tasks they depend on, then run() executes them on a pool
+// of worker threads, starting each task as soon as its dependencies finish.
+// Every task's start and end time is recorded, so after a run the critical
+// path (the chain of dependent tasks that bounds total time) can be reported.
+// A task that throws marks the run failed; tasks depending on it are skipped.
+
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace openbw_ios {
+
+class task_graph {
+public:
+    struct task_result {
+        std::string name;
+        double start_ms = 0;        // Relative to the start of run()
+        double end_ms = 0;
+        bool ran = false;
+        bool failed = false;
+        std::string error;
+    };
+
+    /// Returns the task's index. Dependencies must already have been added.
+    size_t add(std::string name, std::function<void()> fn, const std::vector<std::string>& depends_on = {}) {
+        task t;
+        t.result.name = std::move(name);
+        t.fn = std::move(fn);
+        for (const std::string& dep : depends_on) {
+            size_t index = find(dep);
+            if (index == npos) throw std::invalid_argument("task_graph: unknown dependency " + dep);
+            t.deps.push_back(index);
+        }
+        tasks_.push_back(std::move(t));
+        return tasks_.size() - 1;
+    }
+
+    /// Run every task; returns false if any task threw or was skipped
+    bool run(size_t worker_count) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<size_t> remaining(tasks_.size());
+        std::vector<std::vector<size_t>> dependents(tasks_.size());
+        std::vector<size_t> ready;
+        for (size_t i = 0; i < tasks_.size(); ++i) {
+            task_result fresh;
+            fresh.name = std::move(tasks_[i].result.name);
+            tasks_[i].result = std::move(fresh);
+            remaining[i] = tasks_[i].deps.size();
+            for (size_t dep : tasks_[i].deps) dependents[dep].push_back(i);
+            if (remaining[i] == 0) ready.push_back(i);
+        }
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t finished = 0;
+        bool ok = true;
+        auto elapsed = [&] {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        auto worker = [&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                cv.wait(lock, [&] { return !ready.empty() || finished == tasks_.size(); });
+                if (ready.empty()) return;
+                size_t i = ready.back();
+                ready.pop_back();
+                task& t = tasks_[i];
+
+                bool skip = false;
+                for (size_t dep : t.deps) skip = skip || !tasks_[dep].result.ran || tasks_[dep].result.failed;
+                lock.unlock();
+                t.result.start_ms = elapsed();
+                if (!skip) {
+                    try {
+                        t.fn();
+                        t.result.ran = true;
+                    }
+                    catch (const std::exception& e) {
+                        t.result.ran = t.result.failed = true;
+                        t.result.error = e.what();
+                    }
+                    catch (...) {
+                        t.result.ran = t.result.failed = true;
+                        t.result.error = "unknown error";
+                    }
+                }
+                t.result.end_ms = elapsed();
+                lock.lock();
+
+                if (skip || t.result.failed) ok = false;
+                ++finished;
+                for (size_t next : dependents[i]) {
+                    if (--remaining[next] == 0) ready.push_back(next);
+                }
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        size_t n = std::max<size_t>(1, std::min(worker_count, tasks_.size()));
+        for (size_t i = 1; i < n; ++i) threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads) thread.join();
+        total_ms_ = elapsed();
+        return ok;
+    }
+
+    const task_result& result(size_t index) const { return tasks_[index].result; }
+    size_t size() const { return tasks_.size(); }
+    double total_ms() const { return total_ms_; }
+
+    /// Time spent in tasks, summed: about what the run would take on one
+    /// worker, less any contention between tasks running together
+    double busy_ms() const {
+        double sum = 0;
+        for (const task& t : tasks_) sum += t.result.end_ms - t.result.start_ms;
+        return sum;
+    }
+
+    /// The dependency chain that finished last: starting from the last task to
+    /// end, repeatedly follow the dependency that ended latest. Entry order is
+    /// first to last.
+    std::vector<size_t> critical_path() const {
+        std::vector<size_t> path;
+        if (tasks_.empty()) return path;
+        size_t current = 0;
+        for (size_t i = 1; i < tasks_.size(); ++i) {
+            if (tasks_[i].result.end_ms > tasks_[current].result.end_ms) current = i;
+        }
+        while (true) {
+            path.push_back(current);
+            const task& t = tasks_[current];
+            if (t.deps.empty()) break;
+            current = *std::max_element(t.deps.begin(), t.deps.end(), [&](size_t a, size_t b) {
+                return tasks_[a].result.end_ms < tasks_[b].result.end_ms;
+            });
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    /// "a 12.0 ms -> b 30.5 ms" for logging
+    std::string describe_critical_path() const {
+        std::string out;
+        char buffer[64];
+        for (size_t i : critical_path()) {
+            const task_result& r = tasks_[i].result;
+            if (!out.empty()) out += " -> ";
+            std::snprintf(buffer, sizeof(buffer), " %.1f ms", r.end_ms - r.start_ms);
+            out += r.name + buffer;
+        }
+        return out;
+    }
+
+private:
+    static constexpr size_t npos = (size_t)-1;
+
+    struct task {
+        task_result result;
+        std::function<void()> fn;
+        std::vector<size_t> deps;
+    };
+
+    size_t find(const std::string& name) const {
+        for (size_t i = 0; i < tasks_.size(); ++i) {
+            if (tasks_[i].result.name == name) return i;
+        }
+        return npos;
+    }
+
+    std::vector<task> tasks_;
+    double total_ms_ = 0;
+};
+
+} // namespace openbw_ios
+
+#endif // TASKGRAPH_H
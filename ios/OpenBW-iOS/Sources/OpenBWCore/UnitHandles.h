@@ -0,0 +1,121 @@
+// UnitHandles.h
+// Stable generational handles for OpenBW units
+//
+// A handle packs the unit's slot in OpenBW's unit pool with a generation
+// counter for that slot. Resolving a handle is a direct slot lookup followed
+// by a generation and liveness check, so a handle to a dead unit stays invalid
+// even after the slot has been reused for a new unit. Handles are plain ints
+// and are safe to hand across the Objective-C/Swift boundary.
+//
+// OpenBW's own unit_id only carries a 5-bit generation; the table below widens
+// it to 15 bits by counting every reuse of a slot it observes.
+
+#ifndef UNITHANDLES_H
+#define UNITHANDLES_H
+
+#include "bwgame.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace openbw_ios {
+
+/// Opaque unit handle: bits 0-15 slot + 1, bits 16-30 generation. 0 is never valid.
+struct unit_handle {
+    uint32_t raw = 0;
+
+    unit_handle() = default;
+    explicit unit_handle(uint32_t raw) : raw(raw) {}
+    unit_handle(size_t slot, uint32_t generation)
+        : raw((uint32_t)(slot + 1) | (generation & generation_mask) << 16) {}
+
+    static constexpr uint32_t generation_mask = 0x7fff;
+
+    bool empty() const { return raw == 0; }
+    size_t slot() const { return (raw & 0xffff) - 1; }
+    uint32_t generation() const { return (raw >> 16) & generation_mask; }
+
+    int to_int() const { return (int)raw; }
+    static unit_handle from_int(int value) { return unit_handle((uint32_t)value); }
+
+    bool operator==(const unit_handle& o) const { return raw == o.raw; }
+    bool operator!=(const unit_handle& o) const { return raw != o.raw; }
+};
+
+struct unit_handle_hash {
+    size_t operator()(const unit_handle& h) const { return h.raw; }
+};
+
+/// Per-slot generation table. One instance per game; reset on every new game.
+class unit_handle_table {
+public:
+    void reset() {
+        slots_.clear();
+    }
+
+    /// Handle for a live unit (empty for nullptr)
+    unit_handle handle_for(const bwgame::unit_t* u) {
+        if (!u) return unit_handle();
+        slot_t& s = observe(u);
+        return unit_handle(u->index, s.generation);
+    }
+
+    /// Resolve a handle to its unit, or nullptr if the unit has died or its
+    /// slot has since been reused. O(1).
+    bwgame::unit_t* resolve(const bwgame::state_functions& funcs, unit_handle h) {
+        if (h.empty() || h.slot() >= slots_.size()) return nullptr;
+        slot_t& s = slots_[h.slot()];
+        if (s.generation != h.generation()) return nullptr;
+
+        bwgame::unit_t* u = funcs.get_unit(bwgame::unit_id(h.slot() + 1, s.engine_generation));
+        if (!u) {
+            // OpenBW reallocated the slot since we last looked at it
+            ++s.generation;
+            s.generation &= unit_handle::generation_mask;
+            return nullptr;
+        }
+        if (!is_alive(funcs, u)) {
+            invalidate(u);
+            return nullptr;
+        }
+        return u;
+    }
+
+    /// Retire every handle to u (call when the unit dies)
+    void invalidate(const bwgame::unit_t* u) {
+        if (!u) return;
+        slot_t& s = observe(u);
+        s.generation = (s.generation + 1) & unit_handle::generation_mask;
+    }
+
+    static bool is_alive(const bwgame::state_functions& funcs, const bwgame::unit_t* u) {
+        return u->sprite && !funcs.unit_dead(u);
+    }
+
+private:
+    struct slot_t {
+        uint32_t generation = 1;
+        int engine_generation = -1;
+    };
+
+    // Sync our slot with OpenBW's, starting a new generation on reuse
+    slot_t& observe(const bwgame::unit_t* u) {
+        size_t slot = u->index;
+        if (slot >= slots_.size()) slots_.resize(slot + 1);
+        slot_t& s = slots_[slot];
+        int engine_generation = u->unit_id_generation % (1 << 5);
+        if (s.engine_generation != engine_generation) {
+            if (s.engine_generation != -1) {
+                s.generation = (s.generation + 1) & unit_handle::generation_mask;
+            }
+            s.engine_generation = engine_generation;
+        }
+        return s;
+    }
+
+    std::vector<slot_t> slots_;
+};
+
+} // namespace openbw_ios
+
+#endif // UNITHANDLES_H
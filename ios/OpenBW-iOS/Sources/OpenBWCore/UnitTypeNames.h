@@ -0,0 +1,126 @@
+// UnitTypeNames.h
+// Display names for the common unit types
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types), shared by the game
+// runner's selection info and the replay analyzer's reports. Covers the
+// playable units, buildings and resources; other ids have no name here.
+
+#ifndef UNITTYPENAMES_H
+#define UNITTYPENAMES_H
+
+namespace openbw_ios {
+
+/// English name of a unit type, or nullptr if the id is not covered
+inline const char* unit_type_name(int type_id) {
+    switch (type_id) {
+        // Terran
+        case 0: return "Marine";
+        case 1: return "Ghost";
+        case 2: return "Vulture";
+        case 3: return "Goliath";
+        case 5: return "Siege Tank";
+        case 7: return "SCV";
+        case 8: return "Wraith";
+        case 9: return "Science Vessel";
+        case 11: return "Dropship";
+        case 12: return "Battlecruiser";
+        case 14: return "Nuclear Missile";
+        case 32: return "Firebat";
+        case 34: return "Medic";
+        // Terran Buildings
+        case 106: return "Command Center";
+        case 107: return "Comsat Station";
+        case 108: return "Nuclear Silo";
+        case 109: return "Supply Depot";
+        case 110: return "Refinery";
+        case 111: return "Barracks";
+        case 112: return "Academy";
+        case 113: return "Factory";
+        case 114: return "Starport";
+        case 115: return "Control Tower";
+        case 116: return "Science Facility";
+        case 117: return "Covert Ops";
+        case 118: return "Physics Lab";
+        case 120: return "Machine Shop";
+        case 122: return "Engineering Bay";
+        case 123: return "Armory";
+        case 124: return "Missile Turret";
+        case 125: return "Bunker";
+        // Zerg
+        case 35: return "Larva";
+        case 36: return "Egg";
+        case 37: return "Zergling";
+        case 38: return "Hydralisk";
+        case 39: return "Ultralisk";
+        case 40: return "Broodling";
+        case 41: return "Drone";
+        case 42: return "Overlord";
+        case 43: return "Mutalisk";
+        case 44: return "Guardian";
+        case 45: return "Queen";
+        case 46: return "Defiler";
+        case 47: return "Scourge";
+        case 50: return "Infested Terran";
+        case 62: return "Devourer";
+        case 103: return "Lurker";
+        // Zerg Buildings
+        case 131: return "Hatchery";
+        case 132: return "Lair";
+        case 133: return "Hive";
+        case 134: return "Nydus Canal";
+        case 135: return "Hydralisk Den";
+        case 136: return "Defiler Mound";
+        case 137: return "Greater Spire";
+        case 138: return "Queens Nest";
+        case 139: return "Evolution Chamber";
+        case 140: return "Ultralisk Cavern";
+        case 141: return "Spire";
+        case 142: return "Spawning Pool";
+        case 143: return "Creep Colony";
+        case 144: return "Spore Colony";
+        case 146: return "Sunken Colony";
+        case 149: return "Extractor";
+        // Protoss
+        case 60: return "Corsair";
+        case 61: return "Dark Templar";
+        case 63: return "Dark Archon";
+        case 64: return "Probe";
+        case 65: return "Zealot";
+        case 66: return "Dragoon";
+        case 67: return "High Templar";
+        case 68: return "Archon";
+        case 69: return "Shuttle";
+        case 70: return "Scout";
+        case 71: return "Arbiter";
+        case 72: return "Carrier";
+        case 73: return "Interceptor";
+        case 83: return "Reaver";
+        case 84: return "Observer";
+        case 85: return "Scarab";
+        // Protoss Buildings
+        case 154: return "Nexus";
+        case 155: return "Robotics Facility";
+        case 156: return "Pylon";
+        case 157: return "Assimilator";
+        case 159: return "Observatory";
+        case 160: return "Gateway";
+        case 162: return "Photon Cannon";
+        case 163: return "Citadel of Adun";
+        case 164: return "Cybernetics Core";
+        case 165: return "Templar Archives";
+        case 166: return "Forge";
+        case 167: return "Stargate";
+        case 169: return "Fleet Beacon";
+        case 170: return "Arbiter Tribunal";
+        case 171: return "Robotics Support Bay";
+        case 172: return "Shield Battery";
+        // Resources
+        case 176: return "Mineral Field";
+        case 188: return "Vespene Geyser";
+        default: return nullptr;
+    }
+}
+
+} // namespace openbw_ios
+
+#endif // UNITTYPENAMES_H
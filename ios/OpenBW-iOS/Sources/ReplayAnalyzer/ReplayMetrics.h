@@ -0,0 +1,189 @@
+// ReplayMetrics.h
+// Per-player metrics extracted from replays, and their CSV/JSON writers
+//
+// Portable C++14 (no Foundation/UIKit or OpenBW types). The analyzer fills one
+// replay_metrics per replay on its worker thread; the writers run once at the
+// end over all of them, in input order.
+//
+// CSV is one long table with a row per observation:
+//   replay,slot,player,race,metric,frame,key,value
+// where metric is one of actions, apm, supply_used, supply_max, minerals,
+// gas, build or loss. JSON nests the same data per replay and player, with
+// supply samples as [frame, used, max, minerals, gas].
+
+#ifndef REPLAYMETRICS_H
+#define REPLAYMETRICS_H
+
+#include "UnitTypeNames.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace openbw_ios {
+
+struct supply_sample {
+    int frame = 0;
+    int used = 0;           // Whole supply (the game counts halves)
+    int available = 0;
+    int minerals = 0;
+    int gas = 0;
+};
+
+struct build_event {
+    int frame = 0;
+    const char* kind = "";  // build, train, morph, research or upgrade
+    int id = 0;             // Unit type, tech or upgrade id
+};
+
+struct player_metrics {
+    int slot = 0;
+    std::string name;
+    int race = 0;           // 0 Zerg, 1 Terran, 2 Protoss
+    uint32_t actions = 0;
+    double apm = 0;
+    std::vector<supply_sample> supply;
+    std::vector<build_event> build_order;
+    std::map<int, int> losses;  // Unit type -> units lost
+};
+
+struct replay_metrics {
+    std::string path;
+    std::string map_name;
+    int frames = 0;
+    bool ok = false;
+    std::string error;
+    double analyze_ms = 0;
+    std::vector<player_metrics> players;
+};
+
+namespace detail {
+
+inline const char* race_name(int race) {
+    switch (race) {
+        case 0: return "zerg";
+        case 1: return "terran";
+        case 2: return "protoss";
+        default: return "unknown";
+    }
+}
+
+/// Unit names for unit-type ids, numbers for tech and upgrades
+inline std::string build_item_name(const build_event& e) {
+    bool unit = std::string(e.kind) != "research" && std::string(e.kind) != "upgrade";
+    const char* name = unit ? unit_type_name(e.id) : nullptr;
+    return name ? name : std::to_string(e.id);
+}
+
+inline std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+inline std::string csv_field(const std::string& s) {
+    if (s.find_first_of(",\"\n\r") == std::string::npos) return s;
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+} // namespace detail
+
+inline void write_metrics_csv(FILE* f, const std::vector<replay_metrics>& replays) {
+    std::fprintf(f, "replay,slot,player,race,metric,frame,key,value\n");
+    for (const replay_metrics& r : replays) {
+        if (!r.ok) continue;
+        std::string replay = detail::csv_field(r.path);
+        for (const player_metrics& p : r.players) {
+            std::string prefix = replay + "," + std::to_string(p.slot) + "," + detail::csv_field(p.name) + "," +
+                                 detail::race_name(p.race) + ",";
+            const char* pre = prefix.c_str();
+            std::fprintf(f, "%sactions,%d,,%u\n", pre, r.frames, p.actions);
+            std::fprintf(f, "%sapm,%d,,%.1f\n", pre, r.frames, p.apm);
+            for (const supply_sample& s : p.supply) {
+                std::fprintf(f, "%ssupply_used,%d,,%d\n", pre, s.frame, s.used);
+                std::fprintf(f, "%ssupply_max,%d,,%d\n", pre, s.frame, s.available);
+                std::fprintf(f, "%sminerals,%d,,%d\n", pre, s.frame, s.minerals);
+                std::fprintf(f, "%sgas,%d,,%d\n", pre, s.frame, s.gas);
+            }
+            for (const build_event& e : p.build_order) {
+                std::fprintf(f, "%sbuild,%d,%s,%s\n", pre, e.frame, e.kind,
+                             detail::csv_field(detail::build_item_name(e)).c_str());
+            }
+            for (const auto& loss : p.losses) {
+                const char* name = unit_type_name(loss.first);
+                std::fprintf(f, "%sloss,%d,%s,%d\n", pre, r.frames,
+                             detail::csv_field(name ? name : std::to_string(loss.first)).c_str(), loss.second);
+            }
+        }
+    }
+}
+
+inline void write_metrics_json(FILE* f, const std::vector<replay_metrics>& replays) {
+    using detail::json_string;
+    std::fprintf(f, "[\n");
+    for (size_t i = 0; i < replays.size(); ++i) {
+        const replay_metrics& r = replays[i];
+        std::fprintf(f, "  {\"replay\": %s, \"ok\": %s", json_string(r.path).c_str(), r.ok ? "true" : "false");
+        if (!r.ok) {
+            std::fprintf(f, ", \"error\": %s}%s\n", json_string(r.error).c_str(), i + 1 < replays.size() ? "," : "");
+            continue;
+        }
+        std::fprintf(f, ", \"map\": %s, \"frames\": %d, \"analyze_ms\": %.1f, \"players\": [",
+                     json_string(r.map_name).c_str(), r.frames, r.analyze_ms);
+        for (size_t j = 0; j < r.players.size(); ++j) {
+            const player_metrics& p = r.players[j];
+            std::fprintf(f, "%s\n    {\"slot\": %d, \"name\": %s, \"race\": \"%s\", \"actions\": %u, \"apm\": %.1f",
+                         j ? "," : "", p.slot, json_string(p.name).c_str(), detail::race_name(p.race), p.actions, p.apm);
+
+            std::fprintf(f, ",\n     \"supply\": [");
+            for (size_t k = 0; k < p.supply.size(); ++k) {
+                const supply_sample& s = p.supply[k];
+                std::fprintf(f, "%s[%d, %d, %d, %d, %d]", k ? ", " : "", s.frame, s.used, s.available, s.minerals, s.gas);
+            }
+            std::fprintf(f, "],\n     \"build_order\": [");
+            for (size_t k = 0; k < p.build_order.size(); ++k) {
+                const build_event& e = p.build_order[k];
+                std::fprintf(f, "%s{\"frame\": %d, \"kind\": \"%s\", \"id\": %d, \"name\": %s}", k ? ", " : "",
+                             e.frame, e.kind, e.id, json_string(detail::build_item_name(e)).c_str());
+            }
+            std::fprintf(f, "],\n     \"losses\": {");
+            bool first = true;
+            for (const auto& loss : p.losses) {
+                const char* name = unit_type_name(loss.first);
+                std::fprintf(f, "%s%s: %d", first ? "" : ", ",
+                             json_string(name ? name : std::to_string(loss.first)).c_str(), loss.second);
+                first = false;
+            }
+            std::fprintf(f, "}}");
+        }
+        std::fprintf(f, "\n  ]}%s\n", i + 1 < replays.size() ? "," : "");
+    }
+    std::fprintf(f, "]\n");
+}
+
+} // namespace openbw_ios
+
+#endif // REPLAYMETRICS_H
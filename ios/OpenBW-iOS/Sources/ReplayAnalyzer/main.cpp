@@ -0,0 +1,380 @@
+// main.cpp
+// openbw_replay_analyzer: batch replay metrics on the portable game core
+//
+// Host command-line tool (no Foundation/UIKit). The game data is loaded once
+// into a global_state that every replay shares read-only; each replay gets its
+// own game state and runs headless on a pool of worker threads, so throughput
+// scales with cores instead of being bound by loading the data per replay.
+// Replays are played through the same streaming action reader as in-app
+// playback, and per-player metrics are collected as they play.
+//
+// Usage:
+//   openbw_replay_analyzer --data <dir with MPQs> [--jobs N] [--format csv|json]
+//                          [--output file] [--interval frames] [--baseline]
+//                          <replay or dir>...
+//
+// --baseline plays the batch a second time on one thread and reports the
+// speedup of --jobs N over it, measured as throughput.
+
+#define OPENBW_HEADLESS 1
+
+#include "bwgame.h"
+#include "actions.h"
+#include "replay.h"
+
+#include "ArchiveService.h"
+#include "CommandBuffer.h"
+#include "ReplayReader.h"
+#include "ReplayMetrics.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace openbw_ios;
+
+struct options {
+    std::string data_dir;
+    std::vector<std::string> inputs;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::string format = "csv";
+    std::string output;
+    int sample_interval = 240;      // Frames between supply samples (about 10 s)
+    bool baseline = false;          // Also time the batch on one thread
+};
+
+constexpr double kSecondsPerFrame = 0.042;
+
+// OpenBW functions for one replay, counting each player's unit losses
+struct analyzer_functions : bwgame::action_functions {
+    replay_metrics& metrics;
+    std::array<int, 12> player_index;   // Owner -> index into metrics.players, or -1
+
+    analyzer_functions(bwgame::state& st, bwgame::action_state& action_st, replay_metrics& metrics)
+        : bwgame::action_functions(st, action_st), metrics(metrics) {
+        player_index.fill(-1);
+    }
+
+    virtual void on_kill_unit(bwgame::unit_t* u) override {
+        int owner = u->owner;
+        if (owner < 0 || owner >= (int)player_index.size() || player_index[owner] < 0) return;
+        ++metrics.players[player_index[owner]].losses[(int)u->unit_type->id];
+    }
+};
+
+// Build order entries come from the actions that start production
+void record_build(player_metrics& p, int frame, const uint8_t* action, size_t size) {
+    auto u16 = [&](size_t at) { return at + 2 <= size ? action[at] | action[at + 1] << 8 : -1; };
+    build_event e;
+    e.frame = frame;
+    switch (action[0]) {
+        case game_action::build:            // order, x, y, unit type
+            e.kind = "build";
+            e.id = u16(6);
+            break;
+        case game_action::train:
+            e.kind = "train";
+            e.id = u16(1);
+            break;
+        case game_action::unit_morph:
+        case game_action::building_morph:
+            e.kind = "morph";
+            e.id = u16(1);
+            break;
+        case game_action::research:
+            e.kind = "research";
+            e.id = size > 1 ? action[1] : -1;
+            break;
+        case game_action::upgrade:
+            e.kind = "upgrade";
+            e.id = size > 1 ? action[1] : -1;
+            break;
+        default:
+            return;
+    }
+    if (e.id >= 0) p.build_order.push_back(e);
+}
+
+void sample_supply(const bwgame::state& st, int frame, const std::array<int, 12>& player_index, replay_metrics& out) {
+    for (int owner = 0; owner < (int)player_index.size(); ++owner) {
+        if (player_index[owner] < 0) continue;
+        player_metrics& p = out.players[player_index[owner]];
+        int race = std::max(0, std::min(p.race, 2));
+        supply_sample s;
+        s.frame = frame;
+        s.used = st.supply_used[owner][race].raw_value / 2;
+        s.available = std::min(st.supply_available[owner][race].raw_value / 2, 200);
+        s.minerals = st.current_minerals[owner];
+        s.gas = st.current_gas[owner];
+        p.supply.push_back(s);
+    }
+}
+
+// global_st is only read; replays on other threads share it
+replay_metrics analyze_replay(const std::string& path, bwgame::global_state& global_st, int sample_interval) {
+    replay_metrics out;
+    out.path = path;
+    auto start = std::chrono::steady_clock::now();
+
+    replay_file file;
+    if (!file.open(path, out.error)) return out;
+    const replay_header& header = file.header();
+    out.map_name = header.map_name;
+    out.frames = (int)header.frame_count;
+
+    try {
+        // Everything mutable is per replay; only the game data is shared
+        bwgame::game_state game_st;
+        bwgame::state st;
+        st.global = &global_st;
+        st.game = &game_st;
+        bwgame::action_state action_st;
+        {
+            std::vector<uint8_t> setup = file.without_actions();
+            bwgame::replay_state replay_st;
+            bwgame::replay_functions loader(st, action_st, replay_st);
+            loader.load_replay_data(setup.data(), setup.size());
+        }
+
+        analyzer_functions funcs(st, action_st, out);
+        for (int i = 0; i < 8; ++i) {
+            if (header.players[i].type == 0) continue;
+            player_metrics p;
+            p.slot = i;
+            p.name = header.players[i].name;
+            p.race = (int)st.players[i].race;
+            funcs.player_index[i] = (int)out.players.size();
+            out.players.push_back(std::move(p));
+        }
+
+        replay_action_stream actions;
+        actions.reset(file);
+        while (st.current_frame < out.frames || !actions.done()) {
+            int frame = st.current_frame;
+            const uint8_t* data;
+            size_t size;
+            while (actions.next_block((uint32_t)frame, data, size)) {
+                bwgame::data_loading::data_reader_le r(data, data + size);
+                while (r.left()) {
+                    int owner = header.owner_for_id(r.get<uint8_t>());
+                    size_t begin = size - r.left();
+                    if (owner < 0 || !funcs.read_action(r, owner)) break;
+                    if (funcs.player_index[owner] < 0) continue;
+                    player_metrics& p = out.players[funcs.player_index[owner]];
+                    ++p.actions;
+                    record_build(p, frame, data + begin, size - r.left() - begin);
+                }
+            }
+            if (frame % sample_interval == 0) sample_supply(st, frame, funcs.player_index, out);
+            funcs.next_frame();
+        }
+        sample_supply(st, st.current_frame, funcs.player_index, out);
+        if (actions.failed()) throw std::runtime_error("action stream is corrupt");
+    }
+    catch (const std::exception& e) {
+        out.error = e.what();
+        return out;
+    }
+
+    double minutes = out.frames * kSecondsPerFrame / 60.0;
+    for (player_metrics& p : out.players) p.apm = minutes > 0 ? p.actions / minutes : 0;
+    out.ok = true;
+    out.analyze_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return out;
+}
+
+bool has_extension(const std::string& name, const char* extension) {
+    size_t n = std::strlen(extension);
+    if (name.size() < n) return false;
+    std::string tail = name.substr(name.size() - n);
+    for (char& c : tail) c = (char)tolower((unsigned char)c);
+    return tail == extension;
+}
+
+// Replays in a directory tree, or the path itself if it is a file
+void collect_replays(const std::string& path, std::vector<std::string>& out) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        std::fprintf(stderr, "warning: %s not found\n", path.c_str());
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        out.push_back(path);
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    std::vector<std::string> children;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.empty() || name[0] == '.') continue;
+        std::string child = path + "/" + name;
+        if (has_extension(name, ".rep") || (stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))) {
+            children.push_back(child);
+        }
+    }
+    closedir(dir);
+    std::sort(children.begin(), children.end());
+    for (const std::string& child : children) collect_replays(child, out);
+}
+
+// The game's archives in priority order, matched case-insensitively
+std::vector<std::string> find_archives(const std::string& data_dir) {
+    std::vector<std::string> paths;
+    for (const char* wanted : {"patch_rt.mpq", "broodat.mpq", "stardat.mpq"}) {
+        DIR* dir = opendir(data_dir.c_str());
+        if (!dir) break;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            for (char& c : name) c = (char)tolower((unsigned char)c);
+            if (name == wanted) {
+                paths.push_back(data_dir + "/" + entry->d_name);
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return paths;
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: openbw_replay_analyzer --data <dir> [--jobs N] [--format csv|json]\n"
+        "                              [--output file] [--interval frames] [--baseline]\n"
+        "                              <replay or dir>...\n");
+}
+
+bool parse_options(int argc, char** argv, options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--data" && (v = value())) o.data_dir = v;
+        else if (arg == "--jobs" && (v = value())) o.jobs = (size_t)std::max(1, std::atoi(v));
+        else if (arg == "--format" && (v = value())) o.format = v;
+        else if (arg == "--output" && (v = value())) o.output = v;
+        else if (arg == "--interval" && (v = value())) o.sample_interval = std::max(1, std::atoi(v));
+        else if (arg == "--baseline") o.baseline = true;
+        else if (!arg.empty() && arg[0] != '-') o.inputs.push_back(arg);
+        else return false;
+    }
+    return !o.data_dir.empty() && !o.inputs.empty() && (o.format == "csv" || o.format == "json");
+}
+
+// Analyze every replay on jobs threads; returns the wall time in ms. Workers
+// take the next replay until none are left; results keep input order.
+double run_batch(const std::vector<std::string>& replays, bwgame::global_state& global_st,
+                 int sample_interval, size_t jobs, bool progress, std::vector<replay_metrics>& results) {
+    results.assign(replays.size(), replay_metrics());
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    auto start = std::chrono::steady_clock::now();
+    auto worker = [&] {
+        for (size_t i = next++; i < replays.size(); i = next++) {
+            results[i] = analyze_replay(replays[i], global_st, sample_interval);
+            size_t n = ++done;
+            if (!progress) continue;
+            if (results[i].ok) {
+                std::fprintf(stderr, "[%zu/%zu] %s (%.0f ms)\n", n, replays.size(), replays[i].c_str(), results[i].analyze_ms);
+            } else {
+                std::fprintf(stderr, "[%zu/%zu] %s: %s\n", n, replays.size(), replays[i].c_str(), results[i].error.c_str());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; ++i) threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads) thread.join();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<std::string> replays;
+    for (const std::string& input : opts.inputs) collect_replays(input, replays);
+    if (replays.empty()) {
+        std::fprintf(stderr, "no replays found\n");
+        return 1;
+    }
+
+    // Load the game data once; every replay's state points at it
+    auto load_start = std::chrono::steady_clock::now();
+    archive_service archives;
+    auto global_st = std::make_unique<bwgame::global_state>();
+    try {
+        std::vector<std::string> mpqs = find_archives(opts.data_dir);
+        if (mpqs.empty()) throw std::runtime_error("no game archives in " + opts.data_dir);
+        archives.open(mpqs);
+        bwgame::global_init(*global_st, archives.data_loader());
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "could not load game data: %s\n", e.what());
+        return 1;
+    }
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+
+    std::vector<replay_metrics> results;
+    size_t jobs = std::min(opts.jobs, replays.size());
+    double wall_ms = run_batch(replays, *global_st, opts.sample_interval, jobs, true, results);
+
+    FILE* out = opts.output.empty() ? stdout : std::fopen(opts.output.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "could not write %s\n", opts.output.c_str());
+        return 1;
+    }
+    if (opts.format == "json") {
+        write_metrics_json(out, results);
+    } else {
+        write_metrics_csv(out, results);
+    }
+    if (out != stdout) std::fclose(out);
+
+    // Throughput in replays and game frames per second of wall time. Busy
+    // time over wall time is how many cores were kept busy, which is not a
+    // speedup: per-replay times grow when threads contend for memory
+    // bandwidth and caches. Only --baseline measures the speedup.
+    size_t failed = 0;
+    double busy_ms = 0;
+    double frames = 0;
+    for (const replay_metrics& r : results) {
+        if (!r.ok) ++failed;
+        busy_ms += r.analyze_ms;
+        frames += r.frames;
+    }
+    auto per_second = [](double count, double ms) { return ms > 0 ? count * 1000.0 / ms : 0; };
+    std::fprintf(stderr, "%zu replays (%zu failed) on %zu threads: data %.0f ms, replays %.0f ms wall "
+                 "(%.1f replays/s, %.0f frames/s), %.1f cores busy\n",
+                 replays.size(), failed, jobs, load_ms, wall_ms, per_second((double)replays.size(), wall_ms),
+                 per_second(frames, wall_ms), wall_ms > 0 ? busy_ms / wall_ms : 0);
+
+    if (opts.baseline && jobs > 1) {
+        std::vector<replay_metrics> serial;
+        double serial_ms = run_batch(replays, *global_st, opts.sample_interval, 1, false, serial);
+        double speedup = wall_ms > 0 ? serial_ms / wall_ms : 0;
+        std::fprintf(stderr, "baseline on 1 thread: %.0f ms wall (%.1f replays/s); %.2fx speedup on %zu threads "
+                     "(%.0f%% of linear)\n",
+                     serial_ms, per_second((double)replays.size(), serial_ms), speedup, jobs, 100.0 * speedup / jobs);
+    }
+    return failed == replays.size() ? 1 : 0;
+}
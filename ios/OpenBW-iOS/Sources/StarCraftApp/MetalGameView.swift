@@ -538,18 +538,10 @@ struct GameScreen: View {
                 MetalGameView(gameController: gameController)
                     .ignoresSafeArea()
 
-                // Show Start Game button if not running
+                // Show the map picker if not running
                 if !gameController.isRunning && gameController.error == nil {
-                    VStack {
-                        Spacer()
-                        Button("Start Game") {
-                            // Try to start a game with a built-in map
-                            gameController.startGame(mapPath: "maps/(2)Challenger.scm", race: 0, difficulty: 1)
-                        }
-                        .buttonStyle(.borderedProminent)
-                        .font(.title)
-                        .padding()
-                        Spacer()
+                    MapPickerView(gameController: gameController, assetPath: assetPath) { mapPath in
+                        gameController.startGame(mapPath: mapPath, race: 0, difficulty: 1)
                     }
                 }
 
@@ -743,6 +735,154 @@ struct GameScreen: View {
     }
 }
 
+// MARK: - Map Picker
+
+struct MapPickerView: View {
+    @ObservedObject var gameController: GameController
+    let assetPath: String
+    let onSelect: (String) -> Void
+
+    @State private var maps: [String] = []
+    @State private var mapInfo: [String: OpenBWMapInfo] = [:]
+    @State private var thumbnails: [String: UIImage] = [:]
+    @State private var selectedMap: String?
+
+    private let columns = [GridItem(.adaptive(minimum: 120), spacing: 12)]
+
+    var body: some View {
+        VStack(spacing: 12) {
+            Text("Select Map")
+                .font(.title)
+                .foregroundColor(.white)
+
+            ScrollView {
+                LazyVGrid(columns: columns, spacing: 12) {
+                    ForEach(maps, id: \.self) { map in
+                        Button {
+                            select(map)
+                        } label: {
+                            VStack(spacing: 4) {
+                                ZStack {
+                                    Rectangle().fill(Color.black)
+                                    if let image = thumbnails[map] {
+                                        Image(uiImage: image)
+                                            .resizable()
+                                            .interpolation(.none)
+                                            .aspectRatio(contentMode: .fit)
+                                    }
+                                }
+                                .frame(width: 120, height: 120)
+                                .border(selectedMap == map ? Color.green : Color.clear, width: 2)
+
+                                Text(displayName(map))
+                                    .font(.caption)
+                                    .foregroundColor(.white)
+                                    .lineLimit(1)
+
+                                if let info = mapInfo[map] {
+                                    Text("\(info.maxPlayers)p  \(info.width)x\(info.height)")
+                                        .font(.caption2)
+                                        .foregroundColor(.gray)
+                                }
+                            }
+                        }
+                    }
+                }
+                .padding()
+            }
+
+            Button("Start Game") {
+                if let map = selectedMap {
+                    onSelect("maps/" + map)
+                }
+            }
+            .buttonStyle(.borderedProminent)
+            .font(.title)
+            .disabled(selectedMap == nil)
+        }
+        .padding()
+        .background(Color.black.opacity(0.8))
+        .onAppear {
+            loadMaps()
+        }
+    }
+
+    private func mapsDirectory() -> String? {
+        let candidates = [
+            (assetPath as NSString).appendingPathComponent("maps"),
+            ((Bundle.main.resourcePath ?? "") as NSString).appendingPathComponent("maps")
+        ]
+        return candidates.first { FileManager.default.fileExists(atPath: $0) }
+    }
+
+    private func displayName(_ map: String) -> String {
+        if let name = mapInfo[map]?.name, !name.isEmpty {
+            return name
+        }
+        return (map as NSString).deletingPathExtension
+    }
+
+    private func select(_ map: String) {
+        selectedMap = map
+
+        // Load the map's tileset while the player confirms
+        if let directory = mapsDirectory() {
+            gameController.gameRunner?.prefetchMap(atPath: (directory as NSString).appendingPathComponent(map))
+        }
+    }
+
+    private func loadMaps() {
+        guard let directory = mapsDirectory(),
+              let contents = try? FileManager.default.contentsOfDirectory(atPath: directory) else { return }
+
+        maps = contents
+            .filter { ["scm", "scx"].contains(($0 as NSString).pathExtension.lowercased()) }
+            .sorted()
+
+        // Thumbnails come from the cached megatile color table: one lookup per
+        // tile, so the whole folder renders in milliseconds off the main thread
+        guard let runner = gameController.gameRunner else { return }
+        let names = maps
+        DispatchQueue.global(qos: .userInitiated).async {
+            // Names, player counts and sizes from the map catalog (cached on disk)
+            var info: [String: OpenBWMapInfo] = [:]
+            for map in runner.mapCatalog(forDirectories: [directory]) {
+                info[(map.path as NSString).lastPathComponent] = map
+            }
+            DispatchQueue.main.async {
+                mapInfo = info
+            }
+
+            var images: [String: UIImage] = [:]
+            for name in names {
+                let path = (directory as NSString).appendingPathComponent(name)
+                var width: Int32 = 0
+                var height: Int32 = 0
+                guard let data = runner.thumbnailForMap(atPath: path, maxSize: 128, width: &width, height: &height),
+                      width > 0 && height > 0,
+                      let provider = CGDataProvider(data: data as CFData),
+                      let cgImage = CGImage(
+                        width: Int(width),
+                        height: Int(height),
+                        bitsPerComponent: 8,
+                        bitsPerPixel: 32,
+                        bytesPerRow: Int(width) * 4,
+                        space: CGColorSpaceCreateDeviceRGB(),
+                        bitmapInfo: CGBitmapInfo(rawValue: CGImageAlphaInfo.premultipliedLast.rawValue),
+                        provider: provider,
+                        decode: nil,
+                        shouldInterpolate: false,
+                        intent: .defaultIntent
+                      ) else { continue }
+                images[name] = UIImage(cgImage: cgImage)
+            }
+            DispatchQueue.main.async {
+                thumbnails = images
+            }
+        }
+    }
+}
+
 // MARK: - Selection Box Overlay
 
 struct SelectionBoxOverlay: View {
@@ -876,7 +1016,7 @@ struct ContextMenuButton: View {
 struct MinimapView: View {
     @ObservedObject var gameController: GameController
     @State private var minimapImage: UIImage?
-    @State private var lastUpdateFrame: Int = -1
+    @State private var lastMinimapVersion: UInt64 = 0
 
     var body: some View {
         GeometryReader { geometry in
@@ -919,35 +1059,39 @@ struct MinimapView: View {
     private func updateMinimap() {
         guard let runner = gameController.gameRunner else { return }
 
-        // Get minimap RGBA data
-        var width: Int32 = 0
-        var height: Int32 = 0
-
-        guard let pixels = runner.getMinimapRGBA(&width, height: &height) else { return }
-        defer { free(pixels) }
-
-        let w = Int(width)
-        let h = Int(height)
-        guard w > 0 && h > 0 else { return }
-
-        // Create UIImage from RGBA data
-        let colorSpace = CGColorSpaceCreateDeviceRGB()
-        let bitmapInfo = CGBitmapInfo(rawValue: CGImageAlphaInfo.premultipliedLast.rawValue)
-
-        guard let context = CGContext(
-            data: UnsafeMutableRawPointer(pixels),
-            width: w,
-            height: h,
-            bitsPerComponent: 8,
-            bytesPerRow: w * 4,
-            space: colorSpace,
-            bitmapInfo: bitmapInfo.rawValue
-        ) else { return }
+        // The runner keeps the minimap image up to date; only copy it when it changed
+        guard runner.minimapVersion != lastMinimapVersion else { return }
+
+        var cgImage: CGImage?
+        let version = runner.readMinimapPixels { pixels, width, height, _ in
+            let w = Int(width)
+            let h = Int(height)
+            guard w > 0 && h > 0 else { return }
+
+            // Copy out while the buffer is locked; the runner keeps updating it
+            let data = Data(bytes: pixels, count: w * h * 4)
+            guard let provider = CGDataProvider(data: data as CFData) else { return }
+
+            cgImage = CGImage(
+                width: w,
+                height: h,
+                bitsPerComponent: 8,
+                bitsPerPixel: 32,
+                bytesPerRow: w * 4,
+                space: CGColorSpaceCreateDeviceRGB(),
+                bitmapInfo: CGBitmapInfo(rawValue: CGImageAlphaInfo.premultipliedLast.rawValue),
+                provider: provider,
+                decode: nil,
+                shouldInterpolate: false,
+                intent: .defaultIntent
+            )
+        }
 
-        guard let cgImage = context.makeImage() else { return }
+        guard let image = cgImage else { return }
+        lastMinimapVersion = version
 
         DispatchQueue.main.async {
-            self.minimapImage = UIImage(cgImage: cgImage)
+            self.minimapImage = UIImage(cgImage: image)
         }
     }
 
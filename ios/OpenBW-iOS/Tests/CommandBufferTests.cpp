@@ -0,0 +1,77 @@
+// CommandBufferTests.cpp
+// Byte-exact encoding of UI command records as game actions
+
+#include "CommandBuffer.h"
+#include "TestSupport.h"
+
+#include <vector>
+
+using namespace openbw_ios;
+
+static command_record makeRecord(uint8_t action, std::vector<uint16_t> units) {
+    command_record r;
+    r.action = action;
+    r.unit_count = (uint8_t)units.size();
+    for (size_t i = 0; i < units.size(); ++i) r.units[i] = units[i];
+    return r;
+}
+
+static std::vector<uint8_t> encode(const std::vector<command_record>& records) {
+    std::vector<uint8_t> out;
+    encode_command_actions(records, out);
+    return out;
+}
+
+// Unsiege is 0x25 with a queued byte (0x27 is Train Fighter, which has none)
+static void testUnsiege() {
+    std::vector<uint8_t> expected = {0x09, 0x02, 0x34, 0x12, 0x78, 0x56, 0x25, 0x00};
+    CHECK(encode({makeRecord(game_action::unsiege, {0x1234, 0x5678})}) == expected);
+}
+
+static void testSiege() {
+    std::vector<uint8_t> expected = {0x09, 0x01, 0x01, 0x00, 0x26, 0x00};
+    CHECK(encode({makeRecord(game_action::siege, {0x0001})}) == expected);
+}
+
+// An unsiege followed by another action: each action is exactly its length,
+// so the stop after it is read as a stop
+static void testUnsiegeThenStop() {
+    std::vector<uint8_t> expected = {0x09, 0x01, 0x05, 0x00, 0x25, 0x00,
+                                     0x09, 0x01, 0x06, 0x00, 0x1a, 0x00};
+    CHECK(encode({makeRecord(game_action::unsiege, {5}), makeRecord(game_action::stop, {6})}) == expected);
+}
+
+// Every command (a select and its order) ends at a reported offset, so one
+// the game rejects can be cut out and the commands around it still decode
+static void testCommandEnds() {
+    std::vector<uint16_t> many;
+    for (uint16_t id = 1; id <= 13; ++id) many.push_back(id);
+    std::vector<command_record> records = {makeRecord(game_action::siege, {5}), makeRecord(game_action::stop, many),
+                                           makeRecord(game_action::unsiege, {6})};
+    std::vector<uint8_t> out;
+    std::vector<size_t> ends;
+    encode_command_actions(records, out, &ends);
+    CHECK(out == encode(records));
+    // 13 stopping units need two selections
+    std::vector<size_t> expectedEnds = {6, 6 + 28, 6 + 28 + 6, 6 + 28 + 6 + 6};
+    CHECK(ends == expectedEnds);
+
+    size_t begin = 0;
+    for (size_t end : ends) {
+        CHECK(end > begin && out[begin] == game_action::select);
+        begin = end;
+    }
+
+    // Skipping the stop commands leaves exactly the other two
+    std::vector<uint8_t> kept(out.begin(), out.begin() + ends[0]);
+    kept.insert(kept.end(), out.begin() + ends[2], out.end());
+    CHECK(kept == encode({records[0], records[2]}));
+}
+
+int main() {
+    testUnsiege();
+    testSiege();
+    testUnsiegeThenStop();
+    testCommandEnds();
+    return openbw_ios_test::test_result();
+}
@@ -0,0 +1,129 @@
+// FrameSchedulerTests.cpp
+// Deadline pacing: no drift from frame cost, and catch-up or skip after a slow frame
+//
+// Runs on a clock that is the steady clock plus an offset the frame callbacks
+// advance, so a frame can "take" tens of milliseconds without spending them.
+// Waits between frames are real, which keeps the scheduler's own sleeping
+// under test; the checks allow for some wakeup latency.
+
+#include "FrameScheduler.h"
+#include "TestSupport.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+using namespace openbw_ios;
+
+struct skewed_clock {
+    using duration = std::chrono::steady_clock::duration;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<skewed_clock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() {
+        return time_point(std::chrono::steady_clock::now().time_since_epoch() + offset());
+    }
+
+    // Time that passes instantly, as if spent in a frame
+    static void spend(std::chrono::milliseconds d) { offset() += d; }
+
+    static duration& offset() {
+        static duration value{0};
+        return value;
+    }
+};
+
+using test_scheduler = basic_frame_scheduler<skewed_clock>;
+
+static const std::chrono::milliseconds kPeriod(20);
+static const double kSlackMs = 6;
+
+// Run frames until count have started, recording each start relative to the first
+static std::vector<double> runFrames(test_scheduler& scheduler, int count,
+                                     const std::function<void(int)>& frame_f) {
+    std::vector<double> starts;
+    skewed_clock::time_point first;
+    scheduler.run([&] {
+        skewed_clock::time_point now = skewed_clock::now();
+        if (starts.empty()) first = now;
+        starts.push_back(std::chrono::duration<double, std::milli>(now - first).count());
+        frame_f((int)starts.size() - 1);
+        if ((int)starts.size() == count) scheduler.stop();
+    });
+    return starts;
+}
+
+static bool near(double ms, double expected) {
+    return std::abs(ms - expected) < kSlackMs;
+}
+
+// Frames costing most of a period still start on the period grid: the cost
+// is not added on top of each wait, and a late wakeup is not carried into
+// the frames after it. A fixed wait after each frame would end 30 frames
+// 360 ms late.
+static void testNoDrift() {
+    test_scheduler scheduler(kPeriod, frame_pacing_policy::catch_up, 4);
+    std::vector<double> starts = runFrames(scheduler, 31, [](int) { skewed_clock::spend(std::chrono::milliseconds(12)); });
+    CHECK(starts.size() == 31);
+    for (size_t i = 0; i < starts.size(); ++i) CHECK(starts[i] > i * 20.0 - 1);     // Never early
+    CHECK(near(starts.back(), 600));
+    auto stats = scheduler.stats();
+    CHECK(stats.frames == 31);
+    CHECK(stats.skipped_frames == 0);
+    CHECK(stats.max_frame_us >= 12000);
+}
+
+// A frame of 4.5 periods under catch_up: up to max_catch_up_frames of the
+// missed deadlines run back to back, the rest are dropped, and the frames
+// after return to the original grid
+static void testCatchUp() {
+    test_scheduler scheduler(kPeriod, frame_pacing_policy::catch_up, 2);
+    std::vector<double> starts = runFrames(scheduler, 8, [](int frame) {
+        if (frame == 1) skewed_clock::spend(std::chrono::milliseconds(90));
+    });
+    // Frame 1 runs 20-110. Deadlines 40, 60, 80 and 100 have passed: 40 is
+    // dropped, 60, 80 and 100 are run at once, then 120 is waited for.
+    CHECK(starts.size() == 8);
+    CHECK(near(starts[1], 20));
+    CHECK(near(starts[2], 110) && near(starts[3], 110) && near(starts[4], 110));
+    CHECK(starts[4] - starts[2] < 2);
+    for (int i = 5; i < 8; ++i) CHECK(near(starts[i], 120.0 + (i - 5) * 20));
+    auto stats = scheduler.stats();
+    CHECK(stats.skipped_frames == 1);
+    CHECK(stats.overruns >= 3);
+    CHECK(stats.max_overrun_us >= 60000);
+}
+
+// The same frame under skip: every missed deadline is dropped and the next
+// frame waits for the first one still ahead, on the same grid
+static void testSkip() {
+    test_scheduler scheduler(kPeriod, frame_pacing_policy::skip);
+    std::vector<double> starts = runFrames(scheduler, 5, [](int frame) {
+        if (frame == 1) skewed_clock::spend(std::chrono::milliseconds(90));
+    });
+    CHECK(starts.size() == 5);
+    CHECK(near(starts[2], 120) && near(starts[3], 140) && near(starts[4], 160));
+    auto stats = scheduler.stats();
+    CHECK(stats.skipped_frames >= 4);
+    CHECK(stats.overruns >= 1);
+}
+
+// A stop requested before run() starts returns at once
+static void testStopBeforeRun() {
+    test_scheduler scheduler(kPeriod);
+    scheduler.stop();
+    int frames = 0;
+    scheduler.run([&] { ++frames; });
+    CHECK(frames == 0);
+    CHECK(!scheduler.is_running());
+}
+
+int main() {
+    testNoDrift();
+    testCatchUp();
+    testSkip();
+    testStopBeforeRun();
+    return openbw_ios_test::test_result();
+}
@@ -0,0 +1,236 @@
+// ReplayWriterTests.cpp
+// Implode against explode, and recorded replays read back by replay_file
+
+#include "ReplayReader.h"
+#include "ReplayWriter.h"
+#include "TestSupport.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openbw_ios;
+
+static std::string tempPath(const char* name) {
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = dir && *dir ? dir : "/tmp";
+    if (path.back() != '/') path += '/';
+    return path + name;
+}
+
+static bool roundTrips(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> packed;
+    pkware_implode(data.data(), data.size(), packed);
+    std::vector<uint8_t> unpacked(data.size() + 1);
+    long n = pkware_explode(packed.data(), packed.size(), unpacked.data(), unpacked.size());
+    unpacked.resize(n < 0 ? 0 : (size_t)n);
+    return n == (long)data.size() && unpacked == data;
+}
+
+static void testImplodeRoundTrip() {
+    std::mt19937 rng(1234);
+    auto random = [&](size_t size, int range) {
+        std::vector<uint8_t> v(size);
+        for (uint8_t& b : v) b = (uint8_t)(rng() % range);
+        return v;
+    };
+
+    CHECK(roundTrips({}));
+    CHECK(roundTrips({0x42}));
+    CHECK(roundTrips({1, 2}));
+    CHECK(roundTrips(std::vector<uint8_t>(replay_file::chunk_size, 0)));
+    CHECK(roundTrips(random(replay_file::chunk_size, 256)));     // Stored raw by the writer, but must still decode
+    CHECK(roundTrips(random(replay_file::chunk_size, 4)));       // Short matches everywhere
+    for (size_t size : {3, 4, 5, 100, 4095, 4096, 4097, 8191}) CHECK(roundTrips(random(size, 3)));
+
+    // Every match length up to the maximum, each at a distance of its own
+    std::vector<uint8_t> lengths;
+    for (int length = 2; length <= 520; ++length) {
+        std::vector<uint8_t> run = random((size_t)length, 256);
+        lengths.insert(lengths.end(), run.begin(), run.end());
+        lengths.insert(lengths.end(), 7, (uint8_t)length);
+        lengths.insert(lengths.end(), run.begin(), run.end());
+    }
+    CHECK(roundTrips(lengths));
+
+    // Matches at the edge of the 4 KB window and just beyond it
+    for (size_t distance : {1, 63, 64, 65, 4095, 4096, 4097}) {
+        std::vector<uint8_t> v = random(distance, 256);
+        std::vector<uint8_t> head(v.begin(), v.begin() + std::min<size_t>(distance, 40));
+        v.insert(v.end(), head.begin(), head.end());
+        CHECK(roundTrips(v));
+    }
+
+    // Replay-like data: action blocks with small frame deltas
+    std::vector<uint8_t> blocks;
+    for (uint32_t frame = 0; blocks.size() < 3 * replay_file::chunk_size; frame += 1 + rng() % 8) {
+        detail::append_u32(blocks, frame);
+        blocks.push_back(8);
+        uint8_t action[] = {0, 0x09, 1, (uint8_t)(rng() % 40), 0, 0x14, (uint8_t)rng(), (uint8_t)rng()};
+        blocks.insert(blocks.end(), action, action + sizeof(action));
+    }
+    CHECK(roundTrips(blocks));
+}
+
+static replay_header testHeader() {
+    replay_header h;
+    h.brood_war = true;
+    h.start_time = 0x12345678;
+    h.game_name = "test";
+    h.map_name = "map";
+    h.map_width = 64;
+    h.map_height = 96;
+    h.players[0].type = 2;
+    h.players[0].id = 0;
+    h.players[0].race = 1;
+    h.players[0].name = "Player";
+    h.players[1].slot = 1;
+    h.players[1].type = 1;
+    h.players[1].id = 1;
+    h.players[1].race = 0;
+    h.players[1].name = "Computer";
+    return h;
+}
+
+static std::vector<uint8_t> testChk() {
+    std::vector<uint8_t> chk;
+    std::mt19937 rng(99);
+    for (int i = 0; i < 20000; ++i) chk.push_back((uint8_t)(i % 37 == 0 ? rng() : i / 64));
+    return chk;
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+// encode_replay produces a file replay_file reads back section for section
+static void testEncodeReplay() {
+    replay_header header = testHeader();
+    header.frame_count = 500;
+    std::vector<uint8_t> chk = testChk();
+    std::vector<uint8_t> actions;
+    for (uint32_t frame = 0; frame < 3000; ++frame) {
+        detail::append_u32(actions, frame);
+        uint8_t block[] = {6, 0, 0x09, 1, (uint8_t)frame, 0, 0x1a};
+        actions.insert(actions.end(), block, block + sizeof(block));
+    }
+
+    std::string path = tempPath("openbw_encode_replay.rep");
+    CHECK(writeFile(path, encode_replay(header, actions.data(), actions.size(), chk)));
+    replay_file file;
+    std::string error;
+    CHECK(file.open(path, error));
+    CHECK(file.header().frame_count == 500);
+    CHECK(file.header().start_time == header.start_time);
+    CHECK(file.header().map_width == 64 && file.header().map_height == 96);
+    CHECK(file.header().players[0].type == 2 && file.header().players[0].race == 1);
+    CHECK(file.header().players[1].name == "Computer");
+    std::vector<uint8_t> decoded;
+    CHECK(file.decode(file.actions(), decoded) && decoded == actions);
+    CHECK(file.map_data(decoded) && decoded == chk);
+
+    // A setup replay, with no actions, reads back too
+    CHECK(writeFile(path, encode_replay(header, nullptr, 0, chk)));
+    replay_file empty;
+    CHECK(empty.open(path, error));
+    CHECK(empty.actions().size == 0);
+    replay_action_stream stream;
+    stream.reset(empty);
+    CHECK(stream.done());
+    std::remove(path.c_str());
+}
+
+// Recorded actions come back in their frames, split into blocks of at most
+// 255 bytes, through the background compressor and the save of the tail
+static void testRecorder() {
+    replay_recorder recorder;
+    recorder.start(testHeader(), testChk());
+    std::vector<uint8_t> actions;
+    std::vector<size_t> lengths;
+    const uint32_t frames = 2000;
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        actions.clear();
+        lengths.clear();
+        for (int i = 0; i < 40; ++i) {      // 40 selects of 12 units overflow a block
+            actions.push_back(0x09);
+            actions.push_back(12);
+            for (int k = 0; k < 12; ++k) {
+                actions.push_back((uint8_t)(frame + k));
+                actions.push_back((uint8_t)i);
+            }
+            lengths.push_back(26);
+        }
+        CHECK(recorder.record(frame, 0, actions.data(), lengths));
+    }
+
+    std::string path = tempPath("openbw_recorder.rep");
+    CHECK(recorder.save(path, frames));
+    recorder.stop();
+    replay_file file;
+    std::string error;
+    CHECK(file.open(path, error));
+    CHECK(file.header().frame_count == frames);
+
+    replay_action_stream stream;
+    stream.reset(file);
+    const uint8_t* data;
+    size_t size;
+    size_t total = 0;
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        size_t count = 0;
+        while (stream.next_block(frame, data, size)) {
+            for (size_t at = 0; at < size; at += 27, ++count) {
+                CHECK(data[at] == 0 && data[at + 1] == 0x09 && data[at + 3] == (uint8_t)frame);
+            }
+        }
+        CHECK(count == 40);
+        total += count;
+    }
+    CHECK(total == frames * 40);
+    CHECK(stream.done() && !stream.failed());
+    std::remove(path.c_str());
+}
+
+// An action too long for a block cuts the recording before its frame
+// instead of leaving it out
+static void testOversizedAction() {
+    replay_recorder recorder;
+    recorder.start(testHeader(), testChk());
+    std::vector<uint8_t> select = {0x09, 1, 5, 0};
+    CHECK(recorder.record(10, 0, select.data(), {select.size()}));
+
+    std::vector<uint8_t> big(replay_recorder::max_action_size + 1, 0x5c);
+    std::vector<uint8_t> frame20 = select;
+    frame20.insert(frame20.end(), big.begin(), big.end());
+    CHECK(!recorder.record(20, 0, frame20.data(), {select.size(), big.size()}));
+    CHECK(!recorder.record(30, 0, select.data(), {select.size()}));
+    CHECK(recorder.stats().cut_frame == 20);
+
+    std::string path = tempPath("openbw_oversized.rep");
+    CHECK(recorder.save(path, 100));
+    recorder.stop();
+    replay_file file;
+    std::string error;
+    CHECK(file.open(path, error));
+    CHECK(file.header().frame_count == 20);
+    replay_action_stream stream;
+    stream.reset(file);
+    const uint8_t* data;
+    size_t size;
+    CHECK(stream.next_block(100, data, size) && size == 5);
+    CHECK(!stream.next_block(100, data, size));
+    std::remove(path.c_str());
+}
+
+int main() {
+    testImplodeRoundTrip();
+    testEncodeReplay();
+    testRecorder();
+    testOversizedAction();
+    return openbw_ios_test::test_result();
+}
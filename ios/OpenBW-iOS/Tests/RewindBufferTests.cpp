@@ -0,0 +1,230 @@
+// RewindBufferTests.cpp
+// Snapshots restored through deltas and trims, the action log, and capture pacing
+
+#include "RewindBuffer.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace openbw_ios;
+
+static const size_t kImageSize = 16 * rewind_buffer::block_bytes + 40;   // A short last block
+
+// The state image of a frame: a fixed pattern with one block of it changed
+static std::vector<uint8_t> imageAt(int frame) {
+    std::vector<uint8_t> image(kImageSize);
+    for (size_t i = 0; i < image.size(); ++i) image[i] = (uint8_t)(i % 251);
+    size_t at = (size_t)(frame % 17) * rewind_buffer::block_bytes;
+    for (size_t i = at; i < std::min(at + rewind_buffer::block_bytes, image.size()); ++i) image[i] = (uint8_t)frame;
+    return image;
+}
+
+static void add(rewind_buffer& buffer, int frame, double build_ms = 0, bool measure = true) {
+    std::vector<uint8_t> image = imageAt(frame);
+    buffer.add(frame, image.data(), image.size(), build_ms, measure);
+}
+
+static bool restores(const rewind_buffer& buffer, int frame, int expected_frame) {
+    std::vector<uint8_t> image;
+    int image_frame = -1;
+    return buffer.restore(frame, image, image_frame) && image_frame == expected_frame && image == imageAt(expected_frame);
+}
+
+// Settings that capture every frame and keep everything, for the tests that
+// are not about limits
+static rewind_buffer::settings roomy() {
+    rewind_buffer::settings s;
+    s.window_frames = 1 << 20;
+    s.budget_bytes = size_t(1) << 30;
+    s.keyframe_every = 4;
+    s.capture_fraction = 1000;
+    return s;
+}
+
+// Every frame restores to the latest snapshot at or before it, through the
+// deltas after the nearest full image
+static void testRestore() {
+    rewind_buffer buffer(roomy());
+    std::vector<uint8_t> image;
+    int image_frame;
+    CHECK(!buffer.restore(0, image, image_frame));
+    for (int frame = 10; frame <= 50; frame += 2) add(buffer, frame);
+
+    CHECK(!buffer.restore(9, image, image_frame));
+    for (int frame = 10; frame <= 60; ++frame) CHECK(restores(buffer, frame, std::min(frame - frame % 2, 50)));
+    auto stats = buffer.stats();
+    CHECK(stats.snapshots == 21);
+    CHECK(stats.keyframes == 6);        // Captures 0, 4, ..., 20
+    CHECK(stats.oldest_frame == 10 && stats.newest_frame == 50);
+    CHECK(stats.bytes < 21 * kImageSize);
+
+    // An image of another size is always a full one
+    std::vector<uint8_t> bigger = imageAt(52);
+    bigger.resize(kImageSize + 1);
+    buffer.add(52, bigger.data(), bigger.size(), 0);
+    CHECK(buffer.stats().keyframes == 7);
+    CHECK(restores(buffer, 51, 50));
+}
+
+// Snapshots older than the window go, the delta after the oldest becoming a
+// full image, and the budget drops the oldest but never the newest
+static void testTrim() {
+    rewind_buffer::settings s = roomy();
+    s.window_frames = 10;
+    s.keyframe_every = 32;
+    rewind_buffer window(s);
+    for (int frame = 0; frame <= 40; ++frame) add(window, frame);
+    CHECK(window.oldest_frame() == 30);
+    CHECK(window.stats().keyframes == 2);   // Frame 32's, and the folded oldest
+    std::vector<uint8_t> image;
+    int image_frame;
+    CHECK(!window.restore(29, image, image_frame));
+    for (int frame = 30; frame <= 40; ++frame) CHECK(restores(window, frame, frame));
+
+    s = roomy();
+    s.keyframe_every = 32;
+    s.budget_bytes = 4 * kImageSize;
+    rewind_buffer budget(s);
+    for (int frame = 0; frame <= 200; ++frame) {
+        add(budget, frame);
+        CHECK(budget.stats().bytes <= s.budget_bytes);
+    }
+    CHECK(budget.oldest_frame() > 0);
+    for (int frame = budget.oldest_frame(); frame <= 200; ++frame) CHECK(restores(budget, frame, frame));
+
+    // Below two images only the newest and the diff base stay
+    s.budget_bytes = kImageSize;
+    budget.configure(s);
+    CHECK(budget.stats().snapshots == 1);
+    CHECK(restores(budget, 200, 200));
+    add(budget, 201);
+    CHECK(budget.stats().snapshots == 1);
+    CHECK(restores(budget, 250, 201));
+}
+
+// Logged actions come back in order between the bounds asked for, and only
+// from the oldest snapshot on
+static void testActions() {
+    rewind_buffer buffer(roomy());
+    uint8_t action[] = {0x1a, 0};
+    buffer.add_actions(0, 0, action, sizeof(action));       // Before any snapshot
+    add(buffer, 0);
+    for (int frame = 0; frame < 10; ++frame) {
+        action[1] = (uint8_t)frame;
+        buffer.add_actions(frame, frame % 2, action, sizeof(action));
+        add(buffer, frame + 1);
+    }
+    buffer.add_actions(3, 0, action, sizeof(action));       // Out of order
+    buffer.add_actions(10, 0, action, 0);                   // Empty
+
+    std::vector<int> frames;
+    buffer.for_each_action(2, 6, [&](int frame, int player, const uint8_t* data, size_t size) {
+        CHECK(player == frame % 2 && size == 2 && data[0] == 0x1a && data[1] == frame);
+        frames.push_back(frame);
+    });
+    CHECK((frames == std::vector<int>{2, 3, 4, 5}));
+    size_t count = 0;
+    buffer.for_each_action(0, 100, [&](int, int, const uint8_t*, size_t) { ++count; });
+    CHECK(count == 10);
+
+    rewind_buffer::settings s = roomy();
+    s.window_frames = 4;
+    buffer.configure(s);
+    CHECK(buffer.oldest_frame() == 6);
+    frames.clear();
+    buffer.for_each_action(0, 100, [&](int frame, int, const uint8_t*, size_t) { frames.push_back(frame); });
+    CHECK((frames == std::vector<int>{6, 7, 8, 9}));
+}
+
+// Going back forgets the later timeline: its snapshots, the actions from the
+// target frame on, and the diff base, so the next capture is a full image
+static void testTruncate() {
+    rewind_buffer buffer(roomy());
+    uint8_t action[] = {0x1a, 0};
+    for (int frame = 0; frame <= 20; ++frame) {
+        add(buffer, frame);
+        buffer.add_actions(frame, 0, action, sizeof(action));
+    }
+    buffer.truncate_after(12);
+    CHECK(buffer.newest_frame() == 12);
+    int last = -1;
+    buffer.for_each_action(0, 100, [&](int frame, int, const uint8_t*, size_t) { last = frame; });
+    CHECK(last == 11);
+    size_t keyframes = buffer.stats().keyframes;
+    add(buffer, 13);
+    CHECK(buffer.stats().keyframes == keyframes + 1);
+    for (int frame = 0; frame <= 13; ++frame) CHECK(restores(buffer, frame, frame));
+
+    // A capture at or before the newest replaces the snapshots after it
+    add(buffer, 8);
+    CHECK(buffer.newest_frame() == 8);
+    CHECK(restores(buffer, 20, 8));
+}
+
+// Captures are spaced by their average cost against the capture fraction, up
+// to max_interval; beyond it they are counted as overruns. Unmeasured
+// captures stay out of both.
+static void testPacing() {
+    rewind_buffer::settings s;
+    s.frame_ms = 40;
+    s.capture_fraction = 0.05;          // 2 ms per frame
+    s.max_interval = 48;
+    rewind_buffer buffer(s);
+
+    int frame = 0;
+    add(buffer, frame, 1);
+    auto stats = buffer.stats();
+    CHECK(stats.interval == 1 && stats.overruns == 0 && stats.captures == 1);
+
+    for (int i = 0; i < 40; ++i) {      // 19 ms each: under 10 frames' share
+        frame += buffer.stats().interval;
+        CHECK(buffer.due(frame));
+        add(buffer, frame, 19);
+    }
+    stats = buffer.stats();
+    CHECK(stats.wanted_interval == 10 && stats.interval == 10);
+    CHECK(stats.capture_ms >= 18.5 && stats.capture_ms < 19.5);
+    CHECK(stats.overruns >= 10);        // While the average caught up
+    for (int i = 0; i < 10; ++i) {      // Then none
+        frame += buffer.stats().interval;
+        CHECK(!buffer.due(frame - 1) && buffer.due(frame));
+        add(buffer, frame, 19);
+    }
+    CHECK(buffer.stats().overruns == stats.overruns);
+    size_t overruns = stats.overruns;
+
+    for (int i = 0; i < 60; ++i) {      // 500 ms each: more than max_interval frames' share
+        frame += buffer.stats().interval;
+        add(buffer, frame, 500);
+    }
+    stats = buffer.stats();
+    CHECK(stats.interval == 48);
+    CHECK(stats.wanted_interval > 200);
+    CHECK(stats.overruns >= overruns + 55);
+
+    // A verifying capture costs more but says nothing about the next
+    frame += stats.interval;
+    add(buffer, frame, 5000, false);
+    auto after = buffer.stats();
+    CHECK(after.captures == stats.captures + 1);
+    CHECK(after.capture_ms == stats.capture_ms);
+    CHECK(after.wanted_interval == stats.wanted_interval);
+    CHECK(after.overruns == stats.overruns);
+    CHECK(after.unmeasured_ms >= 5000);
+
+    buffer.clear();
+    stats = buffer.stats();
+    CHECK(stats.snapshots == 0 && stats.captures == 0 && stats.overruns == 0);
+    CHECK(stats.interval == 1 && stats.wanted_interval == 1 && stats.unmeasured_ms == 0);
+    CHECK(buffer.due(frame));
+}
+
+int main() {
+    testRestore();
+    testTrim();
+    testActions();
+    testTruncate();
+    testPacing();
+    return openbw_ios_test::test_result();
+}
@@ -0,0 +1,391 @@
+// StateImageTests.cpp
+// Round trips on a real map: state images, map images and recorded games
+//
+// Needs the game data and a map: --data <dir with MPQs> --map <file>, or
+// OPENBW_TEST_DATA and OPENBW_TEST_MAP. Skipped when neither is given.
+
+#define OPENBW_HEADLESS 1
+
+#include "bwgame.h"
+#include "actions.h"
+#include "data_loading.h"
+#include "replay.h"
+
+#include "ArchiveService.h"
+#include "CommandBuffer.h"
+#include "MapImageSchema.h"
+#include "MeleeSetup.h"
+#include "ReplayReader.h"
+#include "ReplayWriter.h"
+#include "StateImageSchema.h"
+#include "TestSupport.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace openbw_ios;
+
+static std::vector<std::string> findArchives(const std::string& dataDir) {
+    std::vector<std::string> paths;
+    for (const char* wanted : {"patch_rt.mpq", "broodat.mpq", "stardat.mpq"}) {
+        DIR* dir = opendir(dataDir.c_str());
+        if (!dir) break;
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            for (char& c : name) c = (char)tolower((unsigned char)c);
+            if (name == wanted) {
+                paths.push_back(dataDir + "/" + entry->d_name);
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return paths;
+}
+
+// Hash of the state as its image, which covers every saved member
+static uint64_t stateHash(bwgame::state& st, std::vector<uint8_t>* image = nullptr) {
+    state_image_writer writer;
+    std::string error;
+    bwgame::state_functions funcs(st);
+    auto copy = std::make_unique<bwgame::state>(bwgame::copy_state(st));
+    bool ok = write_state_image(writer, st, funcs, 1, copy.get(), error);
+    if (!ok) std::fprintf(stderr, "write_state_image: %s\n", error.c_str());
+    CHECK(ok);
+    const std::vector<uint8_t>& bytes = writer.finish();
+    if (image) *image = bytes;
+    return fnv1a64(bytes.data(), bytes.size());
+}
+
+static uint64_t stateHash(bwgame::game_player& player, std::vector<uint8_t>* image = nullptr) {
+    return stateHash(player.st(), image);
+}
+
+static void step(bwgame::game_player& player, int frames) {
+    for (int i = 0; i < frames; ++i) player.funcs().next_frame();
+}
+
+// Workers of two players walking across the map, so stepping moves units,
+// sprites and images and allocates orders. Each row starts a little further
+// from the middle.
+static void addMovingUnits(bwgame::state& st, bwgame::state_functions& funcs, int row = 0) {
+    int width = st.game->map_width;
+    int height = st.game->map_height;
+    for (int owner = 0; owner < 2; ++owner) {
+        for (int i = 0; i < 6; ++i) {
+            int y = owner == 0 ? height / 4 - row * 40 : height * 3 / 4 + row * 40;
+            bwgame::xy from(width / 4 + i * 32, std::max(32, std::min(height - 32, y)));
+            bwgame::xy to(width * 3 / 4 - i * 32, owner == 0 ? height * 3 / 4 : height / 4);
+            bwgame::unit_t* u = funcs.create_unit(funcs.get_unit_type(bwgame::UnitTypes::Terran_SCV), from, owner);
+            if (!u) continue;
+            funcs.finish_building_unit(u);
+            funcs.set_unit_order(u, funcs.get_order_type(bwgame::Orders::Move), to);
+        }
+    }
+}
+
+static void addMovingUnits(bwgame::game_player& player) {
+    addMovingUnits(player.st(), player.funcs());
+}
+
+static void testRoundTrip(bwgame::game_player& player) {
+    addMovingUnits(player);
+    step(player, 100);
+
+    std::vector<uint8_t> saved;
+    uint64_t savedHash = stateHash(player, &saved);
+    int savedFrame = player.st().current_frame;
+    step(player, 200);
+    uint64_t steppedHash = stateHash(player);
+    CHECK(steppedHash != savedHash);
+
+    state_image_reader reader;
+    object_regions regions;
+    std::string error;
+    auto copy = std::make_unique<bwgame::state>(bwgame::copy_state(player.st()));
+    bool ok = reader.open(saved.data(), saved.size(), state_image_schema::get().key, error) &&
+              prepare_state_image(reader, player.st(), player.funcs(), 1, copy.get(), regions, error) &&
+              read_state_image(reader, player.st(), regions, error);
+    if (!ok) std::fprintf(stderr, "load: %s\n", error.c_str());
+    CHECK(ok);
+    CHECK(player.st().current_frame == savedFrame);
+    CHECK(stateHash(player) == savedHash);
+
+    // The loaded state plays out exactly as the original did
+    step(player, 200);
+    CHECK(stateHash(player) == steppedHash);
+}
+
+// An image only loads on the map it was saved on
+static void testWrongMap(bwgame::game_player& player) {
+    std::vector<uint8_t> saved;
+    stateHash(player, &saved);
+    state_image_reader reader;
+    object_regions regions;
+    std::string error;
+    CHECK(reader.open(saved.data(), saved.size(), state_image_schema::get().key, error));
+    CHECK(!prepare_state_image(reader, player.st(), player.funcs(), 2, nullptr, regions, error));
+}
+
+// A map loaded into a state of its own on the player's game data
+struct LoadedMap {
+    std::unique_ptr<bwgame::game_state> game = std::make_unique<bwgame::game_state>();
+    std::unique_ptr<bwgame::state> st = std::make_unique<bwgame::state>();
+
+    explicit LoadedMap(bwgame::game_player& player) {
+        st->global = player.st().global;
+        st->game = game.get();
+    }
+};
+
+// A map image reads back to the state load_map_file left, and the map plays
+// out the same from it
+static void testMapImage(bwgame::game_player& player, const std::string& mapPath) {
+    LoadedMap first(player), second(player), restored(player);
+    bwgame::game_load_functions(*first.st).load_map_file(mapPath);
+    bwgame::game_load_functions(*second.st).load_map_file(mapPath);
+
+    state_image_writer writer;
+    std::string error;
+    bool ok = write_map_image(writer, *first.st, *second.st, 1, error);
+    if (!ok) std::fprintf(stderr, "write_map_image: %s\n", error.c_str());
+    CHECK(ok);
+    if (!ok) return;
+    const std::vector<uint8_t>& image = writer.finish();
+
+    state_image_reader reader;
+    ok = reader.open(image.data(), image.size(), map_image_schema::get().key, error) &&
+         read_map_image(reader, *restored.st, 1, error);
+    if (!ok) std::fprintf(stderr, "read_map_image: %s\n", error.c_str());
+    CHECK(ok);
+    if (!ok) return;
+    CHECK(restored.game->map_width == first.game->map_width);
+    CHECK(restored.game->regions.regions.size() == first.game->regions.regions.size());
+    CHECK(stateHash(*restored.st) == stateHash(*first.st));
+
+    bwgame::state_functions loadedFuncs(*first.st);
+    bwgame::state_functions restoredFuncs(*restored.st);
+    for (int i = 0; i < 200; ++i) {
+        loadedFuncs.next_frame();
+        restoredFuncs.next_frame();
+    }
+    CHECK(stateHash(*restored.st) == stateHash(*first.st));
+}
+
+static std::vector<uint8_t> readMapChk(const std::string& mapPath) {
+    bwgame::data_loading::mpq_file<> mpq(bwgame::a_string(mapPath.begin(), mapPath.end()));
+    bwgame::a_vector<uint8_t> data;
+    mpq(data, "staredit\\scenario.chk");
+    return std::vector<uint8_t>(data.begin(), data.end());
+}
+
+static std::string tempPath(const char* name) {
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = dir && *dir ? dir : "/tmp";
+    if (path.back() != '/') path += '/';
+    return path + name;
+}
+
+// Execute actions for owner, recording the length of each one that ran
+static void executeActions(bwgame::action_functions& funcs, int owner, const std::vector<uint8_t>& actions,
+                           std::vector<size_t>& lengths) {
+    lengths.clear();
+    bwgame::data_loading::data_reader_le r(actions.data(), actions.data() + actions.size());
+    while (r.left()) {
+        size_t left = r.left();
+        bool ok = funcs.read_action(r, owner);
+        CHECK(ok);
+        if (!ok) return;
+        lengths.push_back(left - r.left());
+    }
+}
+
+// A game set up by the engine's melee setup and recorded while its units are
+// ordered around plays back from its replay file, the way the app plays
+// replays, to exactly the same state
+static void testRecordedGame(bwgame::game_player& player, const std::string& mapPath) {
+    std::vector<uint8_t> chk = readMapChk(mapPath);
+    replay_header header;
+    bool ok = melee_game_header(chk, "test", bwgame::race_t::terran, bwgame::race_t::zerg, header);
+    CHECK(ok);
+    if (!ok) return;
+
+    LoadedMap live(player);
+    bwgame::action_state liveActions;
+    load_melee_game(*live.st, liveActions, header, chk);
+    bwgame::action_functions liveFuncs(*live.st, liveActions);
+
+    replay_recorder recorder;
+    recorder.start(header, chk);
+    std::vector<uint8_t> actions;
+    std::vector<size_t> lengths;
+    int width = live.st->game->map_width;
+    int height = live.st->game->map_height;
+    for (int frame = 0; frame < 600; ++frame) {
+        if (frame % 150 == 10) {
+            // The player's units, sent to alternating quarters of the map
+            command_record r;
+            r.action = game_action::right_click;
+            r.x = (uint16_t)(frame % 300 == 10 ? width / 4 : width * 3 / 4);
+            r.y = (uint16_t)(height / 2);
+            for (bwgame::unit_t* u : bwgame::ptr(live.st->visible_units)) {
+                if (u->owner != melee_setup::human_slot || r.unit_count == game_action::max_selection) continue;
+                r.units[r.unit_count++] = liveFuncs.get_unit_id(u).raw_value;
+            }
+            CHECK(r.unit_count > 0);
+            actions.clear();
+            encode_command_actions({r}, actions);
+            executeActions(liveFuncs, melee_setup::human_slot, actions, lengths);
+            CHECK(recorder.record((uint32_t)frame, melee_setup::human_slot, actions.data(), lengths));
+        }
+        liveFuncs.next_frame();
+    }
+    std::string path = tempPath("openbw_recorded_game.rep");
+    CHECK(recorder.save(path, (uint32_t)live.st->current_frame));
+    recorder.stop();
+
+    replay_file file;
+    std::string error;
+    ok = file.open(path, error);
+    if (!ok) std::fprintf(stderr, "replay_file::open: %s\n", error.c_str());
+    CHECK(ok);
+    if (!ok) return;
+    CHECK(file.header().start_time == header.start_time);
+    CHECK(file.header().frame_count == (uint32_t)live.st->current_frame);
+
+    LoadedMap played(player);
+    bwgame::action_state playedActions;
+    std::vector<uint8_t> setup = file.without_actions();
+    bwgame::replay_state replaySt;
+    bwgame::replay_functions loader(*played.st, playedActions, replaySt);
+    loader.load_replay_data(setup.data(), setup.size());
+    bwgame::action_functions playedFuncs(*played.st, playedActions);
+    replay_action_stream stream;
+    stream.reset(file);
+    while (played.st->current_frame < live.st->current_frame) {
+        const uint8_t* data;
+        size_t size;
+        while (stream.next_block((uint32_t)played.st->current_frame, data, size)) {
+            bwgame::data_loading::data_reader_le r(data, data + size);
+            while (r.left()) {
+                int owner = file.header().owner_for_id(r.get<uint8_t>());
+                bool read = owner >= 0 && playedFuncs.read_action(r, owner);
+                CHECK(read);
+                if (!read) break;
+            }
+        }
+        playedFuncs.next_frame();
+    }
+    CHECK(stateHash(*played.st) == stateHash(*live.st));
+    std::remove(path.c_str());
+}
+
+template<typename F>
+static double averageMs(int runs, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+// Saving and loading a game some minutes in, with many units about, with and
+// without the deep check against a copy_state that debug builds add. Prints
+// the times; checks only that the light path round-trips.
+static void testLateGameTiming(bwgame::game_player& player, const std::string& mapPath) {
+    std::vector<uint8_t> chk = readMapChk(mapPath);
+    replay_header header;
+    bool ok = melee_game_header(chk, "test", bwgame::race_t::terran, bwgame::race_t::protoss, header);
+    CHECK(ok);
+    if (!ok) return;
+    LoadedMap game(player);
+    bwgame::action_state actions;
+    load_melee_game(*game.st, actions, header, chk);
+    bwgame::state_functions funcs(*game.st);
+    for (int row = 0; row < 16; ++row) addMovingUnits(*game.st, funcs, row);
+    for (int i = 0; i < 5000; ++i) funcs.next_frame();  // About 3.5 minutes
+    size_t units = 0;
+    for (bwgame::unit_t* u : bwgame::ptr(game.st->visible_units)) units += u->owner < 8;   // Not neutral
+
+    const int runs = 20;
+    std::string error;
+    state_image_writer writer;
+    ok = true;
+    double saveMs = averageMs(runs, [&] {
+        ok &= write_state_image(writer, *game.st, funcs, 1, nullptr, error);
+    });
+    double deepSaveMs = averageMs(runs, [&] {
+        auto copy = std::make_unique<bwgame::state>(bwgame::copy_state(*game.st));
+        ok &= write_state_image(writer, *game.st, funcs, 1, copy.get(), error);
+    });
+    if (!ok) std::fprintf(stderr, "write_state_image: %s\n", error.c_str());
+    CHECK(ok);
+    if (!ok) return;
+    std::vector<uint8_t> saved = writer.finish();
+    uint64_t savedHash = fnv1a64(saved.data(), saved.size());
+
+    auto load = [&](bool deep) {
+        state_image_reader reader;
+        object_regions regions;
+        std::unique_ptr<bwgame::state> copy;
+        if (deep) copy = std::make_unique<bwgame::state>(bwgame::copy_state(*game.st));
+        ok &= reader.open(saved.data(), saved.size(), state_image_schema::get().key, error) &&
+              prepare_state_image(reader, *game.st, funcs, 1, copy.get(), regions, error) &&
+              read_state_image(reader, *game.st, regions, error);
+    };
+    double loadMs = averageMs(runs, [&] { load(false); });
+    double deepLoadMs = averageMs(runs, [&] { load(true); });
+    if (!ok) std::fprintf(stderr, "load: %s\n", error.c_str());
+    CHECK(ok);
+    CHECK(stateHash(*game.st) == savedHash);
+
+    std::printf("late game (frame %d, %zu player units, %zu KB image): save %.2f ms (%.2f ms deep), load %.2f ms (%.2f ms deep)\n",
+                game.st->current_frame, units, saved.size() / 1024, saveMs, deepSaveMs, loadMs, deepLoadMs);
+}
+
+int main(int argc, char** argv) {
+    std::string dataDir, mapPath;
+    if (const char* v = std::getenv("OPENBW_TEST_DATA")) dataDir = v;
+    if (const char* v = std::getenv("OPENBW_TEST_MAP")) mapPath = v;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (!*argv[i + 1]) continue;        // Empty when CMake was given no path
+        if (arg == "--data") dataDir = argv[i + 1];
+        else if (arg == "--map") mapPath = argv[i + 1];
+    }
+    if (dataDir.empty() || mapPath.empty()) {
+        std::fprintf(stderr, "skipped: no game data or map given\n");
+        return openbw_ios_test::test_skip;
+    }
+
+    try {
+        archive_service archives;
+        std::vector<std::string> mpqs = findArchives(dataDir);
+        if (mpqs.empty()) {
+            std::fprintf(stderr, "skipped: no game archives in %s\n", dataDir.c_str());
+            return openbw_ios_test::test_skip;
+        }
+        archives.open(mpqs);
+        bwgame::game_player player;
+        player.init(archives.data_loader());
+        player.load_map_file(mapPath);
+
+        testRoundTrip(player);
+        testWrongMap(player);
+        testMapImage(player, mapPath);
+        testRecordedGame(player, mapPath);
+        testLateGameTiming(player, mapPath);
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return openbw_ios_test::test_result();
+}
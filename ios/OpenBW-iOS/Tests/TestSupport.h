@@ -0,0 +1,38 @@
+// TestSupport.h
+// Minimal checks for the host test executables
+//
+// Portable C++14. Each test executable is a plain main() that runs its cases
+// with CHECK and returns test_result(): nonzero if any check failed, or
+// test_skip when the data a test needs is not available (ctest reports it as
+// skipped rather than passed).
+
+#ifndef TESTSUPPORT_H
+#define TESTSUPPORT_H
+
+#include <cstdio>
+
+namespace openbw_ios_test {
+
+static constexpr int test_skip = 77;
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int test_result() {
+    if (failures()) std::fprintf(stderr, "%d check(s) failed\n", failures());
+    return failures() ? 1 : 0;
+}
+
+} // namespace openbw_ios_test
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++openbw_ios_test::failures();                                                  \
+        }                                                                                   \
+    } while (0)
+
+#endif // TESTSUPPORT_H